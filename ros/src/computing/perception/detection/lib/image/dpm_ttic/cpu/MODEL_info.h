@@ -74,11 +74,14 @@ struct Partfilters {
 	int *part_sym;		//symmetric information of part filter
 };
 
+struct BufferPool;
+
 //model information
 struct MODEL {
 	Model_info *MI;
 	Rootfilters *RF;
 	Partfilters *PF;
+	BufferPool *pool;	//feature pyramid buffers reused across frames
 };
 
 //Result of Detection
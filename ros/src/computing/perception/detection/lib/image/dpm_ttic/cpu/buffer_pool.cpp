@@ -0,0 +1,101 @@
+/////buffer_pool.cpp   size-keyed free list for pyramid images, histograms and features ///////////////////////
+
+#include <cstdlib>
+#include <cstring>
+#include <map>
+#include <mutex>
+#include <unordered_map>
+
+#include "buffer_pool.hpp"
+
+//released blocks kept for the next frame (a pyramid needs a few buffers per level)
+static const size_t MAX_CACHED_BLOCKS = 512;
+
+struct BufferPool {
+	std::mutex mutex;
+	std::multimap<size_t, void *> free_blocks;		//capacity -> released block
+	std::unordered_map<void *, size_t> capacity;		//capacity of every block handed out
+};
+
+BufferPool *dpm_ttic_cpu_create_buffer_pool()
+{
+	return new BufferPool();
+}
+
+void dpm_ttic_cpu_destroy_buffer_pool(BufferPool *pool)
+{
+	if (pool == nullptr)
+		return;
+
+	for (auto& block : pool->free_blocks)
+		std::free(block.second);
+	for (auto& block : pool->capacity)
+		std::free(block.first);
+	delete pool;
+}
+
+void *dpm_ttic_cpu_pool_malloc(BufferPool *pool,size_t size)
+{
+	if (pool == nullptr)
+		return std::malloc(size);
+	if (size == 0)
+		size = 1;
+
+	std::lock_guard<std::mutex> lock(pool->mutex);
+
+	//smallest cached block that fits, unless it would waste more than half of itself
+	auto it = pool->free_blocks.lower_bound(size);
+	if (it != pool->free_blocks.end() && it->first <= size * 2) {
+		void *ptr = it->second;
+		pool->capacity.emplace(ptr, it->first);
+		pool->free_blocks.erase(it);
+		return ptr;
+	}
+
+	void *ptr = std::malloc(size);
+	if (ptr != nullptr)
+		pool->capacity.emplace(ptr, size);
+	return ptr;
+}
+
+void *dpm_ttic_cpu_pool_calloc(BufferPool *pool,size_t num,size_t size)
+{
+	if (pool == nullptr)
+		return std::calloc(num, size);
+
+	void *ptr = dpm_ttic_cpu_pool_malloc(pool, num * size);
+	if (ptr != nullptr)
+		std::memset(ptr, 0, num * size);
+	return ptr;
+}
+
+void dpm_ttic_cpu_pool_free(BufferPool *pool,void *ptr)
+{
+	if (pool == nullptr || ptr == nullptr) {
+		std::free(ptr);
+		return;
+	}
+
+	std::lock_guard<std::mutex> lock(pool->mutex);
+
+	auto it = pool->capacity.find(ptr);
+	if (it == pool->capacity.end()) {	//not allocated from this pool
+		std::free(ptr);
+		return;
+	}
+
+	size_t cap = it->second;
+	pool->capacity.erase(it);
+
+	if (pool->free_blocks.size() >= MAX_CACHED_BLOCKS) {
+		//drop the smallest cached block, large ones are the expensive ones to get back
+		auto smallest = pool->free_blocks.begin();
+		if (smallest->first >= cap) {
+			std::free(ptr);
+			return;
+		}
+		std::free(smallest->second);
+		pool->free_blocks.erase(smallest);
+	}
+	pool->free_blocks.emplace(cap, ptr);
+}
@@ -0,0 +1,17 @@
+#ifndef _BUFFER_POOL_H_
+#define _BUFFER_POOL_H_
+
+#include <cstddef>
+
+//buffers of the feature pyramid kept alive between frames (one pool per detector)
+struct BufferPool;
+
+extern BufferPool *dpm_ttic_cpu_create_buffer_pool();
+extern void dpm_ttic_cpu_destroy_buffer_pool(BufferPool *pool);
+
+//malloc/calloc/free replacements, a null pool falls back to the C library
+extern void *dpm_ttic_cpu_pool_malloc(BufferPool *pool,size_t size);
+extern void *dpm_ttic_cpu_pool_calloc(BufferPool *pool,size_t num,size_t size);
+extern void dpm_ttic_cpu_pool_free(BufferPool *pool,void *ptr);
+
+#endif /* _BUFFER_POOL_H_ */
@@ -44,7 +44,7 @@ static FLOAT *detect(IplImage *IM,MODEL *MO,FLOAT thresh,int *D_NUMS,FLOAT *A_SC
 	//calculate feature pyramid
 
 	gettimeofday(&tv_calc_f_pyramid_start, NULL);
-	FLOAT **feature = dpm_ttic_cpu_calc_f_pyramid(IM,MO->MI,featsize,scales);
+	FLOAT **feature = dpm_ttic_cpu_calc_f_pyramid(IM,MO->MI,featsize,scales,MO->pool);
 	gettimeofday(&tv_calc_f_pyramid_end, NULL);
 	tvsub(&tv_calc_f_pyramid_end, &tv_calc_f_pyramid_start, &tv);
 	printf("\n");
@@ -55,7 +55,7 @@ static FLOAT *detect(IplImage *IM,MODEL *MO,FLOAT thresh,int *D_NUMS,FLOAT *A_SC
 
 	free(scales);
 	free(featsize);
-	dpm_ttic_cpu_free_features(feature, MO->MI);
+	dpm_ttic_cpu_free_features(feature, MO->MI, MO->pool);
 
 	return boxes;
 }
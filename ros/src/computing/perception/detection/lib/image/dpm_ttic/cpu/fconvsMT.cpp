@@ -4,32 +4,103 @@
 
 /////fconvsMT.cpp  convolute features and filter  /////////////////////////////////////////////////////////////////
 
-//C++ library (thread-functions are only supported by windows)
+//C++ library
 #include <cstdio>
 #include <cstdlib>
+#include <cstring>
+#include <vector>
 
-#include <pthread.h>
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define DPM_TTIC_X86
+#endif
 
 //Original header
 #include "MODEL_info.h"		//File information
 #include "common.hpp"
 #include "switch_float.h"
+#include "worker_pool.hpp"
+
+//output columns handled by one task
+#define COLUMNS_PER_TASK 4
 
 struct thread_data {
 	FLOAT *A;
 	FLOAT *B;
 	FLOAT *C;
 	FLOAT *F;
-	FLOAT *T;
 	int A_dims[3];
 	int B_dims[3];
 	int C_dims[2];
+	int sym;
 };
 
-//thread process
-// convolve A and B(non_symmetric)
-static void* process(void *thread_arg) {
-	thread_data *args = (thread_data *)thread_arg;
+//dst[0..n) += src[0..n) * b
+typedef void (*axpy_func)(FLOAT *dst, const FLOAT *src, FLOAT b, int n);
+
+static void axpy_scalar(FLOAT *dst, const FLOAT *src, FLOAT b, int n)
+{
+	for (int i = 0; i < n; i++)
+		dst[i] += src[i] * b;
+}
+
+#if defined(DPM_TTIC_X86) && defined(FLOAT_IS_float)
+static void axpy_sse(FLOAT *dst, const FLOAT *src, FLOAT b, int n)
+{
+	__m128 vb = _mm_set1_ps(b);
+	int i = 0;
+	for (; i + 4 <= n; i += 4)
+		_mm_storeu_ps(dst + i, _mm_add_ps(_mm_loadu_ps(dst + i), _mm_mul_ps(_mm_loadu_ps(src + i), vb)));
+	axpy_scalar(dst + i, src + i, b, n - i);
+}
+
+__attribute__((target("avx2,fma")))
+static void axpy_avx2(FLOAT *dst, const FLOAT *src, FLOAT b, int n)
+{
+	__m256 vb = _mm256_set1_ps(b);
+	int i = 0;
+	for (; i + 16 <= n; i += 16) {
+		_mm256_storeu_ps(dst + i, _mm256_fmadd_ps(_mm256_loadu_ps(src + i), vb, _mm256_loadu_ps(dst + i)));
+		_mm256_storeu_ps(dst + i + 8, _mm256_fmadd_ps(_mm256_loadu_ps(src + i + 8), vb, _mm256_loadu_ps(dst + i + 8)));
+	}
+	for (; i + 8 <= n; i += 8)
+		_mm256_storeu_ps(dst + i, _mm256_fmadd_ps(_mm256_loadu_ps(src + i), vb, _mm256_loadu_ps(dst + i)));
+	axpy_scalar(dst + i, src + i, b, n - i);
+}
+#endif
+
+//pick the widest kernel supported by the running cpu
+static axpy_func select_axpy()
+{
+#if defined(DPM_TTIC_X86) && defined(FLOAT_IS_float)
+	__builtin_cpu_init();
+	if (__builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma"))
+		return axpy_avx2;
+	return axpy_sse;
+#else
+	return axpy_scalar;
+#endif
+}
+
+static const axpy_func axpy = select_axpy();
+
+//add the response of one filter over the band of columns feat to the output column dst.
+//feat and the filter are column major, each filter element scales a whole output column at once
+static inline void convolve_column(FLOAT *dst, const FLOAT *feat, int feat_rows, const FLOAT *filter,
+				   int filter_rows, int filter_cols, int out_rows)
+{
+	for (int xp = 0; xp < filter_cols; xp++)
+	{
+		const FLOAT *A_col = feat + xp*feat_rows;
+		const FLOAT *B_col = filter + xp*filter_rows;
+		for (int yp = 0; yp < filter_rows; yp++)
+			axpy(dst, A_col + yp, B_col[yp], out_rows);
+	}
+}
+
+// convolve A and B(non_symmetric) for output columns [x_start, x_end)
+static void process(thread_data *args, int x_start, int x_end)
+{
 	FLOAT *A = args->A;	//feature
 	FLOAT *B = args->B;	//filter
 	FLOAT *C = args->C;	//output
@@ -41,77 +112,24 @@ static void* process(void *thread_arg) {
 	const int A_SQ = A_dims[0]*A_dims[1];
 	const int B_SQ = B_dims[0]*B_dims[1];
 
-	for (int f = 0; f < num_features; f++)
+	for (int x = x_start; x < x_end; x++)
 	{
-		FLOAT *dst = C;
-		FLOAT *A_src = A + f*A_SQ;
-		FLOAT *B_src = B + f*B_SQ;
-		int XA0 = 0;
-		for (int x = 0; x < C_dims[1]; x++)
+		FLOAT *dst = C + x*C_dims[0];
+		for (int f = 0; f < num_features; f++)
 		{
-			FLOAT *A_src2 =A_src+XA0;
-			XA0+=A_dims[0];
-			for (int y = 0; y < C_dims[0]; y++)
-			{
-				FLOAT val = 0;
-				FLOAT *A_off = A_src2+y;
-				FLOAT *B_off = B_src;
-				for (int xp = 0; xp < B_dims[1]; xp++)
-				{
-					switch(B_dims[0])
-					{
-					case 20: val += A_off[19] * B_off[19];
-					case 19: val += A_off[18] * B_off[18];
-					case 18: val += A_off[17] * B_off[17];
-					case 17: val += A_off[16] * B_off[16];
-					case 16: val += A_off[15] * B_off[15];
-					case 15: val += A_off[14] * B_off[14];
-					case 14: val += A_off[13] * B_off[13];
-					case 13: val += A_off[12] * B_off[12];
-					case 12: val += A_off[11] * B_off[11];
-					case 11: val += A_off[10] * B_off[10];
-					case 10: val += A_off[9] * B_off[9];
-					case 9: val += A_off[8] * B_off[8];
-					case 8: val += A_off[7] * B_off[7];
-					case 7: val += A_off[6] * B_off[6];
-					case 6: val += A_off[5] * B_off[5];
-					case 5: val += A_off[4] * B_off[4];
-					case 4: val += A_off[3] * B_off[3];
-					case 3: val += A_off[2] * B_off[2];
-					case 2: val += A_off[1] * B_off[1];
-					case 1: val += A_off[0] * B_off[0];
-						break;
-					default:
-						FLOAT *A_temp = A_off;
-						FLOAT *B_temp = B_off;
-						for (int yp = 0; yp < B_dims[0]; yp++)
-						{
-							val += *(A_temp++) * *(B_temp++);
-						}
-					}
-					A_off+=A_dims[0];
-					B_off+=B_dims[0];
-				}
-				*(dst++) += val;
-			}
+			convolve_column(dst, A + f*A_SQ + x*A_dims[0], A_dims[0], B + f*B_SQ,
+					B_dims[0], B_dims[1], C_dims[0]);
 		}
-		A_src+=A_SQ;
-		B_src+=B_SQ;
 	}
-
-	pthread_exit((void*)thread_arg);
-	return nullptr;
 }
 
-// convolve A and B when B is symmetric
-static void* processS(void *thread_arg)
+// convolve A and B when B is symmetric for output columns [x_start, x_end)
+static void processS(thread_data *args, int x_start, int x_end)
 {
-	thread_data *args = (thread_data *)thread_arg;
 	FLOAT *A = args->A;
 	FLOAT *B = args->B;
 	FLOAT *C = args->C;
 	FLOAT *F = args->F;
-	FLOAT *T = args->T;
 	int *A_dims = args->A_dims;
 	int *B_dims = args->B_dims;
 	int *C_dims = args->C_dims;
@@ -126,78 +144,26 @@ static void* processS(void *thread_arg)
 	const int XF_L = A_dims[1]-width1-width2;
 	const int CP_L_S = CP_L*sizeof(FLOAT);
 
-	for (int f = 0; f < num_features; f++)
+	std::vector<FLOAT> T(CP_L);
+
+	for (int x = x_start; x < x_end; x++)
 	{
-		FLOAT *dst = C;
-		FLOAT *A_src = A + f*A_SQ;
-		FLOAT *B_src = B + f*B_SQ;
-		FLOAT *F_src = F + f*A_SQ;
-		int XA = 0;
-		for (int x = 0; x < C_dims[1]; x++)
+		FLOAT *dst = C + x*C_dims[0];
+		int xf = XF_L-x;
+		for (int f = 0; f < num_features; f++)
 		{
 			// generate tmp data for band of output
-			memcpy(T, A_src + XA, CP_L_S);
-			XA+=A_dims[0];
-			int xf = XF_L-x;
-			FLOAT *copy_dst = T;
-			FLOAT *copy_end = T + T_L;
+			FLOAT *A_src = A + f*A_SQ;
+			FLOAT *F_src = F + f*A_SQ;
+			memcpy(T.data(), A_src + x*A_dims[0], CP_L_S);
 			FLOAT *copy_src = F_src + xf*A_dims[0];
-			while (copy_dst < copy_end)
-			{
-				*copy_dst += *copy_src;
-				copy_dst++;
-				copy_src++;
-			}
-
-			for (int y = 0; y < C_dims[0]; y++)
-			{
-				FLOAT val = 0;
-				FLOAT *T_off = T+y;
-				FLOAT *B_off = B_src;
-				for (int xp = 0; xp < width1; xp++)
-				{
-					switch(B_dims[0]) {
-					case 20: val += T_off[19] * B_off[19];
-					case 19: val += T_off[18] * B_off[18];
-					case 18: val += T_off[17] * B_off[17];
-					case 17: val += T_off[16] * B_off[16];
-					case 16: val += T_off[15] * B_off[15];
-					case 15: val += T_off[14] * B_off[14];
-					case 14: val += T_off[13] * B_off[13];
-					case 13: val += T_off[12] * B_off[12];
-					case 12: val += T_off[11] * B_off[11];
-					case 11: val += T_off[10] * B_off[10];
-					case 10: val += T_off[9] * B_off[9];
-					case 9: val += T_off[8] * B_off[8];
-					case 8: val += T_off[7] * B_off[7];
-					case 7: val += T_off[6] * B_off[6];
-					case 6: val += T_off[5] * B_off[5];
-					case 5: val += T_off[4] * B_off[4];
-					case 4: val += T_off[3] * B_off[3];
-					case 3: val += T_off[2] * B_off[2];
-					case 2: val += T_off[1] * B_off[1];
-					case 1: val += T_off[0] * B_off[0];
-						break;
-					default:
-						FLOAT *T_temp = T_off;
-						FLOAT *B_temp = B_off;
-						for (int yp = 0; yp < B_dims[0]; yp++)
-						{
-							val += *(T_temp++) * *(B_temp++);
-						}
-					}
-					T_off+=A_dims[0];
-					B_off+=B_dims[0];
-				}
-
-				*(dst++) += val;
-			}
+			for (int i = 0; i < T_L; i++)
+				T[i] += copy_src[i];
+
+			convolve_column(dst, T.data(), A_dims[0], B + f*B_SQ,
+					B_dims[0], width1, C_dims[0]);
 		}
 	}
-
-	pthread_exit((void*)thread_arg);
-
-	return nullptr;
 }
 
 //Input(feat,flipfeat,filter,symmetric info,1,length)
@@ -210,9 +176,15 @@ FLOAT **dpm_ttic_cpu_fconvsMT(FLOAT*feat,FLOAT*flfeat,FLOAT**filter,int *sym_inf
 
 	const int len=end-start+1;
 	FLOAT **Output=(FLOAT**)malloc(sizeof(FLOAT*)*len);		//Output (cell)
-	// start threads
 	thread_data *td = (thread_data *)calloc(len, sizeof(thread_data));
-	pthread_t *ts = (pthread_t *)calloc(len, sizeof(pthread_t));
+
+	//every task convolves one filter over a few output columns
+	struct task {
+		int filter;
+		int x_start;
+		int x_end;
+	};
+	std::vector<task> tasks;
 
 	for(int ii=0;ii<len;ii++)
 	{
@@ -239,46 +211,30 @@ FLOAT **dpm_ttic_cpu_fconvsMT(FLOAT*feat,FLOAT*flfeat,FLOAT**filter,int *sym_inf
 		td[ii].C_dims[0]=height;
 		td[ii].C_dims[1]=width;
 		td[ii].C=(FLOAT*)calloc(height*width,sizeof(FLOAT));
+		td[ii].sym = sym_info[ii+start];
 
-		int sym = sym_info[ii+start];
-
-		//non_symmetric
-		if (sym ==0)
+		for (int x = 0; x < width; x += COLUMNS_PER_TASK)
 		{
-			if (pthread_create(&ts[ii], NULL, process, (void*)&td[ii]))
-			{
-				printf("Error creating thread\n");
-				exit(0);
-			}
-		}
-		//symmetric
-		else
-		{
-			int T_dims[2];
-			T_dims[0] = td[ii].A_dims[0];
-			T_dims[1] = (int)(td[ii].B_dims[1]/2.0+0.99);
-			td[ii].T=(FLOAT*)calloc(T_dims[0]*T_dims[1],sizeof(FLOAT));
-			if (pthread_create(&ts[ii], NULL, processS, (void*)&td[ii]))
-			{
-				printf("Error creating thread\n");
-				exit(0);
-			}
+			task t = { ii, x, x + COLUMNS_PER_TASK < width ? x + COLUMNS_PER_TASK : width };
+			tasks.push_back(t);
 		}
 
 		M_size[ii*2]=height;
 		M_size[ii*2+1]=width;
-
 	}
 
-	//close handle and get output
-	for (int i = 0; i < len; i++)
-	{
-		pthread_join(ts[i], NULL);
+	dpm_ttic_cpu_parallel_for(tasks.size(), [&](int i) {
+		thread_data *args = &td[tasks[i].filter];
+		if (args->sym == 0)
+			process(args, tasks[i].x_start, tasks[i].x_end);	//non_symmetric
+		else
+			processS(args, tasks[i].x_start, tasks[i].x_end);	//symmetric
+	});
 
+	//get output
+	for (int i = 0; i < len; i++)
 		Output[i]=td[i].C;
-		s_free(td[i].T);
-	}
+
 	s_free(td);
-	s_free(ts);
 	return(Output);
 }
@@ -15,7 +15,6 @@
 
 #include <time.h>
 #include <iostream>
-#include <pthread.h>
 
 using namespace std;
 
@@ -25,6 +24,8 @@ using namespace std;
 #include "common.hpp"
 #include "resize.hpp"
 #include "featurepyramid.hpp"
+#include "worker_pool.hpp"
+#include "buffer_pool.hpp"
 
 //definition of constant
 #define eps 0.0001
@@ -41,6 +42,7 @@ struct thread_data {
 	int F_C;
 	int sbin;
 	FLOAT *Out;
+	BufferPool *pool;
 };
 
 //inline functions(Why does not use stddard libary)
@@ -137,7 +139,11 @@ int *dpm_ttic_cpu_ini_featsize(Model_info *MI)
 
 //calculate HOG features from Image
 //HOG features are calculated for each block(BSL*BSL pixels)
-static FLOAT *calc_feature(FLOAT *SRC,int *ISIZE,int *FTSIZE,int sbin)
+//The image is column-major, so it is walked one pixel column (memory row) at a time:
+//gradients of the column go to a small scratch buffer first, then they are added to the
+//two block columns it overlaps. The histogram keeps the 18 orientations of a block next
+//to each other, which keeps both passes and the feature computation inside the cache.
+static FLOAT *calc_feature(FLOAT *SRC,int *ISIZE,int *FTSIZE,int sbin,BufferPool *pool)
 {
 	//input size
 	const int height=ISIZE[0]; //{268,268,134,67,233,117,203,203,177,154,89,203,154,77}
@@ -152,7 +158,6 @@ static FLOAT *calc_feature(FLOAT *SRC,int *ISIZE,int *FTSIZE,int sbin)
 	//Output features size(Output)
 	const int OUT_SIZE[3]={max_i(blocks[0]-2,0),max_i(blocks[1]-2,0),27+4};//{65,110,31}.....
 	const int O_DIM=OUT_SIZE[0]*OUT_SIZE[1];//{7150}.....
-	const int DIM_N =9*BLOCK_SQ;//{67536}
 
 	//Visible range (eliminate border blocks)
 	const int visible[2]={blocks[0]*sbin,blocks[1]*sbin};
@@ -162,13 +167,27 @@ static FLOAT *calc_feature(FLOAT *SRC,int *ISIZE,int *FTSIZE,int sbin)
 	const int SQUARE =dims[0]*dims[1];
 	const FLOAT SBIN = FLOAT(sbin);
 
+	//HOG Histgram (18 orientations per block) and Norm
+	FLOAT *HHist = (FLOAT*)dpm_ttic_cpu_pool_calloc(pool,BLOCK_SQ*18,sizeof(FLOAT));
+	FLOAT *Norm = (FLOAT*)dpm_ttic_cpu_pool_malloc(pool,BLOCK_SQ*sizeof(FLOAT));
 
-	//HOG Histgram and Norm
-	FLOAT *HHist = (FLOAT*)calloc(BLOCK_SQ*18,sizeof(FLOAT));	// HOG histgram
-	FLOAT *Norm = (FLOAT*)calloc(BLOCK_SQ,sizeof(FLOAT));		// Norm
+	//feature(Output), every element is written below
+	FLOAT *feat=(FLOAT*)dpm_ttic_cpu_pool_malloc(pool,O_DIM*OUT_SIZE[2]*sizeof(FLOAT));
 
-	//feature(Output)
-	FLOAT *feat=(FLOAT*)calloc(OUT_SIZE[0]*OUT_SIZE[1]*OUT_SIZE[2],sizeof(FLOAT));
+	//gradient of one pixel column (magnitude and orientation)
+	const int COL = max_i(vis_R[0],1);
+	FLOAT *Mag = (FLOAT*)dpm_ttic_cpu_pool_malloc(pool,COL*sizeof(FLOAT));
+	int *Ori = (int*)dpm_ttic_cpu_pool_malloc(pool,COL*sizeof(int));
+
+	//vertical interpolation is the same for every column
+	int *IYP = (int*)dpm_ttic_cpu_pool_malloc(pool,COL*sizeof(int));
+	FLOAT *VY0 = (FLOAT*)dpm_ttic_cpu_pool_malloc(pool,COL*sizeof(FLOAT));
+	for(int y=1;y<vis_R[0];y++)
+	{
+		FLOAT yp=((FLOAT)y+0.5)/SBIN-0.5;
+		IYP[y]=(int)floor(yp);
+		VY0[y]=yp-(FLOAT)IYP[y];
+	}
 
 	//calculate HOG histgram
 	for(int x=1;x<vis_R[1];x++)
@@ -177,16 +196,15 @@ static FLOAT *calc_feature(FLOAT *SRC,int *ISIZE,int *FTSIZE,int sbin)
 		FLOAT xp=((FLOAT)x+0.5)/SBIN-0.5;
 		int ixp=(int)floor(xp);
 		int ixpp=ixp+1;
-		int ixp_b  = ixp * blocks[0];
-		int ixpp_b = ixp_b + blocks[0];
 		FLOAT vx0=xp-(FLOAT)ixp;
 		FLOAT vx1=1.0-vx0;
-		bool flag1=true,flag2=true,flagX=true;
-		if(ixp<0) {flag1=false;flagX=false;}
-		if(ixpp>=blocks[1]) {flag2=false;flagX=false;}
+		bool flag1=true,flag2=true;
+		if(ixp<0) flag1=false;
+		if(ixpp>=blocks[1]) flag2=false;
 		int YC=min_i(x,vp1)*dims[0];
 		FLOAT *SRC_YC = SRC+YC;
 
+		//gradient pass
 		for(int y=1;y<vis_R[0];y++)
 		{
 			//first color channel
@@ -222,57 +240,49 @@ static FLOAT *calc_feature(FLOAT *SRC,int *ISIZE,int *FTSIZE,int sbin)
 				else if (-dot>best_dot)	{best_dot=-dot;best_o=o+9;}
 			}
 
-			//Add to 4 histgrams around pixel using linear interpolation
-			FLOAT yp=((FLOAT)y+0.5)/SBIN-0.5;
-			int iyp=(int)floor(yp);
+			Mag[y]=sqrt(v);
+			Ori[y]=best_o;
+		}
+
+		//Add to 4 histgrams around pixel using linear interpolation
+		FLOAT *H1 = flag1 ? HHist+ixp*blocks[0]*18 : nullptr;
+		FLOAT *H2 = flag2 ? HHist+ixpp*blocks[0]*18 : nullptr;
+
+		for(int y=1;y<vis_R[0];y++)
+		{
+			int iyp=IYP[y];
 			int iypp=iyp+1;
-			FLOAT vy0=yp-(FLOAT)iyp;
+			FLOAT vy0=VY0[y];
 			FLOAT vy1=1.0-vy0;
-			v=sqrt(v);
-			int ODim=best_o*BLOCK_SQ;
-			FLOAT *Htemp = HHist+ODim;
+			FLOAT v=Mag[y];
+			int o=Ori[y];
 			FLOAT vx1Xv =vx1*v;
 			FLOAT vx0Xv = vx0*v;
 
-			if(flagX)
-			{
-				if(iyp>=0)
-				{
-					*(Htemp+ ixp_b+iyp)+=vy1*vx1Xv; //1-少数をxyでかけたものにエッジ強度の2乗をかけたもの
-					*(Htemp+ ixpp_b+iyp)+=vy1*vx0Xv;
-				}
-				if (iypp<blocks[0])
-				{
-					*(Htemp+ ixp_b+iypp)+=vy0*vx1Xv;
-					*(Htemp+ ixpp_b+iypp)+=vy0*vx0Xv;
-				}
-			}
-			else if(flag1)
+			if(iyp>=0)
 			{
-				if (iyp>=0) *(Htemp+ixp_b+iyp)+=vy1*vx1Xv;
-				if (iypp<blocks[0]) *(Htemp+ixp_b+iypp)+=vy0*vx1Xv;
+				if(H1) H1[iyp*18+o]+=vy1*vx1Xv;
+				if(H2) H2[iyp*18+o]+=vy1*vx0Xv;
 			}
-			else if(flag2)
+			if (iypp<blocks[0])
 			{
-				if(iyp>=0) *(Htemp+ixpp_b+iyp)+=vy1*vx0Xv;
-				if(iypp<blocks[0]) *(Htemp+ixpp_b+iypp)+=vy0*vx0Xv;
+				if(H1) H1[iypp*18+o]+=vy0*vx1Xv;
+				if(H2) H2[iypp*18+o]+=vy0*vx0Xv;
 			}
 		}
 	}
 
 	//compute energy in each block by summing over orientations
-	for(int kk=0;kk<9;kk++)
+	for(int bb=0;bb<BLOCK_SQ;bb++)
 	{
-		FLOAT *src1=HHist+kk*BLOCK_SQ;
-		FLOAT *src2=src1+DIM_N;
-		FLOAT *dst=Norm;
-		FLOAT *end=Norm+BLOCK_SQ;
-		while(dst<end)
+		const FLOAT *src=HHist+bb*18;
+		FLOAT nn=0;
+		for(int kk=0;kk<9;kk++)
 		{
-			FLOAT sss=*src1+*src2;
-			*(dst++)+=sss*sss;
-			src1++;src2++;
+			FLOAT sss=src[kk]+src[kk+9];
+			nn+=sss*sss;
 		}
+		Norm[bb]=nn;
 	}
 
 	//compute features
@@ -308,34 +318,31 @@ static FLOAT *calc_feature(FLOAT *SRC,int *ISIZE,int *FTSIZE,int sbin)
 			FLOAT t1=0,t2=0,t3=0,t4=0;
 
 			//contrast-sensitive features(18)
-			src=HHist+BA+yp;
+			src=HHist+(BA+yp)*18;
 			for(int kk=0;kk<18;kk++)
 			{
-				FLOAT h1=min_2(*src*n1);
-				FLOAT h2=min_2(*src*n2);
-				FLOAT h3=min_2(*src*n3);
-				FLOAT h4=min_2(*src*n4);
+				FLOAT h1=min_2(src[kk]*n1);
+				FLOAT h2=min_2(src[kk]*n2);
+				FLOAT h3=min_2(src[kk]*n3);
+				FLOAT h4=min_2(src[kk]*n4);
 				*dst=0.5*(h1+h2+h3+h4);
 				t1+=h1;
 				t2+=h2;
 				t3+=h3;
 				t4+=h4;
 				dst+=O_DIM;
-				src+=BLOCK_SQ;
 			}
 
 			//contrast-insensitive features(9)
-			src=HHist+BA+yp;
 			for(int kk=0;kk<9;kk++)
 			{
-				FLOAT sum = *src+*(src+DIM_N);
+				FLOAT sum = src[kk]+src[kk+9];
 				FLOAT h1=min_2(sum*n1);
 				FLOAT h2=min_2(sum*n2);
 				FLOAT h3=min_2(sum*n3);
 				FLOAT h4=min_2(sum*n4);
 				*dst=0.5*(h1+h2+h3+h4);
 				dst+=O_DIM;
-				src+=BLOCK_SQ;
 			}
 
 			//texture gradient
@@ -350,13 +357,16 @@ static FLOAT *calc_feature(FLOAT *SRC,int *ISIZE,int *FTSIZE,int sbin)
 	}
 
 	//Release
-	s_free(HHist);
-	s_free(Norm);
+	dpm_ttic_cpu_pool_free(pool,HHist);
+	dpm_ttic_cpu_pool_free(pool,Norm);
+	dpm_ttic_cpu_pool_free(pool,Mag);
+	dpm_ttic_cpu_pool_free(pool,Ori);
+	dpm_ttic_cpu_pool_free(pool,IYP);
+	dpm_ttic_cpu_pool_free(pool,VY0);
 
 	//size of feature(output)
 	*FTSIZE=OUT_SIZE[0];
 	*(FTSIZE+1)=OUT_SIZE[1];
-	//    printf("feat%f\n",*(feat));
 	return(feat);
 }
 
@@ -364,19 +374,15 @@ static FLOAT *calc_feature(FLOAT *SRC,int *ISIZE,int *FTSIZE,int sbin)
 
 // get pixel-intensity(FLOAT)  of image(IplImage)
 
-static FLOAT *Ipl_to_FLOAT(IplImage *Input)	//get intensity data (FLOAT) of input
+static FLOAT *Ipl_to_FLOAT(IplImage *Input,BufferPool *pool)	//get intensity data (FLOAT) of input
 {
 	const int width = Input->width;
-	printf("%d\n",width);
 	const int height = Input->height;
-	printf("%d\n",height);
 	const int nChannels = Input->nChannels;
-	printf("%d\n",nChannels);
 	const int SQ = height*width;
 	const int WS = Input->widthStep;
 
-	FLOAT *Output = (FLOAT *)malloc(sizeof(FLOAT)*height*width*nChannels);
-	printf("%d",height*width*nChannels);
+	FLOAT *Output = (FLOAT *)dpm_ttic_cpu_pool_malloc(pool,sizeof(FLOAT)*height*width*nChannels);
 
 	FLOAT *R= Output;
 	FLOAT *G= Output+SQ;
@@ -401,18 +407,14 @@ static FLOAT *Ipl_to_FLOAT(IplImage *Input)	//get intensity data (FLOAT) of inpu
 }
 
 // feature calculation
-static void* feat_calc(void *thread_arg)
+static void feat_calc(thread_data *args)
 {
-	thread_data *args = (thread_data *)thread_arg;
-	FLOAT *Out =calc_feature(args->IM,args->ISIZE,args->FSIZE,args->sbin);
+	FLOAT *Out =calc_feature(args->IM,args->ISIZE,args->FSIZE,args->sbin,args->pool);
 	args->Out =Out;
-	//_endthreadex(0);
-	//return(0);
-	pthread_exit((void*)thread_arg);
 }
 
 //void initialize thread data
-static void ini_thread_data(thread_data *TD,FLOAT *IM,int *INSIZE,int sbin,int level)
+static void ini_thread_data(thread_data *TD,FLOAT *IM,int *INSIZE,int sbin,int level,BufferPool *pool)
 {
 	TD->IM=IM;
 	//memcpy_s(TD->ISIZE,sizeof(int)*3,INSIZE,sizeof(int)*3);
@@ -421,10 +423,18 @@ static void ini_thread_data(thread_data *TD,FLOAT *IM,int *INSIZE,int sbin,int l
 	TD->FSIZE[1]=0;
 	TD->sbin=sbin;
 	TD->F_C=level;
+	TD->pool=pool;
+}
+
+//a level is only built when it keeps 3 pixels in both directions (gradient needs both neighbours)
+static bool level_is_valid(const int *sdims,FLOAT scale)
+{
+	return (int)((FLOAT)sdims[0]*scale+0.5)>=3 && (int)((FLOAT)sdims[1]*scale+0.5)>=3;
 }
 
 //calculate feature pyramid (extended to main.cpp)
-FLOAT **dpm_ttic_cpu_calc_f_pyramid(IplImage *Image,Model_info *MI,int *FTSIZE,FLOAT *scale)	//calculate feature pyramid
+//Levels too small to be built (e.g. for a region of interest) have a null feature and zero size.
+FLOAT **dpm_ttic_cpu_calc_f_pyramid(IplImage *Image,Model_info *MI,int *FTSIZE,FLOAT *scale,BufferPool *pool)	//calculate feature pyramid
 {
 	//constant parameters
 	const int max_scale = MI->max_scale;
@@ -434,107 +444,100 @@ FLOAT **dpm_ttic_cpu_calc_f_pyramid(IplImage *Image,Model_info *MI,int *FTSIZE,F
 	const int LEN = max_scale+interval;
 	const FLOAT sc = pow(2,(1.0/(double)interval));
 	int INSIZE[3]={Image->height,Image->width,Image->nChannels};
-	int RISIZE[3]={0,0,0},OUTSIZE[3] ={0,0,0};
-
-	//Original image (FLOAT)
-	FLOAT *D_I = Ipl_to_FLOAT(Image);
 
 	//features
-	FLOAT **feat=(FLOAT**)malloc(sizeof(FLOAT*)*LEN);		//Model information
+	FLOAT **feat=(FLOAT**)calloc(LEN,sizeof(FLOAT*));		//Model information
 
-	//thread for feature calculation
+	//one entry per level, computed by the worker pool once all images are resized
 	thread_data *td = (thread_data *)calloc(LEN, sizeof(thread_data));
-	pthread_t *ts = (pthread_t *)calloc(LEN, sizeof(pthread_t));
 
+	//resized images and their size (level ii+interval shares the image of level ii)
 	FLOAT **RIM_S =(FLOAT**)calloc(LEN,sizeof(FLOAT*));
+	int *RI_S = (int*)calloc(LEN*3,sizeof(int));
 
-	int *RI_S = (int*)calloc(interval*3,sizeof(int));
-	FLOAT *RIM_T;
-	int t_count=0;
-
-	//calculate resized image
+	//save scales
 	for(int ii=0;ii<interval;ii++)
 	{
 		FLOAT st = 1.0/pow(sc,ii);
-		RIM_S[ii] = dpm_ttic_cpu_resize(D_I,INSIZE,RISIZE,st);
-		memcpy(RI_S+ii*3, RISIZE,sizeof(int)*3);
+		*(scale+ii)=st*2;						//"first" 2x interval
+		*(scale+ii+interval)=st;				//"second" 1x interval
+		for(int jj=ii+interval;jj<max_scale;jj+=interval)
+			*(scale+jj+interval)=0.5*(*(scale+jj));	//remained resolutions
 	}
 
-	for(int ii=0;ii<interval;ii++)
+	//original image (FLOAT) is the first level
+	if(level_is_valid(INSIZE,1.0))
+	{
+		RIM_S[0] = Ipl_to_FLOAT(Image,pool);
+		memcpy(RI_S, INSIZE,sizeof(int)*3);
+	}
+
+	//first octave, every level is resized from the previous one (far less pixels to read than
+	//the original image) to the size a direct resize of the original image would give
+	for(int ii=1;ii<interval;ii++)
 	{
 		FLOAT st = 1.0/pow(sc,ii);
-		memcpy(RISIZE, RI_S+ii*3,sizeof(int)*3);
+		if(RIM_S[ii-1]==nullptr || !level_is_valid(INSIZE,st)) break;
+		int *RISIZE = RI_S+ii*3;
+		RISIZE[0] = (int)((FLOAT)INSIZE[0]*st+0.5);
+		RISIZE[1] = (int)((FLOAT)INSIZE[1]*st+0.5);
+		RIM_S[ii] = dpm_ttic_cpu_resize_to(RIM_S[ii-1],RI_S+(ii-1)*3,RISIZE,pool);
+	}
+
+	//the other octaves halve the level one octave above, each chain is independent
+	dpm_ttic_cpu_parallel_for(interval, [&](int ii) {
+		if(RIM_S[ii]==nullptr) return;
 
 		//"first" 2x interval
-		ini_thread_data(&td[t_count],RIM_S[ii],RISIZE,sbin2,ii);  //initialize thread
-		if( pthread_create(&ts[t_count], NULL, feat_calc, (void*)&td[t_count]))
-		{printf("Error thread\n");exit(0);}
-		*(scale+ii)=st*2;									//save scale
-		t_count++;
+		ini_thread_data(&td[ii],RIM_S[ii],RI_S+ii*3,sbin2,ii,pool);
 
 		//"second" 1x interval
 		RIM_S[ii+interval]=RIM_S[ii];
-
-		ini_thread_data(&td[t_count],RIM_S[ii+interval],RISIZE,sbin,ii+interval);	//initialize thread
-		//ts[t_count]=(HANDLE)_beginthreadex(NULL,0,feat_calc,(void*)&td[t_count],0,&threadID);
-		if(pthread_create(&ts[t_count], NULL, feat_calc, (void*)&td[t_count]))
-			//if (ts[t_count]==INVALID_HANDLE_VALUE)
-		{printf("Error thread\n");exit(0);}
-		*(scale+ii+interval)=st;							//save scale
-		t_count++;
+		memcpy(RI_S+(ii+interval)*3, RI_S+ii*3,sizeof(int)*3);
+		ini_thread_data(&td[ii+interval],RIM_S[ii+interval],RI_S+(ii+interval)*3,sbin,ii+interval,pool);
 
 		//remained resolutions (for root_only)
-		RIM_T = RIM_S[ii];		//get original image (just a copy)
 		for(int jj=ii+interval;jj<max_scale;jj+=interval)
 		{
-			//resize image (FLOAT)
-			RIM_S[jj+interval] = dpm_ttic_cpu_resize(RIM_T,RISIZE,OUTSIZE,0.5);
-			memcpy(RISIZE, OUTSIZE,sizeof(int)*3);
-			ini_thread_data(&td[t_count],RIM_S[jj+interval],RISIZE,sbin,jj+interval); //initialize thread
-			//ts[t_count]=(HANDLE)_beginthreadex(NULL,0,feat_calc,(void*)&td[t_count],0,&threadID);
-			if(pthread_create(&ts[t_count], NULL, feat_calc, (void*)&td[t_count]))
-				//if (ts[t_count]==INVALID_HANDLE_VALUE)
-			{printf("Error thread\n");exit(0);}
-			*(scale+jj+interval)=0.5*(*(scale+jj));			//save scale
-			RIM_T = RIM_S[jj+interval];
-			t_count++;
+			if(!level_is_valid(RI_S+jj*3,0.5)) break;
+			RIM_S[jj+interval] = dpm_ttic_cpu_resize(RIM_S[jj],RI_S+jj*3,RI_S+(jj+interval)*3,0.5,pool);
+			ini_thread_data(&td[jj+interval],RIM_S[jj+interval],RI_S+(jj+interval)*3,sbin,jj+interval,pool);
 		}
-	}
+	});
 
+	//calculate features of all levels
+	dpm_ttic_cpu_parallel_for(LEN, [td](int ss) {
+		if(td[ss].IM!=nullptr) feat_calc(&td[ss]);
+	});
 
 	//get thread data
 	for(int ss=0;ss<LEN;ss++)
 	{
-		pthread_join(ts[ss], NULL);
-		feat[td[ss].F_C]=td[ss].Out;
-		memcpy(&FTSIZE[td[ss].F_C*2], td[ss].FSIZE,sizeof(int)*2);
+		feat[ss]=td[ss].Out;
+		memcpy(&FTSIZE[ss*2], td[ss].FSIZE,sizeof(int)*2);
 	}
 
-	//release original image
-	s_free(D_I);
-
-	//release resized image
-	for(int ss=0;ss<interval;ss++) s_free(RIM_S[ss]);
-	for(int ss=interval*2;ss<LEN;ss++) s_free(RIM_S[ss]);
+	//release resized images (including the original one)
+	for(int ss=0;ss<interval;ss++) dpm_ttic_cpu_pool_free(pool,RIM_S[ss]);
+	for(int ss=interval*2;ss<LEN;ss++) dpm_ttic_cpu_pool_free(pool,RIM_S[ss]);
 	s_free(RI_S);
 	s_free(RIM_S);
 
 	//release thread information
 	s_free(td);
-	s_free(ts);
 
 	return(feat);
 }
 
 //release feature pyramid
-void dpm_ttic_cpu_free_features(FLOAT **features,Model_info *MI)
+void dpm_ttic_cpu_free_features(FLOAT **features,Model_info *MI,BufferPool *pool)
 {
 	int LofFeat=MI->max_scale+MI->interval;
 	if(features!=NULL)
 	{
 		for (int ii=0;ii<LofFeat;ii++)
 		{
-			s_free(features[ii]);
+			dpm_ttic_cpu_pool_free(pool,features[ii]);
 		}
 		s_free(features);
 	}
@@ -3,13 +3,15 @@
 
 #include "switch_float.h"
 
+struct BufferPool;
+
 //initialize feature size information matrix (extended to main)
 extern int *dpm_ttic_cpu_ini_featsize(Model_info *MI);
 //release features
-extern void dpm_ttic_cpu_free_features(FLOAT **features,Model_info *MI);
+extern void dpm_ttic_cpu_free_features(FLOAT **features,Model_info *MI,BufferPool *pool);
 //initialize scales (extended to main)
 extern FLOAT *dpm_ttic_cpu_ini_scales(Model_info *MI,IplImage *IM,int X,int Y);
 //calculate feature pyramid (extended to detect.c)
-extern FLOAT **dpm_ttic_cpu_calc_f_pyramid(IplImage *Image,Model_info *MI,int *FTSIZE,FLOAT *scale);
+extern FLOAT **dpm_ttic_cpu_calc_f_pyramid(IplImage *Image,Model_info *MI,int *FTSIZE,FLOAT *scale,BufferPool *pool);
 
 #endif /* _FEATURE_PYRAMID_H_ */
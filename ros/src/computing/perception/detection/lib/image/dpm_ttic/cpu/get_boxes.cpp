@@ -264,7 +264,7 @@ FLOAT *dpm_ttic_cpu_get_boxes(FLOAT **features,FLOAT *scales,int *FSIZE,MODEL *M
 		//matched score size matrix
 		FLOAT scale=(FLOAT)sbin/scales[level];
 
-		if(FSIZE[level*2]+2*pady<MO->MI->max_Y ||(FSIZE[level*2+1]+2*padx<MO->MI->max_X))
+		if(features[level]==nullptr || FSIZE[level*2]+2*pady<MO->MI->max_Y ||(FSIZE[level*2+1]+2*padx<MO->MI->max_X))
 		{
 			Tboxes[count]=nullptr;
 			count++;
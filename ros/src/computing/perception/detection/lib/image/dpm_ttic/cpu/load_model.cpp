@@ -12,6 +12,7 @@
 //Header files
 #include "MODEL_info.h"		//Model-structure definition
 #include "common.hpp"
+#include "buffer_pool.hpp"
 
 #include "switch_float.h"
 
@@ -250,6 +251,8 @@ MODEL *dpm_ttic_cpu_load_model(FLOAT ratio, const char *com_csv, const char *roo
 	model->MI->padx = 0;
 	model->MI->pady = 0;
 
+	model->pool = dpm_ttic_cpu_create_buffer_pool();
+
 	return model;
 }
 
@@ -299,5 +302,7 @@ void dpm_ttic_cpu_free_model(MODEL *MO)
 	s_free(MO->PF->part_sym);
 	s_free(MO->PF);
 
+	dpm_ttic_cpu_destroy_buffer_pool(MO->pool);
+
 	s_free(MO);
 }
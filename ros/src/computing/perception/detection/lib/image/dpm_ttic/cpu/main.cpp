@@ -5,8 +5,11 @@
 
 //OpenCV library
 
+#include <cassert>
 #include <cstdio>
 #include <cstdlib>
+#include <cstring>
+#include <algorithm>
 
 #include <dpm_ttic.hpp>
 
@@ -14,6 +17,7 @@
 #include "switch_float.h"
 #include "detect.hpp"
 #include "load_model.hpp"
+#include "featurepyramid.hpp"
 
 DPMTTIC::DPMTTIC(const char *com_csv, const char *root_csv, const char *part_csv)
 {
@@ -37,14 +41,16 @@ static FLOAT *init_accumulated_score(IplImage *image)
 	return score;
 }
 
-DPMTTICResult DPMTTIC::detect_objects(IplImage *image, const DPMTTICParam& param)
+// offset_x/offset_y: position of image in the frame the corner points refer to
+static DPMTTICResult detect_in_image(MODEL *model, IplImage *image, const DPMTTICParam& param,
+				     int offset_x, int offset_y)
 {
-	// model_->MI->interval = param.lambda;
-	// model_->MI->sbin     = param.num_cells;
+	// model->MI->interval = param.lambda;
+	// model->MI->sbin     = param.num_cells;
 
 	int detected_objects;
 	FLOAT *ac_score = init_accumulated_score(image);
-	RESULT *cars = dpm_ttic_cpu_car_detection(image, model_, param.threshold, &detected_objects, ac_score,
+	RESULT *cars = dpm_ttic_cpu_car_detection(image, model, param.threshold, &detected_objects, ac_score,
 						  param.overlap);
 	free(ac_score);
 
@@ -58,8 +64,8 @@ DPMTTICResult DPMTTIC::detect_objects(IplImage *image, const DPMTTICParam& param
 		int base = i * 4;
 		int *data = &(cars->OR_point[base]);
 
-		result.corner_points.push_back(data[0]);
-		result.corner_points.push_back(data[1]);
+		result.corner_points.push_back(data[0] + offset_x);
+		result.corner_points.push_back(data[1] + offset_y);
 		result.corner_points.push_back(data[2] - data[0]);
 		result.corner_points.push_back(data[3] - data[1]);
 		result.score.push_back(cars->score[i]);
@@ -73,3 +79,50 @@ DPMTTICResult DPMTTIC::detect_objects(IplImage *image, const DPMTTICParam& param
 
 	return result;
 }
+
+DPMTTICResult DPMTTIC::detect_objects(IplImage *image, const DPMTTICParam& param)
+{
+	return detect_in_image(model_, image, param, 0, 0);
+}
+
+DPMTTICResult DPMTTIC::detect_objects(IplImage *image, const DPMTTICParam& param,
+				      const std::vector<CvRect>& rois)
+{
+	if (rois.empty())
+		return detect_objects(image, param);
+
+	// the region is copied byte by byte below
+	assert(image->depth == IPL_DEPTH_8U);
+
+	// bounding box of all regions, clipped to the image
+	int x1 = image->width, y1 = image->height, x2 = 0, y2 = 0;
+	for (const CvRect& roi : rois) {
+		x1 = std::min(x1, std::max(roi.x, 0));
+		y1 = std::min(y1, std::max(roi.y, 0));
+		x2 = std::max(x2, std::min(roi.x + roi.width, image->width));
+		y2 = std::max(y2, std::min(roi.y + roi.height, image->height));
+	}
+
+	if (x2 <= x1 || y2 <= y1) {
+		DPMTTICResult result;
+		result.num = 0;
+		return result;
+	}
+
+	// the number of pyramid levels is fixed by the first frame, so take it from the full frame
+	if (model_->MI->ini)
+		free(dpm_ttic_cpu_ini_scales(model_->MI, image, image->width, image->height));
+
+	// copy the region
+	IplImage *roi_image = cvCreateImage(cvSize(x2 - x1, y2 - y1), image->depth, image->nChannels);
+	const int row_bytes = (x2 - x1) * image->nChannels;
+	for (int y = y1; y < y2; ++y) {
+		memcpy(roi_image->imageData + (y - y1) * roi_image->widthStep,
+		       image->imageData + y * image->widthStep + x1 * image->nChannels, row_bytes);
+	}
+
+	DPMTTICResult result = detect_in_image(model_, roi_image, param, x1, y1);
+	cvReleaseImage(&roi_image);
+
+	return result;
+}
@@ -11,6 +11,7 @@
 #include "common.hpp"
 #include "switch_float.h"
 #include "resize.hpp"
+#include "buffer_pool.hpp"
 
 // struct used for caching interpolation values
 struct alphainfo {
@@ -91,29 +92,38 @@ static void resize1dtran(FLOAT *src, int sheight, FLOAT *dst, int dheight, int w
 	free(ofs);
 }
 
+// resize to the size already stored in odims (odims[2] is taken from sdims)
+// returns resized image (allocated from pool, release it with dpm_ttic_cpu_pool_free)
+FLOAT *dpm_ttic_cpu_resize_to(FLOAT *src,int *sdims,int *odims,BufferPool *pool)
+{
+	odims[2] = sdims[2];
+	//both passes clear their output themselves
+	FLOAT *dst = (FLOAT*)dpm_ttic_cpu_pool_malloc(pool,odims[0]*odims[1]*sdims[2]*sizeof(FLOAT));
+	FLOAT *tmp = (FLOAT*)dpm_ttic_cpu_pool_malloc(pool,odims[0]*sdims[1]*sdims[2]*sizeof(FLOAT));
+	resize1dtran(src, sdims[0], tmp, odims[0], sdims[1], sdims[2]);
+	resize1dtran(tmp, sdims[1], dst, odims[1], odims[0], sdims[2]);
+	dpm_ttic_cpu_pool_free(pool,tmp);
+	return(dst);
+}
+
 // main function (resize)
 // takes a FLOAT color image and a scaling factor
-// returns resized image
-FLOAT *dpm_ttic_cpu_resize(FLOAT *src,int *sdims,int *odims,FLOAT scale)
+// returns resized image (allocated from pool, release it with dpm_ttic_cpu_pool_free)
+FLOAT *dpm_ttic_cpu_resize(FLOAT *src,int *sdims,int *odims,FLOAT scale,BufferPool *pool)
 {
 	FLOAT *dst;
 	if(scale==1.0)
 	{
 		memcpy(odims, sdims,sizeof(int)*3);
 		int DL = odims[0]*odims[1]*odims[2];
-		dst = (FLOAT*)calloc(DL,sizeof(FLOAT));
+		dst = (FLOAT*)dpm_ttic_cpu_pool_malloc(pool,DL*sizeof(FLOAT));
 		memcpy(dst, src,sizeof(FLOAT)*DL);
 	}
 	else
 	{
 		odims[0] = (int)((FLOAT)sdims[0]*scale+0.5);
 		odims[1] = (int)((FLOAT)sdims[1]*scale+0.5);
-		odims[2] = sdims[2];
-		dst = (FLOAT*)calloc(odims[0]*odims[1]*sdims[2],sizeof(FLOAT));
-		FLOAT *tmp = (FLOAT*)calloc(odims[0]*sdims[1]*sdims[2],sizeof(FLOAT));
-		resize1dtran(src, sdims[0], tmp, odims[0], sdims[1], sdims[2]);
-		resize1dtran(tmp, sdims[1], dst, odims[1], odims[0], sdims[2]);
-		free(tmp);
+		dst = dpm_ttic_cpu_resize_to(src,sdims,odims,pool);
 	}
 	return(dst);
 }
@@ -3,6 +3,9 @@
 
 #include "switch_float.h"
 
-extern FLOAT *dpm_ttic_cpu_resize(FLOAT *src,int *sdims,int *odims,FLOAT scale); //resize image
+struct BufferPool;
+
+extern FLOAT *dpm_ttic_cpu_resize(FLOAT *src,int *sdims,int *odims,FLOAT scale,BufferPool *pool); //resize image
+extern FLOAT *dpm_ttic_cpu_resize_to(FLOAT *src,int *sdims,int *odims,BufferPool *pool); //resize image to odims
 
 #endif /* _RESIZE_H_ */
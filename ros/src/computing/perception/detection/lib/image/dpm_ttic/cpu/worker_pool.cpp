@@ -0,0 +1,117 @@
+/////worker_pool.cpp   persistent threads shared by pyramid levels and filters ////////////////////////////////////
+
+#include <atomic>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "worker_pool.hpp"
+
+//set on pool threads and while a caller executes tasks, used to run nested requests serially
+static thread_local bool in_parallel_region = false;
+
+class WorkerPool {
+public:
+	static WorkerPool& instance()
+	{
+		static WorkerPool pool;
+		return pool;
+	}
+
+	void parallel_for(int count, const std::function<void(int)>& func)
+	{
+		if (count <= 0)
+			return;
+
+		if (count == 1 || workers_.empty() || in_parallel_region) {
+			for (int i = 0; i < count; i++)
+				func(i);
+			return;
+		}
+
+		//several detectors may share the pool, one request at a time
+		std::lock_guard<std::mutex> submit_lock(submit_mutex_);
+		{
+			std::lock_guard<std::mutex> lock(mutex_);
+			func_ = &func;
+			count_ = count;
+			next_ = 0;
+			active_ = workers_.size();
+			generation_++;
+		}
+		start_cv_.notify_all();
+
+		in_parallel_region = true;
+		run_tasks();
+		in_parallel_region = false;
+
+		std::unique_lock<std::mutex> lock(mutex_);
+		done_cv_.wait(lock, [this]{ return active_ == 0; });
+		func_ = nullptr;
+	}
+
+private:
+	WorkerPool() : func_(nullptr), count_(0), next_(0), active_(0), generation_(0), stop_(false)
+	{
+		unsigned int threads = std::thread::hardware_concurrency();
+		for (unsigned int i = 1; i < threads; i++)
+			workers_.push_back(std::thread(&WorkerPool::worker_loop, this));
+	}
+
+	~WorkerPool()
+	{
+		{
+			std::lock_guard<std::mutex> lock(mutex_);
+			stop_ = true;
+		}
+		start_cv_.notify_all();
+		for (size_t i = 0; i < workers_.size(); i++)
+			workers_[i].join();
+	}
+
+	void run_tasks()
+	{
+		for (int i = next_++; i < count_; i = next_++)
+			(*func_)(i);
+	}
+
+	void worker_loop()
+	{
+		in_parallel_region = true;
+		unsigned int seen = 0;
+		for (;;) {
+			{
+				std::unique_lock<std::mutex> lock(mutex_);
+				start_cv_.wait(lock, [this, seen]{ return stop_ || generation_ != seen; });
+				if (stop_)
+					return;
+				seen = generation_;
+			}
+
+			run_tasks();
+
+			std::lock_guard<std::mutex> lock(mutex_);
+			if (--active_ == 0)
+				done_cv_.notify_one();
+		}
+	}
+
+	std::vector<std::thread> workers_;
+	std::mutex submit_mutex_;
+	std::mutex mutex_;
+	std::condition_variable start_cv_;
+	std::condition_variable done_cv_;
+
+	const std::function<void(int)> *func_;
+	int count_;
+	std::atomic<int> next_;
+	size_t active_;
+	unsigned int generation_;
+	bool stop_;
+};
+
+void dpm_ttic_cpu_parallel_for(int count, const std::function<void(int)>& func)
+{
+	WorkerPool::instance().parallel_for(count, func);
+}
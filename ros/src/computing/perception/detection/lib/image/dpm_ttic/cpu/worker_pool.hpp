@@ -0,0 +1,10 @@
+#ifndef _WORKER_POOL_H_
+#define _WORKER_POOL_H_
+
+#include <functional>
+
+//run func(0) ... func(count-1) on the persistent worker threads and wait for all of them.
+//The calling thread takes part in the work, nested calls run serially.
+extern void dpm_ttic_cpu_parallel_for(int count, const std::function<void(int)>& func);
+
+#endif /* _WORKER_POOL_H_ */
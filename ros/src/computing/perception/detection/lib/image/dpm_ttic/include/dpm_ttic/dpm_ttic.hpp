@@ -34,6 +34,10 @@ public:
 	~DPMTTIC();
 
 	DPMTTICResult detect_objects(IplImage *image, const DPMTTICParam& param);
+	// Only the bounding box of rois (e.g. regions predicted by a tracker) is searched,
+	// result coordinates stay in the frame of image. Empty rois searches the whole image.
+	DPMTTICResult detect_objects(IplImage *image, const DPMTTICParam& param,
+				     const std::vector<CvRect>& rois);
 };
 
 struct GPUModel;
@@ -0,0 +1,70 @@
+/////dpm_ttic_cpu_benchmark.cpp   time the CPU detector on stored images ////////////////////////////////////////////
+//
+// usage: dpm_ttic_cpu_benchmark <comp.csv> <root.csv> <part.csv> <iterations> <image> [<image> ...]
+
+#include <cstdio>
+#include <cstdlib>
+#include <sys/time.h>
+
+#include <opencv/cv.h>
+#include <opencv/highgui.h>
+
+#include <dpm_ttic.hpp>
+
+static double elapsed_ms(const struct timeval& start, const struct timeval& end)
+{
+	return (end.tv_sec - start.tv_sec) * 1000.0 + (end.tv_usec - start.tv_usec) / 1000.0;
+}
+
+int main(int argc, char **argv)
+{
+	if (argc < 6) {
+		fprintf(stderr, "usage: %s <comp.csv> <root.csv> <part.csv> <iterations> <image> [<image> ...]\n", argv[0]);
+		return 1;
+	}
+
+	DPMTTIC detector(argv[1], argv[2], argv[3]);
+	int iterations = atoi(argv[4]);
+
+	//same defaults as the cv_tracker dpm_ttic node
+	DPMTTICParam param;
+	param.overlap = 0.4;
+	param.threshold = -0.5;
+	param.lambda = 10;
+	param.num_cells = 8;
+
+	double total_ms = 0;
+	int frames = 0;
+	for (int i = 5; i < argc; i++) {
+		IplImage *image = cvLoadImage(argv[i], CV_LOAD_IMAGE_COLOR);
+		if (image == nullptr) {
+			fprintf(stderr, "can not read %s\n", argv[i]);
+			continue;
+		}
+
+		//the first run warms up the worker threads and caches
+		DPMTTICResult result = detector.detect_objects(image, param);
+
+		double image_ms = 0;
+		for (int n = 0; n < iterations; n++) {
+			struct timeval start, end;
+			gettimeofday(&start, nullptr);
+			result = detector.detect_objects(image, param);
+			gettimeofday(&end, nullptr);
+			image_ms += elapsed_ms(start, end);
+		}
+
+		if (iterations > 0)
+			printf("%s: %dx%d, %d objects, %f[ms]\n", argv[i], image->width, image->height,
+			       result.num, image_ms / iterations);
+
+		total_ms += image_ms;
+		frames += iterations;
+		cvReleaseImage(&image);
+	}
+
+	if (frames > 0)
+		printf("average %f[ms] (%f fps) over %d frames\n", total_ms / frames, 1000.0 * frames / total_ms, frames);
+
+	return 0;
+}
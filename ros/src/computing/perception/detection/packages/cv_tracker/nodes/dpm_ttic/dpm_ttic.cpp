@@ -30,6 +30,7 @@
 
 #include <cstdio>
 #include <string>
+#include <vector>
 #include <ros/ros.h>
 
 #include <cv_bridge/cv_bridge.h>
@@ -37,6 +38,7 @@
 #include <sensor_msgs/image_encodings.h>
 
 #include "autoware_msgs/image_obj.h"
+#include "autoware_msgs/image_obj_tracked.h"
 #include "autoware_msgs/ConfigPedestrianDpm.h"
 
 #include <dpm_ttic.hpp>
@@ -54,6 +56,12 @@ static DPMTTIC *ttic_model;
 
 static DPMTTICParam ttic_param;
 
+// regions predicted by the tracker, the CPU detector only searches them between full frames
+static bool use_tracker_rois;
+static int full_frame_interval;
+static double roi_margin;
+static std::vector<CvRect> tracker_rois;
+
 static std::string object_class;static long int counter;
 
 static std::string image_topic_name;
@@ -99,8 +107,13 @@ static void image_raw_cb(const sensor_msgs::Image& image_source)
 		result_to_image_obj_message(msg, result);
 	} else {
 #endif
-		DPMTTICResult result = ttic_model->detect_objects(img_ptr, ttic_param);
-		result_to_image_obj_message(msg, result);
+		if (use_tracker_rois && !tracker_rois.empty() && counter % full_frame_interval != 0) {
+			DPMTTICResult result = ttic_model->detect_objects(img_ptr, ttic_param, tracker_rois);
+			result_to_image_obj_message(msg, result);
+		} else {
+			DPMTTICResult result = ttic_model->detect_objects(img_ptr, ttic_param);
+			result_to_image_obj_message(msg, result);
+		}
 #if defined(HAS_GPU)
 	}
 #endif
@@ -109,6 +122,17 @@ static void image_raw_cb(const sensor_msgs::Image& image_source)
 	counter++;
 }
 
+static void tracked_cb(const autoware_msgs::image_obj_tracked::ConstPtr& tracked)
+{
+	tracker_rois.clear();
+	for (const autoware_msgs::image_rect_ranged& ranged : tracked->rect_ranged) {
+		const autoware_msgs::image_rect& rect = ranged.rect;
+		int dx = rect.width * roi_margin;
+		int dy = rect.height * roi_margin;
+		tracker_rois.push_back(cvRect(rect.x - dx, rect.y - dy, rect.width + 2 * dx, rect.height + 2 * dy));
+	}
+}
+
 static void config_cb(const autoware_msgs::ConfigPedestrianDpm::ConstPtr& param)
 {
 	ttic_param.threshold = param->score_threshold;
@@ -172,6 +196,18 @@ int main(int argc, char* argv[])
 	}
 #endif
 
+	if (!private_nh.getParam("use_tracker_rois", use_tracker_rois)) {
+		use_tracker_rois = false;
+	}
+
+	if (!private_nh.getParam("full_frame_interval", full_frame_interval) || full_frame_interval < 1) {
+		full_frame_interval = 10;
+	}
+
+	if (!private_nh.getParam("roi_margin", roi_margin)) {
+		roi_margin = 0.5;
+	}
+
 	set_default_param(ttic_param);
 
 	const char *com_csv  = comp_csv_path.c_str();
@@ -191,6 +227,11 @@ int main(int argc, char* argv[])
 	ros::Subscriber sub = n.subscribe(image_topic_name, 1, image_raw_cb);
 	image_obj_pub = n.advertise<autoware_msgs::image_obj>("image_obj", 1);
 
+	ros::Subscriber tracked_sub;
+	if (use_tracker_rois) {
+		tracked_sub = n.subscribe("image_obj_tracked", 1, tracked_cb);
+	}
+
 	ros::Subscriber config_sub;
 	std::string config_topic("/config");
 	config_topic += ros::this_node::getNamespace() + "/dpm";
@@ -28,6 +28,7 @@
 #include <pcl/segmentation/conditional_euclidean_clustering.h>
 
 #include <pcl/common/common.h>
+#include <pcl/common/io.h>
 
 #include <pcl/search/organized.h>
 #include <pcl/search/kdtree.h>
@@ -72,6 +73,7 @@
 #include <sstream>
 
 #include "Cluster.h"
+#include "euclidean_cluster.h"
 
 //#include <vector_map/vector_map.h>
 //#include <vector_map_server/GetSignal.h>
@@ -96,6 +98,7 @@ ros::Publisher _pub_jsk_boundingboxes;
 ros::Publisher _pub_jsk_hulls;
 
 ros::ServiceClient _vectormap_server;
+ros::Subscriber _sub_points;
 
 std_msgs::Header _velodyne_header;
 
@@ -135,6 +138,7 @@ static double _remove_points_upto;
 static double _cluster_merge_threshold;
 
 static bool _use_gpu;
+static bool _initialized = false;
 static std::chrono::system_clock::time_point _start, _end;
 
 void transformBoundingBox(const jsk_recognition_msgs::BoundingBox& in_boundingbox, jsk_recognition_msgs::BoundingBox& out_boundingbox, const std::string& in_target_frame, const std_msgs::Header& in_header)
@@ -252,20 +256,17 @@ void publishBoundingBoxArray(const ros::Publisher* in_publisher, const jsk_recog
 	}
 }
 
+//the clouds are published by pointer and only read afterwards, subscribers in the same nodelet manager get them without a copy
 void publishCloud(const ros::Publisher* in_publisher, const pcl::PointCloud<pcl::PointXYZ>::Ptr in_cloud_to_publish_ptr)
 {
-	sensor_msgs::PointCloud2 cloud_msg;
-	pcl::toROSMsg(*in_cloud_to_publish_ptr, cloud_msg);
-	cloud_msg.header=_velodyne_header;
-	in_publisher->publish(cloud_msg);
+	in_cloud_to_publish_ptr->header = pcl_conversions::toPCL(_velodyne_header);
+	in_publisher->publish(in_cloud_to_publish_ptr);
 }
 
 void publishColorCloud(const ros::Publisher* in_publisher, const pcl::PointCloud<pcl::PointXYZRGB>::Ptr in_cloud_to_publish_ptr)
 {
-	sensor_msgs::PointCloud2 cloud_msg;
-	pcl::toROSMsg(*in_cloud_to_publish_ptr, cloud_msg);
-	cloud_msg.header=_velodyne_header;
-	in_publisher->publish(cloud_msg);
+	in_cloud_to_publish_ptr->header = pcl_conversions::toPCL(_velodyne_header);
+	in_publisher->publish(in_cloud_to_publish_ptr);
 }
 
 void keepLanePoints(const pcl::PointCloud<pcl::PointXYZ>::Ptr in_cloud_ptr,
@@ -831,7 +832,7 @@ void removePointsUpTo(const pcl::PointCloud<pcl::PointXYZ>::Ptr in_cloud_ptr, pc
 	}
 }
 
-void velodyne_callback(const sensor_msgs::PointCloud2ConstPtr& in_sensor_cloud)
+void velodyne_callback(const pcl::PointCloud<pcl::PointXYZI>::ConstPtr& in_sensor_cloud)
 {
 	_start = std::chrono::system_clock::now(); // 計測開始時間
 
@@ -855,9 +856,9 @@ void velodyne_callback(const sensor_msgs::PointCloud2ConstPtr& in_sensor_cloud)
 		jsk_recognition_msgs::PolygonArray polygon_array;
 		jsk_rviz_plugins::PictogramArray pictograms_array;
 
-		pcl::fromROSMsg(*in_sensor_cloud, *current_sensor_cloud_ptr);
+		pcl::copyPointCloud(*in_sensor_cloud, *current_sensor_cloud_ptr);
 
-		_velodyne_header = in_sensor_cloud->header;
+		pcl_conversions::fromPCL(in_sensor_cloud->header, _velodyne_header);
 
 		if (_remove_points_upto > 0.0)
 		{
@@ -996,19 +997,18 @@ void vectormap_callback(const visualization_msgs::MarkerArray::Ptr in_vectormap_
 	cv::waitKey(0);
 }*/
 
-int main (int argc, char** argv)
+bool initEuclideanCluster(ros::NodeHandle& h, ros::NodeHandle& private_nh)
 {
-	// Initialize ROS
-	ros::init (argc, argv, "euclidean_cluster");
-
-	ros::NodeHandle h;
-	ros::NodeHandle private_nh("~");
-
-	tf::StampedTransform transform;
-	tf::TransformListener listener;
+	if (_initialized)
+	{
+		ROS_ERROR("euclidean_cluster > Already running in this process, only one instance per process is supported");
+		return false;
+	}
+	_initialized = true;
 
-	_transform = &transform;
-	_transform_listener = &listener;
+	//kept for the lifetime of the process, as the rest of the node state
+	_transform = new tf::StampedTransform();
+	_transform_listener = new tf::TransformListener();
 
 #if (CV_MAJOR_VERSION == 3)
 	generateColors(_colors, 100);
@@ -1016,12 +1016,12 @@ int main (int argc, char** argv)
 	cv::generateColors(_colors, 100);
 #endif
 
-	_pub_cluster_cloud = h.advertise<sensor_msgs::PointCloud2>("/points_cluster",1);
-	_pub_ground_cloud = h.advertise<sensor_msgs::PointCloud2>("/points_ground",1);
+	_pub_cluster_cloud = h.advertise<pcl::PointCloud<pcl::PointXYZRGB> >("/points_cluster",1);
+	_pub_ground_cloud = h.advertise<pcl::PointCloud<pcl::PointXYZ> >("/points_ground",1);
 	_centroid_pub = h.advertise<autoware_msgs::centroids>("/cluster_centroids",1);
 	_marker_pub = h.advertise<visualization_msgs::Marker>("centroid_marker",1);
 
-	_pub_points_lanes_cloud = h.advertise<sensor_msgs::PointCloud2>("/points_lanes",1);
+	_pub_points_lanes_cloud = h.advertise<pcl::PointCloud<pcl::PointXYZ> >("/points_lanes",1);
 	_pub_jsk_boundingboxes = h.advertise<jsk_recognition_msgs::BoundingBoxArray>("/bounding_boxes",1);
 	_pub_jsk_hulls = h.advertise<jsk_recognition_msgs::PolygonArray>("/cluster_hulls",1);
 	_pub_clusters_message = h.advertise<autoware_msgs::CloudClusterArray>("/cloud_clusters",1);
@@ -1090,7 +1090,7 @@ int main (int argc, char** argv)
 	std::cout << "_clustering_distances: ";for (auto i = _clustering_distances.begin(); i != _clustering_distances.end(); ++i)  std::cout << *i << ' '; std::cout <<std::endl;
 
 	// Create a ROS subscriber for the input point cloud
-	ros::Subscriber sub = h.subscribe (points_topic, 1, velodyne_callback);
+	_sub_points = h.subscribe (points_topic, 1, velodyne_callback);
 	//ros::Subscriber sub_vectormap = h.subscribe ("vector_map", 1, vectormap_callback);
 	_vectormap_server = h.serviceClient<vector_map_server::PositionState>("vector_map_server/is_way_area");
 
@@ -1110,6 +1110,5 @@ int main (int argc, char** argv)
 	// marker.lifetime = ros::Duration(0.1);
 	_visualization_marker.frame_locked = true;
 
-	// Spin
-	ros::spin ();
+	return true;
 }
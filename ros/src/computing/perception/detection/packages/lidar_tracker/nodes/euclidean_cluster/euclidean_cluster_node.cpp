@@ -0,0 +1,20 @@
+#include <ros/ros.h>
+
+#include "euclidean_cluster.h"
+
+int main (int argc, char** argv)
+{
+	// Initialize ROS
+	ros::init (argc, argv, "euclidean_cluster");
+
+	ros::NodeHandle h;
+	ros::NodeHandle private_nh("~");
+
+	if (!initEuclideanCluster(h, private_nh))
+		return 1;
+
+	// Spin
+	ros::spin ();
+
+	return 0;
+}
@@ -0,0 +1,28 @@
+#include <pluginlib/class_list_macros.h>
+#include <nodelet/nodelet.h>
+
+#include "euclidean_cluster.h"
+
+namespace lidar_tracker
+{
+	/**
+	 * Runs the euclidean clustering inside a nodelet manager, clouds from the ground filters are passed by pointer.
+	 * Only one instance can be loaded per manager.
+	 */
+	class EuclideanClusterNodelet : public nodelet::Nodelet
+	{
+	public:
+		EuclideanClusterNodelet() {}
+		~EuclideanClusterNodelet() {}
+
+	private:
+		virtual void onInit()
+		{
+			if (!initEuclideanCluster(getNodeHandle(), getPrivateNodeHandle()))
+				NODELET_ERROR("euclidean_cluster nodelet not started");
+		}
+	};
+
+} // namespace lidar_tracker
+
+PLUGINLIB_EXPORT_CLASS(lidar_tracker::EuclideanClusterNodelet, nodelet::Nodelet)
@@ -0,0 +1,20 @@
+/*
+ * euclidean_cluster.h
+ *
+ * Entry point shared by the euclidean_cluster node and nodelet
+ */
+#ifndef EUCLIDEAN_CLUSTER_H_
+#define EUCLIDEAN_CLUSTER_H_
+
+#include <ros/ros.h>
+
+/*!
+ * Reads the parameters, advertises the outputs and subscribes to the input cloud.
+ * The clustering state is global, only one instance can be initialized per process.
+ * @param h public node handle
+ * @param private_nh private node handle to read parameters from
+ * @return false if an instance is already running in this process
+ */
+bool initEuclideanCluster(ros::NodeHandle& h, ros::NodeHandle& private_nh);
+
+#endif  // EUCLIDEAN_CLUSTER_H_
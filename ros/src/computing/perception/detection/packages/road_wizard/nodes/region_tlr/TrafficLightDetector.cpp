@@ -1,3 +1,4 @@
+#include <cstring>
 #include "TrafficLight.h"
 #include "TrafficLightDetector.h"
 
@@ -33,43 +34,65 @@ static inline  bool IsRange(const double lower, const double upper, const double
 } /* static inline  bool IsRange() */
 
 
-static void colorExtraction(const cv::Mat& src, // input HSV image
-                            cv::Mat*       dst, // specified color extracted binarized image
-                            const double   hue_lower, const double hue_upper, // hue thresholds
-                            const double   sat_lower, const double sat_upper, // satulation thresholds
-                            const double   val_lower, const double val_upper) // value thresholds
-{
-  /* create imput image copy */
-  cv::Mat input_img = src.clone();
-
-  *dst = cv::Scalar::all(0);
+/* bit of each signal color in SignalColorTable */
+enum {
+  RED_SIGNAL_BIT    = 1,
+  YELLOW_SIGNAL_BIT = 2,
+  GREEN_SIGNAL_BIT  = 4,
+};
 
-  /*
-    ref:
-    http://qiita.com/crakaC/items/65fab9d0b0ac29e68ab6
-   */
+/*
+  For every possible H, S and V byte, the signal colors whose threshold range contains it.
+  A pixel has a color when the bit is set in all three tables.
+*/
+struct SignalColorTable {
+  uchar hue[256];
+  uchar sat[256];
+  uchar val[256];
+};
 
-  /* create LookUp Table */
-  cv::Mat lut(256, 1, CV_8UC3);
+static void setColorBits(SignalColorTable* table, const hsvSet& threshold, const uchar bit)
+{
   for (int i=0; i<256; i++)
     {
-	  lut.at<cv::Vec3b>(i)[0] = (IsRange(hue_lower, hue_upper, Actual_Hue(i))) ? 255 : 0;
-	  lut.at<cv::Vec3b>(i)[1] = (IsRange(sat_lower, sat_upper, Actual_Sat(i))) ? 255 : 0;
-	  lut.at<cv::Vec3b>(i)[2] = (IsRange(val_lower, val_upper, Actual_Val(i))) ? 255 : 0;
+      if (IsRange(threshold.Hue.lower, threshold.Hue.upper, Actual_Hue(i)))
+        table->hue[i] |= bit;
+      if (IsRange(threshold.Sat.lower, threshold.Sat.upper, Actual_Sat(i)))
+        table->sat[i] |= bit;
+      if (IsRange(threshold.Val.lower, threshold.Val.upper, Actual_Val(i)))
+        table->val[i] |= bit;
     }
+} /* static void setColorBits() */
 
-  /* apply LUT to input image */
-  cv::Mat extracted(input_img.rows, input_img.cols, CV_8UC3);
-  LUT(input_img, lut, extracted);
 
-  /* divide image into each channel */
-  std::vector<cv::Mat> channels;
-  split(extracted, channels);
+static void buildSignalColorTable(SignalColorTable* table)
+{
+  memset(table, 0, sizeof(SignalColorTable));
+  setColorBits(table, thSet.Red, RED_SIGNAL_BIT);
+  setColorBits(table, thSet.Yellow, YELLOW_SIGNAL_BIT);
+  setColorBits(table, thSet.Green, GREEN_SIGNAL_BIT);
+} /* static void buildSignalColorTable() */
 
-  /* create mask */
-  bitwise_and(channels[0], channels[1], *dst);
-  bitwise_and(*dst, channels[2], *dst);
 
+/*
+  binarize HSV image by all signal colors in one pass
+  (same as extracting red, yellow and green masks separately and OR-ing them)
+*/
+static void colorExtraction(const cv::Mat&          src, // input HSV image
+                            cv::Mat*                dst, // signal color extracted binarized image
+                            const SignalColorTable& table)
+{
+  dst->create(src.rows, src.cols, CV_8UC1);
+
+  for (int y=0; y<src.rows; y++)
+    {
+      const uchar* hsv = src.ptr<uchar>(y);
+      uchar*       out = dst->ptr<uchar>(y);
+      for (int x=0; x<src.cols; x++, hsv+=3)
+        {
+          out[x] = (table.hue[hsv[0]] & table.sat[hsv[1]] & table.val[hsv[2]]) ? 255 : 0;
+        }
+    }
 
 } /* static void colorExtraction() */
 
@@ -95,17 +118,19 @@ static bool checkExtinctionLight(const cv::Mat&  src_img,
 
   cv::Mat roi = src_img(cv::Rect(roi_top_left, roi_bot_right));
 
-  cv::Mat roi_HSV;
-  cvtColor(roi, roi_HSV, CV_BGR2HSV);
+  /* only V is used, which is max(B, G, R) of the pixel */
+  cv::Mat bgr_channel[3];
+  split(roi, bgr_channel);
 
-  cv::Mat hsv_channel[3];
-  split(roi_HSV, hsv_channel);
+  cv::Mat value;
+  cv::max(bgr_channel[0], bgr_channel[1], value);
+  cv::max(value, bgr_channel[2], value);
 
   int anchor = 3;
   cv::Mat kernel = getStructuringElement(cv::MORPH_ELLIPSE, cv::Size(2*anchor + 1, 2*anchor + 1), cv::Point(anchor, anchor));
 
   cv::Mat topHat_dark;
-  morphologyEx(hsv_channel[2], topHat_dark, cv::MORPH_TOPHAT, kernel, cv::Point(anchor, anchor), 5);
+  morphologyEx(value, topHat_dark, cv::MORPH_TOPHAT, kernel, cv::Point(anchor, anchor), 5);
 
   /* sharpening */
   cv::Mat tmp;
@@ -154,39 +179,17 @@ static cv::Mat signalDetect_inROI(const cv::Mat& roi,
                                   const cv::Mat&     src_img,
                                   const double       estimatedRadius,
                                   const cv::Point roi_topLeft,
-                                  bool in_turn_signal //if true it will not try to mask by using "circularity""
+                                  bool in_turn_signal, //if true it will not try to mask by using "circularity""
+                                  const SignalColorTable& table
                                   )
 {
   /* reduce noise */
   cv::Mat noiseReduced(roi.rows, roi.cols, CV_8UC3);
   GaussianBlur(roi, noiseReduced, cv::Size(3, 3), 0, 0);
 
-  /* extract color information */
-  cv::Mat red_mask(roi.rows, roi.cols, CV_8UC1);
-  colorExtraction(noiseReduced       ,
-                  &red_mask          ,
-                  thSet.Red.Hue.lower, thSet.Red.Hue.upper,
-                  thSet.Red.Sat.lower, thSet.Red.Sat.upper,
-                  thSet.Red.Val.lower, thSet.Red.Val.upper);
-
-  cv::Mat yellow_mask(roi.rows, roi.cols, CV_8UC1);
-  colorExtraction(noiseReduced          ,
-                  &yellow_mask          ,
-                  thSet.Yellow.Hue.lower, thSet.Yellow.Hue.upper,
-                  thSet.Yellow.Sat.lower, thSet.Yellow.Sat.upper,
-                  thSet.Yellow.Val.lower, thSet.Yellow.Val.upper);
-
-  cv::Mat green_mask(roi.rows, roi.cols, CV_8UC1);
-  colorExtraction(noiseReduced         ,
-                  &green_mask          ,
-                  thSet.Green.Hue.lower, thSet.Green.Hue.upper,
-                  thSet.Green.Sat.lower, thSet.Green.Sat.upper,
-                  thSet.Green.Val.lower, thSet.Green.Val.upper);
-
-  /* combine all color mask and create binarized image */
-  cv::Mat binarized = cv::Mat::zeros(roi.rows, roi.cols, CV_8UC1);
-  bitwise_or(red_mask, yellow_mask, binarized);
-  bitwise_or(binarized, green_mask, binarized);
+  /* extract color information and create binarized image */
+  cv::Mat binarized;
+  colorExtraction(noiseReduced, &binarized, table);
   threshold(binarized, binarized, 0, 255, CV_THRESH_BINARY | CV_THRESH_OTSU);
 
   /* filter by its shape and index each bright region */
@@ -349,115 +352,166 @@ static cv::Mat signalDetect_inROI(const cv::Mat& roi,
 } /* static void signalDetect_inROI() */
 
 
-/* constructor for non initialize value */
-TrafficLightDetector::TrafficLightDetector() {}
+/* sigmoid curve applied to V to emphasize bright lamps */
+static cv::Mat contrastCorrectionLUT()
+{
+  float correction_factor = 10.0;
+  cv::Mat lut(cv::Size(256, 1), CV_8U);
+  for (int i=0; i<256; i++) {
+    lut.at<uchar>(i) = 255.0 / (1 + exp(-correction_factor*(i-128)/255));
+  }
+  return lut;
+} /* static cv::Mat contrastCorrectionLUT() */
 
 
-void TrafficLightDetector::brightnessDetect(const cv::Mat &input) {
+/* judge the lamp state of one context from its part of the shared HSV image */
+static void detectContextState(Context&                context,
+                               const cv::Mat&          input,        // original BGR image
+                               const cv::Mat&          area_HSV,     // contrast corrected HSV image of area
+                               const cv::Point         area_topLeft, // position of area_HSV in input
+                               const SignalColorTable& table)
+{
+  if (context.topLeft.x > context.botRight.x)
+    return;
 
-  cv::Mat tmpImage;
-  input.copyTo(tmpImage);
+  /* extract region of interest from the HSV image */
+  cv::Mat roi_HSV = area_HSV(cv::Rect(context.topLeft - area_topLeft, context.botRight - area_topLeft));
+
+  /* search the place where traffic signals seem to be */
+  cv::Mat    signalMask    = signalDetect_inROI(roi_HSV, input,
+                                                context.lampRadius,
+                                                context.topLeft,
+                                                context.leftTurnSignal || context.rightTurnSignal,
+                                                table);
+
+  /* detect which color is dominant */
+  int red_pixNum    = 0;
+  int yellow_pixNum = 0;
+  int green_pixNum  = 0;
+  int valid_pixNum  = 0;
+  for (int y=0; y<roi_HSV.rows; y++)
+    {
+      const uchar* hsv  = roi_HSV.ptr<uchar>(y);
+      const uchar* mask = signalMask.ptr<uchar>(y);
+      for (int x=0; x<roi_HSV.cols; x++, hsv+=3)
+        {
+          /* extract H, V value from pixel */
+          if (mask[x] == 0 || hsv[2] == 0) {
+            continue;         // this is masked pixel
+          }
+          valid_pixNum++;
 
-  /* contrast correction */
-  cv::Mat tmp;
-  cvtColor(tmpImage, tmp, CV_BGR2HSV);
-  std::vector<cv::Mat> hsv_channel;
-  split(tmp, hsv_channel);
+          /* search which color is actually bright */
+          uchar hue_bits = table.hue[hsv[0]];
+          if (hue_bits & RED_SIGNAL_BIT) {
+            red_pixNum++;
+          }
 
-  float correction_factor = 10.0;
-  uchar lut[256];
-  for (int i=0; i<256; i++) {
-    lut[i] = 255.0 / (1 + exp(-correction_factor*(i-128)/255));
+          if (hue_bits & YELLOW_SIGNAL_BIT) {
+            yellow_pixNum++;
+          }
+
+          if (hue_bits & GREEN_SIGNAL_BIT) {
+            green_pixNum++;
+          }
+        }
+    }
+
+  // std::cout << "(green, yellow, red) / valid = (" << green_pixNum << ", " << yellow_pixNum << ", " << red_pixNum << ") / " << valid_pixNum <<std::endl;
+
+  bool isRed_bright;
+  bool isYellow_bright;
+  bool isGreen_bright;
+
+  if (valid_pixNum > 0) {
+    isRed_bright    = ( ((double)red_pixNum / valid_pixNum)    > 0.5) ? true : false;
+    isYellow_bright = ( ((double)yellow_pixNum / valid_pixNum) > 0.5) ? true : false;
+    isGreen_bright  = ( ((double)green_pixNum / valid_pixNum)  > 0.5) ? true : false;
+  } else {
+    isRed_bright    = false;
+    isYellow_bright = false;
+    isGreen_bright  = false;
   }
 
-  LUT(hsv_channel[2], cv::Mat(cv::Size(256, 1), CV_8U, lut), hsv_channel[2]);
-  merge(hsv_channel, tmp);
-  cvtColor(tmp, tmpImage, CV_HSV2BGR);
+  int currentLightsCode = getCurrentLightsCode(isRed_bright, isYellow_bright, isGreen_bright);
+  context.lightState = determineState(context.lightState, currentLightsCode, &(context.stateJudgeCount));
 
-  for (int i = 0; i < static_cast<int>(contexts.size()); i++) {
-    Context context = contexts.at(i);
+} /* static void detectContextState() */
 
-    if (context.topLeft.x > context.botRight.x)
-      continue;
 
-    /* extract region of interest from input image */
-    cv::Mat roi = tmpImage(cv::Rect(context.topLeft, context.botRight));
+/* contexts only read the shared images and write their own entry */
+class ContextDetectBody : public cv::ParallelLoopBody {
+public:
+  ContextDetectBody(std::vector<Context>& contexts, const cv::Mat& input, const cv::Mat& area_HSV,
+                    const cv::Point area_topLeft, const SignalColorTable& table)
+    : contexts_(contexts), input_(input), area_HSV_(area_HSV), area_topLeft_(area_topLeft), table_(table) {}
 
-    /* convert color space (BGR -> HSV) */
-    cv::Mat roi_HSV;
-    cvtColor(roi, roi_HSV, CV_BGR2HSV);
+  void operator()(const cv::Range& range) const {
+    for (int i = range.start; i < range.end; i++) {
+      detectContextState(contexts_[i], input_, area_HSV_, area_topLeft_, table_);
+    }
+  }
 
-    /* search the place where traffic signals seem to be */
-    cv::Mat    signalMask    = signalDetect_inROI(roi_HSV, input.clone(),
-                                                  context.lampRadius,
-                                                  context.topLeft,
-                                                  context.leftTurnSignal || context.rightTurnSignal);
+private:
+  std::vector<Context>&   contexts_;
+  const cv::Mat&          input_;
+  const cv::Mat&          area_HSV_;
+  const cv::Point         area_topLeft_;
+  const SignalColorTable& table_;
+};
 
-    /* detect which color is dominant */
-    cv::Mat extracted_HSV;
-    roi.copyTo(extracted_HSV, signalMask);
 
-#ifdef SHOW_DEBUG_INFO
-    extracted_HSV.copyTo(roi);
-    imshow("tmpImage", tmpImage);
-    cv::waitKey(5);
-#endif
+/* constructor for non initialize value */
+TrafficLightDetector::TrafficLightDetector() {}
 
-    cvtColor(extracted_HSV, extracted_HSV, CV_BGR2HSV);
-
-    int red_pixNum    = 0;
-    int yellow_pixNum = 0;
-    int green_pixNum  = 0;
-    int valid_pixNum  = 0;
-    for (int y=0; y<extracted_HSV.rows; y++)
-      {
-        for (int x=0; x<extracted_HSV.cols; x++)
-          {
-            /* extract H, V value from pixel */
-            double hue = Actual_Hue(extracted_HSV.at<cv::Vec3b>(y, x)[0]);
-            uchar  val = extracted_HSV.at<cv::Vec3b>(y, x)[2];
-
-            if (val == 0) {
-              continue;         // this is masked pixel
-            }
-            valid_pixNum++;
 
-            /* search which color is actually bright */
-            if (IsRange(thSet.Red.Hue.lower, thSet.Red.Hue.upper, hue)) {
-              red_pixNum++;
-            }
+void TrafficLightDetector::brightnessDetect(const cv::Mat &input) {
 
-            if (IsRange(thSet.Yellow.Hue.lower, thSet.Yellow.Hue.upper, hue)) {
-              yellow_pixNum++;
-            }
+  /* only the area covered by the contexts is converted, once for all of them */
+  cv::Rect area;
+  bool has_roi = false;
+  for (unsigned int i = 0; i < contexts.size(); i++) {
+    const Context& context = contexts.at(i);
+    if (context.topLeft.x > context.botRight.x)
+      continue;
 
-            if (IsRange(thSet.Green.Hue.lower, thSet.Green.Hue.upper, hue)) {
-              green_pixNum++;
-            }
-          }
-    }
+    cv::Rect roi(context.topLeft, context.botRight);
+    area = (has_roi) ? (area | roi) : roi;
+    has_roi = true;
+  }
 
-    // std::cout << "(green, yellow, red) / valid = (" << green_pixNum << ", " << yellow_pixNum << ", " << red_pixNum << ") / " << valid_pixNum <<std::endl;
+  area &= cv::Rect(0, 0, input.cols, input.rows);
+  if (!has_roi || area.area() == 0)
+    return;
 
-    bool isRed_bright;
-    bool isYellow_bright;
-    bool isGreen_bright;
+  /* contrast correction */
+  static const cv::Mat lut = contrastCorrectionLUT();
+  cv::Mat tmp;
+  cvtColor(input(area), tmp, CV_BGR2HSV);
+  std::vector<cv::Mat> hsv_channel;
+  split(tmp, hsv_channel);
 
-    if (valid_pixNum > 0) {
-      isRed_bright    = ( ((double)red_pixNum / valid_pixNum)    > 0.5) ? true : false;
-      isYellow_bright = ( ((double)yellow_pixNum / valid_pixNum) > 0.5) ? true : false;
-      isGreen_bright  = ( ((double)green_pixNum / valid_pixNum)  > 0.5) ? true : false;
-    } else {
-      isRed_bright    = false;
-      isYellow_bright = false;
-      isGreen_bright  = false;
-    }
+  LUT(hsv_channel[2], lut, hsv_channel[2]);
+  merge(hsv_channel, tmp);
 
-    int currentLightsCode = getCurrentLightsCode(isRed_bright, isYellow_bright, isGreen_bright);
-    contexts.at(i).lightState = determineState(contexts.at(i).lightState, currentLightsCode, &(contexts.at(i).stateJudgeCount));
+  cv::Mat corrected;
+  cvtColor(tmp, corrected, CV_HSV2BGR);
 
-    roi.setTo(cv::Scalar(0));
-  }
+  /* convert color space (BGR -> HSV) */
+  cv::Mat area_HSV;
+  cvtColor(corrected, area_HSV, CV_BGR2HSV);
+
+  /* thresholds may be updated between frames */
+  SignalColorTable table;
+  buildSignalColorTable(&table);
+
+  ContextDetectBody body(contexts, input, area_HSV, area.tl(), table);
+#ifdef SHOW_DEBUG_INFO
+  /* debug windows are only updated from this thread */
+  body(cv::Range(0, static_cast<int>(contexts.size())));
+#else
+  cv::parallel_for_(cv::Range(0, static_cast<int>(contexts.size())), body);
+#endif
 }
 
 double getBrightnessRatioInCircle(const cv::Mat &input, const cv::Point center, const int radius) {
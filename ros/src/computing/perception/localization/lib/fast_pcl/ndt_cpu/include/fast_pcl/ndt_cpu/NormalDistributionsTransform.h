@@ -2,6 +2,7 @@
 #define CPU_NDT_H_
 
 #include "Registration.h"
+#include "ScopedTimer.h"
 #include "VoxelGrid.h"
 #include <eigen3/Eigen/Geometry>
 
@@ -30,12 +31,61 @@ public:
 
 	int getRealIterations();
 
+	/* Number of levels of the coarse-to-fine voxel grid pyramid.
+	 * Level l uses a leaf size of resolution * scale^l and aligns every
+	 * 2^l-th source point. Level 1 means single resolution alignment.
+	 * Must be set before setInputTarget. */
+	void setPyramidLevels(int levels);
+
+	void setPyramidScale(float scale);
+
+	int getPyramidLevels() const;
+
+	float getPyramidScale() const;
+
+	/* Number of iterations spent in coarse levels of the last alignment */
+	int getCoarseIterations() const;
+
+	/* Per-stage timing of align(). Disabled by default; when enabled the
+	 * times below are reset at the start of every alignment and given in
+	 * milliseconds. The line search time includes the transform,
+	 * derivative and hessian time spent inside it. */
+	void setProfiling(bool profiling);
+
+	bool getProfiling() const;
+
+	double getTransformTime() const;
+
+	double getDerivativesTime() const;
+
+	double getLineSearchTime() const;
+
+	double getHessianTime() const;
+
+	/* Number of More-Thuente trial steps taken in the last alignment */
+	int getLineSearchIterations() const;
+
 	/* Set the input map points */
 	void setInputTarget(typename pcl::PointCloud<PointTargetType>::Ptr input);
 
 	/* Compute and get fitness score */
 	double getFitnessScore(double max_range = DBL_MAX);
 
+	/* Fitness score that may stop before visiting every source point.
+	 * Points are visited in interleaved passes so that any prefix is spread
+	 * over the whole scan. After min_points, evaluation stops once the 95%
+	 * confidence interval of the mean distance is within confidence * mean
+	 * and that of the inlier ratio is within confidence.
+	 * confidence <= 0 visits every point. */
+	double getFitnessScore(double max_range, double confidence, int min_points = 100);
+
+	/* Fraction of the evaluated points within max_range of the map
+	 * in the last fitness score evaluation */
+	double getInlierRatio() const;
+
+	/* Number of source points visited by the last fitness score evaluation */
+	int getFitnessPoints() const;
+
 protected:
 	void computeTransformation(const Eigen::Matrix<float, 4, 4> &guess);
 
@@ -67,6 +117,13 @@ private:
 									double a_u, double f_u, double g_u,
 									double a_t, double f_t, double g_t);
 
+	/* Newton iterations against a single level of the pyramid */
+	void computeLevelTransformation(int level, const Eigen::Matrix<float, 4, 4> &guess);
+
+	VoxelGrid<PointSourceType> &levelGrid(int level);
+
+	float levelResolution(int level) const;
+
 	void computeAngleDerivatives(Eigen::Matrix<double, 6, 1> pose, bool compute_hessian = true);
 
 	double computeStepLengthMT(const Eigen::Matrix<double, 6, 1> &x, Eigen::Matrix<double, 6, 1> &step_dir,
@@ -106,6 +163,24 @@ private:
 
 
 	VoxelGrid<PointSourceType> voxel_grid_;
+
+	int pyramid_levels_;
+	float pyramid_scale_;
+	int level_;					// Pyramid level being aligned, 0 is the finest
+	int coarse_iterations_;
+
+	// Voxel grids of levels 1..pyramid_levels_ - 1, level 0 is voxel_grid_
+	std::vector<VoxelGrid<PointSourceType> > coarse_grids_;
+
+	bool profiling_;
+	double transform_time_;
+	double derivatives_time_;
+	double line_search_time_;
+	double hessian_time_;
+	int line_search_iterations_;
+
+	double inlier_ratio_;
+	int fitness_points_;
 };
 }
 
@@ -0,0 +1,35 @@
+#ifndef CPU_SCOPED_TIMER_H_
+#define CPU_SCOPED_TIMER_H_
+
+#include <chrono>
+
+namespace cpu {
+
+/* Adds the time spent in the enclosing scope to an accumulator, in milliseconds.
+ * A disabled timer never reads the clock, so leaving timers in hot paths costs
+ * a single branch when profiling is off. */
+class ScopedTimer {
+public:
+	ScopedTimer(bool enabled, double &elapsed_ms) : enabled_(enabled), elapsed_ms_(elapsed_ms)
+	{
+		if (enabled_)
+			start_ = std::chrono::steady_clock::now();
+	}
+
+	~ScopedTimer()
+	{
+		if (enabled_)
+			elapsed_ms_ += std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start_).count();
+	}
+
+private:
+	ScopedTimer(const ScopedTimer &other);
+	ScopedTimer &operator=(const ScopedTimer &other);
+
+	bool enabled_;
+	double &elapsed_ms_;
+	std::chrono::steady_clock::time_point start_;
+};
+}
+
+#endif
@@ -1,5 +1,6 @@
 #include "fast_pcl/ndt_cpu/NormalDistributionsTransform.h"
 #include "fast_pcl/ndt_cpu/debug.h"
+#include <algorithm>
 #include <cmath>
 #include <iostream>
 #include <pcl/common/transforms.h>
@@ -29,6 +30,18 @@ NormalDistributionsTransform<PointSourceType, PointTargetType>::NormalDistributi
 	transformation_epsilon_ = 0.1;
 	max_iterations_ = 35;
 	real_iterations_ = 0;
+
+	pyramid_levels_ = 1;
+	pyramid_scale_ = 2.0f;
+	level_ = 0;
+	coarse_iterations_ = 0;
+
+	profiling_ = false;
+	transform_time_ = derivatives_time_ = line_search_time_ = hessian_time_ = 0;
+	line_search_iterations_ = 0;
+
+	inlier_ratio_ = 0;
+	fitness_points_ = 0;
 }
 
 template <typename PointSourceType, typename PointTargetType>
@@ -79,6 +92,90 @@ int NormalDistributionsTransform<PointSourceType, PointTargetType>::getRealItera
 	 return real_iterations_;
 }
 
+template <typename PointSourceType, typename PointTargetType>
+void NormalDistributionsTransform<PointSourceType, PointTargetType>::setPyramidLevels(int levels)
+{
+	pyramid_levels_ = (levels > 1) ? levels : 1;
+}
+
+template <typename PointSourceType, typename PointTargetType>
+void NormalDistributionsTransform<PointSourceType, PointTargetType>::setPyramidScale(float scale)
+{
+	pyramid_scale_ = (scale > 1.0f) ? scale : 2.0f;
+}
+
+template <typename PointSourceType, typename PointTargetType>
+int NormalDistributionsTransform<PointSourceType, PointTargetType>::getPyramidLevels() const
+{
+	return pyramid_levels_;
+}
+
+template <typename PointSourceType, typename PointTargetType>
+float NormalDistributionsTransform<PointSourceType, PointTargetType>::getPyramidScale() const
+{
+	return pyramid_scale_;
+}
+
+template <typename PointSourceType, typename PointTargetType>
+int NormalDistributionsTransform<PointSourceType, PointTargetType>::getCoarseIterations() const
+{
+	return coarse_iterations_;
+}
+
+template <typename PointSourceType, typename PointTargetType>
+void NormalDistributionsTransform<PointSourceType, PointTargetType>::setProfiling(bool profiling)
+{
+	profiling_ = profiling;
+}
+
+template <typename PointSourceType, typename PointTargetType>
+bool NormalDistributionsTransform<PointSourceType, PointTargetType>::getProfiling() const
+{
+	return profiling_;
+}
+
+template <typename PointSourceType, typename PointTargetType>
+double NormalDistributionsTransform<PointSourceType, PointTargetType>::getTransformTime() const
+{
+	return transform_time_;
+}
+
+template <typename PointSourceType, typename PointTargetType>
+double NormalDistributionsTransform<PointSourceType, PointTargetType>::getDerivativesTime() const
+{
+	return derivatives_time_;
+}
+
+template <typename PointSourceType, typename PointTargetType>
+double NormalDistributionsTransform<PointSourceType, PointTargetType>::getLineSearchTime() const
+{
+	return line_search_time_;
+}
+
+template <typename PointSourceType, typename PointTargetType>
+double NormalDistributionsTransform<PointSourceType, PointTargetType>::getHessianTime() const
+{
+	return hessian_time_;
+}
+
+template <typename PointSourceType, typename PointTargetType>
+int NormalDistributionsTransform<PointSourceType, PointTargetType>::getLineSearchIterations() const
+{
+	return line_search_iterations_;
+}
+
+template <typename PointSourceType, typename PointTargetType>
+VoxelGrid<PointSourceType> &NormalDistributionsTransform<PointSourceType, PointTargetType>::levelGrid(int level)
+{
+	return (level == 0) ? voxel_grid_ : coarse_grids_[level - 1];
+}
+
+template <typename PointSourceType, typename PointTargetType>
+float NormalDistributionsTransform<PointSourceType, PointTargetType>::levelResolution(int level) const
+{
+	return resolution_ * pow(pyramid_scale_, level);
+}
+
 template <typename PointSourceType, typename PointTargetType>
 double NormalDistributionsTransform<PointSourceType, PointTargetType>::auxilaryFunction_PsiMT(double a, double f_a, double f_0, double g_0, double mu)
 {
@@ -100,26 +197,89 @@ void NormalDistributionsTransform<PointSourceType, PointTargetType>::setInputTar
 	if (input->points.size() > 0) {
 		voxel_grid_.setLeafSize(resolution_, resolution_, resolution_);
 		voxel_grid_.setInput(input);
+
+		// Coarser levels of the pyramid
+		coarse_grids_.clear();
+		coarse_grids_.resize(pyramid_levels_ - 1);
+
+		for (int level = 1; level < pyramid_levels_; level++) {
+			float leaf_size = levelResolution(level);
+
+			coarse_grids_[level - 1].setLeafSize(leaf_size, leaf_size, leaf_size);
+			coarse_grids_[level - 1].setInput(input);
+		}
 	}
 }
 
 template <typename PointSourceType, typename PointTargetType>
 void NormalDistributionsTransform<PointSourceType, PointTargetType>::computeTransformation(const Eigen::Matrix<float, 4, 4> &guess)
+{
+	coarse_iterations_ = 0;
+
+	transform_time_ = derivatives_time_ = line_search_time_ = hessian_time_ = 0;
+	line_search_iterations_ = 0;
+
+	int levels = std::min(pyramid_levels_, static_cast<int>(coarse_grids_.size()) + 1);
+
+	if (levels <= 1) {
+		computeLevelTransformation(0, guess);
+		return;
+	}
+
+	// Align coarse-to-fine. Each coarse level only uses every 2^level-th
+	// source point and hands its result to the next finer level as the guess.
+	typename pcl::PointCloud<PointSourceType>::Ptr full_source = source_cloud_;
+	Eigen::Matrix<float, 4, 4> level_guess = guess;
+
+	for (int level = levels - 1; level > 0; level--) {
+		int stride = 1 << level;
+		typename pcl::PointCloud<PointSourceType>::Ptr level_source(new pcl::PointCloud<PointSourceType>());
+
+		level_source->points.reserve(full_source->points.size() / stride + 1);
+
+		for (int i = 0; i < full_source->points.size(); i += stride) {
+			level_source->points.push_back(full_source->points[i]);
+		}
+
+		source_cloud_ = level_source;
+
+		computeLevelTransformation(level, level_guess);
+
+		coarse_iterations_ += nr_iterations_;
+		level_guess = final_transformation_;
+	}
+
+	source_cloud_ = full_source;
+
+	computeLevelTransformation(0, level_guess);
+}
+
+template <typename PointSourceType, typename PointTargetType>
+void NormalDistributionsTransform<PointSourceType, PointTargetType>::computeLevelTransformation(int level, const Eigen::Matrix<float, 4, 4> &guess)
 {
 	nr_iterations_ = 0;
 	converged_ = false;
+	level_ = level;
 
 	double gauss_c1, gauss_c2, gauss_d3;
+	float resolution = levelResolution(level);
+
+	// Coarse levels take proportionally longer steps and stop earlier
+	double level_scale = resolution / resolution_;
+	double step_size = step_size_ * level_scale;
+	double trans_eps = transformation_epsilon_ * level_scale;
 
 	gauss_c1 = 10 * ( 1 - outlier_ratio_);
-	gauss_c2 = outlier_ratio_ / pow(resolution_, 3);
+	gauss_c2 = outlier_ratio_ / pow(resolution, 3);
 	gauss_d3 = - log(gauss_c2);
 	gauss_d1_ = -log(gauss_c1 + gauss_c2) - gauss_d3;
 	gauss_d2_ = -2 * log((-log(gauss_c1 * exp(-0.5) + gauss_c2) - gauss_d3) / gauss_d1_);
 
-	if (guess != Eigen::Matrix4f::Identity()) {
+	// trans_cloud_ no longer matches the source after a coarser level ran
+	if (guess != Eigen::Matrix4f::Identity() || level > 0 || trans_cloud_.points.size() != source_cloud_->points.size()) {
 		final_transformation_ = guess;
 
+		ScopedTimer timer(profiling_, transform_time_);
 		pcl::transformPointCloud(*source_cloud_, trans_cloud_, guess);
 	}
 
@@ -157,7 +317,7 @@ void NormalDistributionsTransform<PointSourceType, PointTargetType>::computeTran
 		}
 
 		delta_p.normalize();
-		delta_p_norm = computeStepLengthMT(p, delta_p, delta_p_norm, step_size_, transformation_epsilon_ / 2, score, score_gradient, hessian, trans_cloud_);
+		delta_p_norm = computeStepLengthMT(p, delta_p, delta_p_norm, step_size, trans_eps / 2, score, score_gradient, hessian, trans_cloud_);
 		delta_p *= delta_p_norm;
 
 		transformation_ = (Eigen::Translation<float, 3>(static_cast<float>(delta_p(0)), static_cast<float>(delta_p(1)), static_cast<float>(delta_p(2))) *
@@ -169,7 +329,7 @@ void NormalDistributionsTransform<PointSourceType, PointTargetType>::computeTran
 
 		//Not update visualizer
 
-		if (nr_iterations_ > max_iterations_ || (nr_iterations_ && (std::fabs(delta_p_norm) < transformation_epsilon_)))
+		if (nr_iterations_ > max_iterations_ || (nr_iterations_ && (std::fabs(delta_p_norm) < trans_eps)))
 			converged_ = true;
 
 		nr_iterations_++;
@@ -184,6 +344,8 @@ double NormalDistributionsTransform<PointSourceType, PointTargetType>::computeDe
 																							typename pcl::PointCloud<PointSourceType> &trans_cloud,
 																							Eigen::Matrix<double, 6, 1> pose, bool compute_hessian)
 {
+	ScopedTimer timer(profiling_, derivatives_time_);
+
 	PointSourceType x_pt, x_trans_pt;
 	Eigen::Vector3d x, x_trans;
 	Eigen::Matrix3d c_inv;
@@ -203,11 +365,14 @@ double NormalDistributionsTransform<PointSourceType, PointTargetType>::computeDe
 	point_gradient.block<3, 3>(0, 0).setIdentity();
 	point_hessian.setZero();
 
+	VoxelGrid<PointSourceType> &grid = levelGrid(level_);
+	float resolution = levelResolution(level_);
+
 	for (int idx = 0; idx < source_cloud_->points.size(); idx++) {
 		neighbor_ids.clear();
 		x_trans_pt = trans_cloud.points[idx];
 
-		voxel_grid_.radiusSearch(x_trans_pt, resolution_, neighbor_ids);
+		grid.radiusSearch(x_trans_pt, resolution, neighbor_ids);
 
 		for (int i = 0; i < neighbor_ids.size(); i++) {
 			int vid = neighbor_ids[i];
@@ -217,8 +382,8 @@ double NormalDistributionsTransform<PointSourceType, PointTargetType>::computeDe
 
 			x_trans = Eigen::Vector3d(x_trans_pt.x, x_trans_pt.y, x_trans_pt.z);
 
-			x_trans -= voxel_grid_.getCentroid(vid);
-			c_inv = voxel_grid_.getInverseCovariance(vid);
+			x_trans -= grid.getCentroid(vid);
+			c_inv = grid.getInverseCovariance(vid);
 
 			computePointDerivatives(x, point_gradient, point_hessian, compute_hessian);
 
@@ -429,6 +594,8 @@ double NormalDistributionsTransform<PointSourceType, PointTargetType>::computeSt
 																							Eigen::Matrix<double, 6, 1> &score_gradient, Eigen::Matrix<double, 6, 6> &hessian,
 																							typename pcl::PointCloud<PointSourceType> &trans_cloud)
 {
+	ScopedTimer timer(profiling_, line_search_time_);
+
 	double phi_0 = -score;
 	double d_phi_0 = -(score_gradient.dot(step_dir));
 
@@ -469,7 +636,10 @@ double NormalDistributionsTransform<PointSourceType, PointTargetType>::computeSt
 								Eigen::AngleAxis<float>(static_cast<float>(x_t(4)), Eigen::Vector3f::UnitY()) *
 								Eigen::AngleAxis<float>(static_cast<float>(x_t(5)), Eigen::Vector3f::UnitZ())).matrix();
 
-	transformPointCloud(*source_cloud_, trans_cloud, final_transformation_);
+	{
+		ScopedTimer transform_timer(profiling_, transform_time_);
+		transformPointCloud(*source_cloud_, trans_cloud, final_transformation_);
+	}
 
 	score = computeDerivatives(score_gradient, hessian, trans_cloud, x_t, true);
 
@@ -495,7 +665,10 @@ double NormalDistributionsTransform<PointSourceType, PointTargetType>::computeSt
 								 Eigen::AngleAxis<float>(static_cast<float>(x_t(4)), Eigen::Vector3f::UnitY()) *
 								 Eigen::AngleAxis<float>(static_cast<float>(x_t(5)), Eigen::Vector3f::UnitZ())).matrix();
 
-		transformPointCloud(*source_cloud_, trans_cloud, final_transformation_);
+		{
+			ScopedTimer transform_timer(profiling_, transform_time_);
+			transformPointCloud(*source_cloud_, trans_cloud, final_transformation_);
+		}
 
 		score = computeDerivatives(score_gradient, hessian, trans_cloud, x_t, false);
 
@@ -527,6 +700,7 @@ double NormalDistributionsTransform<PointSourceType, PointTargetType>::computeSt
 	}
 
 	real_iterations_ += step_iterations;
+	line_search_iterations_ += step_iterations;
 
 	return a_t;
 }
@@ -672,6 +846,8 @@ void NormalDistributionsTransform<PointSourceType, PointTargetType>::updateHessi
 template <typename PointSourceType, typename PointTargetType>
 void NormalDistributionsTransform<PointSourceType, PointTargetType>::computeHessian(Eigen::Matrix<double, 6, 6> &hessian, typename pcl::PointCloud<PointSourceType> &trans_cloud, Eigen::Matrix<double, 6, 1> &p)
 {
+	ScopedTimer timer(profiling_, hessian_time_);
+
 	PointSourceType x_pt, x_trans_pt;
 	Eigen::Vector3d x, x_trans;
 	Eigen::Matrix3d c_inv;
@@ -682,12 +858,15 @@ void NormalDistributionsTransform<PointSourceType, PointTargetType>::computeHess
 	Eigen::Matrix<double, 18, 6> point_hessian;
 
 
+	VoxelGrid<PointSourceType> &grid = levelGrid(level_);
+	float resolution = levelResolution(level_);
+
 	for (int idx = 0; idx < source_cloud_->points.size(); idx++) {
 		x_trans_pt = trans_cloud.points[idx];
 
 		std::vector<int> neighbor_ids;
 
-		voxel_grid_.radiusSearch(x_trans_pt, resolution_, neighbor_ids);
+		grid.radiusSearch(x_trans_pt, resolution, neighbor_ids);
 
 		for (int i = 0; i < neighbor_ids.size(); i++) {
 			int vid = neighbor_ids[i];
@@ -695,8 +874,8 @@ void NormalDistributionsTransform<PointSourceType, PointTargetType>::computeHess
 			x_pt = source_cloud_->points[idx];
 			x = Eigen::Vector3d(x_pt.x, x_pt.y, x_pt.z);
 			x_trans = Eigen::Vector3d(x_trans_pt.x, x_trans_pt.y, x_trans_pt.z);
-			x_trans -= voxel_grid_.getCentroid(vid);
-			c_inv = voxel_grid_.getInverseCovariance(vid);
+			x_trans -= grid.getCentroid(vid);
+			c_inv = grid.getInverseCovariance(vid);
 
 			computePointDerivatives(x, point_gradient, point_hessian);
 
@@ -710,33 +889,80 @@ void NormalDistributionsTransform<PointSourceType, PointTargetType>::computeHess
 template <typename PointSourceType, typename PointTargetType>
 double NormalDistributionsTransform<PointSourceType, PointTargetType>::getFitnessScore(double max_range)
 {
-	double fitness_score = 0.0;
+	return getFitnessScore(max_range, 0);
+}
+
+template <typename PointSourceType, typename PointTargetType>
+double NormalDistributionsTransform<PointSourceType, PointTargetType>::getFitnessScore(double max_range, double confidence, int min_points)
+{
+	// z value of the two-sided 95% confidence interval
+	const double z_score = 1.96;
+	const int stride = 16;
+
+	int points_number = source_cloud_->points.size();
+	int nr = 0, visited = 0;
+	double mean = 0, m2 = 0;	// Welford's running mean and sum of squared deviations
+	bool early_exit = false;
+
+	Eigen::Matrix<float, 4, 4> &t = final_transformation_;
 
-	typename pcl::PointCloud<PointSourceType> trans_cloud;
+	for (int pass = 0; pass < stride && !early_exit; pass++) {
+		for (int i = pass; i < points_number; i += stride) {
+			PointSourceType q = source_cloud_->points[i];
+			float x = q.x, y = q.y, z = q.z;
 
-	transformPointCloud(*source_cloud_, trans_cloud, final_transformation_);
+			q.x = t(0, 0) * x + t(0, 1) * y + t(0, 2) * z + t(0, 3);
+			q.y = t(1, 0) * x + t(1, 1) * y + t(1, 2) * z + t(1, 3);
+			q.z = t(2, 0) * x + t(2, 1) * y + t(2, 2) * z + t(2, 3);
 
-	double distance;
-	int nr = 0;
+			double distance = voxel_grid_.nearestNeighborDistance(q, max_range);
 
+			visited++;
 
-	for (int i = 0; i < trans_cloud.points.size(); i++) {
-		PointSourceType q = trans_cloud.points[i];
+			if (distance <= max_range) {
+				nr++;
 
-		distance = voxel_grid_.nearestNeighborDistance(q, max_range);
+				double delta = distance - mean;
 
-		if (distance <= max_range) {
-			fitness_score += distance;
-			nr++;
+				mean += delta / nr;
+				m2 += delta * (distance - mean);
+			}
+
+			if (confidence <= 0 || visited < min_points || nr < 2)
+				continue;
+
+			double ratio = static_cast<double>(nr) / visited;
+			double mean_error = z_score * sqrt(m2 / (nr - 1) / nr);
+			double ratio_error = z_score * sqrt(ratio * (1 - ratio) / visited);
+
+			if (mean_error <= confidence * mean && ratio_error <= confidence) {
+				early_exit = true;
+				break;
+			}
 		}
 	}
 
+	fitness_points_ = visited;
+	inlier_ratio_ = (visited > 0) ? static_cast<double>(nr) / visited : 0;
+
 	if (nr > 0)
-		return (fitness_score / nr);
+		return mean;
 
 	return DBL_MAX;
 }
 
+template <typename PointSourceType, typename PointTargetType>
+double NormalDistributionsTransform<PointSourceType, PointTargetType>::getInlierRatio() const
+{
+	return inlier_ratio_;
+}
+
+template <typename PointSourceType, typename PointTargetType>
+int NormalDistributionsTransform<PointSourceType, PointTargetType>::getFitnessPoints() const
+{
+	return fitness_points_;
+}
+
 template class NormalDistributionsTransform<pcl::PointXYZI, pcl::PointXYZI>;
 template class NormalDistributionsTransform<pcl::PointXYZ, pcl::PointXYZ>;
 
@@ -20,79 +20,13 @@
 #define __NDT_TKU__
 
 #include <GL/glut.h>
-/*root cell size*/
-/*
-  #define MAP_CELLSIZE 0.2 //m
 
-  #define MAP_X 128
-  #define MAP_Y 80
-  #define MAP_Z 48
-*/
+// The map grid is configured at runtime through g_map_x, g_map_y, g_map_z and
+// g_map_cellsize before initialize_NDmap(). Cells are stored sparsely, so the
+// grid size only bounds the addressable area.
 
-//#define MAP_CELLSIZE 1.0 //m
-#define MAX_ND_NUM (20000000)
-
-// map origin//
-// meidai_map
-#if 0
-#define MAP_CENTER_X (-18407.4 + 215)
-#define MAP_CENTER_Y (-93444.9 - 400)
-#define MAP_CENTER_Z 33
-#define MAP_ROTATION 0.0
-//map size
-#define MAP_X 1600
-#define MAP_Y 1600
-#define MAP_Z 200
-#endif
-
-// meidai_map_all
-#if 0
-#define MAP_CENTER_X (-18500)
-#define MAP_CENTER_Y (-93800)
-#define MAP_CENTER_Z 33
-#define MAP_ROTATION 0.0
-//map size
-#define MAP_X 2200
-#define MAP_Y 2600
-#define MAP_Z 200
-
-#endif
-
-// moriyama_map
-#if 0
-#define MAP_CENTER_X -15741
-#define MAP_CENTER_Y -85697
-#define MAP_CENTER_Z 70
-#define MAP_ROTATION 0.7
-//map size
-#define MAP_X 1600
-#define MAP_Y 1600
-#define MAP_Z 200
-#endif
-
-// tctslc map
-#if 0
-#define MAP_CENTER_X 3702
-#define MAP_CENTER_Y -99430
-#define MAP_CENTER_Z 85
-#define MAP_ROTATION 0
-//map size
-#define MAP_X 1600
-#define MAP_Y 1600
-#define MAP_Z 200
-#endif
-
-#if 0
-//map offset
-#define MAP_CENTER_X 0
-#define MAP_CENTER_Y 0
-#define MAP_CENTER_Z 0
-#define MAP_ROTATION 0
-//map size
-#define MAP_X 1600
-#define MAP_Y 1600
-#define MAP_Z 200
-#endif
+// initial number of hashed cells per layer (power of two)
+#define ND_INITIAL_CELLS (1 << 16)
 
 // initial position
 // meidai IB (141117_run01,run02)
@@ -241,7 +175,12 @@ typedef struct nd_map *NDMapPtr;
 
 typedef struct nd_map
 {
+  /*sparse cell store, open addressing on the linear cell index*/
+  long long *key;
   NDPtr *nd;
+  int capacity;
+  int cell_num;
+
   int layer;
   int x;
   int y;
@@ -270,8 +209,11 @@ int update_covariance(NDPtr nd);
 int add_point_map(NDMapPtr ndmap, PointPtr point);
 int get_ND(NDMapPtr ndmap, PointPtr point, NDPtr *nd, int mode);
 
+int next_ND_cell(NDMapPtr ndmap, int *iter, NDPtr *nd, int *x, int *y, int *z);
+
 NDMapPtr initialize_NDmap(void);
 NDMapPtr initialize_NDmap_layer(int layer, NDMapPtr parent);
+void free_NDmap(NDMapPtr ndmap);
 int round_covariance(NDPtr nd);
 int print_ellipse(FILE *output_file, double mat[3][3], double cx, double cy);
 int print_ellipse_nd(FILE *output_file, NDPtr nd);
@@ -83,11 +83,119 @@ int update_covariance(NDPtr nd)
   return 1;
 }
 
+/*ND cells are allocated in chunks so that pointers stay valid while the pool grows*/
+#define ND_CHUNK_SIZE (1 << 16)
+#define ND_EMPTY_KEY (-1LL)
+
+static NDPtr *nd_chunks = 0;
+static int nd_chunk_num = 0;
+
+static unsigned long long hash_cell_key(long long key)
+{
+  unsigned long long h = (unsigned long long)key;
+
+  h ^= h >> 33;
+  h *= 0xff51afd7ed558ccdULL;
+  h ^= h >> 33;
+  h *= 0xc4ceb9fe1a85ec53ULL;
+  h ^= h >> 33;
+
+  return h;
+}
+
+/*find nd cell by linear cell index, 0 if it does not exist*/
+static NDPtr find_cell(NDMapPtr ndmap, long long key)
+{
+  unsigned long long mask = ndmap->capacity - 1;
+  unsigned long long i = hash_cell_key(key) & mask;
+
+  while (ndmap->key[i] != ND_EMPTY_KEY)
+  {
+    if (ndmap->key[i] == key)
+      return ndmap->nd[i];
+    i = (i + 1) & mask;
+  }
+
+  return 0;
+}
+
+static void insert_cell(NDMapPtr ndmap, long long key, NDPtr nd);
+
+/*double the table when it is half full*/
+static int grow_cells(NDMapPtr ndmap)
+{
+  long long *old_key = ndmap->key;
+  NDPtr *old_nd = ndmap->nd;
+  int old_capacity = ndmap->capacity;
+  int capacity = old_capacity * 2;
+  int i;
+
+  ndmap->key = (long long *)malloc(capacity * sizeof(long long));
+  ndmap->nd = (NDPtr *)malloc(capacity * sizeof(NDPtr));
+  if (!ndmap->key || !ndmap->nd)
+  {
+    free(ndmap->key);
+    free(ndmap->nd);
+    ndmap->key = old_key;
+    ndmap->nd = old_nd;
+    printf("over flow\n");
+    return 0;
+  }
+
+  for (i = 0; i < capacity; i++)
+    ndmap->key[i] = ND_EMPTY_KEY;
+  ndmap->capacity = capacity;
+  ndmap->cell_num = 0;
+
+  for (i = 0; i < old_capacity; i++)
+  {
+    if (old_key[i] != ND_EMPTY_KEY)
+      insert_cell(ndmap, old_key[i], old_nd[i]);
+  }
+
+  free(old_key);
+  free(old_nd);
+
+  return 1;
+}
+
+static void insert_cell(NDMapPtr ndmap, long long key, NDPtr nd)
+{
+  unsigned long long mask = ndmap->capacity - 1;
+  unsigned long long i = hash_cell_key(key) & mask;
+
+  while (ndmap->key[i] != ND_EMPTY_KEY)
+    i = (i + 1) & mask;
+
+  ndmap->key[i] = key;
+  ndmap->nd[i] = nd;
+  ndmap->cell_num++;
+}
+
+/*linear cell index of (x,y,z), the same layout as the former dense array*/
+static long long cell_key(NDMapPtr ndmap, int x, int y, int z)
+{
+  return (long long)x * ndmap->to_x + (long long)y * ndmap->to_y + z;
+}
+
+static void neighbor_keys(NDMapPtr ndmap, int x, int y, int z, long long key[8])
+{
+  key[0] = cell_key(ndmap, x, y, z);
+  key[1] = cell_key(ndmap, x - 1, y, z);
+  key[2] = cell_key(ndmap, x, y - 1, z);
+  key[3] = cell_key(ndmap, x - 1, y - 1, z);
+  key[4] = cell_key(ndmap, x, y, z - 1);
+  key[5] = cell_key(ndmap, x - 1, y, z - 1);
+  key[6] = cell_key(ndmap, x, y - 1, z - 1);
+  key[7] = cell_key(ndmap, x - 1, y - 1, z - 1);
+}
+
 /*add point to ndmap*/
 int add_point_map(NDMapPtr ndmap, PointPtr point)
 {
   double x, y, z;
-  NDPtr *ndp[8];
+  long long key[8];
+  NDPtr nd;
 
   /*mapping*/
   x = (point->x / ndmap->size) + ndmap->x / 2;
@@ -103,22 +211,22 @@ int add_point_map(NDMapPtr ndmap, PointPtr point)
     return 0;
 
   /*select root ND*/
-  ndp[0] = ndmap->nd + (int)x * ndmap->to_x + (int)y * ndmap->to_y + (int)z;
-  ndp[1] = ndp[0] - ndmap->to_x;
-  ndp[2] = ndp[0] - ndmap->to_y;
-  ndp[4] = ndp[0] - 1;
-  ndp[3] = ndp[2] - ndmap->to_x;
-  ndp[5] = ndp[4] - ndmap->to_x;
-  ndp[6] = ndp[4] - ndmap->to_y;
-  ndp[7] = ndp[3] - 1;
+  neighbor_keys(ndmap, (int)x, (int)y, (int)z, key);
 
   /*add  point to map */
   for (int i = 0; i < 8; i++)
   {
-    if ((*ndp[i]) == 0)
-      *ndp[i] = add_ND();
-    if ((*ndp[i]) != 0)
-      add_point_covariance(*ndp[i], point);
+    nd = find_cell(ndmap, key[i]);
+    if (nd == 0)
+    {
+      if (ndmap->cell_num * 2 >= ndmap->capacity && !grow_cells(ndmap))
+        continue;
+      nd = add_ND();
+      if (nd == 0)
+        continue;
+      insert_cell(ndmap, key[i], nd);
+    }
+    add_point_covariance(nd, point);
   }
 
   if (ndmap->next)
@@ -134,7 +242,8 @@ int get_ND(NDMapPtr ndmap, PointPtr point, NDPtr *nd, int ndmode)
 {
   double x, y, z;
   int i;
-  NDPtr *ndp[8];
+  long long key[8];
+  NDPtr ndp;
 
   /*mapping*/
   if (ndmode < 3)
@@ -159,22 +268,16 @@ int get_ND(NDMapPtr ndmap, PointPtr point, NDPtr *nd, int ndmode)
     return 0;
 
   /*select root ND*/
-  ndp[0] = ndmap->nd + (int)x * ndmap->to_x + (int)y * ndmap->to_y + (int)z;
-  ndp[1] = ndp[0] - ndmap->to_x;
-  ndp[2] = ndp[0] - ndmap->to_y;
-  ndp[4] = ndp[0] - 1;
-  ndp[3] = ndp[2] - ndmap->to_x;
-  ndp[5] = ndp[4] - ndmap->to_x;
-  ndp[6] = ndp[4] - ndmap->to_y;
-  ndp[7] = ndp[3] - 1;
+  neighbor_keys(ndmap, (int)x, (int)y, (int)z, key);
 
   for (i = 0; i < 8; i++)
   {
-    if (*ndp[i] != 0)
+    ndp = find_cell(ndmap, key[i]);
+    if (ndp != 0)
     {
-      if (!(*ndp[i])->flag)
-        update_covariance(*ndp[i]);
-      nd[i] = *ndp[i];
+      if (!ndp->flag)
+        update_covariance(ndp);
+      nd[i] = ndp;
     }
     else
     {
@@ -186,18 +289,56 @@ int get_ND(NDMapPtr ndmap, PointPtr point, NDPtr *nd, int ndmode)
   return 1;
 }
 
+/*iterate over the allocated cells of a layer, returns 0 after the last cell*/
+int next_ND_cell(NDMapPtr ndmap, int *iter, NDPtr *nd, int *x, int *y, int *z)
+{
+  long long key;
+
+  while (*iter < ndmap->capacity)
+  {
+    key = ndmap->key[*iter];
+    (*iter)++;
+
+    if (key == ND_EMPTY_KEY)
+      continue;
+
+    *nd = ndmap->nd[*iter - 1];
+    *x = (int)(key / ndmap->to_x);
+    *y = (int)((key % ndmap->to_x) / ndmap->to_y);
+    *z = (int)(key % ndmap->to_y);
+    return 1;
+  }
+
+  return 0;
+}
+
 NDPtr add_ND(void)
 {
   NDPtr ndp;
-  // int m;
+  NDPtr *chunks;
+  int chunk;
 
-  if (NDs_num >= MAX_ND_NUM)
+  chunk = NDs_num / ND_CHUNK_SIZE;
+  if (chunk >= nd_chunk_num)
   {
-    printf("over flow\n");
-    return 0;
+    chunks = (NDPtr *)realloc(nd_chunks, (chunk + 1) * sizeof(NDPtr));
+    if (chunks == 0)
+    {
+      printf("over flow\n");
+      return 0;
+    }
+    nd_chunks = chunks;
+
+    nd_chunks[chunk] = (NDPtr)malloc(sizeof(NormalDistribution) * ND_CHUNK_SIZE);
+    if (nd_chunks[chunk] == 0)
+    {
+      printf("over flow\n");
+      return 0;
+    }
+    nd_chunk_num = chunk + 1;
   }
 
-  ndp = NDs + NDs_num;
+  ndp = nd_chunks[chunk] + NDs_num % ND_CHUNK_SIZE;
   NDs_num++;
 
   ndp->flag = 0;
@@ -220,17 +361,14 @@ NDPtr add_ND(void)
 
 NDMapPtr initialize_NDmap_layer(int layer, NDMapPtr child)
 {
-  // int i,j,k,i2,i3,m;
-  int i, j, k;
+  int i;
   int x, y, z;
-  NDPtr *nd, *ndp;
   NDMapPtr ndmap;
 
   x = (g_map_x >> layer) + 1;
   y = (g_map_y >> layer) + 1;
   z = (g_map_z >> layer) + 1;
 
-  nd = (NDPtr *)malloc(x * y * z * sizeof(NDPtr));
   ndmap = (NDMapPtr)malloc(sizeof(NDMap));
 
   ndmap->x = x;
@@ -239,22 +377,18 @@ NDMapPtr initialize_NDmap_layer(int layer, NDMapPtr child)
   ndmap->to_x = y * z;
   ndmap->to_y = z;
   ndmap->layer = layer;
-  ndmap->nd = nd;
   ndmap->next = child;
   ndmap->size = g_map_cellsize * ((int)1 << layer);
 
-  ndp = nd;
+  /*cells are stored sparsely, memory grows with the occupied cells only*/
+  ndmap->capacity = ND_INITIAL_CELLS;
+  ndmap->cell_num = 0;
+  ndmap->key = (long long *)malloc(ndmap->capacity * sizeof(long long));
+  ndmap->nd = (NDPtr *)malloc(ndmap->capacity * sizeof(NDPtr));
 
-  for (i = 0; i < x; i++)
+  for (i = 0; i < ndmap->capacity; i++)
   {
-    for (j = 0; j < y; j++)
-    {
-      for (k = 0; k < z; k++)
-      {
-        *ndp = 0;
-        ndp++;
-      }
-    }
+    ndmap->key[i] = ND_EMPTY_KEY;
   }
 
   return ndmap;
@@ -266,11 +400,10 @@ NDMapPtr initialize_NDmap(void)
   NDMapPtr ndmap;
   NDPtr null_nd;
 
-  printf("Initialize NDmap\n");
+  printf("Initialize NDmap (%d x %d x %d cells of %.2f m)\n", g_map_x, g_map_y, g_map_z, g_map_cellsize);
   ndmap = 0;
 
   // init NDs
-  NDs = (NDPtr)malloc(sizeof(NormalDistribution) * MAX_ND_NUM);
   NDs_num = 0;
 
   null_nd = add_ND();
@@ -278,6 +411,7 @@ NDMapPtr initialize_NDmap(void)
   {
     return 0;
   }
+  NDs = null_nd;
 
   for (i = LAYER_NUM - 1; i >= 0; i--)
   {
@@ -287,6 +421,32 @@ NDMapPtr initialize_NDmap(void)
   return ndmap;
 }
 
+void free_NDmap(NDMapPtr ndmap)
+{
+  NDMapPtr next;
+  int i;
+
+  while (ndmap)
+  {
+    next = ndmap->next;
+    free(ndmap->key);
+    free(ndmap->nd);
+    free(ndmap);
+    ndmap = next;
+  }
+
+  for (i = 0; i < nd_chunk_num; i++)
+  {
+    free(nd_chunks[i]);
+  }
+  free(nd_chunks);
+  nd_chunks = 0;
+  nd_chunk_num = 0;
+
+  NDs = 0;
+  NDs_num = 0;
+}
+
 int round_covariance(NDPtr nd)
 {
   double v[3][3], a;
@@ -39,6 +39,10 @@
 #include <fstream>
 #include <string>
 #include <chrono>
+#include <cmath>
+#include <deque>
+#include <map>
+#include <vector>
 
 #include <ros/ros.h>
 #include <std_msgs/Float32.h>
@@ -60,9 +64,19 @@
 #include <pcl/io/pcd_io.h>
 #include <pcl/point_types.h>
 #include <pcl_conversions/pcl_conversions.h>
-#include <pcl/registration/ndt.h>
-#include <pcl/registration/icp.h>
+#ifdef USE_FAST_PCL
+  #include <fast_pcl/registration/ndt.h>
+  #include <fast_pcl/registration/icp.h>
+  #include <fast_pcl/registration/transformation_estimation_point_to_plane_lls.h>
+#else
+  #include <pcl/registration/ndt.h>
+  #include <pcl/registration/icp.h>
+  #include <pcl/registration/transformation_estimation_point_to_plane_lls.h>
+#endif
 #include <pcl/filters/voxel_grid.h>
+#include <pcl/features/normal_3d_omp.h>
+#include <pcl/search/kdtree.h>
+#include <pcl/common/io.h>
 
 #include "autoware_msgs/ConfigICP.h"
 
@@ -97,7 +111,31 @@ static int _use_gnss = 1;
 static int init_pos_set = 0;
 
 static pcl::NormalDistributionsTransform<pcl::PointXYZ, pcl::PointXYZ> ndt;
-static pcl::IterativeClosestPoint<pcl::PointXYZ, pcl::PointXYZ> icp;
+// Source and target share the point type so that the correspondence search and
+// getFitnessScore() can query the target kd-tree directly.
+static pcl::IterativeClosestPoint<pcl::PointNormal, pcl::PointNormal> icp;
+
+// The map is split into square tiles of _tile_size [m]. ICP is run against a
+// window of (2 * _crop_tiles + 1)^2 tiles around the predicted pose, whose
+// kd-tree is built once and kept in a small LRU cache.
+struct TargetWindow
+{
+  int ix;
+  int iy;
+  pcl::PointCloud<pcl::PointNormal>::Ptr cloud;
+  pcl::search::KdTree<pcl::PointNormal>::Ptr tree;
+};
+
+#define WINDOW_CACHE_SIZE 4
+
+static double _tile_size = 40.0;
+static int _crop_tiles = 2;
+static int _use_point_to_plane = 0;
+static int _normal_k = 10;
+
+static pcl::PointCloud<pcl::PointNormal>::Ptr map_normal_ptr(new pcl::PointCloud<pcl::PointNormal>);
+static std::map<std::pair<int, int>, std::vector<int> > map_tiles;
+static std::deque<TargetWindow> window_cache;  // front is the window currently set to icp
 
 // Default values for ICP
 static int maximum_iterations = 100;
@@ -228,6 +266,76 @@ static void param_callback(const autoware_msgs::ConfigICP::ConstPtr& input)
 
 }
 
+static std::pair<int, int> tile_index(double x, double y)
+{
+  if (_tile_size <= 0.0)
+    return std::make_pair(0, 0);
+  return std::make_pair(static_cast<int>(std::floor(x / _tile_size)), static_cast<int>(std::floor(y / _tile_size)));
+}
+
+// Makes the window centered on tile (ix, iy) the icp target, building its cloud and kd-tree only on a cache miss.
+// Returns false if icp has no target at all, i.e. the window is empty and no previous window was set.
+static bool set_target_window(int ix, int iy)
+{
+  for (std::deque<TargetWindow>::iterator it = window_cache.begin(); it != window_cache.end(); ++it)
+  {
+    if (it->ix == ix && it->iy == iy)
+    {
+      if (it != window_cache.begin())
+      {
+        TargetWindow w = *it;
+        window_cache.erase(it);
+        window_cache.push_front(w);
+        icp.setInputTarget(w.cloud);
+        icp.setSearchMethodTarget(w.tree, true);
+      }
+      return true;
+    }
+  }
+
+  TargetWindow w;
+  w.ix = ix;
+  w.iy = iy;
+  w.cloud.reset(new pcl::PointCloud<pcl::PointNormal>);
+  int range = (_tile_size <= 0.0) ? 0 : _crop_tiles;
+  for (int x = ix - range; x <= ix + range; x++)
+  {
+    for (int y = iy - range; y <= iy + range; y++)
+    {
+      std::map<std::pair<int, int>, std::vector<int> >::const_iterator tile = map_tiles.find(std::make_pair(x, y));
+      if (tile == map_tiles.end())
+        continue;
+      for (std::vector<int>::const_iterator i = tile->second.begin(); i != tile->second.end(); ++i)
+        w.cloud->push_back(map_normal_ptr->points[*i]);
+    }
+  }
+
+  // Keep the previous target if the vehicle is predicted to be off the map.
+  if (w.cloud->empty())
+  {
+    ROS_WARN_THROTTLE(1.0, "No map points around tile (%d, %d).", ix, iy);
+    return !window_cache.empty();
+  }
+
+  std::chrono::time_point<std::chrono::system_clock> build_start = std::chrono::system_clock::now();
+  w.tree.reset(new pcl::search::KdTree<pcl::PointNormal>);
+  w.tree->setInputCloud(w.cloud);
+  std::chrono::time_point<std::chrono::system_clock> build_end = std::chrono::system_clock::now();
+
+  window_cache.push_front(w);
+  if (window_cache.size() > WINDOW_CACHE_SIZE)
+    window_cache.pop_back();
+
+  // The tree is already built for this cloud, so icp must not rebuild it in initCompute().
+  icp.setInputTarget(w.cloud);
+  icp.setSearchMethodTarget(w.tree, true);
+
+  std::cout << "Target window (" << ix << ", " << iy << "): " << w.cloud->size() << " points, kd-tree built in "
+            << std::chrono::duration_cast<std::chrono::microseconds>(build_end - build_start).count() / 1000.0
+            << " ms." << std::endl;
+  return true;
+}
+
 static void map_callback(const sensor_msgs::PointCloud2::ConstPtr& input)
 {
   if (map_loaded == 0)
@@ -236,9 +344,50 @@ static void map_callback(const sensor_msgs::PointCloud2::ConstPtr& input)
     pcl::fromROSMsg(*input, map);
 
     pcl::PointCloud<pcl::PointXYZ>::Ptr map_ptr(new pcl::PointCloud<pcl::PointXYZ>(map));
+
+    if (_use_point_to_plane == 1)
+    {
+      // Map normals are computed once here; point-to-plane ICP only uses the target normals.
+      pcl::PointCloud<pcl::Normal> normals;
+      pcl::NormalEstimationOMP<pcl::PointXYZ, pcl::Normal> ne;
+      pcl::search::KdTree<pcl::PointXYZ>::Ptr ne_tree(new pcl::search::KdTree<pcl::PointXYZ>);
+      ne.setInputCloud(map_ptr);
+      ne.setSearchMethod(ne_tree);
+      ne.setKSearch(_normal_k);
+      ne.compute(normals);
+
+      pcl::PointCloud<pcl::PointNormal> map_normal;
+      pcl::concatenateFields(map, normals, map_normal);
+
+      // Drop points whose normal could not be estimated; they would make the linear system NaN.
+      map_normal_ptr->clear();
+      for (size_t i = 0; i < map_normal.size(); i++)
+      {
+        const pcl::PointNormal& pn = map_normal.points[i];
+        if (std::isfinite(pn.normal_x) && std::isfinite(pn.normal_y) && std::isfinite(pn.normal_z))
+          map_normal_ptr->push_back(pn);
+      }
+      std::cout << "Map normals computed (" << map_normal_ptr->size() << " / " << map.size() << " points)." << std::endl;
+    }
+    else
+    {
+      pcl::copyPointCloud(map, *map_normal_ptr);
+    }
+
+    map_tiles.clear();
+    window_cache.clear();
+    for (size_t i = 0; i < map_normal_ptr->size(); i++)
+    {
+      const pcl::PointNormal& pn = map_normal_ptr->points[i];
+      map_tiles[tile_index(pn.x, pn.y)].push_back(static_cast<int>(i));
+    }
+    std::cout << "Map split into " << map_tiles.size() << " tiles." << std::endl;
+
     // Setting point cloud to be aligned to.
 //    ndt.setInputTarget(map_ptr);
-    icp.setInputTarget(map_ptr);
+    std::pair<int, int> initial_tile = tile_index(initial_pose.x, initial_pose.y);
+    if (!set_target_window(initial_tile.first, initial_tile.second))
+      ROS_WARN("No map points around the initial tile, waiting for a pose on the map.");
     std::cout << "setInputTarget finished." << std::endl;
 
     // Setting NDT parameters to default values
@@ -346,7 +495,8 @@ static void points_callback(const sensor_msgs::PointCloud2::ConstPtr& input)
     current_scan_time = input->header.stamp;
 
     pcl::fromROSMsg(*input, filtered_scan);
-    pcl::PointCloud<pcl::PointXYZ>::Ptr filtered_scan_ptr(new pcl::PointCloud<pcl::PointXYZ>(filtered_scan));
+    pcl::PointCloud<pcl::PointNormal>::Ptr filtered_scan_ptr(new pcl::PointCloud<pcl::PointNormal>);
+    pcl::copyPointCloud(filtered_scan, *filtered_scan_ptr);
     int scan_points_num = filtered_scan_ptr->size();
 
     Eigen::Matrix4f t(Eigen::Matrix4f::Identity());   // base_link
@@ -373,9 +523,17 @@ static void points_callback(const sensor_msgs::PointCloud2::ConstPtr& input)
     Eigen::AngleAxisf init_rotation_z(predict_pose.yaw, Eigen::Vector3f::UnitZ());
     Eigen::Matrix4f init_guess = (init_translation * init_rotation_z * init_rotation_y * init_rotation_x) * tf_btol;
 
-    pcl::PointCloud<pcl::PointXYZ>::Ptr output_cloud(new pcl::PointCloud<pcl::PointXYZ>);
+    pcl::PointCloud<pcl::PointNormal>::Ptr output_cloud(new pcl::PointCloud<pcl::PointNormal>);
 //    ndt.align(*output_cloud, init_guess);
 
+    // Switch the target window when the predicted localizer position enters another tile.
+    std::pair<int, int> tile = tile_index(init_guess(0, 3), init_guess(1, 3));
+    if (!set_target_window(tile.first, tile.second))
+    {
+      ROS_WARN_THROTTLE(1.0, "ICP has no target window, skipping the scan.");
+      return;
+    }
+
     icp.setMaximumIterations(maximum_iterations);
     icp.setTransformationEpsilon(transformation_epsilon);
     icp.setMaxCorrespondenceDistance(max_correspondence_distance);
@@ -675,6 +833,10 @@ int main(int argc, char** argv)
   private_nh.getParam("use_gnss", _use_gnss);
   private_nh.getParam("queue_size", _queue_size);
   private_nh.getParam("offset", _offset);
+  private_nh.getParam("tile_size", _tile_size);
+  private_nh.getParam("crop_tiles", _crop_tiles);
+  private_nh.getParam("use_point_to_plane", _use_point_to_plane);
+  private_nh.getParam("normal_k", _normal_k);
 
   if (nh.getParam("localizer", _localizer) == false)
   {
@@ -718,6 +880,10 @@ int main(int argc, char** argv)
   std::cout << "use_gnss: " << _use_gnss << std::endl;
   std::cout << "queue_size: " << _queue_size << std::endl;
   std::cout << "offset: " << _offset << std::endl;
+  std::cout << "tile_size: " << _tile_size << std::endl;
+  std::cout << "crop_tiles: " << _crop_tiles << std::endl;
+  std::cout << "use_point_to_plane: " << _use_point_to_plane << std::endl;
+  std::cout << "normal_k: " << _normal_k << std::endl;
   std::cout << "localizer: " << _localizer << std::endl;
   std::cout << "(tf_x,tf_y,tf_z,tf_roll,tf_pitch,tf_yaw): (" << _tf_x << ", " << _tf_y << ", " << _tf_z << ", "
             << _tf_roll << ", " << _tf_pitch << ", " << _tf_yaw << ")" << std::endl;
@@ -735,6 +901,13 @@ int main(int argc, char** argv)
   Eigen::AngleAxisf rot_z_ltob((-1.0) * _tf_yaw, Eigen::Vector3f::UnitZ());
   tf_ltob = (tl_ltob * rot_z_ltob * rot_y_ltob * rot_x_ltob).matrix();
 
+  if (_use_point_to_plane == 1)
+  {
+    boost::shared_ptr<pcl::registration::TransformationEstimationPointToPlaneLLS<pcl::PointNormal, pcl::PointNormal> >
+        point_to_plane(new pcl::registration::TransformationEstimationPointToPlaneLLS<pcl::PointNormal, pcl::PointNormal>);
+    icp.setTransformationEstimation(point_to_plane);
+  }
+
   // Updated in initialpose_callback or gnss_callback
   initial_pose.x = 0.0;
   initial_pose.y = 0.0;
@@ -76,6 +76,8 @@
 #include <autoware_msgs/ConfigNdtMapping.h>
 #include <autoware_msgs/ConfigNdtMappingOutput.h>
 
+#include <points_downsampler/hash_voxel_grid.h>
+
 #include <time.h>
 
 
@@ -133,6 +135,8 @@ static double trans_eps = 0.01;  // Transformation epsilon
 
 // Leaf size of VoxelGrid filter.
 static double voxel_leaf_size = 2.0;
+// Downsamples each scan, same kernel as voxel_grid_filter
+static points_downsampler::HashVoxelGrid scan_voxel_grid;
 
 static ros::Time callback_start, callback_end, t1_start, t1_end, t2_start, t2_end, t3_start, t3_end, t4_start, t4_end,
     t5_start, t5_end;
@@ -507,10 +511,8 @@ static void points_callback(const sensor_msgs::PointCloud2::ConstPtr& input)
   }
 
   // Apply voxelgrid filter
-  pcl::VoxelGrid<pcl::PointXYZI> voxel_grid_filter;
-  voxel_grid_filter.setLeafSize(voxel_leaf_size, voxel_leaf_size, voxel_leaf_size);
-  voxel_grid_filter.setInputCloud(scan_ptr);
-  voxel_grid_filter.filter(*filtered_scan_ptr);
+  scan_voxel_grid.setLeafSize(voxel_leaf_size);
+  scan_voxel_grid.filter(*scan_ptr, *filtered_scan_ptr);
 
   pcl::PointCloud<pcl::PointXYZI>::Ptr map_ptr(new pcl::PointCloud<pcl::PointXYZI>(map));
 
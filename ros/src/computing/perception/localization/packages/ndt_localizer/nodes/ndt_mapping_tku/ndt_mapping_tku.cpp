@@ -4,7 +4,7 @@
   2005/4/24 tku
 */
 
-// number of cells
+// default number of cells
 #define G_MAP_X 2000
 #define G_MAP_Y 2000
 #define G_MAP_Z 200
@@ -408,10 +408,10 @@ void points_callback(const sensor_msgs::PointCloud2::ConstPtr &msg)
 
 void save_nd_map(char *name)
 {
-  int i, j, k, layer;
+  int i, j, k, layer, iter;
   NDData nddat;
   NDMapPtr ndmap;
-  NDPtr *ndp;
+  NDPtr ndp;
   FILE *ofp;
 
   pcl::PointCloud<pcl::PointXYZ> cloud;
@@ -422,33 +422,23 @@ void save_nd_map(char *name)
 
   for (layer = 0; layer < 2; layer++)
   {
-    ndp = ndmap->nd;
-    for (i = 0; i < ndmap->x; i++)
+    iter = 0;
+    while (next_ND_cell(ndmap, &iter, &ndp, &i, &j, &k))
     {
-      for (j = 0; j < ndmap->y; j++)
-      {
-        for (k = 0; k < ndmap->z; k++)
-        {
-          if (*ndp)
-          {
-            update_covariance(*ndp);
-            nddat.nd = **ndp;
-            nddat.x = i;
-            nddat.y = j;
-            nddat.z = k;
-            nddat.layer = layer;
-
-            fwrite(&nddat, sizeof(NDData), 1, ofp);
-
-            // regist the point to pcd data;
-            p.x = (*ndp)->mean.x;
-            p.y = (*ndp)->mean.y;
-            p.z = (*ndp)->mean.z;
-            cloud.points.push_back(p);
-          }
-          ndp++;
-        }
-      }
+      update_covariance(ndp);
+      nddat.nd = *ndp;
+      nddat.x = i;
+      nddat.y = j;
+      nddat.z = k;
+      nddat.layer = layer;
+
+      fwrite(&nddat, sizeof(NDData), 1, ofp);
+
+      // regist the point to pcd data;
+      p.x = ndp->mean.x;
+      p.y = ndp->mean.y;
+      p.z = ndp->mean.z;
+      cloud.points.push_back(p);
     }
     ndmap = ndmap->next;
   }
@@ -530,10 +520,10 @@ int main(int argc, char *argv[])
   sprintf(g_ndmap_name, "%s", "ndmap");
 
   // map size
-  g_map_x = G_MAP_X;
-  g_map_y = G_MAP_Y;
-  g_map_z = G_MAP_Z;
-  g_map_cellsize = G_MAP_CELLSIZE;
+  private_nh.param<int>("map_x", g_map_x, G_MAP_X);
+  private_nh.param<int>("map_y", g_map_y, G_MAP_Y);
+  private_nh.param<int>("map_z", g_map_z, G_MAP_Z);
+  private_nh.param<double>("map_cellsize", g_map_cellsize, G_MAP_CELLSIZE);
   // map center
   g_map_center_x = g_ini_x;
   g_map_center_y = g_ini_y;
@@ -34,6 +34,7 @@
  Yuki KITSUKAWA
  */
 
+#include <algorithm>
 #include <chrono>
 #include <fstream>
 #include <iostream>
@@ -43,6 +44,7 @@
 #include <pthread.h>
 
 #include <ros/ros.h>
+#include <diagnostic_msgs/DiagnosticArray.h>
 #include <sensor_msgs/Imu.h>
 #include <sensor_msgs/PointCloud2.h>
 #include <nav_msgs/Odometry.h>
@@ -173,6 +175,7 @@ static bool has_converged;
 static int iteration = 0;
 static double fitness_score = 0.0;
 static double trans_probability = 0.0;
+static double inlier_ratio = 1.0;
 
 static double diff = 0.0;
 static double diff_x = 0.0, diff_y = 0.0, diff_z = 0.0, diff_yaw;
@@ -222,10 +225,19 @@ static std::string _offset = "linear";  // linear, zero, quadratic
 static ros::Publisher ndt_reliability_pub;
 static std_msgs::Float32 ndt_reliability;
 
+static ros::Publisher ndt_inlier_ratio_pub;
+static std_msgs::Float32 ndt_inlier_ratio;
+
+// Fitness score of cpu_ndt is evaluated on the voxel grid and stops once this relative
+// confidence is reached (0 evaluates every point). Range 0 counts every point as an inlier.
+static double _fitness_confidence = 0.0;
+static double _fitness_max_range = 0.0;
+
 static bool _use_gpu = false;
 static bool _use_openmp = false;
 
 static bool _use_fast_pcl = false;
+static int _pyramid_levels = 1;  // Coarse-to-fine levels of cpu_ndt
 
 static bool _get_height = false;
 static bool _use_local_transform = false;
@@ -238,6 +250,47 @@ static std::string _imu_topic = "/imu_raw";
 static std::ofstream ofs;
 static std::string filename;
 
+// Per-stage latency profiling, enabled by the use_profiling param.
+// Histograms are accumulated over _profiling_window scans and then reset.
+enum ProfileStage
+{
+  STAGE_INPUT_LATENCY,  // header stamp to callback, includes the upstream voxel filter
+  STAGE_CONVERSION,
+  STAGE_PREDICTION,
+  STAGE_ALIGN,
+  STAGE_TRANSFORM,  // the four stages below are spent inside align (cpu_ndt only)
+  STAGE_DERIVATIVES,
+  STAGE_LINE_SEARCH,
+  STAGE_HESSIAN,
+  STAGE_FITNESS_SCORE,
+  STAGE_PUBLISH,
+  STAGE_TOTAL,
+  STAGE_NUM
+};
+
+static const char* stage_names[STAGE_NUM] = { "input_latency", "conversion", "prediction", "align",
+                                              "transform",     "derivatives", "line_search", "hessian",
+                                              "fitness_score", "publish",    "total" };
+
+#define PROFILE_BIN_NUM 8
+static const double profile_bin_edges[PROFILE_BIN_NUM - 1] = { 1.0, 2.0, 5.0, 10.0, 20.0, 50.0, 100.0 };  // [ms]
+
+struct StageStat
+{
+  int count;
+  double sum;
+  double max;
+  int bins[PROFILE_BIN_NUM];
+};
+
+static bool _use_profiling = false;
+static int _profiling_window = 100;
+static ros::Publisher profile_pub;
+static std::ofstream profile_ofs;
+static std::string profile_filename;
+static double stage_time[STAGE_NUM];
+static StageStat stage_stat[STAGE_NUM];
+
 static sensor_msgs::Imu imu;
 static nav_msgs::Odometry odom;
 
@@ -489,6 +542,8 @@ static void map_callback(const sensor_msgs::PointCloud2::ConstPtr& input)
     {
       cpu::NormalDistributionsTransform<pcl::PointXYZ, pcl::PointXYZ> new_cpu_ndt;
       new_cpu_ndt.setResolution(ndt_res);
+      new_cpu_ndt.setPyramidLevels(_pyramid_levels);
+      new_cpu_ndt.setProfiling(_use_profiling);
       new_cpu_ndt.setInputTarget(map_ptr);
       new_cpu_ndt.setMaximumIterations(max_iter);
       new_cpu_ndt.setStepSize(step_size);
@@ -879,12 +934,110 @@ static void imu_callback(const sensor_msgs::Imu::Ptr& input)
   previous_imu_yaw = imu_yaw;
 }
 
+static void reset_stage_stats()
+{
+  for (int i = 0; i < STAGE_NUM; i++)
+  {
+    stage_stat[i].count = 0;
+    stage_stat[i].sum = 0.0;
+    stage_stat[i].max = 0.0;
+    std::fill(stage_stat[i].bins, stage_stat[i].bins + PROFILE_BIN_NUM, 0);
+  }
+}
+
+static void publish_profile(const std_msgs::Header& header, int points_num, int iterations,
+                            int line_search_iterations, int coarse_iterations)
+{
+  diagnostic_msgs::DiagnosticStatus status;
+  status.level = diagnostic_msgs::DiagnosticStatus::OK;
+  status.name = "ndt_matching: stage latency";
+  status.hardware_id = _localizer;
+
+  diagnostic_msgs::KeyValue kv;
+  for (int i = 0; i < STAGE_NUM; i++)
+  {
+    StageStat& stat = stage_stat[i];
+    int bin = std::upper_bound(profile_bin_edges, profile_bin_edges + PROFILE_BIN_NUM - 1, stage_time[i]) -
+              profile_bin_edges;
+    stat.bins[bin]++;
+    stat.count++;
+    stat.sum += stage_time[i];
+    stat.max = std::max(stat.max, stage_time[i]);
+
+    std::ostringstream last, mean, max, histogram;
+    last << stage_time[i];
+    mean << stat.sum / stat.count;
+    max << stat.max;
+    for (int j = 0; j < PROFILE_BIN_NUM; j++)
+    {
+      if (j < PROFILE_BIN_NUM - 1)
+        histogram << "<" << profile_bin_edges[j] << ":" << stat.bins[j] << " ";
+      else
+        histogram << ">=" << profile_bin_edges[j - 1] << ":" << stat.bins[j];
+    }
+
+    kv.key = std::string(stage_names[i]) + " [ms]";
+    kv.value = last.str();
+    status.values.push_back(kv);
+    kv.key = std::string(stage_names[i]) + " mean [ms]";
+    kv.value = mean.str();
+    status.values.push_back(kv);
+    kv.key = std::string(stage_names[i]) + " max [ms]";
+    kv.value = max.str();
+    status.values.push_back(kv);
+    kv.key = std::string(stage_names[i]) + " histogram [ms]";
+    kv.value = histogram.str();
+    status.values.push_back(kv);
+  }
+
+  std::ostringstream message;
+  message << stage_stat[STAGE_TOTAL].count << " scans in window";
+  status.message = message.str();
+
+  std::ostringstream value;
+  value << iterations;
+  kv.key = "iterations";
+  kv.value = value.str();
+  status.values.push_back(kv);
+  value.str("");
+  value << line_search_iterations;
+  kv.key = "line_search_iterations";
+  kv.value = value.str();
+  status.values.push_back(kv);
+  value.str("");
+  value << coarse_iterations;
+  kv.key = "coarse_iterations";
+  kv.value = value.str();
+  status.values.push_back(kv);
+
+  diagnostic_msgs::DiagnosticArray diagnostic_msg;
+  diagnostic_msg.header.stamp = header.stamp;
+  diagnostic_msg.status.push_back(status);
+  profile_pub.publish(diagnostic_msg);
+
+  profile_ofs << header.seq << "," << std::fixed << std::setprecision(9) << header.stamp.toSec() << ","
+              << std::setprecision(3) << points_num << "," << iterations << "," << line_search_iterations << ","
+              << coarse_iterations;
+  for (int i = 0; i < STAGE_NUM; i++)
+    profile_ofs << "," << stage_time[i];
+  profile_ofs << std::endl;
+
+  if (stage_stat[STAGE_TOTAL].count >= _profiling_window)
+    reset_stage_stats();
+}
+
 static void points_callback(const sensor_msgs::PointCloud2::ConstPtr& input)
 {
   if (map_loaded == 1 && init_pos_set == 1)
   {
     matching_start = std::chrono::system_clock::now();
 
+    if (_use_profiling)
+    {
+      std::fill(stage_time, stage_time + STAGE_NUM, 0.0);
+      stage_time[STAGE_INPUT_LATENCY] = (ros::Time::now() - input->header.stamp).toSec() * 1000.0;
+    }
+
     static tf::TransformBroadcaster br;
     tf::Transform transform;
     tf::Quaternion predict_q, ndt_q, current_q, localizer_q;
@@ -894,8 +1047,12 @@ static void points_callback(const sensor_msgs::PointCloud2::ConstPtr& input)
 
     current_scan_time = input->header.stamp;
 
-    pcl::fromROSMsg(*input, filtered_scan);
-    pcl::PointCloud<pcl::PointXYZ>::Ptr filtered_scan_ptr(new pcl::PointCloud<pcl::PointXYZ>(filtered_scan));
+    pcl::PointCloud<pcl::PointXYZ>::Ptr filtered_scan_ptr(new pcl::PointCloud<pcl::PointXYZ>());
+    {
+      cpu::ScopedTimer timer(_use_profiling, stage_time[STAGE_CONVERSION]);
+      pcl::fromROSMsg(*input, filtered_scan);
+      *filtered_scan_ptr = filtered_scan;
+    }
     int scan_points_num = filtered_scan_ptr->size();
 
     Eigen::Matrix4f t(Eigen::Matrix4f::Identity());   // base_link
@@ -904,6 +1061,7 @@ static void points_callback(const sensor_msgs::PointCloud2::ConstPtr& input)
     std::chrono::time_point<std::chrono::system_clock> align_start, align_end, getFitnessScore_start,
         getFitnessScore_end;
     static double align_time, getFitnessScore_time = 0.0;
+    int line_search_iterations = 0, coarse_iterations = 0;
 
     pthread_mutex_lock(&mutex);
 #ifdef CUDA_FOUND
@@ -934,12 +1092,15 @@ static void points_callback(const sensor_msgs::PointCloud2::ConstPtr& input)
     predict_pose.pitch = previous_pose.pitch;
     predict_pose.yaw = previous_pose.yaw + offset_yaw;
 
-    if (_use_imu == true && _use_odom == true)
-      imu_odom_calc(current_scan_time);
-    if (_use_imu == true && _use_odom == false)
-      imu_calc(current_scan_time);
-    if (_use_imu == false && _use_odom == true)
-      odom_calc(current_scan_time);
+    {
+      cpu::ScopedTimer timer(_use_profiling, stage_time[STAGE_PREDICTION]);
+      if (_use_imu == true && _use_odom == true)
+        imu_odom_calc(current_scan_time);
+      if (_use_imu == true && _use_odom == false)
+        imu_calc(current_scan_time);
+      if (_use_imu == false && _use_odom == true)
+        odom_calc(current_scan_time);
+    }
 
     pose predict_pose_for_ndt;
     if (_use_imu == true && _use_odom == true)
@@ -992,10 +1153,22 @@ static void points_callback(const sensor_msgs::PointCloud2::ConstPtr& input)
         iteration = cpu_ndt.getFinalNumIteration();
 
         getFitnessScore_start = std::chrono::system_clock::now();
-        fitness_score = cpu_ndt.getFitnessScore();
+        fitness_score = cpu_ndt.getFitnessScore(_fitness_max_range > 0.0 ? _fitness_max_range : DBL_MAX,
+                                                _fitness_confidence);
         getFitnessScore_end = std::chrono::system_clock::now();
 
+        inlier_ratio = cpu_ndt.getInlierRatio();
         trans_probability = cpu_ndt.getTransformationProbability();
+
+        if (_use_profiling)
+        {
+          stage_time[STAGE_TRANSFORM] = cpu_ndt.getTransformTime();
+          stage_time[STAGE_DERIVATIVES] = cpu_ndt.getDerivativesTime();
+          stage_time[STAGE_LINE_SEARCH] = cpu_ndt.getLineSearchTime();
+          stage_time[STAGE_HESSIAN] = cpu_ndt.getHessianTime();
+          line_search_iterations = cpu_ndt.getLineSearchIterations();
+          coarse_iterations = cpu_ndt.getCoarseIterations();
+        }
       }
       else
       {
@@ -1033,6 +1206,8 @@ static void points_callback(const sensor_msgs::PointCloud2::ConstPtr& input)
 
     pthread_mutex_unlock(&mutex);
 
+    std::chrono::time_point<std::chrono::system_clock> publish_start = std::chrono::system_clock::now();
+
     tf::Matrix3x3 mat_l;  // localizer
     mat_l.setValue(static_cast<double>(t(0, 0)), static_cast<double>(t(0, 1)), static_cast<double>(t(0, 2)),
                    static_cast<double>(t(1, 0)), static_cast<double>(t(1, 1)), static_cast<double>(t(1, 2)),
@@ -1305,6 +1480,14 @@ static void points_callback(const sensor_msgs::PointCloud2::ConstPtr& input)
 
     matching_end = std::chrono::system_clock::now();
     exe_time = std::chrono::duration_cast<std::chrono::microseconds>(matching_end - matching_start).count() / 1000.0;
+    if (_use_profiling)
+    {
+      stage_time[STAGE_ALIGN] = align_time;
+      stage_time[STAGE_FITNESS_SCORE] = getFitnessScore_time;
+      stage_time[STAGE_PUBLISH] =
+          std::chrono::duration_cast<std::chrono::microseconds>(matching_end - publish_start).count() / 1000.0;
+      stage_time[STAGE_TOTAL] = exe_time;
+    }
     time_ndt_matching.data = exe_time;
     time_ndt_matching_pub.publish(time_ndt_matching);
 
@@ -1340,6 +1523,15 @@ static void points_callback(const sensor_msgs::PointCloud2::ConstPtr& input)
                            Wc * ((2.0 - trans_probability) / 2.0) * 100.0;
     ndt_reliability_pub.publish(ndt_reliability);
 
+    if (_use_fast_pcl)
+    {
+      ndt_inlier_ratio.data = inlier_ratio;
+      ndt_inlier_ratio_pub.publish(ndt_inlier_ratio);
+    }
+
+    if (_use_profiling)
+      publish_profile(input->header, scan_points_num, iteration, line_search_iterations, coarse_iterations);
+
     // Write log
     if (!ofs)
     {
@@ -1359,7 +1551,7 @@ static void points_callback(const sensor_msgs::PointCloud2::ConstPtr& input)
         << predict_pose_error << "," << iteration << "," << fitness_score << "," << trans_probability << ","
         << ndt_reliability.data << "," << current_velocity << "," << current_velocity_smooth << "," << current_accel
         << "," << angular_velocity << "," << time_ndt_matching.data << "," << align_time << "," << getFitnessScore_time
-        << std::endl;
+        << "," << inlier_ratio << std::endl;
 
     std::cout << "-----------------------------------------------------------------" << std::endl;
     std::cout << "Sequence: " << input->header.seq << std::endl;
@@ -1370,6 +1562,8 @@ static void points_callback(const sensor_msgs::PointCloud2::ConstPtr& input)
     std::cout << "NDT has converged: " << has_converged << std::endl;
     std::cout << "Fitness Score: " << fitness_score << std::endl;
     std::cout << "Transformation Probability: " << trans_probability << std::endl;
+    if (_use_fast_pcl)
+      std::cout << "Inlier Ratio: " << inlier_ratio << " (" << cpu_ndt.getFitnessPoints() << " points evaluated)" << std::endl;
     std::cout << "Execution Time: " << exe_time << " ms." << std::endl;
     std::cout << "Number of Iterations: " << iteration << std::endl;
     std::cout << "NDT Reliability: " << ndt_reliability.data << std::endl;
@@ -1486,12 +1680,28 @@ int main(int argc, char** argv)
   private_nh.getParam("use_openmp", _use_openmp);
   private_nh.getParam("use_gpu", _use_gpu);
   private_nh.getParam("use_fast_pcl", _use_fast_pcl);
+  private_nh.getParam("pyramid_levels", _pyramid_levels);
   private_nh.getParam("get_height", _get_height);
   private_nh.getParam("use_local_transform", _use_local_transform);
   private_nh.getParam("use_imu", _use_imu);
   private_nh.getParam("use_odom", _use_odom);
   private_nh.getParam("imu_upside_down", _imu_upside_down);
   private_nh.getParam("imu_topic", _imu_topic);
+  private_nh.getParam("fitness_confidence", _fitness_confidence);
+  private_nh.getParam("fitness_max_range", _fitness_max_range);
+  private_nh.getParam("use_profiling", _use_profiling);
+  private_nh.getParam("profiling_window", _profiling_window);
+
+  if (_use_profiling)
+  {
+    profile_filename = "ndt_matching_profile_" + std::string(buffer) + ".csv";
+    profile_ofs.open(profile_filename.c_str(), std::ios::app);
+    profile_ofs << "seq,stamp,points,iterations,line_search_iterations,coarse_iterations";
+    for (int i = 0; i < STAGE_NUM; i++)
+      profile_ofs << "," << stage_names[i];
+    profile_ofs << std::endl;
+    reset_stage_stats();
+  }
 
 #if defined(CUDA_FOUND) && defined(USE_FAST_PCL)
   if (_use_gpu == true && _use_openmp == true)
@@ -1545,6 +1755,7 @@ int main(int argc, char** argv)
   std::cout << "use_gpu: " << _use_gpu << std::endl;
   std::cout << "use_openmp: " << _use_openmp << std::endl;
   std::cout << "use_fast_pcl: " << _use_fast_pcl << std::endl;
+  std::cout << "pyramid_levels: " << _pyramid_levels << std::endl;
   std::cout << "get_height: " << _get_height << std::endl;
   std::cout << "use_local_transform: " << _use_local_transform << std::endl;
   std::cout << "use_imu: " << _use_imu << std::endl;
@@ -1552,6 +1763,11 @@ int main(int argc, char** argv)
   std::cout << "imu_upside_down: " << _imu_upside_down << std::endl;
   std::cout << "localizer: " << _localizer << std::endl;
   std::cout << "imu_topic: " << _imu_topic << std::endl;
+  std::cout << "fitness_confidence: " << _fitness_confidence << std::endl;
+  std::cout << "fitness_max_range: " << _fitness_max_range << std::endl;
+  std::cout << "use_profiling: " << _use_profiling << std::endl;
+  if (_use_profiling)
+    std::cout << "Profile log file: " << profile_filename << std::endl;
   std::cout << "(tf_x,tf_y,tf_z,tf_roll,tf_pitch,tf_yaw): (" << _tf_x << ", " << _tf_y << ", " << _tf_z << ", "
             << _tf_roll << ", " << _tf_pitch << ", " << _tf_yaw << ")" << std::endl;
   std::cout << "-----------------------------------------------------------------" << std::endl;
@@ -1585,6 +1801,9 @@ int main(int argc, char** argv)
   time_ndt_matching_pub = nh.advertise<std_msgs::Float32>("/time_ndt_matching", 10);
   ndt_stat_pub = nh.advertise<autoware_msgs::ndt_stat>("/ndt_stat", 10);
   ndt_reliability_pub = nh.advertise<std_msgs::Float32>("/ndt_reliability", 10);
+  ndt_inlier_ratio_pub = nh.advertise<std_msgs::Float32>("/ndt_inlier_ratio", 10);
+  if (_use_profiling)
+    profile_pub = nh.advertise<diagnostic_msgs::DiagnosticArray>("/ndt_matching_profile", 10);
 
   // Subscribers
   ros::Subscriber param_sub = nh.subscribe("config/ndt", 10, param_callback);
@@ -4,7 +4,7 @@
  * ndt_matching for ROS
  */
 
-// number of cells
+// default number of cells
 #define G_MAP_X 2000
 #define G_MAP_Y 2000
 #define G_MAP_Z 200
@@ -17,11 +17,13 @@
 #include <GL/glut.h>
 #include <math.h>
 #include <stdio.h>
+#include <algorithm>
 #include <chrono>
 #include <fstream>
 #include <iostream>
 #include <sstream>
 #include <string>
+#include <vector>
 #include "algebra.h"
 #include "ndt.h"
 
@@ -113,16 +115,34 @@ static void map_callback(const sensor_msgs::PointCloud2::ConstPtr &input)
 
     pcl::PointCloud<pcl::PointXYZ>::Ptr map_ptr(new pcl::PointCloud<pcl::PointXYZ>(map));
 
-    Point p;
-    for (pcl::PointCloud<pcl::PointXYZ>::const_iterator item = map_ptr->begin(); item != map_ptr->end(); item++)
+    std::vector<Point> map_points_local(map_ptr->size());
+    double max_x = 0.0, max_y = 0.0, max_z = 0.0;
+    for (int i = 0; i < (int)map_ptr->size(); i++)
     {
-      p.x = (item->x - g_map_center_x) * cos(-g_map_rotation) - (item->y - g_map_center_y) * sin(-g_map_rotation);
-      p.y = (item->x - g_map_center_x) * sin(-g_map_rotation) + (item->y - g_map_center_y) * cos(-g_map_rotation);
-      p.z = item->z - g_map_center_z;
-      add_point_map(NDmap, &p);
+      const pcl::PointXYZ &item = map_ptr->points[i];
+      Point &p = map_points_local[i];
+      p.x = (item.x - g_map_center_x) * cos(-g_map_rotation) - (item.y - g_map_center_y) * sin(-g_map_rotation);
+      p.y = (item.x - g_map_center_x) * sin(-g_map_rotation) + (item.y - g_map_center_y) * cos(-g_map_rotation);
+      p.z = item.z - g_map_center_z;
+      max_x = std::max(max_x, fabs(p.x));
+      max_y = std::max(max_y, fabs(p.y));
+      max_z = std::max(max_z, fabs(p.z));
+    }
+
+    // Size the grid from the loaded map (cells are stored sparsely, so only the bounds change)
+    g_map_x = 2 * ((int)ceil(max_x / g_map_cellsize) + (1 << LAYER_NUM));
+    g_map_y = 2 * ((int)ceil(max_y / g_map_cellsize) + (1 << LAYER_NUM));
+    g_map_z = 2 * ((int)ceil(max_z / g_map_cellsize) + (1 << LAYER_NUM));
+    free_NDmap(NDmap);
+    NDmap = initialize_NDmap();
+
+    for (int i = 0; i < (int)map_points_local.size(); i++)
+    {
+      add_point_map(NDmap, &map_points_local[i]);
     }
     std::cout << "Finished loading point cloud map." << std::endl;
     std::cout << "Map points num: " << map_ptr->size() << " points." << std::endl;
+    std::cout << "ND cells num: " << NDs_num << std::endl;
 
     is_map_exist = 1;
     map_loaded = 1;
@@ -503,11 +523,11 @@ int main(int argc, char *argv[])
   // map path
   sprintf(g_ndmap_name, "%s", "ndmap");
 
-  // map size
-  g_map_x = G_MAP_X;
-  g_map_y = G_MAP_Y;
-  g_map_z = G_MAP_Z;
-  g_map_cellsize = G_MAP_CELLSIZE;
+  // map size (resized to the loaded map in map_callback)
+  private_nh.param<int>("map_x", g_map_x, G_MAP_X);
+  private_nh.param<int>("map_y", g_map_y, G_MAP_Y);
+  private_nh.param<int>("map_z", g_map_z, G_MAP_Z);
+  private_nh.param<double>("map_cellsize", g_map_cellsize, G_MAP_CELLSIZE);
   // map center
   g_map_center_x = g_ini_x;
   g_map_center_y = g_ini_y;
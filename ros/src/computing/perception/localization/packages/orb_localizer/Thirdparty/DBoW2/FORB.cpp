@@ -137,6 +137,21 @@ void FORB::fromString(FORB::TDescriptor &a, const std::string &s)
 
 // --------------------------------------------------------------------------
 
+void FORB::toBinary(const FORB::TDescriptor &a, unsigned char *p)
+{
+  const unsigned char *d = a.ptr<unsigned char>();
+  std::copy(d, d+FORB::L, p);
+}
+
+// --------------------------------------------------------------------------
+
+void FORB::fromBinary(FORB::TDescriptor &a, const unsigned char *p)
+{
+  a = cv::Mat(1, FORB::L, CV_8U, const_cast<unsigned char*>(p));
+}
+
+// --------------------------------------------------------------------------
+
 void FORB::toMat32F(const std::vector<TDescriptor> &descriptors, 
   cv::Mat &mat)
 {
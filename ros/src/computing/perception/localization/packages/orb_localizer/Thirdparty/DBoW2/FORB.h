@@ -60,6 +60,21 @@ public:
    */
   static void fromString(TDescriptor &a, const std::string &s);
 
+  /**
+   * Copies the L raw bytes of a descriptor into a buffer
+   * @param a descriptor
+   * @param p destination buffer of at least L bytes
+   */
+  static void toBinary(const TDescriptor &a, unsigned char *p);
+
+  /**
+   * Makes a descriptor that refers to L raw bytes without copying them.
+   * The bytes must outlive the descriptor and are never written
+   * @param a descriptor
+   * @param p source buffer of L bytes
+   */
+  static void fromBinary(TDescriptor &a, const unsigned char *p);
+
   /**
    * Returns a mat with the descriptors in float format
    * @param descriptors
@@ -3,6 +3,8 @@
  * Added functions: Save and Load from text files without using cv::FileStorage.
  * Date: August 2015
  * Raúl Mur-Artal
+ *
+ * Added functions: Save and memory-mapped Load of a binary format.
  */
 
 /**
@@ -26,6 +28,14 @@
 #include <algorithm>
 #include <opencv2/core/core.hpp>
 #include <limits>
+#include <memory>
+#include <cstring>
+#include <stdint.h>
+
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
 
 #include "DUtils/Random.h"
 #include "BowVector.h"
@@ -245,6 +255,35 @@ public:
    */
   void saveToTextFile(const std::string &filename) const;  
 
+  /**
+   * Loads the vocabulary from a binary file written by saveToBinaryFile.
+   * The file is memory-mapped read-only and word descriptors point into
+   * the mapping, so processes loading the same file share its pages
+   * @param filename
+   * @return false if the file can not be mapped or is not a valid
+   *   binary vocabulary
+   */
+  bool loadFromBinaryFile(const std::string &filename);
+
+  /**
+   * Saves the vocabulary into a binary file
+   * @param filename
+   */
+  void saveToBinaryFile(const std::string &filename) const;
+
+  /**
+   * Loads the vocabulary from either a binary or a text file, chosen
+   * by the file header
+   * @param filename
+   */
+  bool loadFromFile(const std::string &filename);
+
+  /**
+   * Returns whether the file starts with the binary vocabulary header
+   * @param filename
+   */
+  static bool isBinaryFile(const std::string &filename);
+
   /**
    * Saves the vocabulary into a file
    * @param filename
@@ -327,6 +366,43 @@ protected:
     inline bool isLeaf() const { return children.empty(); }
   };
 
+  /// Header of the binary vocabulary file. It is followed by, in this
+  /// order, the parent ids (uint32), the weights (WordValue), the leaf
+  /// flags (uint8) and the descriptors of every node but the root.
+  /// Each array starts at a multiple of BINARY_ALIGNMENT bytes
+  struct BinaryHeader
+  {
+    char magic[8];
+    uint32_t version;
+    int32_t k;
+    int32_t L;
+    int32_t scoring;
+    int32_t weighting;
+    uint32_t descriptor_bytes;
+    uint64_t nodes;
+  };
+
+  /// Offsets of the arrays of a binary vocabulary file
+  struct BinaryLayout
+  {
+    size_t parents;
+    size_t weights;
+    size_t leaves;
+    size_t descriptors;
+    size_t total;
+  };
+
+  static const char BINARY_MAGIC[8];
+  static const uint32_t BINARY_VERSION = 1;
+  static const size_t BINARY_ALIGNMENT = 32;
+
+  /**
+   * Computes where each array of a binary vocabulary file starts
+   * @param nodes number of nodes without the root
+   * @param descriptor_bytes size of one descriptor
+   */
+  static BinaryLayout binaryLayout(uint64_t nodes, uint32_t descriptor_bytes);
+
 protected:
 
   /**
@@ -424,11 +500,20 @@ protected:
   /// Words of the vocabulary (tree leaves)
   /// this condition holds: m_words[wid]->word_id == wid
   std::vector<Node*> m_words;
+
+  /// Mapped binary file the node descriptors point into, if any
+  std::shared_ptr<const void> m_mapping;
   
 };
 
 // --------------------------------------------------------------------------
 
+template<class TDescriptor, class F>
+const char TemplatedVocabulary<TDescriptor,F>::BINARY_MAGIC[8] =
+  {'D', 'B', 'o', 'W', '2', 'B', 'I', 'N'};
+
+// --------------------------------------------------------------------------
+
 template<class TDescriptor, class F>
 TemplatedVocabulary<TDescriptor,F>::TemplatedVocabulary
   (int k, int L, WeightingType weighting, ScoringType scoring)
@@ -546,6 +631,7 @@ TemplatedVocabulary<TDescriptor,F>::operator=
   this->m_words.clear();
   
   this->m_nodes = voc.m_nodes;
+  this->m_mapping = voc.m_mapping;
   this->createWords();
   
   return *this;
@@ -559,6 +645,7 @@ void TemplatedVocabulary<TDescriptor,F>::create(
 {
   m_nodes.clear();
   m_words.clear();
+  m_mapping.reset();
   
   // expected_nodes = Sum_{i=0..L} ( k^i )
 	int expected_nodes = 
@@ -1339,11 +1426,12 @@ bool TemplatedVocabulary<TDescriptor,F>::loadFromTextFile(const std::string &fil
     ifstream f;
     f.open(filename.c_str());
 	
-    if(f.eof())
+    if(!f.is_open() || f.eof())
 	return false;
 
     m_words.clear();
     m_nodes.clear();
+    m_mapping.reset();
 
     string s;
     getline(f,s);
@@ -1378,6 +1466,8 @@ bool TemplatedVocabulary<TDescriptor,F>::loadFromTextFile(const std::string &fil
     {
         string snode;
         getline(f,snode);
+        if(snode.empty())
+            continue;
         stringstream ssnode;
         ssnode << snode;
 
@@ -1449,6 +1539,186 @@ void TemplatedVocabulary<TDescriptor,F>::saveToTextFile(const std::string &filen
 
 // --------------------------------------------------------------------------
 
+template<class TDescriptor, class F>
+typename TemplatedVocabulary<TDescriptor,F>::BinaryLayout
+TemplatedVocabulary<TDescriptor,F>::binaryLayout
+  (uint64_t nodes, uint32_t descriptor_bytes)
+{
+  const size_t a = BINARY_ALIGNMENT;
+  BinaryLayout layout;
+  layout.parents = (sizeof(BinaryHeader) + a - 1) / a * a;
+  layout.weights = (layout.parents + nodes * sizeof(uint32_t) + a - 1) / a * a;
+  layout.leaves = (layout.weights + nodes * sizeof(WordValue) + a - 1) / a * a;
+  layout.descriptors = (layout.leaves + nodes + a - 1) / a * a;
+  layout.total = layout.descriptors + nodes * descriptor_bytes;
+  return layout;
+}
+
+// --------------------------------------------------------------------------
+
+template<class TDescriptor, class F>
+bool TemplatedVocabulary<TDescriptor,F>::isBinaryFile(const std::string &filename)
+{
+  ifstream f(filename.c_str(), ios_base::in | ios_base::binary);
+  char magic[sizeof(BINARY_MAGIC)];
+  if(!f.read(magic, sizeof(magic)))
+    return false;
+  return memcmp(magic, BINARY_MAGIC, sizeof(magic)) == 0;
+}
+
+// --------------------------------------------------------------------------
+
+template<class TDescriptor, class F>
+bool TemplatedVocabulary<TDescriptor,F>::loadFromFile(const std::string &filename)
+{
+  if(isBinaryFile(filename))
+    return loadFromBinaryFile(filename);
+  else
+    return loadFromTextFile(filename);
+}
+
+// --------------------------------------------------------------------------
+
+template<class TDescriptor, class F>
+bool TemplatedVocabulary<TDescriptor,F>::loadFromBinaryFile(const std::string &filename)
+{
+  int fd = open(filename.c_str(), O_RDONLY);
+  if(fd < 0)
+    return false;
+
+  struct stat st;
+  if(fstat(fd, &st) != 0 || (size_t)st.st_size < sizeof(BinaryHeader))
+  {
+    close(fd);
+    return false;
+  }
+
+  const size_t length = st.st_size;
+  void *addr = mmap(NULL, length, PROT_READ, MAP_SHARED, fd, 0);
+  close(fd);
+  if(addr == MAP_FAILED)
+    return false;
+
+  std::shared_ptr<const void> mapping(addr, [length](const void *p)
+    { munmap(const_cast<void*>(p), length); });
+
+  const unsigned char *base = static_cast<const unsigned char*>(addr);
+  BinaryHeader header;
+  memcpy(&header, base, sizeof(header));
+
+  if(memcmp(header.magic, BINARY_MAGIC, sizeof(header.magic)) != 0 ||
+    header.version != BINARY_VERSION ||
+    header.descriptor_bytes != (uint32_t)F::L ||
+    header.k < 0 || header.k > 20 || header.L < 1 || header.L > 10 ||
+    header.scoring < 0 || header.scoring > 5 ||
+    header.weighting < 0 || header.weighting > 3 ||
+    header.nodes > std::numeric_limits<NodeId>::max() ||
+    binaryLayout(header.nodes, header.descriptor_bytes).total > length)
+  {
+    std::cerr << "Vocabulary loading failure: This is not a correct binary file!" << endl;
+    return false;
+  }
+
+  const BinaryLayout layout = binaryLayout(header.nodes, header.descriptor_bytes);
+  const uint32_t *parents =
+    reinterpret_cast<const uint32_t*>(base + layout.parents);
+  const WordValue *weights =
+    reinterpret_cast<const WordValue*>(base + layout.weights);
+  const uint8_t *leaves = base + layout.leaves;
+  const unsigned char *descriptors = base + layout.descriptors;
+
+  madvise(addr, length, MADV_WILLNEED);
+
+  m_k = header.k;
+  m_L = header.L;
+  m_scoring = (ScoringType)header.scoring;
+  m_weighting = (WeightingType)header.weighting;
+  createScoringObject();
+
+  const size_t N = header.nodes;
+  const size_t nwords = std::count_if(leaves, leaves + N,
+    [](uint8_t leaf) { return leaf != 0; });
+
+  // m_nodes is sized once so m_words can point into it
+  m_words.clear();
+  m_nodes.clear();
+  m_nodes.resize(N + 1);
+  m_words.reserve(nwords);
+  m_nodes[0].id = 0;
+
+  for(size_t i = 0; i < N; ++i)
+  {
+    const NodeId nid = i + 1;
+    const NodeId pid = parents[i];
+    if(pid >= nid || (pid > 0 && leaves[pid - 1]))
+    {
+      std::cerr << "Vocabulary loading failure: corrupted binary file!" << endl;
+      m_nodes.clear();
+      m_words.clear();
+      return false;
+    }
+
+    Node &node = m_nodes[nid];
+    node.id = nid;
+    node.parent = pid;
+    node.weight = weights[i];
+    F::fromBinary(node.descriptor, descriptors + i * header.descriptor_bytes);
+    m_nodes[pid].children.push_back(nid);
+
+    if(leaves[i])
+    {
+      node.word_id = m_words.size();
+      m_words.push_back(&node);
+    }
+    else
+    {
+      node.children.reserve(m_k);
+    }
+  }
+
+  m_mapping = mapping;
+  return true;
+}
+
+// --------------------------------------------------------------------------
+
+template<class TDescriptor, class F>
+void TemplatedVocabulary<TDescriptor,F>::saveToBinaryFile(const std::string &filename) const
+{
+  const uint64_t N = m_nodes.empty() ? 0 : m_nodes.size() - 1;
+  const BinaryLayout layout = binaryLayout(N, F::L);
+  std::vector<unsigned char> buffer(layout.total, 0);
+
+  BinaryHeader header;
+  memset(&header, 0, sizeof(header));
+  memcpy(header.magic, BINARY_MAGIC, sizeof(header.magic));
+  header.version = BINARY_VERSION;
+  header.k = m_k;
+  header.L = m_L;
+  header.scoring = m_scoring;
+  header.weighting = m_weighting;
+  header.descriptor_bytes = F::L;
+  header.nodes = N;
+  memcpy(&buffer[0], &header, sizeof(header));
+
+  for(size_t i = 0; i < N; ++i)
+  {
+    const Node &node = m_nodes[i + 1];
+    const uint32_t parent = node.parent;
+    const WordValue weight = node.weight;
+    memcpy(&buffer[layout.parents + i * sizeof(uint32_t)], &parent, sizeof(parent));
+    memcpy(&buffer[layout.weights + i * sizeof(WordValue)], &weight, sizeof(weight));
+    buffer[layout.leaves + i] = node.isLeaf() ? 1 : 0;
+    F::toBinary(node.descriptor, &buffer[layout.descriptors + i * F::L]);
+  }
+
+  ofstream f(filename.c_str(), ios_base::out | ios_base::binary | ios_base::trunc);
+  if(!f.is_open()) throw string("Could not open file ") + filename;
+  f.write(reinterpret_cast<const char*>(&buffer[0]), buffer.size());
+}
+
+// --------------------------------------------------------------------------
+
 template<class TDescriptor, class F>
 void TemplatedVocabulary<TDescriptor,F>::save(const std::string &filename) const
 {
@@ -138,8 +138,10 @@ public:
         return pKF1->mnId<pKF2->mnId;
     }
 
-    // Called after map loading for each keyframe
-    void fixConnections (Map *smap, KeyFrameDatabase *kfdb);
+    // Called after map loading for each keyframe.
+    // Chunked maps keep the id lists, as they relink whenever chunks
+    // are loaded or evicted.
+    void fixConnections (Map *smap, KeyFrameDatabase *kfdb, bool keepIdList=false);
 
     /* Returns normalized keyframe's direction vector (really axis of quaternion) */
     void getDirectionVector (float &dirX, float &dirY, float &dirZ);
@@ -28,6 +28,7 @@
 #include <vector>
 #include <map>
 #include <mutex>
+#include <cstdint>
 
 // For Fast keyframe search
 #define PCL_NO_PRECOMPILE
@@ -106,6 +107,66 @@ public:
 			numOfReferencePoint;
 	};
 
+// Chunked map storage.
+// Keyframes are grouped into cubic cells of their camera center, each cell
+// being stored as an independent archive together with the map points
+// referenced to its keyframes. An index at the end of the file lists
+// the cells and the position of every keyframe, so that only the cells
+// around the tracked camera need to be kept in memory.
+	void saveToDiskChunked (const std::string &filename, float chunkSize);
+
+	struct ChunkedMapFileHeader {
+		char signature[7];
+		long unsigned int
+			numOfKeyFrame,
+			numOfMapPoint,
+			numOfReferencePoint,
+			numOfChunk,
+			indexOffset;
+		float chunkSize;
+	};
+
+	struct KeyFrameIndexEntry {
+		int64_t id;
+		double timestamp;
+		float x, y, z;
+		int chunk;
+	};
+
+	struct MapChunk {
+		int cx, cy, cz;
+		long unsigned int offset, size;
+
+		// Bounding box of keyframe camera centers, built from the index
+		float minX, minY, minZ, maxX, maxY, maxZ;
+
+		bool loaded;
+		std::vector<KeyFrame*> keyframes;
+		std::vector<MapPoint*> mapPoints;
+	};
+
+	// Chunks closer than loadRadius to the camera are loaded, those
+	// farther than evictRadius are evicted. With loadRadius of zero,
+	// chunked maps are loaded completely. Must be set before loadFromDisk.
+	void setActiveRegion (float loadRadius, float evictRadius);
+
+	bool isChunked () const
+	{ return !mapChunks.empty(); }
+
+	// Loads and evicts chunks around the camera center. When the center
+	// is empty, the chunks around the first keyframe are loaded if nothing
+	// is resident yet. Evicted objects are removed from the map and the
+	// keyframe database, but are only deleted by releaseEvicted(), after
+	// the caller dropped its own references. Call with mMutexMapUpdate held,
+	// readers outside the tracking thread (e.g. MapDrawer) hold it as well.
+	// Returns true if the resident set changed.
+	bool updateActiveRegion (const cv::Mat &cameraCenter,
+		std::set<KeyFrame*> &evictedKeyFrames,
+		std::set<MapPoint*> &evictedMapPoints);
+
+	void releaseEvicted (std::set<KeyFrame*> &evictedKeyFrames,
+		std::set<MapPoint*> &evictedMapPoints);
+
 //	KeyFrame* getNearestKeyFrame (
 //		const float &x, const float &y, const float &z,
 //		const float fdir_x, const float fdir_y, const float fdir_z,
@@ -138,6 +199,21 @@ protected:
 
     KeyFrameDatabase *mKeyFrameDb;
 
+    // Chunked map state
+    void loadChunk (MapChunk &chunk, std::istream &mapFileFd);
+    void evictChunk (MapChunk &chunk,
+    	std::set<KeyFrame*> &evictedKeyFrames,
+    	std::set<MapPoint*> &evictedMapPoints);
+    void relinkResidentObjects ();
+    void buildKeyFrameOctree ();
+
+    std::string chunkedMapFile;
+    std::vector<MapChunk> mapChunks;
+    std::vector<KeyFrameIndexEntry> keyframeIndex;
+    std::vector<int64_t> referenceMapPointIds;
+    float chunkLoadRadius,
+		chunkEvictRadius;
+
 };
 
 } //namespace ORB_SLAM
@@ -549,6 +549,8 @@ void load (Archive & ar, MapPoint &mapPoint, const unsigned int version)
 	// XXX: Should we refactor the above part of this function? it looks the same as
 	// saving part
 	MapPoint::mpReplacement[mapPoint.mnId] = _mpReplaced;
+	mapPoint._kfObservation = kfObservation;
+	mapPoint._refKfId = refKfId;
 	mapPoint.mObservations = createObjectList<KeyFrame> (kfObservation);
 	mapPoint.mpRefKF = (refKfId==-1 ?
 			NULL :
@@ -191,7 +191,11 @@ public:
      // Additions for map restoration
     static map<long unsigned int, long unsigned int> mpReplacement;
 	static map<idtype, MapPoint*> objectListLookup;
-	void fixConnections (Map *smap);
+	void fixConnections (Map *smap, bool keepIdList=false);
+
+	// these class members are meant to be temporary when serializing.
+	map<idtype,size_t> _kfObservation;
+	idtype _refKfId;
 
 };
 
@@ -42,6 +42,14 @@ public:
 
     // Computes the Hamming distance between two ORB descriptors
     static int DescriptorDistance(const cv::Mat &a, const cv::Mat &b);
+    static int DescriptorDistance(const unsigned char *a, const unsigned char *b);
+
+    // Computes the Hamming distance between one query descriptor and a batch of rows
+    // of a descriptor matrix (one 32-byte ORB descriptor per row). Rows are read in place,
+    // so the matrix already acts as the packed candidate buffer. Uses AVX2 or hardware
+    // popcount when the CPU supports it.
+    static void DescriptorDistances(const unsigned char *query, const cv::Mat &descriptors,
+                                    const int *rows, const int n, int *dist);
 
     // Search matches between Frame keypoints and projected MapPoints. Returns number of matches
     // Used to track the local map (Tracking)
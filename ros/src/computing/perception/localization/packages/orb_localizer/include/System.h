@@ -146,6 +146,10 @@ public:
 
 private:
 
+    // For chunked maps in localization: loads the chunks around the last
+    // tracked pose and frees the distant ones, before tracking a new frame.
+    void UpdateMapRegion();
+
     // Input sensor
     eSensor mSensor;
 
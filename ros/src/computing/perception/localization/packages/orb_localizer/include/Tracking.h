@@ -85,6 +85,10 @@ public:
 
     void setMapLoaded ();
 
+    // Drops every reference to keyframes and map points evicted from a
+    // chunked map. Tracking is lost if its reference keyframe is evicted.
+    void ForgetMapObjects (const std::set<KeyFrame*> &keyframes, const std::set<MapPoint*> &mappoints);
+
     // XXX: Stub
     KeyFrame* getNearestKeyFrame()
     { return mpLastKeyFrame; }
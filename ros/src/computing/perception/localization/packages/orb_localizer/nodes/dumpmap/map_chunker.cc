@@ -0,0 +1,94 @@
+/*
+ * map_chunker.cc
+ *
+ * Converts a map file into the chunked map format, that orb_matching
+ * loads around the current pose only (see Map.ChunkLoadRadius).
+ * The map vocabulary is copied next to the new map in binary format.
+ */
+
+#include <string>
+#include <iostream>
+#include <cstdlib>
+#include <algorithm>
+#include "Map.h"
+#include "KeyFrame.h"
+#include "MapPoint.h"
+#include "ORBVocabulary.h"
+#include "KeyFrameDatabase.h"
+
+
+using namespace std;
+using ORB_SLAM2::Map;
+using ORB_SLAM2::KeyFrame;
+using ORB_SLAM2::KeyFrameDatabase;
+using ORB_SLAM2::ORBVocabulary;
+
+
+// Keyframes spacing along the route, in multiples of which chunks are sized by default
+const float keyframesPerChunk = 20;
+
+
+float defaultChunkSize (const Map &World)
+{
+	vector<float> spacing;
+	for (unsigned int i=1; i<World.kfListSorted.size(); i++) {
+		cv::Mat d = World.kfListSorted[i]->GetCameraCenter() - World.kfListSorted[i-1]->GetCameraCenter();
+		spacing.push_back (cv::norm(d));
+	}
+	if (spacing.empty())
+		return 1.0;
+
+	std::nth_element (spacing.begin(), spacing.begin() + spacing.size()/2, spacing.end());
+	return keyframesPerChunk * spacing[spacing.size()/2];
+}
+
+
+int main (int argc, char **argv)
+{
+	if (argc < 3) {
+		cerr << "Usage: " << argv[0] << " <input map> <output map> [chunk size]" << endl;
+		cerr << "Chunk size is in map units; by default " << keyframesPerChunk << " times the median keyframe spacing" << endl;
+		return 1;
+	}
+
+	const string inputMap (argv[1]),
+		outputMap (argv[2]);
+
+	ORBVocabulary mapVoc;
+	if (mapVoc.loadFromFile (inputMap + ".voc") == false) {
+		cerr << "Map vocabulary not found, using generic vocabulary" << endl;
+		if (mapVoc.loadFromFile (ORB_SLAM_VOCABULARY) == false) {
+			cerr << "Failed to open at: " << ORB_SLAM_VOCABULARY << endl;
+			return 1;
+		}
+	}
+
+	KeyFrameDatabase keyframeDB (mapVoc);
+	Map World;
+	try {
+		World.loadFromDisk (inputMap, &keyframeDB);
+	} catch (exception &e) {
+		cerr << "Unable to load map " << inputMap << endl;
+		return 1;
+	}
+
+	const float chunkSize = (argc > 3) ? atof(argv[3]) : defaultChunkSize(World);
+	if (chunkSize <= 0) {
+		cerr << "Invalid chunk size" << endl;
+		return 1;
+	}
+	cout << "Chunk size: " << chunkSize << endl;
+
+	try {
+		World.saveToDiskChunked (outputMap, chunkSize);
+		mapVoc.saveToBinaryFile (outputMap + ".voc");
+	} catch (exception &e) {
+		cerr << "Unable to write map " << outputMap << endl;
+		return 1;
+	} catch (string &e) {
+		cerr << e << endl;
+		return 1;
+	}
+
+	return 0;
+}
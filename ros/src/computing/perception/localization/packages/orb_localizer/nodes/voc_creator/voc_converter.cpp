@@ -0,0 +1,51 @@
+/*
+ * voc_converter.cpp
+ *
+ * Converts an ORB vocabulary between the text format and the
+ * memory-mappable binary format. The direction is chosen from the
+ * header of the input file.
+ */
+
+#include <string>
+#include <iostream>
+#include <ORBVocabulary.h>
+
+
+using namespace std;
+using ORB_SLAM2::ORBVocabulary;
+
+
+int main (int argc, char **argv)
+{
+	if (argc != 3) {
+		cerr << "Usage: " << argv[0] << " <input vocabulary> <output vocabulary>" << endl;
+		cerr << "Text input is written as binary, binary input is written as text" << endl;
+		return 1;
+	}
+
+	const string inputPath (argv[1]),
+		outputPath (argv[2]);
+
+	ORBVocabulary vocabulary;
+	const bool toBinary = !ORBVocabulary::isBinaryFile (inputPath);
+
+	cerr << "Loading " << inputPath << "... ";
+	if (vocabulary.loadFromFile (inputPath) == false or vocabulary.empty()) {
+		cerr << "Failed" << endl;
+		return 1;
+	}
+	cerr << vocabulary.size() << " words" << endl;
+
+	try {
+		if (toBinary)
+			vocabulary.saveToBinaryFile (outputPath);
+		else
+			vocabulary.saveToTextFile (outputPath);
+	} catch (string &e) {
+		cerr << e << endl;
+		return 1;
+	}
+	cerr << "Saved " << (toBinary ? "binary" : "text") << " vocabulary to " << outputPath << endl;
+
+	return 0;
+}
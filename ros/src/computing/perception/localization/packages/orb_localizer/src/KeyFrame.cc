@@ -690,7 +690,7 @@ float KeyFrame::ComputeSceneMedianDepth(const int q)
 }
 
 
-void KeyFrame::fixConnections (Map *smap, KeyFrameDatabase *kfdb)
+void KeyFrame::fixConnections (Map *smap, KeyFrameDatabase *kfdb, bool keepIdList)
 {
 	mpMap = smap;
 	mpKeyFrameDB = kfdb;
@@ -702,7 +702,8 @@ void KeyFrame::fixConnections (Map *smap, KeyFrameDatabase *kfdb)
 	mvpOrderedConnectedKeyFrames = createObjectList<KeyFrame> (_vmvpOrderedConnectedKeyFrames);
 	mvpOrderedConnectedKeyFrames = purgeNull(mvpOrderedConnectedKeyFrames);
 
-	mpParent = (_parentId==-1) ? NULL : objectListLookup[_parentId];
+	map<idtype, KeyFrame*>::const_iterator parent = objectListLookup.find (_parentId);
+	mpParent = (parent==objectListLookup.end()) ? NULL : parent->second;
 
 	mspChildrens = createObjectList<KeyFrame> (_vmspChildrens);
 
@@ -710,6 +711,9 @@ void KeyFrame::fixConnections (Map *smap, KeyFrameDatabase *kfdb)
 
 	mvpMapPoints = createObjectList<MapPoint> (_mapPointIdList);
 
+	if (keepIdList)
+		return;
+
 	// memory clearing
 	_imConnectedKeyFrameWeights.clear();
 	_vmvpOrderedConnectedKeyFrames.clear();
@@ -28,6 +28,10 @@
 #include <cstdio>
 #include <exception>
 #include <string>
+#include <tuple>
+#include <cmath>
+#include <algorithm>
+#include <limits>
 
 #include <boost/archive/binary_oarchive.hpp>
 #include <boost/archive/binary_iarchive.hpp>
@@ -38,6 +42,32 @@
 using std::string;
 
 
+namespace boost {
+namespace serialization {
+
+template <class Archive>
+void serialize (Archive &ar, ORB_SLAM2::Map::MapChunk &chunk, const unsigned int version)
+{
+	ar &
+		chunk.cx & chunk.cy & chunk.cz &
+		chunk.offset & chunk.size;
+}
+
+
+template <class Archive>
+void serialize (Archive &ar, ORB_SLAM2::Map::KeyFrameIndexEntry &entry, const unsigned int version)
+{
+	ar &
+		entry.id &
+		entry.timestamp &
+		entry.x & entry.y & entry.z &
+		entry.chunk;
+}
+
+}
+}
+
+
 template<class T>
 vector<T> set2vector (const set<T> &st)
 {
@@ -54,7 +84,10 @@ namespace ORB_SLAM2
 
 Map::Map():
 	mnMaxKFid(0),
-	mbMapUpdated(false)
+	mbMapUpdated(false),
+	mKeyFrameDb(NULL),
+	chunkLoadRadius(0),
+	chunkEvictRadius(0)
 {
 }
 
@@ -159,6 +192,7 @@ KeyFrame* Map::offsetKeyframe (KeyFrame* kfSrc, int offset)
 
 
 const char *signature = "ORBSLAM";
+const char *chunkedSignature = "ORBSLMC";
 
 void Map::saveToDisk(const string &mapfilename, KeyFrameDatabase *keyframeDatabase)
 {
@@ -220,7 +254,7 @@ void Map::saveToDisk(const string &mapfilename, KeyFrameDatabase *keyframeDataba
 	boost::filesystem::path mapPath (mapfilename);
 	boost::filesystem::path mapDir = mapPath.parent_path();
 	string mapVocab = mapPath.string() + ".voc";
-	mapVoc.saveToTextFile (mapVocab);
+	mapVoc.saveToBinaryFile (mapVocab);
 	cout << "Done\n";
 }
 
@@ -244,6 +278,49 @@ void Map::loadFromDisk(const string &filename, KeyFrameDatabase *kfMemDb)
 		throw BadMapFile();
 	mapFileFd.read ((char*)&header, sizeof(header));
 
+	if (strncmp(header.signature, chunkedSignature, sizeof(header.signature))==0) {
+		ChunkedMapFileHeader cheader;
+		mapFileFd.seekg (0);
+		mapFileFd.read ((char*)&cheader, sizeof(cheader));
+		cout << "Chunked map; Keyframes: " << cheader.numOfKeyFrame << ", MapPoint: " << cheader.numOfMapPoint
+			<< ", Chunks: " << cheader.numOfChunk << endl;
+
+		mapFileFd.seekg (cheader.indexOffset);
+		boost::archive::binary_iarchive indexArchive (mapFileFd);
+		indexArchive >> mapChunks >> keyframeIndex >> referenceMapPointIds;
+
+		for (auto &chunk: mapChunks) {
+			chunk.loaded = false;
+			chunk.minX = chunk.minY = chunk.minZ = std::numeric_limits<float>::max();
+			chunk.maxX = chunk.maxY = chunk.maxZ = -std::numeric_limits<float>::max();
+		}
+		for (auto &entry: keyframeIndex) {
+			MapChunk &chunk = mapChunks.at(entry.chunk);
+			chunk.minX = std::min(chunk.minX, entry.x), chunk.maxX = std::max(chunk.maxX, entry.x);
+			chunk.minY = std::min(chunk.minY, entry.y), chunk.maxY = std::max(chunk.maxY, entry.y);
+			chunk.minZ = std::min(chunk.minZ, entry.z), chunk.maxZ = std::max(chunk.maxZ, entry.z);
+		}
+
+		chunkedMapFile = filename;
+		mKeyFrameDb = kfMemDb;
+
+		if (chunkLoadRadius > 0) {
+			set<KeyFrame*> evictedKeyFrames;
+			set<MapPoint*> evictedMapPoints;
+			updateActiveRegion (cv::Mat(), evictedKeyFrames, evictedMapPoints);
+		}
+		else {
+			for (auto &chunk: mapChunks)
+				loadChunk (chunk, mapFileFd);
+			relinkResidentObjects();
+		}
+
+		mapFileFd.close();
+		mbMapUpdated = true;
+		cout << "Done restoring map" << endl;
+		return;
+	}
+
 	if (strncmp(header.signature, signature, sizeof(signature)-1) !=0)
 		throw BadMapFile();
 	cout << "Keyframes: " << header.numOfKeyFrame << ", MapPoint: " << header.numOfMapPoint << endl;
@@ -322,6 +399,14 @@ void Map::loadFromDisk(const string &filename, KeyFrameDatabase *kfMemDb)
 	mbMapUpdated = true;
 	cout << "Done restoring map" << endl;
 
+	mKeyFrameDb = kfMemDb;
+	buildKeyFrameOctree();
+//	cout << "Done restoring Octree" << endl;
+}
+
+
+void Map::buildKeyFrameOctree ()
+{
 	/* Point Cloud Reconstruction */
 	kfCloud = pcl::PointCloud<KeyFramePt>::Ptr (new pcl::PointCloud<KeyFramePt>);
 	kfCloud->width = mspKeyFrames.size();
@@ -340,8 +425,293 @@ void Map::loadFromDisk(const string &filename, KeyFrameDatabase *kfMemDb)
 	kfOctree = pcl::octree::OctreePointCloudSearch<KeyFramePt>::Ptr (new pcl::octree::OctreePointCloudSearch<KeyFramePt> (MapOctreeResolution));
 	kfOctree->setInputCloud(kfCloud);
 	kfOctree->addPointsFromInputCloud();
-	mKeyFrameDb = kfMemDb;
-//	cout << "Done restoring Octree" << endl;
+}
+
+
+void Map::setActiveRegion (float loadRadius, float evictRadius)
+{
+	chunkLoadRadius = loadRadius;
+	// Evicting closer than loading would reload the same chunks over and over
+	chunkEvictRadius = std::max(loadRadius, evictRadius);
+}
+
+
+void Map::saveToDiskChunked (const string &mapfilename, const float chunkSize)
+{
+	// Keyframes that were loaded as bad are kept too, as map points may refer to them
+	set<KeyFrame*> allKeyFrames (mspKeyFrames.begin(), mspKeyFrames.end());
+	allKeyFrames.insert (kfListSorted.begin(), kfListSorted.end());
+
+	vector<MapChunk> chunks;
+	vector<KeyFrameIndexEntry> kfIndex;
+	std::map<std::tuple<int,int,int>, int> chunkIds;
+	std::map<const KeyFrame*, int> kfChunk;
+
+	for (set<KeyFrame*>::const_iterator kfit=allKeyFrames.begin(); kfit!=allKeyFrames.end(); kfit++) {
+		KeyFrame *kf = *kfit;
+		if (kf==NULL)
+			continue;
+
+		cv::Mat pos = kf->GetCameraCenter();
+		KeyFrameIndexEntry entry;
+		entry.id = kf->mnId;
+		entry.timestamp = kf->mTimeStamp;
+		entry.x = pos.at<float>(0);
+		entry.y = pos.at<float>(1);
+		entry.z = pos.at<float>(2);
+
+		const std::tuple<int,int,int> cell (
+			(int)floor(entry.x / chunkSize),
+			(int)floor(entry.y / chunkSize),
+			(int)floor(entry.z / chunkSize));
+		std::map<std::tuple<int,int,int>, int>::const_iterator cit = chunkIds.find(cell);
+		if (cit==chunkIds.end()) {
+			MapChunk chunk;
+			chunk.cx = std::get<0>(cell);
+			chunk.cy = std::get<1>(cell);
+			chunk.cz = std::get<2>(cell);
+			chunk.loaded = false;
+			cit = chunkIds.insert (std::make_pair(cell, (int)chunks.size())).first;
+			chunks.push_back (chunk);
+		}
+
+		entry.chunk = cit->second;
+		chunks[entry.chunk].keyframes.push_back (kf);
+		kfChunk[kf] = entry.chunk;
+		kfIndex.push_back (entry);
+	}
+
+	// Map points are stored with their reference keyframe
+	long unsigned int numOfMapPoint = 0;
+	for (set<MapPoint*>::const_iterator mpit=mspMapPoints.begin(); mpit!=mspMapPoints.end(); mpit++) {
+		MapPoint *mp = *mpit;
+		if (mp==NULL)
+			continue;
+		std::map<const KeyFrame*, int>::const_iterator kit = kfChunk.find (mp->GetReferenceKeyFrame());
+		if (kit==kfChunk.end())
+			continue;
+		chunks[kit->second].mapPoints.push_back (mp);
+		numOfMapPoint++;
+	}
+
+	ChunkedMapFileHeader header;
+	memset (&header, 0, sizeof(header));
+	memcpy (header.signature, chunkedSignature, sizeof(header.signature));
+	header.numOfKeyFrame = kfIndex.size();
+	header.numOfMapPoint = numOfMapPoint;
+	header.numOfReferencePoint = this->mvpReferenceMapPoints.size();
+	header.numOfChunk = chunks.size();
+	header.chunkSize = chunkSize;
+
+	fstream mapFileFd;
+	mapFileFd.open (mapfilename.c_str(), fstream::out | fstream::trunc | fstream::binary);
+	if (!mapFileFd.is_open())
+		throw MapFileException();
+	mapFileFd.write ((const char*)&header, sizeof(header));
+
+	int p = 0;
+	for (auto &chunk: chunks) {
+		chunk.offset = mapFileFd.tellp();
+		{
+			boost::archive::binary_oarchive chunkArchive (mapFileFd);
+			const long unsigned int
+				numOfKeyFrame = chunk.keyframes.size(),
+				numOfMapPoint = chunk.mapPoints.size();
+			chunkArchive << numOfKeyFrame << numOfMapPoint;
+			for (const KeyFrame *kf: chunk.keyframes)
+				chunkArchive << *kf;
+			for (const MapPoint *mp: chunk.mapPoints)
+				chunkArchive << *mp;
+		}
+		chunk.size = (long unsigned int)mapFileFd.tellp() - chunk.offset;
+		cout << "Chunks: " << ++p << "/" << chunks.size() << "\r";
+	}
+	cout << endl;
+
+	const vector<idtype> vmvpReferenceMapPoints = createIdList (mvpReferenceMapPoints);
+	header.indexOffset = mapFileFd.tellp();
+	{
+		boost::archive::binary_oarchive indexArchive (mapFileFd);
+		indexArchive << chunks << kfIndex << vmvpReferenceMapPoints;
+	}
+
+	mapFileFd.seekp (0);
+	mapFileFd.write ((const char*)&header, sizeof(header));
+	mapFileFd.close();
+
+	cout << "Header written: " << header.numOfKeyFrame << " keyframes, " << header.numOfMapPoint << " points, "
+		<< header.numOfChunk << " chunks" << endl;
+}
+
+
+void Map::loadChunk (MapChunk &chunk, std::istream &mapFileFd)
+{
+	mapFileFd.seekg (chunk.offset);
+	boost::archive::binary_iarchive chunkArchive (mapFileFd);
+
+	long unsigned int numOfKeyFrame, numOfMapPoint;
+	chunkArchive >> numOfKeyFrame >> numOfMapPoint;
+
+	for (unsigned int p=0; p<numOfKeyFrame; p++) {
+		KeyFrame *kf = new KeyFrame;
+		chunkArchive >> *kf;
+		chunk.keyframes.push_back (kf);
+		if (mKeyFrameDb!=NULL and !kf->isBad())
+			mKeyFrameDb->add (kf);
+
+		if (kf->mnId > KeyFrame::nNextId) {
+			KeyFrame::nNextId = kf->mnId + 2;
+			Frame::nNextId = kf->mnId + 3;
+		}
+	}
+
+	for (unsigned int p=0; p<numOfMapPoint; p++) {
+		MapPoint *mp = new MapPoint;
+		chunkArchive >> *mp;
+		chunk.mapPoints.push_back (mp);
+		if (mp->mnId > MapPoint::nNextId) {
+			MapPoint::nNextId = mp->mnId + 2;
+		}
+	}
+
+	chunk.loaded = true;
+}
+
+
+void Map::evictChunk (MapChunk &chunk,
+	set<KeyFrame*> &evictedKeyFrames,
+	set<MapPoint*> &evictedMapPoints)
+{
+	for (KeyFrame *kf: chunk.keyframes) {
+		if (mKeyFrameDb!=NULL and !kf->isBad())
+			mKeyFrameDb->erase (kf);
+		KeyFrame::objectListLookup.erase (kf->mnId);
+		evictedKeyFrames.insert (kf);
+	}
+
+	for (MapPoint *mp: chunk.mapPoints) {
+		MapPoint::objectListLookup.erase (mp->mnId);
+		evictedMapPoints.insert (mp);
+	}
+
+	chunk.keyframes.clear();
+	chunk.mapPoints.clear();
+	chunk.loaded = false;
+}
+
+
+void Map::relinkResidentObjects ()
+{
+	{
+		unique_lock<mutex> lock(mMutexMap);
+
+		mspKeyFrames.clear();
+		mspMapPoints.clear();
+		kfListSorted.clear();
+		kfMapSortedId.clear();
+
+		for (auto &chunk: mapChunks) {
+			for (KeyFrame *kf: chunk.keyframes) {
+				if (!kf->isBad())
+					mspKeyFrames.insert (kf);
+				kfListSorted.push_back (kf);
+			}
+			mspMapPoints.insert (chunk.mapPoints.begin(), chunk.mapPoints.end());
+		}
+	}
+
+	std::sort(kfListSorted.begin(), kfListSorted.end(), keyframeTimestampSortComparator);
+	for (unsigned int p=0; p<kfListSorted.size(); p++) {
+		kfMapSortedId[kfListSorted[p]] = p;
+	}
+
+	if (mKeyFrameDb!=NULL) {
+		// Keep the id lists, so the links to objects of other chunks are
+		// restored once those are loaded
+		const bool keepIdList = (chunkLoadRadius > 0);
+
+		for (set<KeyFrame*>::iterator kfset=mspKeyFrames.begin(); kfset!=mspKeyFrames.end(); kfset++) {
+			(*kfset)->fixConnections (this, mKeyFrameDb, keepIdList);
+		}
+
+		for (set<MapPoint*>::iterator mpset=mspMapPoints.begin(); mpset!=mspMapPoints.end(); mpset++) {
+			(*mpset)->fixConnections (this, keepIdList);
+		}
+	}
+
+	SetReferenceMapPoints (purgeNull (createObjectList<MapPoint> (referenceMapPointIds)));
+
+	buildKeyFrameOctree();
+}
+
+
+bool Map::updateActiveRegion (const cv::Mat &cameraCenter,
+	set<KeyFrame*> &evictedKeyFrames,
+	set<MapPoint*> &evictedMapPoints)
+{
+	if (mapChunks.empty() or chunkLoadRadius <= 0)
+		return false;
+
+	float x, y, z;
+	if (cameraCenter.empty()) {
+		// Without a pose, start from the beginning of the route
+		for (auto &chunk: mapChunks) {
+			if (chunk.loaded)
+				return false;
+		}
+		if (keyframeIndex.empty())
+			return false;
+		const KeyFrameIndexEntry &first = *std::min_element(keyframeIndex.begin(), keyframeIndex.end(),
+			[](const KeyFrameIndexEntry &e1, const KeyFrameIndexEntry &e2)
+			{ return e1.timestamp < e2.timestamp; });
+		x = first.x, y = first.y, z = first.z;
+	}
+	else {
+		x = cameraCenter.at<float>(0);
+		y = cameraCenter.at<float>(1);
+		z = cameraCenter.at<float>(2);
+	}
+
+	fstream mapFileFd;
+	bool changed = false;
+
+	for (auto &chunk: mapChunks) {
+		// Distance from the camera to the bounding box of the chunk
+		const float
+			dx = std::max(std::max(chunk.minX - x, x - chunk.maxX), 0.0f),
+			dy = std::max(std::max(chunk.minY - y, y - chunk.maxY), 0.0f),
+			dz = std::max(std::max(chunk.minZ - z, z - chunk.maxZ), 0.0f),
+			dist = sqrtf(dx*dx + dy*dy + dz*dz);
+
+		if (chunk.loaded==false and dist <= chunkLoadRadius) {
+			if (!mapFileFd.is_open()) {
+				mapFileFd.open (chunkedMapFile.c_str(), fstream::in | fstream::binary);
+				if (!mapFileFd.is_open())
+					throw BadMapFile();
+			}
+			loadChunk (chunk, mapFileFd);
+			changed = true;
+		}
+		else if (chunk.loaded==true and dist > chunkEvictRadius) {
+			evictChunk (chunk, evictedKeyFrames, evictedMapPoints);
+			changed = true;
+		}
+	}
+
+	if (changed)
+		relinkResidentObjects();
+	return changed;
+}
+
+
+void Map::releaseEvicted (set<KeyFrame*> &evictedKeyFrames, set<MapPoint*> &evictedMapPoints)
+{
+	for (MapPoint *mp: evictedMapPoints)
+		delete (mp);
+	for (KeyFrame *kf: evictedKeyFrames)
+		delete (kf);
+	evictedMapPoints.clear();
+	evictedKeyFrames.clear();
 }
 
 
@@ -356,6 +726,10 @@ Map::getNearestKeyFrame (const Eigen::Vector3f &position,
 	vector<KeyFrame*> *kfSelectors
 )
 {
+	// Chunked maps may have no resident keyframe around
+	if (!kfOctree or kfCloud->empty())
+		return NULL;
+
 	KeyFramePt queryPoint;
 	queryPoint.x = position.x(), queryPoint.y = position.y(), queryPoint.z = position.z();
 
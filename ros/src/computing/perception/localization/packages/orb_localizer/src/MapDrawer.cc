@@ -43,6 +43,9 @@ MapDrawer::MapDrawer(Map* pMap, const string &strSettingPath):mpMap(pMap)
 
 void MapDrawer::DrawMapPoints()
 {
+    // Chunk eviction deletes map points under this lock
+    unique_lock<mutex> lock(mpMap->mMutexMapUpdate);
+
     const vector<MapPoint*> &vpMPs = mpMap->GetAllMapPoints();
     const vector<MapPoint*> &vpRefMPs = mpMap->GetReferenceMapPoints();
 
@@ -86,6 +89,9 @@ void MapDrawer::DrawKeyFrames(const bool bDrawKF, const bool bDrawGraph)
     const float h = w*0.75;
     const float z = w*0.6;
 
+    // Chunk eviction deletes keyframes under this lock
+    unique_lock<mutex> lock(mpMap->mMutexMapUpdate);
+
     const vector<KeyFrame*> vpKFs = mpMap->GetAllKeyFrames();
 
     if(bDrawKF)
@@ -20,6 +20,7 @@
 
 #include "MapPoint.h"
 #include "ORBmatcher.h"
+#include "MapObjectSerialization.h"
 
 #include<mutex>
 
@@ -400,10 +401,21 @@ int MapPoint::PredictScale(const float &currentDist, const float &logScaleFactor
 }
 
 
-void MapPoint::fixConnections (Map *smap)
+void MapPoint::fixConnections (Map *smap, bool keepIdList)
 {
 	mpMap = smap;
 	mpReplaced = MapPoint::objectListLookup [ MapPoint::mpReplacement[this->mnId] ];
+
+	// Observing keyframes may have been loaded after this point
+	{
+		unique_lock<mutex> lock(mMutexFeatures);
+		mObservations = createObjectList<KeyFrame> (_kfObservation);
+		map<idtype, KeyFrame*>::const_iterator refKf = KeyFrame::objectListLookup.find (_refKfId);
+		mpRefKF = (refKf==KeyFrame::objectListLookup.end()) ? NULL : refKf->second;
+	}
+
+	if (keepIdList==false)
+		_kfObservation.clear();
 }
 
 
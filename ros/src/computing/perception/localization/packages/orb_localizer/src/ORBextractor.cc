@@ -768,16 +768,30 @@ void ORBextractor::ComputeKeyPointsOctTree(vector<vector<KeyPoint> >& allKeypoin
 
     const float W = 30;
 
+    // FAST cells of all levels form a single work list, so large levels are
+    // split among threads instead of keeping one thread busy per level.
+    // Every cell writes to its own buffer; the buffers are concatenated in
+    // the serial row-major order afterwards, so the result does not depend
+    // on the number of threads.
+    struct FastCell
+    {
+        int level;
+        int iniX, maxX, iniY, maxY;
+        int offX, offY;
+    };
+
+    vector<FastCell> vCells;
+    vector<int> vLevelFirstCell(nlevels+1,0);
+
     for (int level = 0; level < nlevels; ++level)
     {
+        vLevelFirstCell[level] = vCells.size();
+
         const int minBorderX = EDGE_THRESHOLD-3;
         const int minBorderY = minBorderX;
         const int maxBorderX = mvImagePyramid[level].cols-EDGE_THRESHOLD+3;
         const int maxBorderY = mvImagePyramid[level].rows-EDGE_THRESHOLD+3;
 
-        vector<cv::KeyPoint> vToDistributeKeys;
-        vToDistributeKeys.reserve(nfeatures*10);
-
         const float width = (maxBorderX-minBorderX);
         const float height = (maxBorderY-minBorderY);
 
@@ -805,31 +819,59 @@ void ORBextractor::ComputeKeyPointsOctTree(vector<vector<KeyPoint> >& allKeypoin
                 if(maxX>maxBorderX)
                     maxX = maxBorderX;
 
-                vector<cv::KeyPoint> vKeysCell;
-                FAST(mvImagePyramid[level].rowRange(iniY,maxY).colRange(iniX,maxX),
-                     vKeysCell,iniThFAST,true);
+                FastCell cell;
+                cell.level = level;
+                cell.iniX = iniX;
+                cell.maxX = maxX;
+                cell.iniY = iniY;
+                cell.maxY = maxY;
+                cell.offX = j*wCell;
+                cell.offY = i*hCell;
+                vCells.push_back(cell);
+            }
+        }
+    }
+    vLevelFirstCell[nlevels] = vCells.size();
 
-                if(vKeysCell.empty())
-                {
-                    FAST(mvImagePyramid[level].rowRange(iniY,maxY).colRange(iniX,maxX),
-                         vKeysCell,minThFAST,true);
-                }
+    vector<vector<cv::KeyPoint> > vCellKeys(vCells.size());
 
-                if(!vKeysCell.empty())
-                {
-                    for(vector<cv::KeyPoint>::iterator vit=vKeysCell.begin(); vit!=vKeysCell.end();vit++)
-                    {
-                        (*vit).pt.x+=j*wCell;
-                        (*vit).pt.y+=i*hCell;
-                        vToDistributeKeys.push_back(*vit);
-                    }
-                }
+    #pragma omp parallel for schedule(dynamic,16)
+    for(int c=0; c<(int)vCells.size(); c++)
+    {
+        const FastCell &cell = vCells[c];
+        const Mat cellImage = mvImagePyramid[cell.level].rowRange(cell.iniY,cell.maxY).colRange(cell.iniX,cell.maxX);
+        vector<cv::KeyPoint> &vKeysCell = vCellKeys[c];
 
-            }
+        FAST(cellImage,vKeysCell,iniThFAST,true);
+
+        if(vKeysCell.empty())
+            FAST(cellImage,vKeysCell,minThFAST,true);
+
+        for(vector<cv::KeyPoint>::iterator vit=vKeysCell.begin(); vit!=vKeysCell.end();vit++)
+        {
+            (*vit).pt.x+=cell.offX;
+            (*vit).pt.y+=cell.offY;
         }
+    }
+
+    #pragma omp parallel for schedule(dynamic,1)
+    for (int level = 0; level < nlevels; ++level)
+    {
+        const int minBorderX = EDGE_THRESHOLD-3;
+        const int minBorderY = minBorderX;
+        const int maxBorderX = mvImagePyramid[level].cols-EDGE_THRESHOLD+3;
+        const int maxBorderY = mvImagePyramid[level].rows-EDGE_THRESHOLD+3;
+
+        size_t nToDistribute = 0;
+        for(int c=vLevelFirstCell[level]; c<vLevelFirstCell[level+1]; c++)
+            nToDistribute += vCellKeys[c].size();
+
+        vector<cv::KeyPoint> vToDistributeKeys;
+        vToDistributeKeys.reserve(nToDistribute);
+        for(int c=vLevelFirstCell[level]; c<vLevelFirstCell[level+1]; c++)
+            vToDistributeKeys.insert(vToDistributeKeys.end(), vCellKeys[c].begin(), vCellKeys[c].end());
 
         vector<KeyPoint> & keypoints = allKeypoints[level];
-        keypoints.reserve(nfeatures);
 
         keypoints = DistributeOctTree(vToDistributeKeys, minBorderX, maxBorderX,
                                       minBorderY, maxBorderY,mnFeaturesPerLevel[level], level);
@@ -845,11 +887,10 @@ void ORBextractor::ComputeKeyPointsOctTree(vector<vector<KeyPoint> >& allKeypoin
             keypoints[i].octave=level;
             keypoints[i].size = scaledPatchSize;
         }
-    }
 
-    // compute orientations
-    for (int level = 0; level < nlevels; ++level)
-        computeOrientation(mvImagePyramid[level], allKeypoints[level], umax);
+        // compute orientations
+        computeOrientation(mvImagePyramid[level], keypoints, umax);
+    }
 }
 
 void ORBextractor::ComputeKeyPointsOld(std::vector<std::vector<KeyPoint> > &allKeypoints)
@@ -1069,10 +1110,13 @@ void ORBextractor::operator()( InputArray _image, InputArray _mask, vector<KeyPo
         descriptors = _descriptors.getMat();
     }
 
-    _keypoints.clear();
-    _keypoints.reserve(nkeypoints);
+    // Descriptor rows of every level are fixed by the keypoint counts, so
+    // levels can be blurred and described independently
+    vector<int> vLevelOffset(nlevels+1,0);
+    for (int level = 0; level < nlevels; ++level)
+        vLevelOffset[level+1] = vLevelOffset[level] + (int)allKeypoints[level].size();
 
-    int offset = 0;
+    #pragma omp parallel for schedule(dynamic,1)
     for (int level = 0; level < nlevels; ++level)
     {
         vector<KeyPoint>& keypoints = allKeypoints[level];
@@ -1086,11 +1130,9 @@ void ORBextractor::operator()( InputArray _image, InputArray _mask, vector<KeyPo
         GaussianBlur(workingMat, workingMat, Size(7, 7), 2, 2, BORDER_REFLECT_101);
 
         // Compute the descriptors
-        Mat desc = descriptors.rowRange(offset, offset + nkeypointsLevel);
+        Mat desc = descriptors.rowRange(vLevelOffset[level], vLevelOffset[level] + nkeypointsLevel);
         computeDescriptors(workingMat, keypoints, desc, pattern);
 
-        offset += nkeypointsLevel;
-
         // Scale keypoint coordinates
         if (level != 0)
         {
@@ -1099,9 +1141,13 @@ void ORBextractor::operator()( InputArray _image, InputArray _mask, vector<KeyPo
                  keypointEnd = keypoints.end(); keypoint != keypointEnd; ++keypoint)
                 keypoint->pt *= scale;
         }
-        // And add the keypoints to the output
-        _keypoints.insert(_keypoints.end(), keypoints.begin(), keypoints.end());
     }
+
+    // And add the keypoints to the output
+    _keypoints.clear();
+    _keypoints.reserve(nkeypoints);
+    for (int level = 0; level < nlevels; ++level)
+        _keypoints.insert(_keypoints.end(), allKeypoints[level].begin(), allKeypoints[level].end());
 }
 
 void ORBextractor::ComputePyramid(cv::Mat image)
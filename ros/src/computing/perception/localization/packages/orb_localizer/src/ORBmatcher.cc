@@ -21,6 +21,7 @@
 #include "ORBmatcher.h"
 
 #include<limits.h>
+#include<string.h>
 
 #include<opencv2/core/core.hpp>
 #include<opencv2/features2d/features2d.hpp>
@@ -29,11 +30,141 @@
 
 #include<stdint-gcc.h>
 
+#if defined(__GNUC__) && defined(__x86_64__)
+#include<immintrin.h>
+#endif
+
 using namespace std;
 
 namespace ORB_SLAM2
 {
 
+namespace
+{
+
+inline uint64_t load64(const unsigned char *p)
+{
+    uint64_t v;
+    memcpy(&v, p, sizeof(v));
+    return v;
+}
+
+#ifdef __POPCNT__
+inline int popcount64(uint64_t v)
+{
+    return __builtin_popcountll(v);
+}
+#else
+inline int popcount64(uint64_t v)
+{
+    v = v - ((v >> 1) & 0x5555555555555555ULL);
+    v = (v & 0x3333333333333333ULL) + ((v >> 2) & 0x3333333333333333ULL);
+    return (int)((((v + (v >> 4)) & 0x0F0F0F0F0F0F0F0FULL) * 0x0101010101010101ULL) >> 56);
+}
+#endif
+
+typedef void (*DistanceKernel)(const unsigned char*, const unsigned char*, size_t, const int*, int, int*);
+
+void distancesGeneric(const unsigned char *q, const unsigned char *base, size_t step,
+                      const int *rows, int n, int *dist)
+{
+    const uint64_t q0=load64(q), q1=load64(q+8), q2=load64(q+16), q3=load64(q+24);
+
+    for(int i=0; i<n; i++)
+    {
+        const unsigned char *d = base + rows[i]*step;
+        dist[i] = popcount64(q0^load64(d)) + popcount64(q1^load64(d+8)) +
+                  popcount64(q2^load64(d+16)) + popcount64(q3^load64(d+24));
+    }
+}
+
+#if defined(__GNUC__) && defined(__x86_64__)
+
+// Same loop compiled for the POPCNT instruction, selected at runtime
+__attribute__((target("popcnt")))
+void distancesPopcnt(const unsigned char *q, const unsigned char *base, size_t step,
+                     const int *rows, int n, int *dist)
+{
+    const uint64_t q0=load64(q), q1=load64(q+8), q2=load64(q+16), q3=load64(q+24);
+
+    for(int i=0; i<n; i++)
+    {
+        const unsigned char *d = base + rows[i]*step;
+        dist[i] = __builtin_popcountll(q0^load64(d)) + __builtin_popcountll(q1^load64(d+8)) +
+                  __builtin_popcountll(q2^load64(d+16)) + __builtin_popcountll(q3^load64(d+24));
+    }
+}
+
+// Per-byte popcount of (q xor d) with the nibble lookup trick, then summed into
+// four 64-bit lanes. Every lane is at most 64.
+__attribute__((target("avx2")))
+inline __m256i xorCountAVX2(const __m256i q, const unsigned char *d)
+{
+    const __m256i lut = _mm256_setr_epi8(0,1,1,2,1,2,2,3,1,2,2,3,2,3,3,4,
+                                         0,1,1,2,1,2,2,3,1,2,2,3,2,3,3,4);
+    const __m256i lowMask = _mm256_set1_epi8(0x0f);
+
+    const __m256i x = _mm256_xor_si256(q, _mm256_loadu_si256(reinterpret_cast<const __m256i*>(d)));
+    const __m256i lo = _mm256_shuffle_epi8(lut, _mm256_and_si256(x, lowMask));
+    const __m256i hi = _mm256_shuffle_epi8(lut, _mm256_and_si256(_mm256_srli_epi16(x, 4), lowMask));
+    return _mm256_sad_epu8(_mm256_add_epi8(lo, hi), _mm256_setzero_si256());
+}
+
+__attribute__((target("avx2")))
+inline uint64_t horizontalSumAVX2(const __m256i v)
+{
+    const __m128i s = _mm_add_epi64(_mm256_castsi256_si128(v), _mm256_extracti128_si256(v, 1));
+    return (uint64_t)_mm_cvtsi128_si64(s) + (uint64_t)_mm_extract_epi64(s, 1);
+}
+
+// Four candidates at a time: their lane sums are packed into separate 16-bit
+// fields of one register so a single horizontal add yields all four distances.
+__attribute__((target("avx2")))
+void distancesAVX2(const unsigned char *q, const unsigned char *base, size_t step,
+                   const int *rows, int n, int *dist)
+{
+    const __m256i vq = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(q));
+
+    int i=0;
+    for(; i+4<=n; i+=4)
+    {
+        __m256i s = xorCountAVX2(vq, base + rows[i]*step);
+        s = _mm256_add_epi64(s, _mm256_slli_epi64(xorCountAVX2(vq, base + rows[i+1]*step), 16));
+        s = _mm256_add_epi64(s, _mm256_slli_epi64(xorCountAVX2(vq, base + rows[i+2]*step), 32));
+        s = _mm256_add_epi64(s, _mm256_slli_epi64(xorCountAVX2(vq, base + rows[i+3]*step), 48));
+
+        const uint64_t total = horizontalSumAVX2(s);
+        dist[i]   = (int)(total & 0xffff);
+        dist[i+1] = (int)((total >> 16) & 0xffff);
+        dist[i+2] = (int)((total >> 32) & 0xffff);
+        dist[i+3] = (int)(total >> 48);
+    }
+
+    for(; i<n; i++)
+        dist[i] = (int)horizontalSumAVX2(xorCountAVX2(vq, base + rows[i]*step));
+}
+
+DistanceKernel selectDistanceKernel()
+{
+    __builtin_cpu_init();
+    if(__builtin_cpu_supports("avx2"))
+        return distancesAVX2;
+    if(__builtin_cpu_supports("popcnt"))
+        return distancesPopcnt;
+    return distancesGeneric;
+}
+
+#else
+
+DistanceKernel selectDistanceKernel()
+{
+    return distancesGeneric;
+}
+
+#endif
+
+} // anonymous namespace
+
 const int ORBmatcher::TH_HIGH = 100;
 const int ORBmatcher::TH_LOW = 50;
 const int ORBmatcher::HISTO_LENGTH = 30;
@@ -48,6 +179,8 @@ int ORBmatcher::SearchByProjection(Frame &F, const vector<MapPoint*> &vpMapPoint
 
     const bool bFactor = th!=1.0;
 
+    vector<int> vCandidates, vDistances;
+
     for(size_t iMP=0; iMP<vpMapPoints.size(); iMP++)
     {
         MapPoint* pMP = vpMapPoints[iMP];
@@ -73,13 +206,7 @@ int ORBmatcher::SearchByProjection(Frame &F, const vector<MapPoint*> &vpMapPoint
 
         const cv::Mat MPdescriptor = pMP->GetDescriptor();
 
-        int bestDist=256;
-        int bestLevel= -1;
-        int bestDist2=256;
-        int bestLevel2 = -1;
-        int bestIdx =-1 ;
-
-        // Get best and second matches with near keypoints
+        vCandidates.clear();
         for(vector<size_t>::const_iterator vit=vIndices.begin(), vend=vIndices.end(); vit!=vend; vit++)
         {
             const size_t idx = *vit;
@@ -95,9 +222,26 @@ int ORBmatcher::SearchByProjection(Frame &F, const vector<MapPoint*> &vpMapPoint
                     continue;
             }
 
-            const cv::Mat &d = F.mDescriptors.row(idx);
+            vCandidates.push_back(idx);
+        }
+
+        if(vCandidates.empty())
+            continue;
+
+        vDistances.resize(vCandidates.size());
+        DescriptorDistances(MPdescriptor.ptr<unsigned char>(),F.mDescriptors,&vCandidates[0],vCandidates.size(),&vDistances[0]);
+
+        int bestDist=256;
+        int bestLevel= -1;
+        int bestDist2=256;
+        int bestLevel2 = -1;
+        int bestIdx =-1 ;
 
-            const int dist = DescriptorDistance(MPdescriptor,d);
+        // Get best and second matches with near keypoints
+        for(size_t k=0; k<vCandidates.size(); k++)
+        {
+            const int idx = vCandidates[k];
+            const int dist = vDistances[k];
 
             if(dist<bestDist)
             {
@@ -171,6 +315,8 @@ int ORBmatcher::SearchByBoW(KeyFrame* pKF,Frame &F, vector<MapPoint*> &vpMapPoin
         rotHist[i].reserve(500);
     const float factor = 1.0f/HISTO_LENGTH;
 
+    vector<int> vCandidates, vDistances;
+
     // We perform the matching over ORB that belong to the same vocabulary node (at a certain level)
     DBoW2::FeatureVector::const_iterator KFit = vFeatVecKF.begin();
     DBoW2::FeatureVector::const_iterator Fit = F.mFeatVec.begin();
@@ -181,8 +327,8 @@ int ORBmatcher::SearchByBoW(KeyFrame* pKF,Frame &F, vector<MapPoint*> &vpMapPoin
     {
         if(KFit->first == Fit->first)
         {
-            const vector<unsigned int> vIndicesKF = KFit->second;
-            const vector<unsigned int> vIndicesF = Fit->second;
+            const vector<unsigned int> &vIndicesKF = KFit->second;
+            const vector<unsigned int> &vIndicesF = Fit->second;
 
             for(size_t iKF=0; iKF<vIndicesKF.size(); iKF++)
             {
@@ -196,12 +342,7 @@ int ORBmatcher::SearchByBoW(KeyFrame* pKF,Frame &F, vector<MapPoint*> &vpMapPoin
                 if(pMP->isBad())
                     continue;                
 
-                const cv::Mat &dKF= pKF->mDescriptors.row(realIdxKF);
-
-                int bestDist1=256;
-                int bestIdxF =-1 ;
-                int bestDist2=256;
-
+                vCandidates.clear();
                 for(size_t iF=0; iF<vIndicesF.size(); iF++)
                 {
                     const unsigned int realIdxF = vIndicesF[iF];
@@ -209,9 +350,23 @@ int ORBmatcher::SearchByBoW(KeyFrame* pKF,Frame &F, vector<MapPoint*> &vpMapPoin
                     if(vpMapPointMatches[realIdxF])
                         continue;
 
-                    const cv::Mat &dF = F.mDescriptors.row(realIdxF);
+                    vCandidates.push_back(realIdxF);
+                }
 
-                    const int dist =  DescriptorDistance(dKF,dF);
+                if(vCandidates.empty())
+                    continue;
+
+                vDistances.resize(vCandidates.size());
+                DescriptorDistances(pKF->mDescriptors.ptr<unsigned char>(realIdxKF),F.mDescriptors,&vCandidates[0],vCandidates.size(),&vDistances[0]);
+
+                int bestDist1=256;
+                int bestIdxF =-1 ;
+                int bestDist2=256;
+
+                for(size_t k=0; k<vCandidates.size(); k++)
+                {
+                    const int realIdxF = vCandidates[k];
+                    const int dist = vDistances[k];
 
                     if(dist<bestDist1)
                     {
@@ -415,6 +570,8 @@ int ORBmatcher::SearchForInitialization(Frame &F1, Frame &F2, vector<cv::Point2f
     vector<int> vMatchedDistance(F2.mvKeysUn.size(),INT_MAX);
     vector<int> vnMatches21(F2.mvKeysUn.size(),-1);
 
+    vector<int> vCandidates, vDistances;
+
     for(size_t i1=0, iend1=F1.mvKeysUn.size(); i1<iend1; i1++)
     {
         cv::KeyPoint kp1 = F1.mvKeysUn[i1];
@@ -427,19 +584,18 @@ int ORBmatcher::SearchForInitialization(Frame &F1, Frame &F2, vector<cv::Point2f
         if(vIndices2.empty())
             continue;
 
-        cv::Mat d1 = F1.mDescriptors.row(i1);
+        vCandidates.assign(vIndices2.begin(),vIndices2.end());
+        vDistances.resize(vCandidates.size());
+        DescriptorDistances(F1.mDescriptors.ptr<unsigned char>(i1),F2.mDescriptors,&vCandidates[0],vCandidates.size(),&vDistances[0]);
 
         int bestDist = INT_MAX;
         int bestDist2 = INT_MAX;
         int bestIdx2 = -1;
 
-        for(vector<size_t>::iterator vit=vIndices2.begin(); vit!=vIndices2.end(); vit++)
+        for(size_t k=0; k<vCandidates.size(); k++)
         {
-            size_t i2 = *vit;
-
-            cv::Mat d2 = F2.mDescriptors.row(i2);
-
-            int dist = DescriptorDistance(d1,d2);
+            const int i2 = vCandidates[k];
+            const int dist = vDistances[k];
 
             if(vMatchedDistance[i2]<=dist)
                 continue;
@@ -542,6 +698,8 @@ int ORBmatcher::SearchByBoW(KeyFrame *pKF1, KeyFrame *pKF2, vector<MapPoint *> &
 
     int nmatches = 0;
 
+    vector<int> vCandidates, vDistances;
+
     DBoW2::FeatureVector::const_iterator f1it = vFeatVec1.begin();
     DBoW2::FeatureVector::const_iterator f2it = vFeatVec2.begin();
     DBoW2::FeatureVector::const_iterator f1end = vFeatVec1.end();
@@ -561,12 +719,7 @@ int ORBmatcher::SearchByBoW(KeyFrame *pKF1, KeyFrame *pKF2, vector<MapPoint *> &
                 if(pMP1->isBad())
                     continue;
 
-                const cv::Mat &d1 = Descriptors1.row(idx1);
-
-                int bestDist1=256;
-                int bestIdx2 =-1 ;
-                int bestDist2=256;
-
+                vCandidates.clear();
                 for(size_t i2=0, iend2=f2it->second.size(); i2<iend2; i2++)
                 {
                     const size_t idx2 = f2it->second[i2];
@@ -579,9 +732,23 @@ int ORBmatcher::SearchByBoW(KeyFrame *pKF1, KeyFrame *pKF2, vector<MapPoint *> &
                     if(pMP2->isBad())
                         continue;
 
-                    const cv::Mat &d2 = Descriptors2.row(idx2);
+                    vCandidates.push_back(idx2);
+                }
+
+                if(vCandidates.empty())
+                    continue;
+
+                vDistances.resize(vCandidates.size());
+                DescriptorDistances(Descriptors1.ptr<unsigned char>(idx1),Descriptors2,&vCandidates[0],vCandidates.size(),&vDistances[0]);
 
-                    int dist = DescriptorDistance(d1,d2);
+                int bestDist1=256;
+                int bestIdx2 =-1 ;
+                int bestDist2=256;
+
+                for(size_t k=0; k<vCandidates.size(); k++)
+                {
+                    const int idx2 = vCandidates[k];
+                    const int dist = vDistances[k];
 
                     if(dist<bestDist1)
                     {
@@ -1348,6 +1515,8 @@ int ORBmatcher::SearchByProjection(Frame &CurrentFrame, const Frame &LastFrame,
     const bool bForward = tlc.at<float>(2)>CurrentFrame.mb && !bMono;
     const bool bBackward = -tlc.at<float>(2)>CurrentFrame.mb && !bMono;
 
+    vector<int> vCandidates, vDistances;
+
     for(int i=0; i<LastFrame.N; i++)
     {
         MapPoint* pMP = LastFrame.mvpMapPoints[i];
@@ -1394,9 +1563,7 @@ int ORBmatcher::SearchByProjection(Frame &CurrentFrame, const Frame &LastFrame,
 
                 const cv::Mat dMP = pMP->GetDescriptor();
 
-                int bestDist = 256;
-                int bestIdx2 = -1;
-
+                vCandidates.clear();
                 for(vector<size_t>::const_iterator vit=vIndices2.begin(), vend=vIndices2.end(); vit!=vend; vit++)
                 {
                     const size_t i2 = *vit;
@@ -1412,14 +1579,24 @@ int ORBmatcher::SearchByProjection(Frame &CurrentFrame, const Frame &LastFrame,
                             continue;
                     }
 
-                    const cv::Mat &d = CurrentFrame.mDescriptors.row(i2);
+                    vCandidates.push_back(i2);
+                }
+
+                if(vCandidates.empty())
+                    continue;
+
+                vDistances.resize(vCandidates.size());
+                DescriptorDistances(dMP.ptr<unsigned char>(),CurrentFrame.mDescriptors,&vCandidates[0],vCandidates.size(),&vDistances[0]);
 
-                    const int dist = DescriptorDistance(dMP,d);
+                int bestDist = 256;
+                int bestIdx2 = -1;
 
-                    if(dist<bestDist)
+                for(size_t k=0; k<vCandidates.size(); k++)
+                {
+                    if(vDistances[k]<bestDist)
                     {
-                        bestDist=dist;
-                        bestIdx2=i2;
+                        bestDist=vDistances[k];
+                        bestIdx2=vCandidates[k];
                     }
                 }
 
@@ -1485,6 +1662,8 @@ int ORBmatcher::SearchByProjection(Frame &CurrentFrame, KeyFrame *pKF, const set
 
     const vector<MapPoint*> vpMPs = pKF->GetMapPointMatches();
 
+    vector<int> vCandidates, vDistances;
+
     for(size_t i=0, iend=vpMPs.size(); i<iend; i++)
     {
         MapPoint* pMP = vpMPs[i];
@@ -1532,23 +1711,31 @@ int ORBmatcher::SearchByProjection(Frame &CurrentFrame, KeyFrame *pKF, const set
 
                 const cv::Mat dMP = pMP->GetDescriptor();
 
-                int bestDist = 256;
-                int bestIdx2 = -1;
-
+                vCandidates.clear();
                 for(vector<size_t>::const_iterator vit=vIndices2.begin(); vit!=vIndices2.end(); vit++)
                 {
                     const size_t i2 = *vit;
                     if(CurrentFrame.mvpMapPoints[i2])
                         continue;
 
-                    const cv::Mat &d = CurrentFrame.mDescriptors.row(i2);
+                    vCandidates.push_back(i2);
+                }
+
+                if(vCandidates.empty())
+                    continue;
+
+                vDistances.resize(vCandidates.size());
+                DescriptorDistances(dMP.ptr<unsigned char>(),CurrentFrame.mDescriptors,&vCandidates[0],vCandidates.size(),&vDistances[0]);
 
-                    const int dist = DescriptorDistance(dMP,d);
+                int bestDist = 256;
+                int bestIdx2 = -1;
 
-                    if(dist<bestDist)
+                for(size_t k=0; k<vCandidates.size(); k++)
+                {
+                    if(vDistances[k]<bestDist)
                     {
-                        bestDist=dist;
-                        bestIdx2=i2;
+                        bestDist=vDistances[k];
+                        bestIdx2=vCandidates[k];
                     }
                 }
 
@@ -1646,20 +1833,27 @@ void ORBmatcher::ComputeThreeMaxima(vector<int>* histo, const int L, int &ind1,
 // http://graphics.stanford.edu/~seander/bithacks.html#CountBitsSetParallel
 int ORBmatcher::DescriptorDistance(const cv::Mat &a, const cv::Mat &b)
 {
-    const int *pa = a.ptr<int32_t>();
-    const int *pb = b.ptr<int32_t>();
+    return DescriptorDistance(a.ptr<unsigned char>(), b.ptr<unsigned char>());
+}
 
+int ORBmatcher::DescriptorDistance(const unsigned char *a, const unsigned char *b)
+{
     int dist=0;
 
-    for(int i=0; i<8; i++, pa++, pb++)
-    {
-        unsigned  int v = *pa ^ *pb;
-        v = v - ((v >> 1) & 0x55555555);
-        v = (v & 0x33333333) + ((v >> 2) & 0x33333333);
-        dist += (((v + (v >> 4)) & 0xF0F0F0F) * 0x1010101) >> 24;
-    }
+    for(int i=0; i<4; i++)
+        dist += popcount64(load64(a+8*i) ^ load64(b+8*i));
 
     return dist;
 }
 
+void ORBmatcher::DescriptorDistances(const unsigned char *query, const cv::Mat &descriptors,
+                                     const int *rows, const int n, int *dist)
+{
+    if(n<=0)
+        return;
+
+    static const DistanceKernel kernel = selectDistanceKernel();
+    kernel(query, descriptors.ptr<unsigned char>(), descriptors.step[0], rows, n, dist);
+}
+
 } //namespace ORB_SLAM
@@ -72,7 +72,7 @@ System::System(const string &strVocFile, const string &strSettingsFile, const eS
     mpVocabulary = new ORBVocabulary();
     if (opMode==MAPPING and strVocFile.empty() == false) {
     	cout << endl << "Loading Generic ORB Vocabulary..." << endl;
-		bool bVocLoad = mpVocabulary->loadFromTextFile(strVocFile);
+		bool bVocLoad = mpVocabulary->loadFromFile(strVocFile);
 		if(!bVocLoad)
 		{
 			cerr << "Wrong path to vocabulary. " << endl;
@@ -84,11 +84,11 @@ System::System(const string &strVocFile, const string &strSettingsFile, const eS
     else {
     	cout << endl << "Loading Custom ORB Vocabulary... " ;
     	string mapVoc = mapFileName + ".voc";
-    	bool vocload = mpVocabulary->loadFromTextFile (mapVoc);
+    	bool vocload = mpVocabulary->loadFromFile (mapVoc);
 		if(!vocload)
 		{
 			cerr << "Failed. Falling back to generic... " << endl;
-			vocload = mpVocabulary->loadFromTextFile (strVocFile);
+			vocload = mpVocabulary->loadFromFile (strVocFile);
 			if (vocload==false) {
 				cerr << "Failed to open at: " << strVocFile << endl;
 				exit(-1);
@@ -103,6 +103,11 @@ System::System(const string &strVocFile, const string &strSettingsFile, const eS
 
     //Create the Map
     mpMap = new Map();
+    if (opMode==LOCALIZATION) {
+    	mpMap->setActiveRegion (
+    		(float)fsSettings["Map.ChunkLoadRadius"],
+    		(float)fsSettings["Map.ChunkEvictRadius"]);
+    }
     try {
     	cout << "Loading map..." << endl;
     	mpMap->loadFromDisk (mapFileName, mpKeyFrameDatabase);
@@ -182,6 +187,9 @@ cv::Mat System::TrackStereo(const cv::Mat &imLeft, const cv::Mat &imRight, const
     }
     }
 
+    if (opMode==LOCALIZATION)
+        UpdateMapRegion();
+
     return mpTracker->GrabImageStereo(imLeft,imRight,timestamp);
 }
 
@@ -204,6 +212,9 @@ cv::Mat System::TrackRGBD(const cv::Mat &im, const cv::Mat &depthmap, const doub
     }
     }
 
+    if (opMode==LOCALIZATION)
+        UpdateMapRegion();
+
     return mpTracker->GrabImageRGBD(im,depthmap,timestamp);
 }
 
@@ -226,6 +237,9 @@ cv::Mat System::TrackMonocular(const cv::Mat &im, const double &timestamp)
     }
     }
 
+    if (opMode==LOCALIZATION)
+        UpdateMapRegion();
+
     cv::Mat camPosOrb = mpTracker->GrabImageMonocular(im,timestamp);
 
     if (offlineMapping==true) {
@@ -239,6 +253,27 @@ cv::Mat System::TrackMonocular(const cv::Mat &im, const double &timestamp)
 }
 
 
+void System::UpdateMapRegion()
+{
+    if (!mpMap->isChunked())
+        return;
+
+    cv::Mat cameraCenter;
+    if (mpTracker->trackingIsGood())
+        cameraCenter = mpTracker->mCurrentFrame.GetCameraCenter();
+
+    set<KeyFrame*> evictedKeyFrames;
+    set<MapPoint*> evictedMapPoints;
+
+    unique_lock<mutex> lock(mpMap->mMutexMapUpdate);
+    if (mpMap->updateActiveRegion(cameraCenter, evictedKeyFrames, evictedMapPoints))
+    {
+        mpTracker->ForgetMapObjects(evictedKeyFrames, evictedMapPoints);
+        mpMap->releaseEvicted(evictedKeyFrames, evictedMapPoints);
+    }
+}
+
+
 void System::Reset()
 {
     unique_lock<mutex> lock(mMutexReset);
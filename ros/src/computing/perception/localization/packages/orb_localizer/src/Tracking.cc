@@ -34,6 +34,7 @@
 #include"PnPsolver.h"
 
 #include<iostream>
+#include<algorithm>
 
 #include<mutex>
 
@@ -159,6 +160,43 @@ void Tracking::setMapLoaded()
 }
 
 
+void Tracking::ForgetMapObjects (const set<KeyFrame*> &keyframes, const set<MapPoint*> &mappoints)
+{
+	Frame *frames[] = {&mCurrentFrame, &mLastFrame, &mInitialFrame};
+	for (Frame *frame: frames) {
+		for (MapPoint* &pMP: frame->mvpMapPoints) {
+			if (pMP!=NULL and mappoints.count(pMP))
+				pMP = static_cast<MapPoint*>(NULL);
+		}
+		if (keyframes.count(frame->mpReferenceKF))
+			frame->mpReferenceKF = static_cast<KeyFrame*>(NULL);
+	}
+
+	mvpLocalMapPoints.erase(
+		remove_if(mvpLocalMapPoints.begin(), mvpLocalMapPoints.end(),
+			[&mappoints](MapPoint *pMP) { return mappoints.count(pMP)!=0; }),
+		mvpLocalMapPoints.end());
+	mvpLocalKeyFrames.erase(
+		remove_if(mvpLocalKeyFrames.begin(), mvpLocalKeyFrames.end(),
+			[&keyframes](KeyFrame *pKF) { return keyframes.count(pKF)!=0; }),
+		mvpLocalKeyFrames.end());
+
+	for (KeyFrame* &pKF: mlpReferences) {
+		if (keyframes.count(pKF))
+			pKF = static_cast<KeyFrame*>(NULL);
+	}
+
+	if (keyframes.count(mpLastKeyFrame))
+		mpLastKeyFrame = static_cast<KeyFrame*>(NULL);
+
+	if (keyframes.count(mpReferenceKF)) {
+		mpReferenceKF = static_cast<KeyFrame*>(NULL);
+		mVelocity = cv::Mat();
+		mState = LOST;
+	}
+}
+
+
 void Tracking::SetLocalMapper(LocalMapping *pLocalMapper)
 {
     mpLocalMapper=pLocalMapper;
@@ -13,6 +13,7 @@
 #include <sensor_msgs/PointCloud2.h>
 #include <visualization_msgs/Marker.h>
 #include <visualization_msgs/MarkerArray.h>
+#include <vector>
 
 using namespace grid_map;
 
@@ -32,6 +33,7 @@ private:
   double tf_x_;
   double tf_z_;
   double map_x_offset_;
+  double field_cutoff_;
   GridMap map_;
   class ObstacleFieldParameter {
   public:
@@ -51,12 +53,58 @@ private:
     double around_x;
     double around_y;
   };
+  // Tabulated exp(-d^2 / (2 * variance)^2) for one axis, zero beyond the
+  // field cutoff so that an obstacle only touches a bounded region.
+  // Distances are rounded to the nearest sample, every resolution / 16.
+  class GaussianTable {
+  public:
+    GaussianTable() : step(0.0), max_distance(0.0) {}
+    void build(double variance, double cutoff, double resolution);
+    double at(double d) const {
+      size_t i = static_cast<size_t>(std::fabs(d) / step + 0.5);
+      return i < values.size() ? values[i] : 0.0;
+    }
+    double step;
+    double max_distance;
+    std::vector<double> values;
+  };
+  // Obstacle pose with its rotation evaluated once and the range of grid
+  // cells its field can reach.
+  class ObstacleFootprint {
+  public:
+    double pos_x;
+    double pos_y;
+    double len_x;
+    double len_y;
+    double cos_yaw;
+    double sin_yaw;
+    int start_x;
+    int end_x;
+    int start_y;
+    int end_y;
+  };
+  // Cell range that can be touched by one vscan point.
+  class PointFootprint {
+  public:
+    double pos_x;
+    double pos_y;
+    int start_x;
+    int end_x;
+    int start_y;
+    int end_y;
+  };
+  ObstacleFieldParameter obstacle_param_;
+  GaussianTable obstacle_x_table_;
+  GaussianTable obstacle_y_table_;
 
   void obj_callback(autoware_msgs::DetectedObjectArray::ConstPtr obj_msg);
   void target_waypoint_callback(
       visualization_msgs::Marker::ConstPtr target_point_msgs);
   void vscan_points_callback(sensor_msgs::PointCloud2::ConstPtr vscan_msg);
   void publish_potential_field();
+  bool get_index_range(double min_x, double max_x, double min_y, double max_y,
+                       int &start_x, int &end_x, int &start_y, int &end_y);
+  double obstacle_value(const ObstacleFootprint &obj, double x, double y);
 
 public:
   PotentialField();
@@ -97,6 +145,15 @@ PotentialField::PotentialField()
     map_x_offset_ = 10.0;
     ROS_INFO("map x offset %f", map_x_offset_);
   }
+  if (!private_nh.getParam("field_cutoff", field_cutoff_)) {
+    field_cutoff_ = 0.001;
+    ROS_INFO("field cutoff %f", field_cutoff_);
+  }
+  // The cutoff is a field value, log(cutoff) must be negative and finite.
+  if (!(field_cutoff_ > 0.0 && field_cutoff_ < 1.0)) {
+    ROS_WARN("field cutoff %f is out of (0, 1), using 0.001", field_cutoff_);
+    field_cutoff_ = 0.001;
+  }
   publisher_ =
       nh_.advertise<grid_map_msgs::GridMap>("/potential_field", 1, true);
 
@@ -124,6 +181,10 @@ void PotentialField::init() {
     map_.at("vscan_points_field", *it) = 0.0;
     map_.at("potential_field", *it) = 0.0;
   }
+  obstacle_x_table_.build(obstacle_param_.ver_x_p, field_cutoff_,
+                          map_resolution_);
+  obstacle_y_table_.build(obstacle_param_.ver_y_p, field_cutoff_,
+                          map_resolution_);
   ROS_INFO("Created map with size %f x %f m (%i x %i cells).",
            map_.getLength().x(), map_.getLength().y(), map_.getSize()(0),
            map_.getSize()(1));
@@ -141,113 +202,134 @@ void PotentialField::publish_potential_field() {
   ROS_INFO_THROTTLE(1.0, "Grid map (timestamp %f) published.",
                     message.info.header.stamp.toSec());
 }
+void PotentialField::GaussianTable::build(double variance, double cutoff,
+                                          double resolution) {
+  double sigma = 2.0 * variance;
+  max_distance = sigma * std::sqrt(-1.0 * std::log(cutoff));
+  step = resolution / 16.0;
+  values.resize(static_cast<size_t>(max_distance / step) + 1);
+  for (size_t i(0); i < values.size(); ++i) {
+    double d = i * step;
+    values[i] = std::exp(-1.0 * (d * d) / (sigma * sigma));
+  }
+}
+
+bool PotentialField::get_index_range(double min_x, double max_x, double min_y,
+                                     double max_y, int &start_x, int &end_x,
+                                     int &start_y, int &end_y) {
+  // Index 0 is at the positive end of each axis in grid_map.
+  const Position &center = map_.getPosition();
+  const Length &length = map_.getLength();
+  const Size &size = map_.getSize();
+  double resolution = map_.getResolution();
+  double top_x = center.x() + length.x() / 2.0;
+  double top_y = center.y() + length.y() / 2.0;
+
+  start_x = std::max(0, (int)std::floor((top_x - max_x) / resolution));
+  end_x = std::min(size(0) - 1, (int)std::floor((top_x - min_x) / resolution));
+  start_y = std::max(0, (int)std::floor((top_y - max_y) / resolution));
+  end_y = std::min(size(1) - 1, (int)std::floor((top_y - min_y) / resolution));
+  return start_x <= end_x && start_y <= end_y;
+}
+
+double PotentialField::obstacle_value(const ObstacleFootprint &obj, double x,
+                                      double y) {
+  double pos_x = obj.pos_x;
+  double pos_y = obj.pos_y;
+  double len_x = obj.len_x;
+  double len_y = obj.len_y;
+  double rotated_pos_x = obj.cos_yaw * (x - pos_x) +
+                         obj.sin_yaw * (y - pos_y) + pos_x;
+  double rotated_pos_y = -1.0 * obj.sin_yaw * (x - pos_x) +
+                         obj.cos_yaw * (y - pos_y) + pos_y;
+
+  const GaussianTable &gx = obstacle_x_table_;
+  const GaussianTable &gy = obstacle_y_table_;
+  if (pos_x - len_x < rotated_pos_x && rotated_pos_x < pos_x + len_x) {
+    if (pos_y - len_y < rotated_pos_y && rotated_pos_y < pos_y + len_y)
+      return std::exp(0.0);
+    else if (rotated_pos_y < pos_y - len_y)
+      return gy.at(rotated_pos_y - (pos_y - len_y));
+    else if (pos_y + len_y < rotated_pos_y)
+      return gy.at(rotated_pos_y - (pos_y + len_y));
+  } else if (rotated_pos_x < pos_x - len_x) {
+    double fx = gx.at(rotated_pos_x - (pos_x - len_x));
+    if (rotated_pos_y < pos_y - len_y)
+      return gy.at(rotated_pos_y - (pos_y - len_y)) * fx;
+    else if (pos_y + len_y < rotated_pos_y)
+      return gy.at(rotated_pos_y - (pos_y + len_y)) * fx;
+    else if (pos_y - len_y < rotated_pos_y && rotated_pos_y < pos_y + len_y)
+      return fx;
+  } else if (pos_x + len_x < rotated_pos_x) {
+    double fx = gx.at(rotated_pos_x - (pos_x + len_x));
+    if (rotated_pos_y < pos_y - len_y)
+      return gy.at(rotated_pos_y - (pos_y - len_y)) * fx;
+    else if (pos_y + len_y / 2.0 < rotated_pos_y)
+      return gy.at(rotated_pos_y - (pos_y + len_y)) * fx;
+    else if (pos_y - len_y < rotated_pos_y && rotated_pos_y < pos_y + len_y)
+      return fx;
+  }
+  return 0.0;
+}
+
 void PotentialField::obj_callback(
     autoware_msgs::DetectedObjectArray::ConstPtr obj_msg) { // Create grid map.
-  static ObstacleFieldParameter param;
-  double ver_x_p(param.ver_x_p);
-  double ver_y_p(param.ver_y_p);
-
   // Add data to grid map.
   ros::Time time = ros::Time::now();
 
-  for (GridMapIterator it(map_); !it.isPastEnd(); ++it) {
+  // Rotation and reachable cells of every obstacle, computed once.
+  std::vector<ObstacleFootprint> footprints;
+  footprints.reserve(obj_msg->objects.size());
+  for (int i(0); i < (int)obj_msg->objects.size(); ++i) {
+    ObstacleFootprint obj;
+    obj.pos_x = obj_msg->objects.at(i).pose.position.x + tf_x_ - map_x_offset_;
+    obj.pos_y = obj_msg->objects.at(i).pose.position.y;
+    obj.len_x = obj_msg->objects.at(i).dimensions.x / 2.0;
+    obj.len_y = obj_msg->objects.at(i).dimensions.y / 2.0;
 
-    Position position;
-    map_.getPosition(*it, position);
-    map_.at("obstacle_field", *it) = 0.0;
-    for (int i(0); i < (int)obj_msg->objects.size(); ++i) {
-      double pos_x =
-          obj_msg->objects.at(i).pose.position.x + tf_x_ - map_x_offset_;
-      double pos_y = obj_msg->objects.at(i).pose.position.y;
-      double len_x = obj_msg->objects.at(i).dimensions.x / 2.0;
-      double len_y = obj_msg->objects.at(i).dimensions.y / 2.0;
-
-      double r, p, y;
-      tf::Quaternion quat(obj_msg->objects.at(i).pose.orientation.x,
-                          obj_msg->objects.at(i).pose.orientation.y,
-                          obj_msg->objects.at(i).pose.orientation.z,
-                          obj_msg->objects.at(i).pose.orientation.w);
-      tf::Matrix3x3(quat).getRPY(r, p, y);
-
-      double rotated_pos_x = std::cos(-1.0 * y) * (position.x() - pos_x) -
-                             std::sin(-1.0 * y) * (position.y() - pos_y) +
-                             pos_x;
-      double rotated_pos_y = std::sin(-1.0 * y) * (position.x() - pos_x) +
-                             std::cos(-1.0 * y) * (position.y() - pos_y) +
-                             pos_y;
-
-      if (-0.5 < pos_x && pos_x < 4.0) {
-        if (-1.0 < pos_y && pos_y < 1.0)
-          continue;
-      }
-      if (pos_x - len_x < rotated_pos_x && rotated_pos_x < pos_x + len_x) {
-        if (pos_y - len_y < rotated_pos_y && rotated_pos_y < pos_y + len_y) {
-          map_.at("obstacle_field", *it) =
-              std::max(std::exp(0.0),
-                       static_cast<double>(map_.at("obstacle_field", *it)));
-        } else if (rotated_pos_y < pos_y - len_y) {
-          map_.at("obstacle_field", *it) = std::max(
-              std::exp(
-                  (-1.0 * (std::pow((rotated_pos_y - (pos_y - len_y)), 2.0) /
-                           std::pow(2.0 * ver_y_p, 2.0)))),
-              static_cast<double>(map_.at("obstacle_field", *it)));
-        } else if (pos_y + len_y < rotated_pos_y) {
-          map_.at("obstacle_field", *it) = std::max(
-              std::exp(
-                  (-1.0 * (std::pow((rotated_pos_y - (pos_y + len_y)), 2.0) /
-                           std::pow(2.0 * ver_y_p, 2.0)))),
-              static_cast<double>(map_.at("obstacle_field", *it)));
-        }
-      } else if (rotated_pos_x < pos_x - len_x) {
-        if (rotated_pos_y < pos_y - len_y) {
-          map_.at("obstacle_field", *it) = std::max(
-              std::exp(
-                  (-1.0 * (std::pow((rotated_pos_y - (pos_y - len_y)), 2.0) /
-                           std::pow(2.0 * ver_y_p, 2.0))) +
-                  (-1.0 * (std::pow((rotated_pos_x - (pos_x - len_x)), 2.0) /
-                           std::pow(2.0 * ver_x_p, 2.0)))),
-              static_cast<double>(map_.at("obstacle_field", *it)));
-        } else if (pos_y + len_y < rotated_pos_y) {
-          map_.at("obstacle_field", *it) = std::max(
-              std::exp(
-                  (-1.0 * (std::pow((rotated_pos_y - (pos_y + len_y)), 2.0) /
-                           std::pow(2.0 * ver_y_p, 2.0))) +
-                  (-1.0 * (std::pow((rotated_pos_x - (pos_x - len_x)), 2.0) /
-                           std::pow(2.0 * ver_x_p, 2.0)))),
-              static_cast<double>(map_.at("obstacle_field", *it)));
-        } else if (pos_y - len_y < rotated_pos_y &&
-                   rotated_pos_y < pos_y + len_y) {
-          map_.at("obstacle_field", *it) = std::max(
-              std::exp(
-                  (-1.0 * (std::pow((rotated_pos_x - (pos_x - len_x)), 2.0) /
-                           std::pow(2.0 * ver_x_p, 2.0)))),
-              static_cast<double>(map_.at("obstacle_field", *it)));
-        }
-      } else if (pos_x + len_x < rotated_pos_x) {
-        if (rotated_pos_y < pos_y - len_y) {
-          map_.at("obstacle_field", *it) = std::max(
-              std::exp(
-                  (-1.0 * (std::pow((rotated_pos_y - (pos_y - len_y)), 2.0) /
-                           std::pow(2.0 * ver_y_p, 2.0))) +
-                  (-1.0 * (std::pow((rotated_pos_x - (pos_x + len_x)), 2.0) /
-                           std::pow(2.0 * ver_x_p, 2.0)))),
-              static_cast<double>(map_.at("obstacle_field", *it)));
-        } else if (pos_y + len_y / 2.0 < rotated_pos_y) {
-          map_.at("obstacle_field", *it) = std::max(
-              std::exp(
-                  (-1.0 * (std::pow((rotated_pos_y - (pos_y + len_y)), 2.0) /
-                           std::pow(2.0 * ver_y_p, 2.0))) +
-                  (-1.0 * (std::pow((rotated_pos_x - (pos_x + len_x)), 2.0) /
-                           std::pow(2.0 * ver_x_p, 2.0)))),
-              static_cast<double>(map_.at("obstacle_field", *it)));
-        } else if (pos_y - len_y < rotated_pos_y &&
-                   rotated_pos_y < pos_y + len_y) {
-          map_.at("obstacle_field", *it) = std::max(
-              std::exp(
-                  (-1.0 * (std::pow((rotated_pos_x - (pos_x + len_x)), 2.0) /
-                           std::pow(2.0 * ver_x_p, 2.0)))),
-              static_cast<double>(map_.at("obstacle_field", *it)));
-        }
+    if (-0.5 < obj.pos_x && obj.pos_x < 4.0) {
+      if (-1.0 < obj.pos_y && obj.pos_y < 1.0)
+        continue;
+    }
+
+    double r, p, y;
+    tf::Quaternion quat(obj_msg->objects.at(i).pose.orientation.x,
+                        obj_msg->objects.at(i).pose.orientation.y,
+                        obj_msg->objects.at(i).pose.orientation.z,
+                        obj_msg->objects.at(i).pose.orientation.w);
+    tf::Matrix3x3(quat).getRPY(r, p, y);
+    obj.cos_yaw = std::cos(y);
+    obj.sin_yaw = std::sin(y);
+
+    // Bounding box of the rotated footprint grown by the field cutoff.
+    double half_x = obj.len_x + obstacle_x_table_.max_distance;
+    double half_y = obj.len_y + obstacle_y_table_.max_distance;
+    double extent_x = std::fabs(obj.cos_yaw) * half_x +
+                      std::fabs(obj.sin_yaw) * half_y;
+    double extent_y = std::fabs(obj.sin_yaw) * half_x +
+                      std::fabs(obj.cos_yaw) * half_y;
+    if (get_index_range(obj.pos_x - extent_x, obj.pos_x + extent_x,
+                        obj.pos_y - extent_y, obj.pos_y + extent_y,
+                        obj.start_x, obj.end_x, obj.start_y, obj.end_y))
+      footprints.push_back(obj);
+  }
+
+  Matrix &field = map_["obstacle_field"];
+  field.setZero();
+
+  // Each row of cells belongs to one thread, obstacles are splatted into it.
+#pragma omp parallel for schedule(dynamic)
+  for (int ix = 0; ix < (int)field.rows(); ++ix) {
+    for (size_t i(0); i < footprints.size(); ++i) {
+      const ObstacleFootprint &obj = footprints[i];
+      if (ix < obj.start_x || obj.end_x < ix)
+        continue;
+      for (int iy = obj.start_y; iy <= obj.end_y; ++iy) {
+        Position position;
+        map_.getPosition(Index(ix, iy), position);
+        double value = obstacle_value(obj, position.x(), position.y());
+        if (value > field(ix, iy))
+          field(ix, iy) = value;
       }
     }
   }
@@ -299,29 +381,49 @@ void PotentialField::vscan_points_callback(
   ros::Time time = ros::Time::now();
   pcl::PointCloud<pcl::PointXYZ> pcl_vscan;
   pcl::fromROSMsg(*vscan_msg, pcl_vscan);
-  pcl::PointCloud<pcl::PointXYZ>::Ptr pcl_vscan_ptr(
-      new pcl::PointCloud<pcl::PointXYZ>(pcl_vscan));
 
   double length_x = map_.getLength().x() / 2.0;
   double length_y = map_.getLength().y() / 2.0;
 
-  for (GridMapIterator it(map_); !it.isPastEnd(); ++it) {
-    Position position;
-    map_.getPosition(*it, position);
-    map_.at("vscan_points_field", *it) = 0.0;
-    for (int i(0); i < (int)pcl_vscan.size(); ++i) {
-      double point_x = pcl_vscan.at(i).x - map_x_offset_;
-      if (3.0 < pcl_vscan.at(i).z + tf_z_ || pcl_vscan.at(i).z + tf_z_ < 0.3)
-        continue;
-      if (length_x < point_x && point_x < -1.0 * length_x)
-        continue;
-      if (length_y < pcl_vscan.at(i).y && pcl_vscan.at(i).y < -1.0 * length_y)
+  std::vector<PointFootprint> footprints;
+  footprints.reserve(pcl_vscan.size());
+  for (int i(0); i < (int)pcl_vscan.size(); ++i) {
+    double point_x = pcl_vscan.at(i).x - map_x_offset_;
+    if (3.0 < pcl_vscan.at(i).z + tf_z_ || pcl_vscan.at(i).z + tf_z_ < 0.3)
+      continue;
+    if (length_x < point_x && point_x < -1.0 * length_x)
+      continue;
+    if (length_y < pcl_vscan.at(i).y && pcl_vscan.at(i).y < -1.0 * length_y)
+      continue;
+
+    PointFootprint point;
+    point.pos_x = point_x + tf_x_;
+    point.pos_y = pcl_vscan.at(i).y;
+    if (get_index_range(point.pos_x - around_x, point.pos_x + around_x,
+                        point.pos_y - around_y, point.pos_y + around_y,
+                        point.start_x, point.end_x, point.start_y,
+                        point.end_y))
+      footprints.push_back(point);
+  }
+
+  Matrix &field = map_["vscan_points_field"];
+  field.setZero();
+
+#pragma omp parallel for schedule(dynamic)
+  for (int ix = 0; ix < (int)field.rows(); ++ix) {
+    for (size_t i(0); i < footprints.size(); ++i) {
+      const PointFootprint &point = footprints[i];
+      if (ix < point.start_x || point.end_x < ix)
         continue;
-      if ((point_x + tf_x_) - around_x < position.x() &&
-          position.x() < point_x + tf_x_ + around_x) {
-        if (pcl_vscan.at(i).y - around_y < position.y() &&
-            position.y() < pcl_vscan.at(i).y + around_y) {
-          map_.at("vscan_points_field", *it) = 1.0; // std::exp(0.0) ;
+      for (int iy = point.start_y; iy <= point.end_y; ++iy) {
+        Position position;
+        map_.getPosition(Index(ix, iy), position);
+        if (point.pos_x - around_x < position.x() &&
+            position.x() < point.pos_x + around_x) {
+          if (point.pos_y - around_y < position.y() &&
+              position.y() < point.pos_y + around_y) {
+            field(ix, iy) = 1.0; // std::exp(0.0) ;
+          }
         }
       }
     }
@@ -54,6 +54,8 @@ public:
 	 * @param SmoothTolerance performance measure , conjugate gradient conversion factor should be 0.1 - 0.01
 	 * @param speedProfileFactor how car should slow for corners
 	 * @param bHeadingSmooth follow car heading direction or center line path heading for sampling direction
+	 * @param SmoothMaxIterations upper bound on smoother iterations per rollout, 0 iterates until SmoothTolerance is reached
+	 * @param nThreads number of threads used to generate the rollouts of each reference path
 	 */
 	void GenerateRunoffTrajectory(const std::vector<std::vector<WayPoint> >& referencePaths, const WayPoint& carPos, const bool& bEnableLaneChange, const double& speed, const double& microPlanDistance,
 				const double& maxSpeed,const double& minSpeed, const double&  carTipMargin, const double& rollInMargin,
@@ -62,7 +64,7 @@ public:
 				const double& SmoothTolerance, const double& speedProfileFactor, const bool& bHeadingSmooth,
 				const int& iCurrGlobalPath, const int& iCurrLocalTraj,
 				std::vector<std::vector<std::vector<WayPoint> > >& rollOutsPaths,
-				std::vector<WayPoint>& sampledPoints);
+				std::vector<WayPoint>& sampledPoints, const int& SmoothMaxIterations = 0, const int& nThreads = 1);
 
 	/**
 	 * @brief Path planning for structured environment using dynamic programming
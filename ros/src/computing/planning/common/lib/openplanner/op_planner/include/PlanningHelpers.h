@@ -96,6 +96,7 @@ public:
 
 	static void FixPathDensity(std::vector<WayPoint>& path, const double& distanceDensity);
 	static void SmoothPath(std::vector<WayPoint>& path, double weight_data =0.25,double weight_smooth = 0.25,double tolerance = 0.01);
+	static int SmoothPathToReference(const std::vector<WayPoint>& path_in, std::vector<WayPoint>& path_out, double weight_data =0.25,double weight_smooth = 0.25,double tolerance = 0.01, const int& maxIterations = 0);
 	static double CalcCircle(const GPSPoint& pt1, const GPSPoint& pt2, const GPSPoint& pt3, GPSPoint& center);
 	static double CalcAngleAndCost(std::vector<WayPoint>& path, const double& lastCost = 0, const bool& bSmooth = true );
 	//static double CalcAngleAndCostSimple(std::vector<WayPoint>& path, const double& lastCost = 0);
@@ -116,7 +117,7 @@ public:
 			const double& rollInSpeedFactor, const double& pathDensity, const double& rollOutDensity,
 			const int& rollOutNumber, const double& SmoothDataWeight, const double& SmoothWeight,
 			const double& SmoothTolerance, const bool& bHeadingSmooth,
-			std::vector<WayPoint>& sampledPoints);
+			std::vector<WayPoint>& sampledPoints, const int& SmoothMaxIterations = 0, const int& nThreads = 1);
 
 	static void SmoothSpeedProfiles(std::vector<WayPoint>& path_in, double weight_data, double weight_smooth, double tolerance	= 0.1);
 	static void SmoothCurvatureProfiles(std::vector<WayPoint>& path_in, double weight_data, double weight_smooth, double tolerance = 0.1);
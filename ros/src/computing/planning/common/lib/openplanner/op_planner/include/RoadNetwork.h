@@ -779,6 +779,12 @@ public:
 	double 	smoothingDataWeight;
 	double 	smoothingSmoothWeight;
 	double 	smoothingToleranceError;
+	int 	smoothingMaxIterations; // 0 smooths until the tolerance is reached
+	int 	rollOutThreads;
+	int 	costThreads; // rollouts of a lane are split over this many threads when their costs are evaluated
+	bool 	enableObstaclePrediction; // predict the paths of moving obstacles before evaluating the trajectory costs
+	int 	predictionThreads;
+	double 	predictionCacheMargin; // extra distance planned for each obstacle so its prediction can be reused on the next cycles, 0 disables the cache
 
 
 	double additionalBrakingDistance;
@@ -814,6 +820,12 @@ public:
 		smoothingDataWeight				= 0.47;
 		smoothingSmoothWeight			= 0.2;
 		smoothingToleranceError			= 0.05;
+		smoothingMaxIterations			= 0;
+		rollOutThreads					= 1;
+		costThreads						= 1;
+		enableObstaclePrediction		= false;
+		predictionThreads				= 1;
+		predictionCacheMargin			= 10.0;
 
 		additionalBrakingDistance		= 10.0;
 		verticalSafetyDistance 			= 0.0;
@@ -44,10 +44,26 @@ public:
 
 
 private:
+	/*
+	 * Frenet coordinates of one contour point on a lane's reference path, shared by all rollouts of that lane
+	 */
+	struct ContourProjection
+	{
+		bool bSkip;
+		double perp_distance;
+		double longitudinal_distance;
+	};
+
+	vector<ContourProjection> m_ContourTable;
+	vector<bool> m_ContourInsideBorder;
+
 	bool ValidateRollOutsInput(const vector<vector<vector<WayPoint> > >& rollOuts);
 	vector<TrajectoryCost> CalculatePriorityAndLaneChangeCosts(const vector<vector<WayPoint> >& laneRollOuts, const int& lane_index, const PlanningParams& params);
 	void NormalizeCosts(vector<TrajectoryCost>& trajectoryCosts);
 	void CalculateLateralAndLongitudinalCosts(vector<TrajectoryCost>& trajectoryCosts, const vector<vector<vector<WayPoint> > >& rollOuts, const vector<vector<WayPoint> >& totalPaths, const WayPoint& currState, const vector<WayPoint>& contourPoints, const PlanningParams& params, const CAR_BASIC_INFO& carInfo, const VehicleState& vehicleState);
+	void ProjectContourPoints(const vector<WayPoint>& path, const WayPoint& currState, const vector<WayPoint>& contourPoints);
+	void CalculateRollOutCosts(TrajectoryCost& trajectoryCost, const vector<WayPoint>& contourPoints, const PlanningParams& params,
+			const CAR_BASIC_INFO& carInfo, const double& critical_lateral_distance, const double& critical_long_front_distance);
 	void CalculateTransitionCosts(vector<TrajectoryCost>& trajectoryCosts, const int& currTrajectoryIndex, const PlanningParams& params);
 	bool CalculateIntersectionVelocities(const std::vector<WayPoint>& path, const DetectedObject& obj, const WayPoint& currState,const CAR_BASIC_INFO& carInfo, WayPoint& collisionPoint);
 
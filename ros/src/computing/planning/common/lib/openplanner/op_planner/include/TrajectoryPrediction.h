@@ -11,6 +11,7 @@
 #include <RoadNetwork.h>
 #include "PlannerCommonDef.h"
 #include "PlanningHelpers.h"
+#include <map>
 
 namespace PlannerHNS
 {
@@ -24,9 +25,33 @@ public:
 	void DoOneStep(PlannerHNS::RoadNetwork& map, const PlannerHNS::VehicleState& vstatus, const PlannerHNS::WayPoint& currState, std::vector<PlannerHNS::WayPoint>& currPath, std::vector<PlannerHNS::DetectedObject>& obj_list, const double& minfDist);
 	double PredictTimeCostForTrajectory(std::vector<PlannerHNS::WayPoint>& path, const PlannerHNS::VehicleState& vstatus, const PlannerHNS::WayPoint& currState,const double& minfDist);
 	void PredictObstacleTrajectory(PlannerHNS::RoadNetwork& map, const DetectedObject& obj, const double& predTime, std::vector<std::vector<PlannerHNS::WayPoint> >& paths,const double& minfDist);
+	void ResetPredictionCache(); //cached lanes point into the road network, call when the map changes
 public:
 	double m_MaxCollisionPredictionTime;
-
+	bool m_bUsePredictionCache;
+	double m_PredictionCacheMargin; //extra distance planned ahead so a cached prediction stays valid while the object moves,
+									//the DP tree is searched this much further so the branches kept can differ from an uncached prediction
+	double m_PredictionCacheLateralTolerance; //maximum distance of the object from its cached lane
+	int m_nPredictionThreads;
+
+private:
+	/*
+	 * Predicted paths of one track, valid while the object stays on the lane they were planned from
+	 */
+	struct PredictionCacheEntry
+	{
+		Lane* pLane;
+		bool bDirection;
+		std::vector<std::vector<PlannerHNS::WayPoint> > paths;
+	};
+
+	std::map<int, PredictionCacheEntry> m_PredictionCache;
+
+	double GetPredictionDistance(const DetectedObject& obj, const double& predTime, const double& minfDist);
+	Lane* GenerateObstaclePaths(PlannerHNS::RoadNetwork& map, const DetectedObject& obj, const double& planDistance, std::vector<std::vector<PlannerHNS::WayPoint> >& paths);
+	bool IsOnCachedLane(const DetectedObject& obj, const PredictionCacheEntry& entry);
+	double ExtractPredictedPaths(const DetectedObject& obj, const std::vector<std::vector<PlannerHNS::WayPoint> >& plannedPaths, const double& planDistance, std::vector<std::vector<PlannerHNS::WayPoint> >& paths);
+	void CalculateTimeCost(const DetectedObject& obj, const double& planDistance, std::vector<std::vector<PlannerHNS::WayPoint> >& paths);
 };
 
 } /* namespace PlannerHNS */
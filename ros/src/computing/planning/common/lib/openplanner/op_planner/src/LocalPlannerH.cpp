@@ -83,6 +83,11 @@ void LocalPlannerH::Init(const ControllerParams& ctrlParams, const PlannerHNS::P
 		if(m_pCurrentBehaviorState)
 			m_pCurrentBehaviorState->SetBehaviorsParams(&m_params);
 
+		m_TrajectoryPredictionForMovingObstacles.m_nPredictionThreads = m_params.predictionThreads;
+		m_TrajectoryPredictionForMovingObstacles.m_PredictionCacheMargin = m_params.predictionCacheMargin;
+		m_TrajectoryPredictionForMovingObstacles.m_bUsePredictionCache = m_params.predictionCacheMargin > 0;
+		m_TrajectoryPredictionForMovingObstacles.ResetPredictionCache();
+
  	}
 
 void LocalPlannerH::InitBehaviorStates()
@@ -775,7 +780,8 @@ void LocalPlannerH::ReInitializePlanner(const WayPoint& start_pose)
 
 
 	m_PredictedTrajectoryObstacles = obj_list;
-	//m_TrajectoryPredictionForMovingObstacles.DoOneStep(map, vehicleState, state, m_TotalPath.at(m_iCurrentTotalPathId), m_PredictedTrajectoryObstacles, m_params.minFollowingDistance);
+	if(m_params.enableObstaclePrediction && m_iCurrentTotalPathId >= 0 && m_iCurrentTotalPathId < (int)m_TotalPath.size())
+		m_TrajectoryPredictionForMovingObstacles.DoOneStep(map, vehicleState, state, m_TotalPath.at(m_iCurrentTotalPathId), m_PredictedTrajectoryObstacles, m_params.minFollowingDistance);
 
 	timespec t;
 	UtilityH::GetTickCount(t);
@@ -42,7 +42,7 @@ void PlannerH::GenerateRunoffTrajectory(const std::vector<std::vector<WayPoint>
 		const double& SmoothTolerance, const double& speedProfileFactor, const bool& bHeadingSmooth,
 		const int& iCurrGlobalPath, const int& iCurrLocalTraj,
 		std::vector<std::vector<std::vector<WayPoint> > >& rollOutsPaths,
-		std::vector<WayPoint>& sampledPoints_debug)
+		std::vector<WayPoint>& sampledPoints_debug, const int& SmoothMaxIterations, const int& nThreads)
 {
 
 	if(referencePaths.size()==0) return;
@@ -61,7 +61,8 @@ void PlannerH::GenerateRunoffTrajectory(const std::vector<std::vector<WayPoint>
 			PlanningHelpers::CalculateRollInTrajectories(carPos, speed, referencePaths.at(i), s_index, e_index, e_distances,
 					local_rollOutPaths, microPlanDistance, maxSpeed, carTipMargin, rollInMargin,
 					rollInSpeedFactor, pathDensity, rollOutDensity,rollOutNumber,
-					SmoothDataWeight, SmoothWeight, SmoothTolerance, bHeadingSmooth, sampledPoints_debug);
+					SmoothDataWeight, SmoothWeight, SmoothTolerance, bHeadingSmooth, sampledPoints_debug,
+					SmoothMaxIterations, nThreads);
 		}
 		else
 		{
@@ -8,6 +8,8 @@
 #include "PlanningHelpers.h"
 #include "MatrixOperations.h"
 #include <string>
+#include <algorithm>
+#include <thread>
 //#include "spline.hpp"
 
 
@@ -1059,8 +1061,17 @@ void PlanningHelpers::SmoothPath(vector<WayPoint>& path, double weight_data,
 		return;
 	}
 
-	const vector<WayPoint>& path_in = path;
-	vector<WayPoint> smoothPath_out =  path_in;
+	vector<WayPoint> smoothPath_out =  path;
+	SmoothPathToReference(path, smoothPath_out, weight_data, weight_smooth, tolerance);
+	path = smoothPath_out;
+}
+
+int PlanningHelpers::SmoothPathToReference(const vector<WayPoint>& path_in, vector<WayPoint>& path_out, double weight_data,
+		double weight_smooth, double tolerance, const int& maxIterations)
+{
+	//path_out holds the starting guess (normally a copy of path_in) and receives the smoothed path
+	if (path_in.size() <= 2 || path_out.size() != path_in.size())
+		return 0;
 
 	double change = tolerance;
 	double xtemp, ytemp;
@@ -1068,37 +1079,34 @@ void PlanningHelpers::SmoothPath(vector<WayPoint>& path, double weight_data,
 
 	int size = path_in.size();
 
-	while (change >= tolerance)
+	while (change >= tolerance && (maxIterations <= 0 || nIterations < maxIterations))
 	{
 		change = 0.0;
 		for (int i = 1; i < size - 1; i++)
 		{
-//			if (smoothPath_out[i].pos.a != smoothPath_out[i - 1].pos.a)
-//				continue;
-
-			xtemp = smoothPath_out[i].pos.x;
-			ytemp = smoothPath_out[i].pos.y;
+			xtemp = path_out[i].pos.x;
+			ytemp = path_out[i].pos.y;
 
-			smoothPath_out[i].pos.x += weight_data
-					* (path_in[i].pos.x - smoothPath_out[i].pos.x);
-			smoothPath_out[i].pos.y += weight_data
-					* (path_in[i].pos.y - smoothPath_out[i].pos.y);
+			path_out[i].pos.x += weight_data
+					* (path_in[i].pos.x - path_out[i].pos.x);
+			path_out[i].pos.y += weight_data
+					* (path_in[i].pos.y - path_out[i].pos.y);
 
-			smoothPath_out[i].pos.x += weight_smooth
-					* (smoothPath_out[i - 1].pos.x + smoothPath_out[i + 1].pos.x
-							- (2.0 * smoothPath_out[i].pos.x));
-			smoothPath_out[i].pos.y += weight_smooth
-					* (smoothPath_out[i - 1].pos.y + smoothPath_out[i + 1].pos.y
-							- (2.0 * smoothPath_out[i].pos.y));
+			path_out[i].pos.x += weight_smooth
+					* (path_out[i - 1].pos.x + path_out[i + 1].pos.x
+							- (2.0 * path_out[i].pos.x));
+			path_out[i].pos.y += weight_smooth
+					* (path_out[i - 1].pos.y + path_out[i + 1].pos.y
+							- (2.0 * path_out[i].pos.y));
 
-			change += fabs(xtemp - smoothPath_out[i].pos.x);
-			change += fabs(ytemp - smoothPath_out[i].pos.y);
+			change += fabs(xtemp - path_out[i].pos.x);
+			change += fabs(ytemp - path_out[i].pos.y);
 
 		}
 		nIterations++;
 	}
 
-	path = smoothPath_out;
+	return nIterations;
 }
 
 //double PlanningHelpers::CalcAngleAndCostSimple(vector<WayPoint>& path, const double& lastCost)
@@ -1299,15 +1307,11 @@ void PlanningHelpers::CalculateRollInTrajectories(const WayPoint& carPos, const
 		const double& rollInSpeedFactor, const double& pathDensity, const double& rollOutDensity,
 		const int& rollOutNumber, const double& SmoothDataWeight, const double& SmoothWeight,
 		const double& SmoothTolerance, const bool& bHeadingSmooth,
-		std::vector<WayPoint>& sampledPoints)
+		std::vector<WayPoint>& sampledPoints, const int& SmoothMaxIterations, const int& nThreads)
 {
 	WayPoint p;
 	double dummyd = 0;
 
-	int iLimitIndex = (carTipMargin/0.3)/pathDensity;
-	if(iLimitIndex >= originalCenter.size())
-		iLimitIndex = originalCenter.size() - 1;
-
 	//Get Closest Index
 	RelativeInfo info;
 	GetRelativeInfo(originalCenter, carPos, info);
@@ -1410,141 +1414,124 @@ void PlanningHelpers::CalculateRollInTrajectories(const WayPoint& carPos, const
 	}
 
 	int nSteps = end_index - smoothing_start_index;
+	int nRollOuts = rollOutNumber+1;
 
-
-	vector<double> inc_list;
-	rollInPaths.clear();
-	vector<double> inc_list_inc;
-	for(int i=0; i< rollOutNumber+1; i++)
+	//the tail after the smoothed section extends up to max_roll_distance
+	d_limit = 0;
+	unsigned int tail_end_index = smoothing_end_index;
+	for(unsigned int j = smoothing_end_index; j < originalCenter.size(); j++)
 	{
-		double diff = end_laterals.at(i)-initial_roll_in_distance;
-		inc_list.push_back(diff/(double)nSteps);
-		rollInPaths.push_back(vector<WayPoint>());
-		inc_list_inc.push_back(0);
-	}
-
-
-
-	vector<vector<WayPoint> > execluded_from_smoothing;
-	for(unsigned int i=0; i< rollOutNumber+1 ; i++)
-		execluded_from_smoothing.push_back(vector<WayPoint>());
-
+		if(j > 0)
+			d_limit += distance2points(originalCenter.at(j).pos, originalCenter.at(j-1).pos);
 
+		if(d_limit > max_roll_distance)
+			break;
 
-	//Insert First strait points within the tip of the car range
-	for(unsigned int j = start_index; j < smoothing_start_index; j++)
-	{
-		p = originalCenter.at(j);
-		double original_speed = p.v;
-	  for(unsigned int i=0; i< rollOutNumber+1 ; i++)
-	  {
-		  p.pos.x = originalCenter.at(j).pos.x -  initial_roll_in_distance*cos(p.pos.a + M_PI_2);
-		  p.pos.y = originalCenter.at(j).pos.y -  initial_roll_in_distance*sin(p.pos.a + M_PI_2);
-		  if(i!=centralTrajectoryIndex)
-			  p.v = original_speed * LANE_CHANGE_SPEED_FACTOR;
-		  else
-			  p.v = original_speed ;
-
-		  if(j < iLimitIndex)
-			  execluded_from_smoothing.at(i).push_back(p);
-		  else
-			  rollInPaths.at(i).push_back(p);
-
-		  sampledPoints.push_back(p);
-	  }
+		tail_end_index++;
 	}
 
-	for(unsigned int j = smoothing_start_index; j < end_index; j++)
-	  {
-		  p = originalCenter.at(j);
-		  double original_speed = p.v;
-		  for(unsigned int i=0; i< rollOutNumber+1 ; i++)
-		  {
-			  inc_list_inc[i] += inc_list[i];
-			  double d = inc_list_inc[i];
-			  p.pos.x = originalCenter.at(j).pos.x -  initial_roll_in_distance*cos(p.pos.a + M_PI_2) - d*cos(p.pos.a+ M_PI_2);
-			  p.pos.y = originalCenter.at(j).pos.y -  initial_roll_in_distance*sin(p.pos.a + M_PI_2) - d*sin(p.pos.a+ M_PI_2);
-			  if(i!=centralTrajectoryIndex)
-				  p.v = original_speed * LANE_CHANGE_SPEED_FACTOR;
-			  else
-				  p.v = original_speed ;
-
-			  rollInPaths.at(i).push_back(p);
-
-			  sampledPoints.push_back(p);
-		  }
-	  }
-
-	//Insert last strait points to make better smoothing
-	for(unsigned int j = end_index; j < smoothing_end_index; j++)
+	//Shared center line geometry, the lateral direction of each center point is the same for every rollout
+	vector<GPSPoint> normals(tail_end_index - start_index);
+	for(unsigned int j = start_index; j < tail_end_index; j++)
 	{
-		p = originalCenter.at(j);
-		double original_speed = p.v;
-	  for(unsigned int i=0; i< rollOutNumber+1 ; i++)
-	  {
-		  double d = end_laterals.at(i);
-		  p.pos.x  = originalCenter.at(j).pos.x - d*cos(p.pos.a + M_PI_2);
-		  p.pos.y  = originalCenter.at(j).pos.y - d*sin(p.pos.a + M_PI_2);
-		  if(i!=centralTrajectoryIndex)
-			  p.v = original_speed * LANE_CHANGE_SPEED_FACTOR;
-		  else
-			  p.v = original_speed ;
-		  rollInPaths.at(i).push_back(p);
-
-		  sampledPoints.push_back(p);
-	  }
+		normals.at(j - start_index).x = cos(originalCenter.at(j).pos.a + M_PI_2);
+		normals.at(j - start_index).y = sin(originalCenter.at(j).pos.a + M_PI_2);
 	}
 
-	for(unsigned int i=0; i< rollOutNumber+1 ; i++)
-		rollInPaths.at(i).insert(rollInPaths.at(i).begin(), execluded_from_smoothing.at(i).begin(), execluded_from_smoothing.at(i).end());
+	unsigned int nSmoothed = smoothing_end_index - start_index;
+	unsigned int nTotal = tail_end_index - start_index;
 
-	///***   Smoothing From Car Heading Section ***///
-//	if(bHeadingSmooth)
-//	{
-//		for(unsigned int i=0; i< rollOutNumber+1 ; i++)
-//		{
-//			unsigned int cut_index = GetClosestNextPointIndex(rollInPaths.at(i), RollOutStratPath.at(RollOutStratPath.size()-1));
-//			rollInPaths.at(i).erase(rollInPaths.at(i).begin(), rollInPaths.at(i).begin()+cut_index);
-//			rollInPaths.at(i).insert(rollInPaths.at(i).begin(), RollOutStratPath.begin(), RollOutStratPath.end());
-//		}
-//	}
-	///***   -------------------------------- ***///
+	rollInPaths.clear();
+	rollInPaths.resize(nRollOuts);
+	vector<vector<WayPoint> > sampledRollIns(nRollOuts);
 
-	for(unsigned int i=0; i< rollOutNumber+1 ; i++)
+	auto generateRollOut = [&](const int& i)
 	{
-		SmoothPath(rollInPaths.at(i), SmoothDataWeight, SmoothWeight, SmoothTolerance);
-	}
+		vector<WayPoint>& sampled = sampledRollIns.at(i);
+		vector<WayPoint>& path = rollInPaths.at(i);
+		sampled.reserve(nSmoothed);
+		path.reserve(nTotal);
 
-	d_limit = 0;
-	for(unsigned int j = smoothing_end_index; j < originalCenter.size(); j++)
-	  {
-		if(j > 0)
-			d_limit += distance2points(originalCenter.at(j).pos, originalCenter.at(j-1).pos);
+		double speed_factor = (i != centralTrajectoryIndex) ? LANE_CHANGE_SPEED_FACTOR : 1.0;
+		double inc = end_laterals.at(i)-initial_roll_in_distance;
+		inc = inc/(double)nSteps;
+		double d = 0;
 
-		if(d_limit > max_roll_distance)
-			break;
+		for(unsigned int j = start_index; j < smoothing_end_index; j++)
+		{
+			const GPSPoint& n = normals.at(j - start_index);
+			WayPoint wp = originalCenter.at(j);
+			if(j < smoothing_start_index)
+			{
+				//strait points within the tip of the car range
+				wp.pos.x = originalCenter.at(j).pos.x -  initial_roll_in_distance*n.x;
+				wp.pos.y = originalCenter.at(j).pos.y -  initial_roll_in_distance*n.y;
+			}
+			else if(j < end_index)
+			{
+				d += inc;
+				wp.pos.x = originalCenter.at(j).pos.x -  initial_roll_in_distance*n.x - d*n.x;
+				wp.pos.y = originalCenter.at(j).pos.y -  initial_roll_in_distance*n.y - d*n.y;
+			}
+			else
+			{
+				//last strait points to make better smoothing
+				wp.pos.x = originalCenter.at(j).pos.x - end_laterals.at(i)*n.x;
+				wp.pos.y = originalCenter.at(j).pos.y - end_laterals.at(i)*n.y;
+			}
+			wp.v = originalCenter.at(j).v * speed_factor;
+			sampled.push_back(wp);
+		}
 
-			p = originalCenter.at(j);
-			double original_speed = p.v;
-		  for(unsigned int i=0; i< rollInPaths.size() ; i++)
-		  {
-			  double d = end_laterals.at(i);
-			  p.pos.x  = originalCenter.at(j).pos.x - d*cos(p.pos.a + M_PI_2);
-			  p.pos.y  = originalCenter.at(j).pos.y - d*sin(p.pos.a + M_PI_2);
+		path = sampled;
+		SmoothPathToReference(sampled, path, SmoothDataWeight, SmoothWeight, SmoothTolerance, SmoothMaxIterations);
 
-			  if(i!=centralTrajectoryIndex)
-				  p.v = original_speed * LANE_CHANGE_SPEED_FACTOR;
-			  else
-				  p.v = original_speed ;
+		for(unsigned int j = smoothing_end_index; j < tail_end_index; j++)
+		{
+			const GPSPoint& n = normals.at(j - start_index);
+			WayPoint wp = originalCenter.at(j);
+			wp.pos.x  = originalCenter.at(j).pos.x - end_laterals.at(i)*n.x;
+			wp.pos.y  = originalCenter.at(j).pos.y - end_laterals.at(i)*n.y;
+			wp.v = originalCenter.at(j).v * speed_factor;
+			path.push_back(wp);
+		}
+	};
 
-			  rollInPaths.at(i).push_back(p);
+	//Each rollout only touches its own buffers, so they can be generated concurrently
+	int nWorkers = std::max(1, std::min(nThreads, nRollOuts));
+	if(nWorkers == 1)
+	{
+		for(int i=0; i < nRollOuts; i++)
+			generateRollOut(i);
+	}
+	else
+	{
+		vector<std::thread> workers;
+		for(int iw = 0; iw < nWorkers; iw++)
+		{
+			workers.push_back(std::thread([&, iw]()
+			{
+				for(int i = iw; i < nRollOuts; i += nWorkers)
+					generateRollOut(i);
+			}));
+		}
 
-			  sampledPoints.push_back(p);
-		  }
-	  }
+		for(unsigned int iw = 0; iw < workers.size(); iw++)
+			workers.at(iw).join();
+	}
 
-//	for(unsigned int i=0; i< rollInPaths.size(); i++)
-//		CalcAngleAndCost(rollInPaths.at(i));
+	//sampled points keep the center line order, all rollouts of one center point next to each other
+	sampledPoints.reserve(sampledPoints.size() + nTotal*nRollOuts);
+	for(unsigned int k = 0; k < nTotal; k++)
+	{
+		for(int i=0; i < nRollOuts; i++)
+		{
+			if(k < nSmoothed)
+				sampledPoints.push_back(sampledRollIns.at(i).at(k));
+			else
+				sampledPoints.push_back(rollInPaths.at(i).at(k));
+		}
+	}
 }
 
 bool PlanningHelpers::FindInList(const std::vector<int>& list,const int& x)
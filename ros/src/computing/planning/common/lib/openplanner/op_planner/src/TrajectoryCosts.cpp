@@ -7,6 +7,8 @@
 
 #include "TrajectoryCosts.h"
 #include "MatrixOperations.h"
+#include <algorithm>
+#include <thread>
 
 namespace PlannerHNS
 {
@@ -179,76 +181,119 @@ void TrajectoryCosts::CalculateLateralAndLongitudinalCosts(vector<TrajectoryCost
 	m_SafetyBorder.points.push_back(top_left) ;
 	m_SafetyBorder.points.push_back(top_left_car) ;
 
+	//The safety border does not depend on the lane or the rollout, test every contour point once
+	m_ContourInsideBorder.resize(contourPoints.size());
+	for(unsigned int icon = 0; icon < contourPoints.size(); icon++)
+		m_ContourInsideBorder.at(icon) = m_SafetyBorder.PointInsidePolygon(m_SafetyBorder, contourPoints.at(icon).pos) == true;
+
 	for(unsigned int il=0; il < rollOuts.size(); il++)
 	{
 		if(rollOuts.at(il).size() > 0 && rollOuts.at(il).at(0).size()>0)
 		{
-			RelativeInfo car_info;
-			PlanningHelpers::GetRelativeInfo(totalPaths.at(il), currState, car_info);
+			//All rollouts of a lane are measured against the same reference path, project the contour points once
+			ProjectContourPoints(totalPaths.at(il), currState, contourPoints);
 
+			int nRollOuts = rollOuts.at(il).size();
+			int nThreads = std::max(1, std::min(params.costThreads, nRollOuts));
 
-			for(unsigned int it=0; it< rollOuts.at(il).size(); it++)
+			if(nThreads == 1)
+			{
+				for(int it=0; it < nRollOuts; it++)
+					CalculateRollOutCosts(trajectoryCosts.at(iCostIndex + it), contourPoints, params, carInfo, critical_lateral_distance, critical_long_front_distance);
+			}
+			else
 			{
-				int skip_id = -1;
-				for(unsigned int icon = 0; icon < contourPoints.size(); icon++)
+				//Each rollout only writes its own cost, so the threads share nothing but the read only table
+				vector<std::thread> workers;
+				for(int ith = 0; ith < nThreads; ith++)
 				{
-					if(skip_id == contourPoints.at(icon).id)
-						continue;
+					workers.push_back(std::thread([&, ith]()
+					{
+						for(int it = ith; it < nRollOuts; it += nThreads)
+							CalculateRollOutCosts(trajectoryCosts.at(iCostIndex + it), contourPoints, params, carInfo, critical_lateral_distance, critical_long_front_distance);
+					}));
+				}
 
-					RelativeInfo obj_info;
-					PlanningHelpers::GetRelativeInfo(totalPaths.at(il), contourPoints.at(icon), obj_info);
-					double longitudinalDist = PlanningHelpers::GetExactDistanceOnTrajectory(totalPaths.at(il), car_info, obj_info);
-					if(obj_info.iFront == 0 && longitudinalDist > 0)
-						longitudinalDist = -longitudinalDist;
+				for(unsigned int ith = 0; ith < workers.size(); ith++)
+					workers.at(ith).join();
+			}
 
-					double direct_distance = hypot(obj_info.perp_point.pos.y-contourPoints.at(icon).pos.y, obj_info.perp_point.pos.x-contourPoints.at(icon).pos.x);
-					if(contourPoints.at(icon).v < 0.1 && direct_distance > (m_LateralSkipDistance+contourPoints.at(icon).cost))
-					{
-						skip_id = contourPoints.at(icon).id;
-						continue;
-					}
+			iCostIndex += nRollOuts;
+		}
+	}
+}
+
+void TrajectoryCosts::ProjectContourPoints(const vector<WayPoint>& path, const WayPoint& currState, const vector<WayPoint>& contourPoints)
+{
+	RelativeInfo car_info;
+	PlanningHelpers::GetRelativeInfo(path, currState, car_info);
 
-					double close_in_percentage = 1;
-//					close_in_percentage = ((longitudinalDist- critical_long_front_distance)/params.rollInMargin)*4.0;
-//
-//					if(close_in_percentage <= 0 || close_in_percentage > 1) close_in_percentage = 1;
+	m_ContourTable.resize(contourPoints.size());
 
-					double distance_from_center = trajectoryCosts.at(iCostIndex).distance_from_center;
+	int skip_id = -1;
+	for(unsigned int icon = 0; icon < contourPoints.size(); icon++)
+	{
+		ContourProjection& proj = m_ContourTable.at(icon);
+		proj.bSkip = true;
 
-					if(close_in_percentage < 1)
-						distance_from_center = distance_from_center - distance_from_center * (1.0-close_in_percentage);
+		if(skip_id == contourPoints.at(icon).id)
+			continue;
 
-					double lateralDist = fabs(obj_info.perp_distance - distance_from_center);
+		RelativeInfo obj_info;
+		PlanningHelpers::GetRelativeInfo(path, contourPoints.at(icon), obj_info);
+		double longitudinalDist = PlanningHelpers::GetExactDistanceOnTrajectory(path, car_info, obj_info);
+		if(obj_info.iFront == 0 && longitudinalDist > 0)
+			longitudinalDist = -longitudinalDist;
 
-					if(longitudinalDist < -carInfo.length || longitudinalDist > params.minFollowingDistance || lateralDist > m_LateralSkipDistance)
-					{
-						continue;
-					}
+		double direct_distance = hypot(obj_info.perp_point.pos.y-contourPoints.at(icon).pos.y, obj_info.perp_point.pos.x-contourPoints.at(icon).pos.x);
+		if(contourPoints.at(icon).v < 0.1 && direct_distance > (m_LateralSkipDistance+contourPoints.at(icon).cost))
+		{
+			skip_id = contourPoints.at(icon).id;
+			continue;
+		}
+
+		proj.bSkip = false;
+		proj.perp_distance = obj_info.perp_distance;
+		proj.longitudinal_distance = longitudinalDist;
+	}
+}
+
+void TrajectoryCosts::CalculateRollOutCosts(TrajectoryCost& trajectoryCost, const vector<WayPoint>& contourPoints, const PlanningParams& params,
+		const CAR_BASIC_INFO& carInfo, const double& critical_lateral_distance, const double& critical_long_front_distance)
+{
+	for(unsigned int icon = 0; icon < contourPoints.size(); icon++)
+	{
+		const ContourProjection& proj = m_ContourTable.at(icon);
+		if(proj.bSkip)
+			continue;
 
-					longitudinalDist = longitudinalDist - critical_long_front_distance;
+		double longitudinalDist = proj.longitudinal_distance;
+		double lateralDist = fabs(proj.perp_distance - trajectoryCost.distance_from_center);
 
-					if(m_SafetyBorder.PointInsidePolygon(m_SafetyBorder, contourPoints.at(icon).pos) == true)
-						trajectoryCosts.at(iCostIndex).bBlocked = true;
+		if(longitudinalDist < -carInfo.length || longitudinalDist > params.minFollowingDistance || lateralDist > m_LateralSkipDistance)
+		{
+			continue;
+		}
 
-					if(lateralDist <= critical_lateral_distance
-							&& longitudinalDist >= -carInfo.length/1.5
-							&& longitudinalDist < params.minFollowingDistance)
-						trajectoryCosts.at(iCostIndex).bBlocked = true;
+		longitudinalDist = longitudinalDist - critical_long_front_distance;
 
+		if(m_ContourInsideBorder.at(icon))
+			trajectoryCost.bBlocked = true;
 
-					trajectoryCosts.at(iCostIndex).lateral_cost += 1.0/lateralDist;
-					trajectoryCosts.at(iCostIndex).longitudinal_cost += 1.0/fabs(longitudinalDist);
+		if(lateralDist <= critical_lateral_distance
+				&& longitudinalDist >= -carInfo.length/1.5
+				&& longitudinalDist < params.minFollowingDistance)
+			trajectoryCost.bBlocked = true;
 
 
-					if(longitudinalDist >= -critical_long_front_distance && longitudinalDist < trajectoryCosts.at(iCostIndex).closest_obj_distance)
-					{
-						trajectoryCosts.at(iCostIndex).closest_obj_distance = longitudinalDist;
-						trajectoryCosts.at(iCostIndex).closest_obj_velocity = contourPoints.at(icon).v;
-					}
-				}
+		trajectoryCost.lateral_cost += 1.0/lateralDist;
+		trajectoryCost.longitudinal_cost += 1.0/fabs(longitudinalDist);
 
-				iCostIndex++;
-			}
+
+		if(longitudinalDist >= -critical_long_front_distance && longitudinalDist < trajectoryCost.closest_obj_distance)
+		{
+			trajectoryCost.closest_obj_distance = longitudinalDist;
+			trajectoryCost.closest_obj_velocity = contourPoints.at(icon).v;
 		}
 	}
 }
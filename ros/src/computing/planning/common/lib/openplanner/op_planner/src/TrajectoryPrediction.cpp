@@ -8,6 +8,8 @@
 #include "TrajectoryPrediction.h"
 #include "PlannerH.h"
 #include "MappingHelpers.h"
+#include <algorithm>
+#include <thread>
 
 namespace PlannerHNS
 {
@@ -15,30 +17,115 @@ namespace PlannerHNS
 TrajectoryPrediction::TrajectoryPrediction()
 {
 	m_MaxCollisionPredictionTime = 6;
+	m_bUsePredictionCache = true;
+	m_PredictionCacheMargin = 10;
+	m_PredictionCacheLateralTolerance = 1.5;
+	m_nPredictionThreads = 1;
 }
 
 TrajectoryPrediction::~TrajectoryPrediction()
 {
 }
 
+void TrajectoryPrediction::ResetPredictionCache()
+{
+	m_PredictionCache.clear();
+}
+
 void TrajectoryPrediction::DoOneStep(PlannerHNS::RoadNetwork& map, const PlannerHNS::VehicleState& vstatus, const PlannerHNS::WayPoint& currState, std::vector<PlannerHNS::WayPoint>& currPath, std::vector<PlannerHNS::DetectedObject>& obj_list, const double& minfDist)
 {
 	double predTime = PredictTimeCostForTrajectory(currPath, vstatus, currState, minfDist);
 	if(predTime > m_MaxCollisionPredictionTime)
 		predTime = m_MaxCollisionPredictionTime;
 
+	if(!m_bUsePredictionCache)
+		m_PredictionCache.clear();
+
+	//1- reuse the cached predictions of objects that are still on the same lane
+	std::map<int, PredictionCacheEntry> currentCache;
+	std::vector<int> newPredictions;
 	for(unsigned int i = 0; i < obj_list.size(); i++)
 	{
 		if(obj_list.at(i).bVelocity && obj_list.at(i).center.v > 0.1)
 		{
 			obj_list.at(i).predTrajectories.clear();
-			PredictObstacleTrajectory(map, obj_list.at(i), predTime, obj_list.at(i).predTrajectories, minfDist);
+			double planDistance = GetPredictionDistance(obj_list.at(i), predTime, minfDist);
+			if(planDistance <= 0)
+				continue;
+
+			std::map<int, PredictionCacheEntry>::iterator it = m_PredictionCache.find(obj_list.at(i).id);
+			if(it != m_PredictionCache.end() && IsOnCachedLane(obj_list.at(i), it->second)
+					&& ExtractPredictedPaths(obj_list.at(i), it->second.paths, planDistance, obj_list.at(i).predTrajectories) >= planDistance)
+			{
+				CalculateTimeCost(obj_list.at(i), planDistance, obj_list.at(i).predTrajectories);
+				currentCache[obj_list.at(i).id] = std::move(it->second);
+			}
+			else
+			{
+				obj_list.at(i).predTrajectories.clear();
+				newPredictions.push_back(i);
+			}
 		}
 		else
 		{
 			obj_list.at(i).bVelocity = false;
 		}
 	}
+
+	//2- plan the rest, every object only writes its own trajectories and cache slot
+	std::vector<PredictionCacheEntry> newEntries(newPredictions.size());
+	auto predictObject = [&](const int& k)
+	{
+		DetectedObject& obj = obj_list.at(newPredictions.at(k));
+		PredictionCacheEntry& entry = newEntries.at(k);
+		if(!m_bUsePredictionCache)
+		{
+			//without the cache the paths are planned exactly as far as needed
+			entry.pLane = 0;
+			PredictObstacleTrajectory(map, obj, predTime, obj.predTrajectories, minfDist);
+			return;
+		}
+
+		double planDistance = GetPredictionDistance(obj, predTime, minfDist);
+		entry.bDirection = obj.bDirection;
+		entry.pLane = GenerateObstaclePaths(map, obj, planDistance + m_PredictionCacheMargin, entry.paths);
+		ExtractPredictedPaths(obj, entry.paths, planDistance, obj.predTrajectories);
+		CalculateTimeCost(obj, planDistance, obj.predTrajectories);
+	};
+
+	int nThreads = std::max(1, std::min(m_nPredictionThreads, (int)newPredictions.size()));
+	if(nThreads == 1)
+	{
+		for(unsigned int k = 0; k < newPredictions.size(); k++)
+			predictObject(k);
+	}
+	else
+	{
+		std::vector<std::thread> workers;
+		for(int ith = 0; ith < nThreads; ith++)
+		{
+			workers.push_back(std::thread([&, ith]()
+			{
+				for(int k = ith; k < (int)newPredictions.size(); k += nThreads)
+					predictObject(k);
+			}));
+		}
+
+		for(unsigned int ith = 0; ith < workers.size(); ith++)
+			workers.at(ith).join();
+	}
+
+	//3- tracks that disappeared are dropped from the cache
+	if(m_bUsePredictionCache)
+	{
+		for(unsigned int k = 0; k < newPredictions.size(); k++)
+		{
+			if(newEntries.at(k).pLane)
+				currentCache[obj_list.at(newPredictions.at(k)).id] = std::move(newEntries.at(k));
+		}
+	}
+
+	m_PredictionCache.swap(currentCache);
 }
 
 double TrajectoryPrediction::PredictTimeCostForTrajectory(std::vector<PlannerHNS::WayPoint>& path, const PlannerHNS::VehicleState& vstatus, const PlannerHNS::WayPoint& currState, const double& minfDist)
@@ -76,47 +163,116 @@ double TrajectoryPrediction::PredictTimeCostForTrajectory(std::vector<PlannerHNS
 
 void TrajectoryPrediction::PredictObstacleTrajectory(PlannerHNS::RoadNetwork& map, const DetectedObject& obj, const double& predTime, std::vector<std::vector<PlannerHNS::WayPoint> >& paths,const double& minfDist)
 {
-	PlannerHNS::PlanningParams planningDefaultParams;
-	planningDefaultParams.rollOutNumber = 0;
-	planningDefaultParams.microPlanDistance = predTime*obj.center.v;
-	if(planningDefaultParams.microPlanDistance > minfDist)
-		planningDefaultParams.microPlanDistance = minfDist;
+	double planDistance = GetPredictionDistance(obj, predTime, minfDist);
+	GenerateObstaclePaths(map, obj, planDistance, paths);
+	CalculateTimeCost(obj, planDistance, paths);
+}
 
-	planningDefaultParams.pathDensity = 1;
+double TrajectoryPrediction::GetPredictionDistance(const DetectedObject& obj, const double& predTime, const double& minfDist)
+{
+	double planDistance = predTime*obj.center.v;
+	if(planDistance > minfDist)
+		planDistance = minfDist;
+
+	return planDistance;
+}
+
+Lane* TrajectoryPrediction::GenerateObstaclePaths(PlannerHNS::RoadNetwork& map, const DetectedObject& obj, const double& planDistance, std::vector<std::vector<PlannerHNS::WayPoint> >& paths)
+{
+	if(planDistance <= 0)
+		return 0;
 
 	//cout << "Pred Time: " << predTime << ", Object Speed: " <<obj.center.v << endl;
 	WayPoint* pClosestWP =  MappingHelpers::GetClosestWaypointFromMap(obj.center, map, obj.bDirection);
+	if(!pClosestWP)
+		return 0;
+
 	PlannerHNS::PlannerH planner;
+	WayPoint obj_center = obj.center;
+	obj_center.pos.a = pClosestWP->pos.a;
+	planner.PredictPlanUsingDP(obj_center, pClosestWP, planDistance, paths, false);
+	for(unsigned int j=0; j < paths.size(); j++)
+	{
+		PlanningHelpers::FixPathDensity(paths.at(j), 1);
+		PlanningHelpers::CalcAngleAndCost(paths.at(j));
+	}
+
+	return pClosestWP->pLane;
+}
+
+bool TrajectoryPrediction::IsOnCachedLane(const DetectedObject& obj, const PredictionCacheEntry& entry)
+{
+	if(!entry.pLane || entry.bDirection != obj.bDirection || entry.pLane->points.size() < 2)
+		return false;
+
+	RelativeInfo info;
+	PlanningHelpers::GetRelativeInfo(entry.pLane->points, obj.center, info);
+
+	//beyond either end of the lane the object has moved on to another lane
+	if(info.iFront == 0 || info.iFront >= (int)entry.pLane->points.size()-1)
+		return false;
 
-	if(planningDefaultParams.microPlanDistance > 0)
+	return fabs(info.perp_distance) <= m_PredictionCacheLateralTolerance;
+}
+
+double TrajectoryPrediction::ExtractPredictedPaths(const DetectedObject& obj, const std::vector<std::vector<PlannerHNS::WayPoint> >& plannedPaths, const double& planDistance, std::vector<std::vector<PlannerHNS::WayPoint> >& paths)
+{
+	//Start every path at the current object position and keep planDistance of it, returns the shortest available distance
+	double min_remaining = -1;
+	paths.clear();
+	for(unsigned int j=0; j < plannedPaths.size(); j++)
 	{
-		WayPoint obj_center = obj.center;
-		obj_center.pos.a = pClosestWP->pos.a;
-		planner.PredictPlanUsingDP(obj_center, pClosestWP, planningDefaultParams.microPlanDistance, paths, false);
-		for(unsigned int j=0; j < paths.size(); j++)
+		const std::vector<WayPoint>& planned = plannedPaths.at(j);
+		if(planned.size() < 2)
+		{
+			paths.push_back(planned);
+			continue;
+		}
+
+		RelativeInfo info;
+		PlanningHelpers::GetRelativeInfo(planned, obj.center, info);
+		int iStart = info.iFront > 0 ? info.iFront : 1;
+
+		double remaining = planned.back().cost - planned.at(iStart).cost + distance2points(obj.center.pos, planned.at(iStart).pos);
+		if(min_remaining < 0 || remaining < min_remaining)
+			min_remaining = remaining;
+
+		std::vector<WayPoint> path;
+		path.push_back(planned.at(0));
+		path.at(0).pos = obj.center.pos;
+		for(unsigned int i = iStart; i < planned.size(); i++)
 		{
-			PlanningHelpers::FixPathDensity(paths.at(j), planningDefaultParams.pathDensity);
-			PlanningHelpers::CalcAngleAndCost(paths.at(j));
+			path.push_back(planned.at(i));
+			if(planned.at(i).cost - planned.at(iStart).cost > planDistance)
+				break;
 		}
 
-		for(unsigned int j=0; j < paths.size(); j++)
+		PlanningHelpers::CalcAngleAndCost(path);
+		paths.push_back(path);
+	}
+
+	return min_remaining;
+}
+
+void TrajectoryPrediction::CalculateTimeCost(const DetectedObject& obj, const double& planDistance, std::vector<std::vector<PlannerHNS::WayPoint> >& paths)
+{
+	for(unsigned int j=0; j < paths.size(); j++)
+	{
+		if(paths.at(j).size() > 0)
 		{
-			if(paths.at(j).size() > 0)
+			double timeDelay = 0;
+			double total_distance = 0;
+			paths.at(j).at(0).timeCost = 0;
+			paths.at(j).at(0).v = obj.center.v;
+			for(unsigned int i=1; i<paths.at(j).size(); i++)
 			{
-				double timeDelay = 0;
-				double total_distance = 0;
-				paths.at(j).at(0).timeCost = 0;
-				paths.at(j).at(0).v = obj.center.v;
-				for(unsigned int i=1; i<paths.at(j).size(); i++)
-				{
-					paths.at(j).at(i).v = obj.center.v;
-					total_distance += hypot(paths.at(j).at(i).pos.y- paths.at(j).at(i-1).pos.y, paths.at(j).at(i).pos.x- paths.at(j).at(i-1).pos.x);
-					if(obj.center.v > 0.1 && total_distance > 0.1)
-						timeDelay = total_distance/obj.center.v;
-					paths.at(j).at(i).timeCost = timeDelay;
-					if(total_distance > planningDefaultParams.microPlanDistance)
-						break;
-				}
+				paths.at(j).at(i).v = obj.center.v;
+				total_distance += hypot(paths.at(j).at(i).pos.y- paths.at(j).at(i-1).pos.y, paths.at(j).at(i).pos.x- paths.at(j).at(i-1).pos.x);
+				if(obj.center.v > 0.1 && total_distance > 0.1)
+					timeDelay = total_distance/obj.center.v;
+				paths.at(j).at(i).timeCost = timeDelay;
+				if(total_distance > planDistance)
+					break;
 			}
 		}
 	}
@@ -15,14 +15,17 @@
 #include "UtilityH.h"
 #include <math.h>
 #include <iostream>
+#include <unordered_map>
 
 namespace SimulationNS
 {
 
 #define DEBUG_TRACKER 0
 #define NEVER_GORGET_TIME -1000
+#define TRACKER_LOG_PERIOD 1.0 // seconds between two debug summaries
 
 enum TRACKING_TYPE {ASSOCIATE_ONLY = 0, SIMPLE_TRACKER = 1, CONTOUR_TRACKER = 2};
+enum ASSOCIATION_COST_TYPE {NORMALIZED_COST = 0, CONTOUR_SIZE_COST = 1, CONTOUR_PLANAR_SIZE_COST = 2};
 
 struct Kalman1dState
 {
@@ -457,6 +460,43 @@ public:
 	}
 };
 
+/*
+ * Uniform grid over the track centers, used to gate the detection/track pairs
+ * before any cost is computed. A track is registered in every cell covered by
+ * its gate radius.
+ */
+class TrackGrid
+{
+public:
+	TrackGrid();
+	void Reset(const double& cell_size, const int& nTracks);
+	void Insert(const int& index, const PlannerHNS::GPSPoint& p, const double& radius);
+	void Query(const PlannerHNS::GPSPoint& p, const double& radius, std::vector<int>& candidates);
+
+private:
+	double m_CellSize;
+	int m_QueryStamp;
+	std::vector<int> m_LastQuery;
+	std::unordered_map<long long, std::vector<int> > m_Cells;
+
+	long long CellKey(const int& ix, const int& iy) const;
+};
+
+/*
+ * Minimum cost assignment (Hungarian / Kuhn-Munkres) over a sparse list of
+ * object/track costs. Each connected group of candidates is solved on its own
+ * small dense matrix, pairs that are not in the list are never assigned.
+ */
+class HungarianAssignment
+{
+public:
+	static void Solve(const int& nObjects, const int& nTracks, const std::vector<CostRecordSet>& costs, std::vector<int>& objToTrack);
+
+private:
+	static void SolveDense(const std::vector<std::vector<double> >& cost, std::vector<int>& rowToCol);
+	static int FindRoot(std::vector<int>& parents, int i);
+};
+
 class SimpleTracker
 {
 public:
@@ -489,9 +529,13 @@ public:
 	double m_CirclesResolution;
 	double m_MAX_ASSOCIATION_SIZE_DIFF;
 	double m_MAX_ASSOCIATION_ANGLE_DIFF;
+	bool m_bDebugLog;
 
 private:
 	std::vector<KFTrackV> newObjects;
+	TrackGrid m_TracksGrid;
+	std::vector<int> m_ObjToTrack;
+	timespec m_LogTimer;
 	void AssociateAndTrack();
 	void AssociateSimply();
 	void AssociateToRegions(KFTrackV& detectedObject);
@@ -503,6 +547,12 @@ private:
 	void MatchClosest();
 	void MatchClosestCost();
 
+	void BuildCostsList(const ASSOCIATION_COST_TYPE& cost_type);
+	void MatchAndReplaceTracks(const ASSOCIATION_COST_TYPE& cost_type);
+	KFTrackV CreateTrack(PlannerHNS::DetectedObject& obj);
+	double ContourRadius(const PlannerHNS::DetectedObject& obj);
+	void LogAssociation(const char* stage, const int& nObjects, const int& nTracks, const int& nMatched);
+
 };
 
 }
@@ -12,6 +12,8 @@
 #include <iostream>
 #include <vector>
 #include <cstdio>
+#include <limits>
+#include <algorithm>
 
 #include <opencv2/core/core.hpp>
 #include <opencv2/highgui/highgui.hpp>
@@ -35,7 +37,9 @@ SimpleTracker::SimpleTracker()
 	m_nMinTrustAppearances = 5;
 	m_Horizon = 100.0;
 	m_CirclesResolution = 5.0;
+	m_bDebugLog = DEBUG_TRACKER;
 	UtilityHNS::UtilityH::GetTickCount(m_TrackTimer);
+	UtilityHNS::UtilityH::GetTickCount(m_LogTimer);
 }
 
 void SimpleTracker::InitSimpleTracker()
@@ -131,269 +135,233 @@ void SimpleTracker::DoOneStep(const WayPoint& currPose, const std::vector<Detect
 
 }
 
-void SimpleTracker::MatchClosest()
+double SimpleTracker::ContourRadius(const DetectedObject& obj)
 {
-	newObjects.clear();
-
-	std::cout << std::endl << std::endl  << std::endl;
-	while(m_DetectedObjects.size() > 0)
+	double r = 0;
+	for(unsigned int k = 0; k < obj.contour.size(); k++)
 	{
-		double iCloseset_track = -1;
-		double iCloseset_obj = -1;
-		double dCloseset = 99999999;
-		bool bFoundMatch = false;
+		double d = hypot(obj.contour.at(k).y - obj.center.pos.y, obj.contour.at(k).x - obj.center.pos.x);
+		if(d > r)
+			r = d;
+	}
+	return r;
+}
 
-		double size_diff = -1;
-		std::cout << std::endl;
+void SimpleTracker::BuildCostsList(const ASSOCIATION_COST_TYPE& cost_type)
+{
+	m_CostsLists.clear();
 
-		m_CostsLists.clear();
+	if(m_DetectedObjects.size() == 0 || m_TrackSimply.size() == 0)
+		return;
 
-		for(unsigned int jj = 0; jj < m_DetectedObjects.size(); jj++)
-		{
-			double object_size = sqrt(m_DetectedObjects.at(jj).w*m_DetectedObjects.at(jj).w + m_DetectedObjects.at(jj).l*m_DetectedObjects.at(jj).l + m_DetectedObjects.at(jj).h*m_DetectedObjects.at(jj).h);
+	// Gate the pairs through the tracks grid. A pair is a candidate when the centers
+	// are closer than the association distance or, for the contour costs, when
+	// one center can be inside the other object's contour.
+	bool bContour = cost_type != NORMALIZED_COST;
+	m_TracksGrid.Reset(m_MAX_ASSOCIATION_DISTANCE, m_TrackSimply.size());
 
-			for(unsigned int i = 0; i < m_TrackSimply.size(); i++)
-			{
-				double d = hypot(m_DetectedObjects.at(jj).center.pos.y-m_TrackSimply.at(i).obj.center.pos.y, m_DetectedObjects.at(jj).center.pos.x-m_TrackSimply.at(i).obj.center.pos.x);
-				double old_size = sqrt(m_TrackSimply.at(i).obj.w*m_TrackSimply.at(i).obj.w + m_TrackSimply.at(i).obj.l*m_TrackSimply.at(i).obj.l + m_TrackSimply.at(i).obj.h*m_TrackSimply.at(i).obj.h);
-				double obj_diff = fabs(object_size - old_size);
-
-				bool bInsidePolygon = (InsidePolygon(m_TrackSimply.at(i).obj.contour, m_DetectedObjects.at(jj).center.pos) == 1 || InsidePolygon(m_DetectedObjects.at(jj).contour, m_TrackSimply.at(i).obj.center.pos) == 1);
-
-				if(obj_diff < m_MAX_ASSOCIATION_SIZE_DIFF &&  bInsidePolygon)
-				 {
-					 bFoundMatch = true;
-					 iCloseset_track = i;
-					 iCloseset_obj = jj;
-					 size_diff = obj_diff;
-					 std::cout << "Polygon Size Match" << std::endl;
-					 break;
-				 }
-
-				if(obj_diff < m_MAX_ASSOCIATION_SIZE_DIFF && d < dCloseset)
-				{
-					dCloseset = d;
-					iCloseset_track = i;
-					iCloseset_obj = jj;
-					size_diff = obj_diff;
-					size_diff = obj_diff;
-				}
-			}
-
-			if(bFoundMatch)
-				break;
-		}
+	std::vector<double> tracks_size(m_TrackSimply.size());
+	for(unsigned int i = 0; i < m_TrackSimply.size(); i++)
+	{
+		const DetectedObject& t_obj = m_TrackSimply.at(i).obj;
+		double gate = m_MAX_ASSOCIATION_DISTANCE;
+		if(bContour)
+			gate = std::max(gate, ContourRadius(t_obj));
+		m_TracksGrid.Insert(i, t_obj.center.pos, gate);
+
+		if(cost_type == CONTOUR_PLANAR_SIZE_COST)
+			tracks_size.at(i) = hypot(t_obj.w, t_obj.l);
+		else
+			tracks_size.at(i) = sqrt(t_obj.w*t_obj.w + t_obj.l*t_obj.l + t_obj.h*t_obj.h);
+	}
 
-		if(iCloseset_obj != -1 && iCloseset_track != -1 && (dCloseset <= m_MAX_ASSOCIATION_DISTANCE || bFoundMatch == true))
-		{
-			std::cout << "MatchObj: " << m_TrackSimply.at(iCloseset_track).obj.id << ", MinD: " << dCloseset << ", SizeDiff: (" << size_diff <<  ")" << ", ObjI" << iCloseset_obj <<", TrackI: " << iCloseset_track << ", CMatch: " << bFoundMatch << std::endl;
+	double max_d = -1, min_d = 999999999;
+	double max_a = -1, min_a = 999999999;
+	double max_w = -1, min_w = 999999999;
+	double max_l = -1, min_l = 999999999;
+	double max_h = -1, min_h = 999999999;
 
-			m_DetectedObjects.at(iCloseset_obj).id = m_TrackSimply.at(iCloseset_track).obj.id;
-			MergeObjectAndTrack(m_TrackSimply.at(iCloseset_track), m_DetectedObjects.at(iCloseset_obj));
-			newObjects.push_back(m_TrackSimply.at(iCloseset_track));
-			m_TrackSimply.erase(m_TrackSimply.begin()+iCloseset_track);
-			m_DetectedObjects.erase(m_DetectedObjects.begin()+iCloseset_obj);
-		}
+	std::vector<int> candidates;
+	for(unsigned int jj = 0; jj < m_DetectedObjects.size(); jj++)
+	{
+		const DetectedObject& d_obj = m_DetectedObjects.at(jj);
+		double object_size = 0;
+		if(cost_type == CONTOUR_PLANAR_SIZE_COST)
+			object_size = hypot(d_obj.w, d_obj.l);
 		else
+			object_size = sqrt(d_obj.w*d_obj.w + d_obj.l*d_obj.l + d_obj.h*d_obj.h);
+
+		m_TracksGrid.Query(d_obj.center.pos, bContour ? ContourRadius(d_obj) : 0, candidates);
+
+		for(unsigned int ic = 0; ic < candidates.size(); ic++)
 		{
-			iTracksNumber = iTracksNumber + 1;
-			if(iCloseset_obj != -1)
-			{
-				m_DetectedObjects.at(iCloseset_obj).id = iTracksNumber;
-				KFTrackV track(m_DetectedObjects.at(iCloseset_obj).center.pos.x, m_DetectedObjects.at(iCloseset_obj).center.pos.y,m_DetectedObjects.at(iCloseset_obj).actual_yaw, m_DetectedObjects.at(iCloseset_obj).id, m_dt, m_nMinTrustAppearances);
-				track.obj = m_DetectedObjects.at(iCloseset_obj);
-				newObjects.push_back(track);
-				//std::cout << "NewObj: " << iTracksNumber  << ", MinD: " << dCloseset << ", MinS: " << min_size << ", ObjI:" << iCloseset_obj <<", TrackI: " << iCloseset_track << ", ContMatch: " << bFoundMatch << std::endl;
-				m_DetectedObjects.erase(m_DetectedObjects.begin()+iCloseset_obj);
-			}
-			else
+			int i = candidates.at(ic);
+			const DetectedObject& t_obj = m_TrackSimply.at(i).obj;
+
+			double d = hypot(d_obj.center.pos.y-t_obj.center.pos.y, d_obj.center.pos.x-t_obj.center.pos.x);
+			double obj_diff = fabs(object_size - tracks_size.at(i));
+
+			if(bContour)
 			{
-				m_DetectedObjects.at(0).id = iTracksNumber;
-				KFTrackV track(m_DetectedObjects.at(0).center.pos.x, m_DetectedObjects.at(0).center.pos.y,m_DetectedObjects.at(0).actual_yaw, m_DetectedObjects.at(0).id, m_dt, m_nMinTrustAppearances);
-				track.obj = m_DetectedObjects.at(0);
-				newObjects.push_back(track);
-				//std::cout << "NewObj: " << iTracksNumber  << ", MinD: " << dCloseset << ", MinS: " << min_size << ", ObjI:" << 0 <<", TrackI: " << iCloseset_track << ", ContMatch: " << bFoundMatch << std::endl;
-				m_DetectedObjects.erase(m_DetectedObjects.begin()+0);
+				if(obj_diff >= m_MAX_ASSOCIATION_SIZE_DIFF)
+					continue;
+
+				// contour matches always win over the distance only matches
+				CostRecordSet c(jj, i, d, obj_diff, 0, 0, 0, 0);
+				if(InsidePolygon(t_obj.contour, d_obj.center.pos) == 1 || InsidePolygon(d_obj.contour, t_obj.center.pos) == 1)
+					c.cost = 0.5 * d / (d + m_MAX_ASSOCIATION_DISTANCE);
+				else if(d <= m_MAX_ASSOCIATION_DISTANCE)
+					c.cost = 1.0 + d / m_MAX_ASSOCIATION_DISTANCE;
+				else
+					continue;
+
+				m_CostsLists.push_back(c);
+				continue;
 			}
-		}
-	}
 
-	m_TrackSimply = newObjects;
-}
+			if(d > m_MAX_ASSOCIATION_DISTANCE)
+				continue;
 
-void SimpleTracker::MatchClosestCost()
-{
-	newObjects.clear();
+			double w_diff = fabs(t_obj.w - d_obj.w);
+			double h_diff = fabs(t_obj.h - d_obj.h);
+			double l_diff = fabs(t_obj.l - d_obj.l);
 
-	//std::cout << std::endl << std::endl  << std::endl;
-	while(m_DetectedObjects.size() > 0)
-	{
-		//std::cout << std::endl;
-		double max_d = -1;
-		double min_d = 999999999;
-		double max_s = -1;
-		double min_s = 999999999;
-		double max_a = -1;
-		double min_a = 999999999;
-		double max_w = -1;
-		double min_w = 999999999;
-		double max_l = -1;
-		double min_l = 999999999;
-		double max_h = -1;
-		double min_h = 999999999;
-
-		m_CostsLists.clear();
-
-		for(unsigned int jj = 0; jj < m_DetectedObjects.size(); jj++)
-		{
-			double object_size = sqrt(m_DetectedObjects.at(jj).w*m_DetectedObjects.at(jj).w + m_DetectedObjects.at(jj).l*m_DetectedObjects.at(jj).l + m_DetectedObjects.at(jj).h*m_DetectedObjects.at(jj).h);
-
-			for(unsigned int i = 0; i < m_TrackSimply.size(); i++)
+			double a_diff = M_PI;
+			if(t_obj.bDirection)
 			{
-				double d = hypot(m_DetectedObjects.at(jj).center.pos.y-m_TrackSimply.at(i).obj.center.pos.y, m_DetectedObjects.at(jj).center.pos.x-m_TrackSimply.at(i).obj.center.pos.x);
-				double old_size = sqrt(m_TrackSimply.at(i).obj.w*m_TrackSimply.at(i).obj.w + m_TrackSimply.at(i).obj.l*m_TrackSimply.at(i).obj.l + m_TrackSimply.at(i).obj.h*m_TrackSimply.at(i).obj.h);
-				double obj_diff = fabs(object_size - old_size);
-				double w_diff = fabs(m_TrackSimply.at(i).obj.w - m_DetectedObjects.at(jj).w);
-				double h_diff = fabs(m_TrackSimply.at(i).obj.h - m_DetectedObjects.at(jj).h);
-				double l_diff = fabs(m_TrackSimply.at(i).obj.l - m_DetectedObjects.at(jj).l);
-
-				bool bDirectionMatch = false;
-				bool bSimilarSize = false;
-				double a_diff = M_PI;
-				if(m_TrackSimply.at(i).obj.bDirection)
+				double diff_y = d_obj.center.pos.y - t_obj.center.pos.y;
+				double diff_x = d_obj.center.pos.x - t_obj.center.pos.x ;
+				if(hypot(diff_y, diff_x) > 0.2)
 				{
-					double diff_y = m_DetectedObjects.at(jj).center.pos.y - m_TrackSimply.at(i).obj.center.pos.y;
-					double diff_x = m_DetectedObjects.at(jj).center.pos.x - m_TrackSimply.at(i).obj.center.pos.x ;
-					if(hypot(diff_y, diff_x) > 0.2)
-					{
-						double a = UtilityHNS::UtilityH::FixNegativeAngle(atan2(diff_y, diff_x));
-						a_diff = UtilityHNS::UtilityH::AngleBetweenTwoAnglesPositive(a,m_TrackSimply.at(i).obj.center.pos.a);
-						if(a_diff < m_MAX_ASSOCIATION_ANGLE_DIFF)
-							bDirectionMatch = true;
-					}
+					double a = UtilityHNS::UtilityH::FixNegativeAngle(atan2(diff_y, diff_x));
+					a_diff = UtilityHNS::UtilityH::AngleBetweenTwoAnglesPositive(a,t_obj.center.pos.a);
 				}
+			}
 
-				if(w_diff < m_MAX_ASSOCIATION_SIZE_DIFF/3.0 && h_diff < m_MAX_ASSOCIATION_SIZE_DIFF/3.0 && l_diff < m_MAX_ASSOCIATION_SIZE_DIFF/3.0)
-					bSimilarSize = true;
+			if(d > max_d) max_d = d; if(d < min_d) min_d = d;
+			if(w_diff > max_w) max_w = w_diff; if(w_diff < min_w) min_w = w_diff;
+			if(l_diff > max_l) max_l = l_diff; if(l_diff < min_l) min_l = l_diff;
+			if(h_diff > max_h) max_h = h_diff; if(h_diff < min_h) min_h = h_diff;
+			if(a_diff > max_a) max_a = a_diff; if(a_diff < min_a) min_a = a_diff;
 
-				if(d > max_d) max_d = d; if(d < min_d) min_d = d;
-				if(obj_diff > max_s) max_s = obj_diff; if(obj_diff < min_s) min_s = obj_diff;
-				if(w_diff > max_w) max_w = w_diff; if(w_diff < min_w) min_w = w_diff;
-				if(l_diff > max_l) max_l = l_diff; if(l_diff < min_l) min_l = l_diff;
-				if(h_diff > max_h) max_h = h_diff; if(h_diff < min_h) min_h = h_diff;
-				if(a_diff > max_a) max_a = a_diff; if(a_diff < min_a) min_a = a_diff;
+			m_CostsLists.push_back(CostRecordSet(jj, i, d, obj_diff, w_diff, l_diff, h_diff, a_diff));
+		}
+	}
 
-				m_CostsLists.push_back(CostRecordSet(jj, i, d, obj_diff, w_diff, l_diff, h_diff, a_diff));
+	if(bContour)
+		return;
 
-			//	std::cout << "Test: " << m_TrackSimply.at(i).obj.id << ", MinD: " << d << ", ObjS: " << obj_diff << ", Angle: " << a_diff << ", ObjI: " << jj << ", TrackI: " << i << std::endl;
-			}
+	// Normalize over the gated pairs, then keep only the acceptable ones
+	double d_v = max_d - min_d;
+	double w_v = max_w - min_w;
+	double l_v = max_l - min_l;
+	double h_v = max_h - min_h;
+	double a_v = max_a - min_a;
 
+	unsigned int nAccepted = 0;
+	for(unsigned int ic = 0 ; ic < m_CostsLists.size() ; ic++)
+	{
+		CostRecordSet& c = m_CostsLists.at(ic);
+		int actual_count = 0;
+		if(d_v != 0)
+		{
+			c.cost += c.distance_diff/d_v;
+			actual_count++;
 		}
 
-		// Normalize and find the minimum
-		std::vector<double> vs;
-
-		double d_v = max_d - min_d;
-		double w_v = max_w - min_w;
-		double l_v = max_l - min_l;
-		double h_v = max_h - min_h;
-		double a_v = max_a - min_a;
-		double s_v = max_s - min_s;
+		if(w_v != 0)
+		{
+			c.cost += c.width_diff/w_v;
+			actual_count++;
+		}
 
-		for(unsigned int ic = 0 ; ic < m_CostsLists.size() ; ic++)
+		if(l_v != 0)
 		{
-			int actual_count = 0;
-			if(d_v != 0)
-			{
-				m_CostsLists.at(ic).cost += m_CostsLists.at(ic).distance_diff/d_v;
-				actual_count++;
-			}
+			c.cost += c.length_diff/l_v;
+			actual_count++;
+		}
 
-			if(w_v != 0)
-			{
-				m_CostsLists.at(ic).cost += m_CostsLists.at(ic).width_diff/w_v;
-				actual_count++;
-			}
+		if(h_v != 0)
+		{
+			c.cost += c.height_diff/h_v;
+			actual_count++;
+		}
 
-			if(l_v != 0)
-			{
-				m_CostsLists.at(ic).cost += m_CostsLists.at(ic).length_diff/l_v;
-				actual_count++;
-			}
+		if(a_v != 0 && c.angle_diff < M_PI_2)
+		{
+			c.cost += c.angle_diff/a_v;
+			actual_count++;
+		}
+		else
+			c.angle_diff = 0;
 
-			if(h_v != 0)
-			{
-				m_CostsLists.at(ic).cost += m_CostsLists.at(ic).height_diff/h_v;
-				actual_count++;
-			}
+		if(actual_count > 0)
+			c.cost = c.cost / (double)actual_count;
 
-			if(a_v != 0 && m_CostsLists.at(ic).angle_diff < M_PI_2)
-			{
-				m_CostsLists.at(ic).cost += m_CostsLists.at(ic).angle_diff/a_v;
-				actual_count++;
-			}
-			else
-				m_CostsLists.at(ic).angle_diff = 0;
+		if(c.size_diff < m_MAX_ASSOCIATION_SIZE_DIFF && c.angle_diff < m_MAX_ASSOCIATION_ANGLE_DIFF)
+			m_CostsLists.at(nAccepted++) = c;
+	}
+	m_CostsLists.resize(nAccepted);
+}
 
-//			if(s_v != 0 )
-//			{
-//				m_CostsLists.at(ic).cost += m_CostsLists.at(ic).size_diff/s_v;
-//				actual_count++;
-//			}
+KFTrackV SimpleTracker::CreateTrack(DetectedObject& obj)
+{
+	iTracksNumber = iTracksNumber + 1;
+	obj.id = iTracksNumber;
+	KFTrackV track(obj.center.pos.x, obj.center.pos.y, obj.actual_yaw, obj.id, m_dt, m_nMinTrustAppearances);
+	track.obj = obj;
+	return track;
+}
 
+void SimpleTracker::MatchAndReplaceTracks(const ASSOCIATION_COST_TYPE& cost_type)
+{
+	BuildCostsList(cost_type);
+	HungarianAssignment::Solve(m_DetectedObjects.size(), m_TrackSimply.size(), m_CostsLists, m_ObjToTrack);
 
-			if(actual_count > 0)
-				m_CostsLists.at(ic).cost = m_CostsLists.at(ic).cost / (double)actual_count;
-		//	std::cout << "Cost = " << m_CostsLists.at(ic).cost << std::endl;
+	// Tracks that are not matched are dropped, every unmatched detection starts a new track
+	newObjects.clear();
+	newObjects.reserve(m_DetectedObjects.size());
+	int nMatched = 0;
+	for(unsigned int jj = 0; jj < m_DetectedObjects.size(); jj++)
+	{
+		int i = m_ObjToTrack.at(jj);
+		if(i >= 0)
+		{
+			m_DetectedObjects.at(jj).id = m_TrackSimply.at(i).obj.id;
+			MergeObjectAndTrack(m_TrackSimply.at(i), m_DetectedObjects.at(jj));
+			newObjects.push_back(m_TrackSimply.at(i));
+			nMatched++;
 		}
-
-		CostRecordSet min_set;
-		min_set.cost = 99999999;
-
-		for(unsigned int ic = 0 ; ic < m_CostsLists.size() ; ic++)
+		else
 		{
-			if(m_CostsLists.at(ic).cost < min_set.cost)
-				min_set = m_CostsLists.at(ic);
+			newObjects.push_back(CreateTrack(m_DetectedObjects.at(jj)));
 		}
+	}
 
+	LogAssociation(cost_type == NORMALIZED_COST ? "MatchClosestCost" : "MatchClosest", m_DetectedObjects.size(), m_TrackSimply.size(), nMatched);
 
-		if(min_set.i_obj != -1 && min_set.i_track != -1 &&  min_set.distance_diff <= m_MAX_ASSOCIATION_DISTANCE && min_set.size_diff < m_MAX_ASSOCIATION_SIZE_DIFF && min_set.angle_diff < m_MAX_ASSOCIATION_ANGLE_DIFF)
-		{
-		//	std::cout << "MatchObj: " << m_TrackSimply.at(min_set.i_track).obj.id << ", MinD: " << min_set.distance_diff << ", SizeDiff: (" << min_set.size_diff << ")" << ", AngDiff: " << min_set.angle_diff  << ", ObjI" << min_set.i_obj <<", TrackI: " << min_set.i_track << std::endl;
+	m_DetectedObjects.clear();
+	m_TrackSimply.swap(newObjects);
+}
 
-			m_DetectedObjects.at(min_set.i_obj).id = m_TrackSimply.at(min_set.i_track).obj.id;
-			MergeObjectAndTrack(m_TrackSimply.at(min_set.i_track), m_DetectedObjects.at(min_set.i_obj));
-			newObjects.push_back(m_TrackSimply.at(min_set.i_track));
-			m_TrackSimply.erase(m_TrackSimply.begin()+min_set.i_track);
-			m_DetectedObjects.erase(m_DetectedObjects.begin()+min_set.i_obj);
-		}
-		else
-		{
-			iTracksNumber = iTracksNumber + 1;
+void SimpleTracker::MatchClosest()
+{
+	MatchAndReplaceTracks(CONTOUR_SIZE_COST);
+}
 
-			if(min_set.i_obj != -1)
-			{
-				m_DetectedObjects.at(min_set.i_obj).id = iTracksNumber;
-				KFTrackV track(m_DetectedObjects.at(min_set.i_obj).center.pos.x, m_DetectedObjects.at(min_set.i_obj).center.pos.y,m_DetectedObjects.at(min_set.i_obj).actual_yaw, m_DetectedObjects.at(min_set.i_obj).id, m_dt, m_nMinTrustAppearances);
-				track.obj = m_DetectedObjects.at(min_set.i_obj);
-				newObjects.push_back(track);
+void SimpleTracker::MatchClosestCost()
+{
+	MatchAndReplaceTracks(NORMALIZED_COST);
+}
 
-				//std::cout << "NewMatch: " << iTracksNumber << ", "<< ", MinD: " << min_set.distance_diff << ", SizeDiff: (" << min_set.size_diff << ")" << ", AngDiff: " << min_set.angle_diff << ", ObjI" << min_set.i_obj <<", TrackI: " << min_set.i_track << std::endl;
-				m_DetectedObjects.erase(m_DetectedObjects.begin()+min_set.i_obj);
-			}
-			else
-			{
-				m_DetectedObjects.at(0).id = iTracksNumber;
-				KFTrackV track(m_DetectedObjects.at(0).center.pos.x, m_DetectedObjects.at(0).center.pos.y,m_DetectedObjects.at(0).actual_yaw, m_DetectedObjects.at(0).id, m_dt, m_nMinTrustAppearances);
-				track.obj = m_DetectedObjects.at(0);
-				newObjects.push_back(track);
-				//std::cout << "NewObj: " << iTracksNumber << ", "<< ", MinD: " << min_set.distance_diff << ", SizeDiff: (" << min_set.size_diff << ")" << ", AngDiff: " << min_set.angle_diff << ", ObjI" << min_set.i_obj <<", TrackI: " << min_set.i_track << std::endl;
-				m_DetectedObjects.erase(m_DetectedObjects.begin()+0);
-			}
-		}
-	}
+void SimpleTracker::LogAssociation(const char* stage, const int& nObjects, const int& nTracks, const int& nMatched)
+{
+	if(!m_bDebugLog || UtilityHNS::UtilityH::GetTimeDiffNow(m_LogTimer) < TRACKER_LOG_PERIOD)
+		return;
 
-	m_TrackSimply = newObjects;
+	UtilityHNS::UtilityH::GetTickCount(m_LogTimer);
+	std::cout << stage << ": Objects: " << nObjects << ", Tracks: " << nTracks << ", Candidates: " << m_CostsLists.size()
+			<< ", Matched: " << nMatched << ", New: " << nObjects - nMatched << std::endl;
 }
 
 void SimpleTracker::AssociateOnly()
@@ -449,82 +417,33 @@ void SimpleTracker::AssociateAndTrack()
 		m_TrackSimply.at(i).m_bUpdated = false;
 
 
-	std::cout << std::endl;
-	while(m_DetectedObjects.size() > 0)
-	{
-		double iCloseset_track = -1;
-		double iCloseset_obj = -1;
-		double dCloseset = 99999999;
-		bool bFoundMatch = false;
-		double min_size = -1;
-		std::cout << "DetObjSize: " <<  m_DetectedObjects.size() <<  ", TracksSize: " << m_TrackSimply.size() << std::endl;
-		for(unsigned int jj = 0; jj < m_DetectedObjects.size(); jj++)
-		{
-			double object_size = hypot(m_DetectedObjects.at(jj).w, m_DetectedObjects.at(jj).l);
-
-			for(unsigned int i = 0; i < m_TrackSimply.size(); i++)
-			{
-				double old_size = hypot(m_TrackSimply.at(i).obj.w, m_TrackSimply.at(i).obj.l);
-				double obj_diff = fabs(object_size - old_size);
-				double d = hypot(m_DetectedObjects.at(jj).center.pos.y-m_TrackSimply.at(i).obj.center.pos.y, m_DetectedObjects.at(jj).center.pos.x-m_TrackSimply.at(i).obj.center.pos.x);
-
-				std::cout << "Test: " << m_TrackSimply.at(i).obj.id << ", MinD: " << d << ", ObjS: " << object_size << ", ObjI: " << jj << ", TrackS: " << old_size << ", TrackI: " << i << std::endl;
-
-				if(obj_diff < m_MAX_ASSOCIATION_SIZE_DIFF && (InsidePolygon(m_TrackSimply.at(i).obj.contour, m_DetectedObjects.at(jj).center.pos) == 1 || InsidePolygon(m_DetectedObjects.at(jj).contour, m_TrackSimply.at(i).obj.center.pos) == 1) )
-				 {
-					 bFoundMatch = true;
-					 iCloseset_track = i;
-					 iCloseset_obj = jj;
-					 break;
-				 }
+	BuildCostsList(CONTOUR_PLANAR_SIZE_COST);
+	HungarianAssignment::Solve(m_DetectedObjects.size(), m_TrackSimply.size(), m_CostsLists, m_ObjToTrack);
 
-				if(obj_diff < m_MAX_ASSOCIATION_SIZE_DIFF && d < dCloseset)
-				{
-					dCloseset = d;
-					iCloseset_track = i;
-					iCloseset_obj = jj;
-					min_size = obj_diff;
-				}
-			}
-
-			if(bFoundMatch)
-				break;
-		}
-
-		if(iCloseset_obj != -1 && iCloseset_track != -1 && (dCloseset <= m_MAX_ASSOCIATION_DISTANCE || bFoundMatch == true))
+	// Unmatched tracks are kept until CleanOldTracks forgets them
+	int nTracks = m_TrackSimply.size();
+	int nMatched = 0;
+	for(unsigned int jj = 0; jj < m_DetectedObjects.size(); jj++)
+	{
+		int i = m_ObjToTrack.at(jj);
+		if(i >= 0)
 		{
-			std::cout << "MatchObj: " << m_TrackSimply.at(iCloseset_track).obj.id << ", MinD: " << dCloseset << ", MinS: " << min_size << ", ObjI" << iCloseset_obj <<", TrackI: " << iCloseset_track << ", ContourMatch: " << bFoundMatch << std::endl;
-			m_DetectedObjects.at(iCloseset_obj).id = m_TrackSimply.at(iCloseset_track).obj.id;
-			MergeObjectAndTrack(m_TrackSimply.at(iCloseset_track), m_DetectedObjects.at(iCloseset_obj));
-			AssociateToRegions(m_TrackSimply.at(iCloseset_track));
-			m_DetectedObjects.erase(m_DetectedObjects.begin()+iCloseset_obj);
+			m_DetectedObjects.at(jj).id = m_TrackSimply.at(i).obj.id;
+			MergeObjectAndTrack(m_TrackSimply.at(i), m_DetectedObjects.at(jj));
+			AssociateToRegions(m_TrackSimply.at(i));
+			nMatched++;
 		}
 		else
 		{
-			iTracksNumber = iTracksNumber + 1;
-			if(iCloseset_obj != -1)
-			{
-				m_DetectedObjects.at(iCloseset_obj).id = iTracksNumber;
-				KFTrackV track(m_DetectedObjects.at(iCloseset_obj).center.pos.x, m_DetectedObjects.at(iCloseset_obj).center.pos.y,m_DetectedObjects.at(iCloseset_obj).actual_yaw, m_DetectedObjects.at(iCloseset_obj).id, m_dt, m_nMinTrustAppearances);
-				track.obj = m_DetectedObjects.at(iCloseset_obj);
-				AssociateToRegions(track);
-				m_TrackSimply.push_back(track);
-				std::cout << "UnMachedObj: " << iTracksNumber  << ", MinD: " << dCloseset << ", MinS: " << min_size << ", ObjI:" << iCloseset_obj <<", TrackI: " << iCloseset_track << ", ContMatch: " << bFoundMatch << std::endl;
-				m_DetectedObjects.erase(m_DetectedObjects.begin()+iCloseset_obj);
-			}
-			else
-			{
-				m_DetectedObjects.at(0).id = iTracksNumber;
-				KFTrackV track(m_DetectedObjects.at(0).center.pos.x, m_DetectedObjects.at(0).center.pos.y,m_DetectedObjects.at(0).actual_yaw, m_DetectedObjects.at(0).id, m_dt, m_nMinTrustAppearances);
-				track.obj = m_DetectedObjects.at(0);
-				AssociateToRegions(track);
-				m_TrackSimply.push_back(track);
-				std::cout << "NewObj: " << iTracksNumber  << ", MinD: " << dCloseset << ", MinS: " << min_size << ", ObjI:" << 0 <<", TrackI: " << iCloseset_track << ", ContMatch: " << bFoundMatch << std::endl;
-				m_DetectedObjects.erase(m_DetectedObjects.begin()+0);
-			}
+			KFTrackV track = CreateTrack(m_DetectedObjects.at(jj));
+			AssociateToRegions(track);
+			m_TrackSimply.push_back(track);
 		}
 	}
 
+	LogAssociation("AssociateAndTrack", m_DetectedObjects.size(), nTracks, nMatched);
+	m_DetectedObjects.clear();
+
 	for(unsigned int i =0; i< m_TrackSimply.size(); i++)
 	{
 		//if(m_TrackSimply.at(i).m_bUpdated)
@@ -615,4 +534,242 @@ int SimpleTracker::InsidePolygon(const std::vector<GPSPoint>& polygon,const GPSP
 	else
 		return 1;
 }
+
+TrackGrid::TrackGrid()
+{
+	m_CellSize = 1.0;
+	m_QueryStamp = 0;
+}
+
+void TrackGrid::Reset(const double& cell_size, const int& nTracks)
+{
+	m_CellSize = std::max(cell_size, 0.5);
+	m_Cells.clear();
+	m_LastQuery.assign(nTracks, -1);
+	m_QueryStamp = 0;
+}
+
+long long TrackGrid::CellKey(const int& ix, const int& iy) const
+{
+	return ((long long)ix << 32) ^ (long long)(unsigned int)iy;
+}
+
+void TrackGrid::Insert(const int& index, const GPSPoint& p, const double& radius)
+{
+	int min_x = floor((p.x - radius)/m_CellSize);
+	int max_x = floor((p.x + radius)/m_CellSize);
+	int min_y = floor((p.y - radius)/m_CellSize);
+	int max_y = floor((p.y + radius)/m_CellSize);
+
+	for(int ix = min_x; ix <= max_x; ix++)
+		for(int iy = min_y; iy <= max_y; iy++)
+			m_Cells[CellKey(ix, iy)].push_back(index);
+}
+
+void TrackGrid::Query(const GPSPoint& p, const double& radius, std::vector<int>& candidates)
+{
+	candidates.clear();
+	m_QueryStamp++;
+
+	int min_x = floor((p.x - radius)/m_CellSize);
+	int max_x = floor((p.x + radius)/m_CellSize);
+	int min_y = floor((p.y - radius)/m_CellSize);
+	int max_y = floor((p.y + radius)/m_CellSize);
+
+	for(int ix = min_x; ix <= max_x; ix++)
+	{
+		for(int iy = min_y; iy <= max_y; iy++)
+		{
+			std::unordered_map<long long, std::vector<int> >::const_iterator it = m_Cells.find(CellKey(ix, iy));
+			if(it == m_Cells.end())
+				continue;
+
+			for(unsigned int k = 0; k < it->second.size(); k++)
+			{
+				int index = it->second.at(k);
+				if(m_LastQuery.at(index) != m_QueryStamp)
+				{
+					m_LastQuery.at(index) = m_QueryStamp;
+					candidates.push_back(index);
+				}
+			}
+		}
+	}
+
+	std::sort(candidates.begin(), candidates.end());
+}
+
+int HungarianAssignment::FindRoot(std::vector<int>& parents, int i)
+{
+	while(parents.at(i) != i)
+	{
+		parents.at(i) = parents.at(parents.at(i));
+		i = parents.at(i);
+	}
+	return i;
+}
+
+void HungarianAssignment::Solve(const int& nObjects, const int& nTracks, const std::vector<CostRecordSet>& costs, std::vector<int>& objToTrack)
+{
+	objToTrack.assign(nObjects, -1);
+	if(costs.size() == 0)
+		return;
+
+	// Split the candidates into independent groups, objects are nodes [0, nObjects)
+	// and tracks are nodes [nObjects, nObjects+nTracks)
+	std::vector<int> parents(nObjects + nTracks);
+	for(unsigned int i = 0; i < parents.size(); i++)
+		parents.at(i) = i;
+
+	for(unsigned int ic = 0; ic < costs.size(); ic++)
+	{
+		int r1 = FindRoot(parents, costs.at(ic).i_obj);
+		int r2 = FindRoot(parents, nObjects + costs.at(ic).i_track);
+		if(r1 != r2)
+			parents.at(r1) = r2;
+	}
+
+	std::vector<int> group_index(nObjects + nTracks, -1);
+	std::vector<std::vector<int> > group_costs;
+	for(unsigned int ic = 0; ic < costs.size(); ic++)
+	{
+		int root = FindRoot(parents, costs.at(ic).i_obj);
+		if(group_index.at(root) < 0)
+		{
+			group_index.at(root) = group_costs.size();
+			group_costs.push_back(std::vector<int>());
+		}
+		group_costs.at(group_index.at(root)).push_back(ic);
+	}
+
+	std::vector<int> local_index(nObjects + nTracks, -1);
+	std::vector<int> rows, cols, rowToCol;
+	std::vector<std::vector<double> > dense;
+
+	for(unsigned int ig = 0; ig < group_costs.size(); ig++)
+	{
+		const std::vector<int>& group = group_costs.at(ig);
+
+		if(group.size() == 1)
+		{
+			objToTrack.at(costs.at(group.at(0)).i_obj) = costs.at(group.at(0)).i_track;
+			continue;
+		}
+
+		rows.clear();
+		cols.clear();
+		for(unsigned int k = 0; k < group.size(); k++)
+		{
+			const CostRecordSet& c = costs.at(group.at(k));
+			if(local_index.at(c.i_obj) < 0)
+			{
+				local_index.at(c.i_obj) = rows.size();
+				rows.push_back(c.i_obj);
+			}
+			if(local_index.at(nObjects + c.i_track) < 0)
+			{
+				local_index.at(nObjects + c.i_track) = cols.size();
+				cols.push_back(c.i_track);
+			}
+		}
+
+		// Missing pairs get a cost larger than any full assignment of real pairs
+		double max_cost = 0;
+		for(unsigned int k = 0; k < group.size(); k++)
+			max_cost = std::max(max_cost, costs.at(group.at(k)).cost);
+		double no_pair_cost = (max_cost + 1.0) * (group.size() + 1);
+
+		int n = std::max(rows.size(), cols.size());
+		dense.assign(n, std::vector<double>(n, no_pair_cost));
+		std::vector<std::vector<bool> > valid(n, std::vector<bool>(n, false));
+		for(unsigned int k = 0; k < group.size(); k++)
+		{
+			const CostRecordSet& c = costs.at(group.at(k));
+			int r = local_index.at(c.i_obj);
+			int l = local_index.at(nObjects + c.i_track);
+			dense.at(r).at(l) = c.cost;
+			valid.at(r).at(l) = true;
+		}
+
+		SolveDense(dense, rowToCol);
+
+		for(unsigned int r = 0; r < rows.size(); r++)
+		{
+			int l = rowToCol.at(r);
+			if(l >= 0 && l < (int)cols.size() && valid.at(r).at(l))
+				objToTrack.at(rows.at(r)) = cols.at(l);
+		}
+
+		for(unsigned int r = 0; r < rows.size(); r++)
+			local_index.at(rows.at(r)) = -1;
+		for(unsigned int l = 0; l < cols.size(); l++)
+			local_index.at(nObjects + cols.at(l)) = -1;
+	}
+}
+
+void HungarianAssignment::SolveDense(const std::vector<std::vector<double> >& cost, std::vector<int>& rowToCol)
+{
+	// Shortest augmenting path version with row/column potentials, O(n^3)
+	int n = cost.size();
+	const double inf = std::numeric_limits<double>::max();
+	std::vector<double> u(n+1, 0), v(n+1, 0), minv(n+1);
+	std::vector<int> p(n+1, 0), way(n+1, 0);
+	std::vector<bool> used(n+1);
+
+	for(int i = 1; i <= n; i++)
+	{
+		p.at(0) = i;
+		int j0 = 0;
+		std::fill(minv.begin(), minv.end(), inf);
+		std::fill(used.begin(), used.end(), false);
+		do
+		{
+			used.at(j0) = true;
+			int i0 = p.at(j0);
+			int j1 = 0;
+			double delta = inf;
+			for(int j = 1; j <= n; j++)
+			{
+				if(used.at(j))
+					continue;
+				double cur = cost.at(i0-1).at(j-1) - u.at(i0) - v.at(j);
+				if(cur < minv.at(j))
+				{
+					minv.at(j) = cur;
+					way.at(j) = j0;
+				}
+				if(minv.at(j) < delta)
+				{
+					delta = minv.at(j);
+					j1 = j;
+				}
+			}
+			for(int j = 0; j <= n; j++)
+			{
+				if(used.at(j))
+				{
+					u.at(p.at(j)) += delta;
+					v.at(j) -= delta;
+				}
+				else
+					minv.at(j) -= delta;
+			}
+			j0 = j1;
+		}
+		while(p.at(j0) != 0);
+
+		do
+		{
+			int j1 = way.at(j0);
+			p.at(j0) = p.at(j1);
+			j0 = j1;
+		}
+		while(j0 != 0);
+	}
+
+	rowToCol.assign(n, -1);
+	for(int j = 1; j <= n; j++)
+		if(p.at(j) > 0)
+			rowToCol.at(p.at(j)-1) = j-1;
+}
 }
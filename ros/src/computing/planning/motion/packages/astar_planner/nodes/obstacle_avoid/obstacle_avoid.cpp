@@ -137,6 +137,7 @@ int main(int argc, char** argv)
 
   // variables for avoidance
   autoware_msgs::lane avoid_lane;
+  ClosestWaypointTracker avoid_lane_tracker;
   int end_of_avoid_index = -1;
   bool avoidance = false;
   while (ros::ok())
@@ -147,7 +148,7 @@ int main(int argc, char** argv)
 
     // We switch 2 waypoints, original path and avoiding path
     if (avoidance)
-      closest_waypoint = getClosestWaypoint(avoid_lane, search_info.getCurrentPose().pose);
+      closest_waypoint = avoid_lane_tracker.update(avoid_lane, search_info.getCurrentPose().pose);
     else
       closest_waypoint = search_info.getClosestWaypointIndex();
 
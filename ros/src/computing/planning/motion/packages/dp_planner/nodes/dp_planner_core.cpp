@@ -414,6 +414,10 @@ void PlannerX::UpdatePlanningParams()
 
 	nh.getParam("/dp_planner/enableLaneChange", params.enableLaneChange);
 	nh.getParam("/dp_planner/enabTrajectoryVelocities", params.enabTrajectoryVelocities);
+	nh.getParam("/dp_planner/costThreads", params.costThreads);
+	nh.getParam("/dp_planner/enableObstaclePrediction", params.enableObstaclePrediction);
+	nh.getParam("/dp_planner/predictionThreads", params.predictionThreads);
+	nh.getParam("/dp_planner/predictionCacheMargin", params.predictionCacheMargin);
 
 	nh.getParam("/dp_planner/enableObjectTracking", m_bEnableTracking);
 	nh.getParam("/dp_planner/enableOutsideControl", m_bEnableOutsideControl);
@@ -892,12 +896,14 @@ void PlannerX::PlannerMainLoop()
 		{
 			bKmlMapLoaded = true;
 			PlannerHNS::MappingHelpers::LoadKML(m_KmlMapPath, m_Map);
+			m_LocalPlanner.m_TrajectoryPredictionForMovingObstacles.ResetPredictionCache();
 			//sub_WayPlannerPaths = nh.subscribe("/lane_waypoints_array", 	10,		&PlannerX::callbackGetWayPlannerPath, 	this);
 		}
 		else if(m_MapSource == MAP_FOLDER && !bKmlMapLoaded)
 		{
 			bKmlMapLoaded = true;
 			PlannerHNS::MappingHelpers::ConstructRoadNetworkFromDataFiles(m_KmlMapPath, m_Map, true);
+			m_LocalPlanner.m_TrajectoryPredictionForMovingObstacles.ResetPredictionCache();
 		}
 		else if(m_MapSource == MAP_AUTOWARE)
 		{
@@ -907,6 +913,7 @@ void PlannerX::PlannerMainLoop()
 				UtilityHNS::UtilityH::GetTickCount(timerTemp);
 				 m_AwMap.bDtLanes = m_AwMap.bLanes = m_AwMap.bPoints = false;
 				 RosHelpers::UpdateRoadMap(m_AwMap,m_Map);
+				 m_LocalPlanner.m_TrajectoryPredictionForMovingObstacles.ResetPredictionCache();
 				 std::cout << "Converting Vector Map Time : " <<UtilityHNS::UtilityH::GetTimeDiffNow(timerTemp) << std::endl;
 				 //sub_WayPlannerPaths = nh.subscribe("/lane_waypoints_array", 	10,		&PlannerX::callbackGetWayPlannerPath, 	this);
 			 }
@@ -101,6 +101,7 @@ static double g_look_ahead_threshold_calc_ratio = 2.0;
 static double g_minimum_look_ahead_threshold = 6.0; // the next waypoint must be outside of this threshold.
 
 static WayPoints g_current_waypoints;
+static ClosestWaypointTracker g_closest_waypoint_tracker;
 
 static void ConfigCallback(const autoware_msgs::ConfigWaypointFollowerConstPtr &config)
 {
@@ -596,7 +597,7 @@ int main(int argc, char **argv)
     }
 
     // Get the closest waypoinmt
-    int closest_waypoint = getClosestWaypoint(g_current_waypoints.getCurrentWaypoints(), g_current_pose.pose);
+    int closest_waypoint = g_closest_waypoint_tracker.update(g_current_waypoints.getCurrentWaypoints(), g_current_pose.pose);
     ROS_INFO_STREAM("closest waypoint = " << closest_waypoint);
 
       // If the current  waypoint has a valid index
@@ -68,6 +68,7 @@ int g_obstacle_waypoint = -1;
 double g_deceleration_search_distance = 30;
 double g_search_distance = 60;
 int g_closest_waypoint = -1;
+ClosestWaypointTracker g_closest_waypoint_tracker;
 double g_current_vel = 0.0;  // (m/s) subscribe estimated_vel
 CrossWalk vmap;
 ObstaclePoints g_obstacle;
@@ -857,7 +858,7 @@ int main(int argc, char **argv)
       continue;
     }
 
-    g_closest_waypoint = getClosestWaypoint(g_path_change.getCurrentWaypoints(), g_control_pose.pose);
+    g_closest_waypoint = g_closest_waypoint_tracker.update(g_path_change.getCurrentWaypoints(), g_control_pose.pose);
 
     std_msgs::Int32 closest_waypoint;
     closest_waypoint.data = g_closest_waypoint;
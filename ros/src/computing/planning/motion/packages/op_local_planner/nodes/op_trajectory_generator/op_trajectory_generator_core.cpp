@@ -99,6 +99,9 @@ void TrajectoryGen::UpdatePlanningParams(ros::NodeHandle& _nh)
 	else
 		m_PlanningParams.rollOutNumber = 0;
 
+	_nh.getParam("/op_trajectory_generator/smoothingMaxIterations", m_PlanningParams.smoothingMaxIterations);
+	_nh.getParam("/op_trajectory_generator/rollOutThreads", m_PlanningParams.rollOutThreads);
+
 	_nh.getParam("/op_trajectory_generator/horizonDistance", m_PlanningParams.horizonDistance);
 	_nh.getParam("/op_trajectory_generator/minFollowingDistance", m_PlanningParams.minFollowingDistance);
 	_nh.getParam("/op_trajectory_generator/minDistanceToAvoid", m_PlanningParams.minDistanceToAvoid);
@@ -278,7 +281,9 @@ void TrajectoryGen::MainLoop()
 								m_PlanningParams.speedProfileFactor,
 								m_PlanningParams.enableHeadingSmoothing,
 								-1 , -1,
-								m_RollOuts, sampledPoints_debug);
+								m_RollOuts, sampledPoints_debug,
+								m_PlanningParams.smoothingMaxIterations,
+								m_PlanningParams.rollOutThreads);
 		}
 		else
 			sub_GlobalPlannerPaths = nh.subscribe("/lane_waypoints_array", 	1,		&TrajectoryGen::callbackGetGlobalPlannerPath, 	this);
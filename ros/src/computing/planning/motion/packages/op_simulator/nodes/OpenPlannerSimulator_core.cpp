@@ -583,6 +583,7 @@ void OpenPlannerSimulator::PlannerMainLoop()
 		{
 			m_bMap = true;
 			PlannerHNS::MappingHelpers::LoadKML(m_SimParams.KmlMapPath, m_Map);
+			m_LocalPlanner.m_TrajectoryPredictionForMovingObstacles.ResetPredictionCache();
 			if(!m_SimParams.bRandomStart)
 				InitializeSimuCar(m_SimParams.startPose);
 		}
@@ -590,6 +591,7 @@ void OpenPlannerSimulator::PlannerMainLoop()
 		{
 			m_bMap = true;
 			PlannerHNS::MappingHelpers::ConstructRoadNetworkFromDataFiles(m_SimParams.KmlMapPath, m_Map, true);
+			m_LocalPlanner.m_TrajectoryPredictionForMovingObstacles.ResetPredictionCache();
 			if(!m_SimParams.bRandomStart)
 				InitializeSimuCar(m_SimParams.startPose);
 		}
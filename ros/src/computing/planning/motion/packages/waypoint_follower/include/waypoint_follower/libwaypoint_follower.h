@@ -35,6 +35,8 @@
 #include <iostream>
 #include <sstream>
 #include <fstream>
+#include <unordered_map>
+#include <vector>
 
 // ROS header
 #include <tf/transform_broadcaster.h>
@@ -61,7 +63,7 @@ public:
   geometry_msgs::Quaternion getWaypointOrientation(int waypoint) const;
   geometry_msgs::Pose getWaypointPose(int waypoint) const;
   double getWaypointVelocityMPS(int waypoint) const;
-  autoware_msgs::lane getCurrentWaypoints() const
+  const autoware_msgs::lane &getCurrentWaypoints() const
   {
     return current_waypoints_;
   }
@@ -100,4 +102,41 @@ int getClosestWaypoint(const autoware_msgs::lane &current_path, geometry_msgs::P
 bool getLinearEquation(geometry_msgs::Point start, geometry_msgs::Point end, double *a, double *b, double *c);
 double getDistanceBetweenLineAndPoint(geometry_msgs::Point point, double sa, double b, double c);
 double getRelativeAngle(geometry_msgs::Pose waypoint_pose, geometry_msgs::Pose vehicle_pose);
+
+// Closest waypoint search that remembers the previous result.
+// While the path is unchanged, only waypoints up to window_length [m] of arc length ahead of the previous closest
+// waypoint are examined. A new path or a lost track (relocalization) falls back to a search over a grid index of the
+// path, which gives the same result as getClosestWaypoint().
+class ClosestWaypointTracker
+{
+public:
+  ClosestWaypointTracker(double search_distance = 5.0, double window_length = 30.0);
+  int update(const autoware_msgs::lane &current_path, const geometry_msgs::Pose &current_pose);
+  void reset();
+  int getClosestWaypoint() const
+  {
+    return closest_waypoint_;
+  }
+
+private:
+  bool isSamePath(const autoware_msgs::lane &current_path) const;
+  void indexPath(const autoware_msgs::lane &current_path);
+  bool isCandidate(const autoware_msgs::lane &current_path, int waypoint, const geometry_msgs::Pose &current_pose,
+                   double *distance) const;
+  int searchWindow(const autoware_msgs::lane &current_path, const geometry_msgs::Pose &current_pose) const;
+  int searchGlobal(const autoware_msgs::lane &current_path, const geometry_msgs::Pose &current_pose) const;
+  long long cellKey(int x, int y) const;
+
+  double search_distance_;
+  double window_length_;
+  int closest_waypoint_;
+
+  // signature of the indexed path
+  int path_size_;
+  geometry_msgs::Point path_front_;
+  geometry_msgs::Point path_back_;
+
+  std::vector<double> arc_length_;                          // cumulative distance along the path
+  std::unordered_map<long long, std::vector<int> > grid_;  // waypoint indices per search_distance_ cell
+};
 #endif
@@ -30,6 +30,9 @@
 
 #include "waypoint_follower/libwaypoint_follower.h"
 
+#include <algorithm>
+#include <cmath>
+
 int WayPoints::getSize() const
 {
   if (current_waypoints_.waypoints.empty())
@@ -171,73 +174,206 @@ double getRelativeAngle(geometry_msgs::Pose waypoint_pose, geometry_msgs::Pose v
   return angle;
 }
 
+static bool isFrontWaypoint(const autoware_msgs::lane &current_path, int waypoint,
+                            const geometry_msgs::Pose &current_pose)
+{
+  return calcRelativeCoordinate(current_path.waypoints[waypoint].pose.pose.position, current_pose).x >= 0;
+}
+
+// search every waypoint, used when no candidate is found near the current pose
+static int getClosestFrontWaypoint(const autoware_msgs::lane &current_path, const geometry_msgs::Pose &current_pose)
+{
+  ROS_INFO("no candidate. search closest waypoint from all waypoints...");
+  int waypoint_min = -1;
+  double distance_min = DBL_MAX;
+  for (int i = 1; i < static_cast<int>(current_path.waypoints.size()); i++)
+  {
+    if (!isFrontWaypoint(current_path, i, current_pose))
+      continue;
+
+    double d = getPlaneDistance(current_path.waypoints[i].pose.pose.position, current_pose.position);
+    if (d < distance_min)
+    {
+      waypoint_min = i;
+      distance_min = d;
+    }
+  }
+  return waypoint_min;
+}
+
 // get closest waypoint from current pose
 int getClosestWaypoint(const autoware_msgs::lane &current_path, geometry_msgs::Pose current_pose)
 {
-  WayPoints wp;
-  wp.setPath(current_path);
-
-  if (wp.isEmpty())
+  if (current_path.waypoints.empty())
     return -1;
 
   // search closest candidate within a certain meter
   double search_distance = 5.0;
-  std::vector<int> waypoint_candidates;
-  for (int i = 1; i < wp.getSize(); i++)
+  double angle_threshold = 90;
+  int waypoint_min = -1;
+  double distance_min = DBL_MAX;
+  for (int i = 1; i < static_cast<int>(current_path.waypoints.size()); i++)
   {
-    if (getPlaneDistance(wp.getWaypointPosition(i), current_pose.position) > search_distance)
+    double d = getPlaneDistance(current_path.waypoints[i].pose.pose.position, current_pose.position);
+    if (d > search_distance || d >= distance_min)
       continue;
 
-    if (!wp.isFront(i, current_pose))
+    if (!isFrontWaypoint(current_path, i, current_pose))
       continue;
 
-    double angle_threshold = 90;
-    if (getRelativeAngle(wp.getWaypointPose(i), current_pose) > angle_threshold)
+    if (getRelativeAngle(current_path.waypoints[i].pose.pose, current_pose) > angle_threshold)
       continue;
 
-    waypoint_candidates.push_back(i);
+    waypoint_min = i;
+    distance_min = d;
+  }
+
+  if (waypoint_min != -1)
+    return waypoint_min;
+
+  // if there is no candidate...
+  return getClosestFrontWaypoint(current_path, current_pose);
+}
+
+ClosestWaypointTracker::ClosestWaypointTracker(double search_distance, double window_length)
+  : search_distance_(search_distance), window_length_(window_length), closest_waypoint_(-1), path_size_(0)
+{
+}
+
+void ClosestWaypointTracker::reset()
+{
+  closest_waypoint_ = -1;
+  path_size_ = 0;
+  arc_length_.clear();
+  grid_.clear();
+}
+
+int ClosestWaypointTracker::update(const autoware_msgs::lane &current_path, const geometry_msgs::Pose &current_pose)
+{
+  if (current_path.waypoints.empty())
+  {
+    reset();
+    return -1;
   }
 
-  // get closest waypoint from candidates
-  if (!waypoint_candidates.empty())
+  if (!isSamePath(current_path))
   {
-    int waypoint_min = -1;
-    double distance_min = DBL_MAX;
-    for (auto el : waypoint_candidates)
+    indexPath(current_path);
+    closest_waypoint_ = -1;
+  }
+
+  int closest = (closest_waypoint_ > 0) ? searchWindow(current_path, current_pose) : -1;
+  if (closest == -1)
+    closest = searchGlobal(current_path, current_pose);
+
+  closest_waypoint_ = closest;
+  return closest_waypoint_;
+}
+
+bool ClosestWaypointTracker::isSamePath(const autoware_msgs::lane &current_path) const
+{
+  if (static_cast<int>(current_path.waypoints.size()) != path_size_)
+    return false;
+
+  const geometry_msgs::Point &front = current_path.waypoints.front().pose.pose.position;
+  const geometry_msgs::Point &back = current_path.waypoints.back().pose.pose.position;
+  return front.x == path_front_.x && front.y == path_front_.y && front.z == path_front_.z && back.x == path_back_.x &&
+         back.y == path_back_.y && back.z == path_back_.z;
+}
+
+long long ClosestWaypointTracker::cellKey(int x, int y) const
+{
+  return (static_cast<long long>(x) << 32) ^ static_cast<unsigned int>(y);
+}
+
+void ClosestWaypointTracker::indexPath(const autoware_msgs::lane &current_path)
+{
+  path_size_ = current_path.waypoints.size();
+  path_front_ = current_path.waypoints.front().pose.pose.position;
+  path_back_ = current_path.waypoints.back().pose.pose.position;
+
+  arc_length_.assign(path_size_, 0.0);
+  grid_.clear();
+  for (int i = 0; i < path_size_; i++)
+  {
+    const geometry_msgs::Point &p = current_path.waypoints[i].pose.pose.position;
+    if (i > 0)
+      arc_length_[i] = arc_length_[i - 1] + getPlaneDistance(current_path.waypoints[i - 1].pose.pose.position, p);
+
+    grid_[cellKey(floor(p.x / search_distance_), floor(p.y / search_distance_))].push_back(i);
+  }
+}
+
+bool ClosestWaypointTracker::isCandidate(const autoware_msgs::lane &current_path, int waypoint,
+                                         const geometry_msgs::Pose &current_pose, double *distance) const
+{
+  *distance = getPlaneDistance(current_path.waypoints[waypoint].pose.pose.position, current_pose.position);
+  if (*distance > search_distance_)
+    return false;
+
+  if (!isFrontWaypoint(current_path, waypoint, current_pose))
+    return false;
+
+  double angle_threshold = 90;
+  return getRelativeAngle(current_path.waypoints[waypoint].pose.pose, current_pose) <= angle_threshold;
+}
+
+// search forward from the previous closest waypoint within window_length_
+int ClosestWaypointTracker::searchWindow(const autoware_msgs::lane &current_path,
+                                         const geometry_msgs::Pose &current_pose) const
+{
+  int waypoint_min = -1;
+  double distance_min = DBL_MAX;
+  double window_end = arc_length_[closest_waypoint_] + window_length_;
+  for (int i = std::max(1, closest_waypoint_ - 1); i < path_size_ && arc_length_[i] <= window_end; i++)
+  {
+    double d;
+    if (isCandidate(current_path, i, current_pose, &d) && d < distance_min)
     {
-      // ROS_INFO("closest_candidates : %d",el);
-      double d = getPlaneDistance(wp.getWaypointPosition(el), current_pose.position);
-      if (d < distance_min)
-      {
-        waypoint_min = el;
-        distance_min = d;
-      }
+      waypoint_min = i;
+      distance_min = d;
     }
-    return waypoint_min;
   }
-  else
+  return waypoint_min;
+}
+
+// candidates are within search_distance_, so only the 3x3 cells around the pose need to be examined
+int ClosestWaypointTracker::searchGlobal(const autoware_msgs::lane &current_path,
+                                         const geometry_msgs::Pose &current_pose) const
+{
+  int cx = floor(current_pose.position.x / search_distance_);
+  int cy = floor(current_pose.position.y / search_distance_);
+
+  int waypoint_min = -1;
+  double distance_min = DBL_MAX;
+  for (int x = cx - 1; x <= cx + 1; x++)
   {
-    ROS_INFO("no candidate. search closest waypoint from all waypoints...");
-    // if there is no candidate...
-    int waypoint_min = -1;
-    double distance_min = DBL_MAX;
-    for (int i = 1; i < wp.getSize(); i++)
+    for (int y = cy - 1; y <= cy + 1; y++)
     {
-      if (!wp.isFront(i, current_pose))
+      std::unordered_map<long long, std::vector<int> >::const_iterator cell = grid_.find(cellKey(x, y));
+      if (cell == grid_.end())
         continue;
 
-      // if (!wp.isValid(i, current_pose))
-      //  continue;
-
-      double d = getPlaneDistance(wp.getWaypointPosition(i), current_pose.position);
-      if (d < distance_min)
+      for (int i : cell->second)
       {
-        waypoint_min = i;
-        distance_min = d;
+        double d;
+        if (i == 0 || !isCandidate(current_path, i, current_pose, &d))
+          continue;
+
+        // ties go to the lower index, as in getClosestWaypoint()
+        if (d < distance_min || (d == distance_min && i < waypoint_min))
+        {
+          waypoint_min = i;
+          distance_min = d;
+        }
       }
     }
-    return waypoint_min;
   }
+
+  if (waypoint_min != -1)
+    return waypoint_min;
+
+  return getClosestFrontWaypoint(current_path, current_pose);
 }
 
 // let the linear equation be "ax + by + c = 0"
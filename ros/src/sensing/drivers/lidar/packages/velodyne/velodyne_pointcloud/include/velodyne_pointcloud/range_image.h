@@ -0,0 +1,106 @@
+/* -*- mode: C++ -*-
+ *
+ *  Copyright (C) 2017, Nagoya University
+ *
+ *  License: Modified BSD Software License Agreement
+ */
+
+/** \file
+ *
+ *  Organized ring x azimuth view of a Velodyne point cloud.
+ */
+
+#ifndef __VELODYNE_POINTCLOUD_RANGE_IMAGE_H
+#define __VELODYNE_POINTCLOUD_RANGE_IMAGE_H
+
+#include <cmath>
+#include <vector>
+
+#include <pcl/point_cloud.h>
+#include <velodyne_pointcloud/point_types.h>
+
+namespace velodyne_pointcloud
+{
+  /** \brief Dense ring x azimuth array of indices into a PointXYZIR cloud.
+   *
+   *  Rows are the laser rings, columns are azimuth bins following the
+   *  rotation of the sensor (clockwise seen from above, starting at +x).
+   *  Each cell holds the index of the point that fell in it (the last
+   *  one if several did) and its distance on the XY plane, or -1 when
+   *  the cell is empty.  The buffers are kept between scans, so one
+   *  instance per stream of clouds builds the image without allocating.
+   */
+  class RangeImage
+  {
+  public:
+    RangeImage(): rings_(0), columns_(0) {}
+
+    /** \brief Bins every point of the cloud in one pass.
+     *
+     *  Points with a ring outside [0, rings) are ignored.
+     */
+    void build(const pcl::PointCloud<PointXYZIR> &cloud, int rings, int columns)
+    {
+      rings_ = rings;
+      columns_ = columns;
+      index_.assign(rings_ * columns_, -1);
+      range_.resize(rings_ * columns_);
+
+      for (size_t i = 0; i < cloud.points.size(); i++)
+        {
+          const PointXYZIR &p = cloud.points[i];
+          if (p.ring >= rings_)
+            continue;
+
+          double u = atan2(p.y, p.x) * 180 / M_PI;
+          if (u < 0) { u = 360 + u; }
+          int column = columns_ - (int)((double)columns_ * u / 360.0) - 1;
+          // u rounds to 360 for tiny negative angles, the same direction as u = 0
+          if (column < 0)
+            column = wrapColumn(column);
+
+          int cell = p.ring * columns_ + column;
+          index_[cell] = i;
+          const double x = p.x;
+          const double y = p.y;
+          range_[cell] = sqrt(x * x + y * y);
+        }
+    }
+
+    int rings() const { return rings_; }
+    int columns() const { return columns_; }
+
+    /** \brief true if a point fell in the cell */
+    bool valid(int ring, int column) const
+    {
+      return index_[ring * columns_ + column] >= 0;
+    }
+
+    /** \brief index of the point in the cloud, -1 if the cell is empty */
+    int index(int ring, int column) const
+    {
+      return index_[ring * columns_ + column];
+    }
+
+    /** \brief distance of the point on the XY plane, only set for valid cells */
+    double range(int ring, int column) const
+    {
+      return range_[ring * columns_ + column];
+    }
+
+    /** \brief neighbouring column, wrapping around the full rotation */
+    int wrapColumn(int column) const
+    {
+      return (column % columns_ + columns_) % columns_;
+    }
+
+  private:
+    int rings_;
+    int columns_;
+    std::vector<int> index_;
+    std::vector<double> range_;
+  };
+
+} // namespace velodyne_pointcloud
+
+#endif // __VELODYNE_POINTCLOUD_RANGE_IMAGE_H
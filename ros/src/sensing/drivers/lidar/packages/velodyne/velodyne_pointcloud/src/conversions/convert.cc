@@ -15,16 +15,35 @@
 
 #include "convert.h"
 
+#include <algorithm>
+
 #include <pcl_conversions/pcl_conversions.h>
 
 namespace velodyne_pointcloud
 {
   /** @brief Constructor. */
   Convert::Convert(ros::NodeHandle node, ros::NodeHandle private_nh):
-    data_(new velodyne_rawdata::RawData())
+    data_(new velodyne_rawdata::RawData()),
+    next_cloud_(0),
+    cloud_packets_(0),
+    last_rotation_(-1),
+    reserve_points_(0)
   {
     data_->setup(private_nh);
 
+    private_nh.param("streaming", config_.streaming, false);
+    private_nh.param("sector_packets", config_.sector_packets, 0);
+    private_nh.param("buffers", config_.buffers, 4);
+    if (config_.buffers < 2)
+      config_.buffers = 2;
+    if (config_.streaming)
+      {
+        ROS_INFO_STREAM("streaming conversion, sector_packets: "
+                        << config_.sector_packets
+                        << ", buffers: " << config_.buffers);
+        clouds_.resize(config_.buffers);
+      }
+
 
     // advertise output point cloud (before subscribing to input data)
     output_ =
@@ -58,6 +77,12 @@ namespace velodyne_pointcloud
     if (output_.getNumSubscribers() == 0)         // no one listening?
       return;                                     // avoid much work
 
+    if (config_.streaming)
+      {
+        processPackets(scanMsg);
+        return;
+      }
+
     // allocate a point cloud with same time and frame ID as raw data
     velodyne_rawdata::VPointCloud::Ptr
       outMsg(new velodyne_rawdata::VPointCloud());
@@ -65,6 +90,8 @@ namespace velodyne_pointcloud
     outMsg->header.stamp = pcl_conversions::toPCL(scanMsg->header).stamp;
     outMsg->header.frame_id = scanMsg->header.frame_id;
     outMsg->height = 1;
+    outMsg->points.reserve(scanMsg->packets.size()
+                           * velodyne_rawdata::SCANS_PER_PACKET);
 
     // process each packet provided by the driver
     for (size_t i = 0; i < scanMsg->packets.size(); ++i)
@@ -78,4 +105,88 @@ namespace velodyne_pointcloud
     output_.publish(outMsg);
   }
 
+  /** @brief Unpack packets one at a time into preallocated clouds.
+   *
+   *  A cloud is published when the azimuth wraps around (a complete
+   *  revolution) or, if sector_packets is set, after that many
+   *  packets.  The driver may split revolutions over several
+   *  VelodyneScan messages (its npackets parameter) to cut latency.
+   */
+  void Convert::processPackets(const velodyne_msgs::VelodyneScan::ConstPtr &scanMsg)
+  {
+    for (size_t i = 0; i < scanMsg->packets.size(); ++i)
+      {
+        const velodyne_msgs::VelodynePacket &pkt = scanMsg->packets[i];
+        const velodyne_rawdata::raw_packet_t *raw =
+          (const velodyne_rawdata::raw_packet_t *) &pkt.data[0];
+        int rotation = raw->blocks[0].rotation;
+
+        if (cloud_ && rotation < last_rotation_)
+          {
+            // a complete revolution; size new clouds for it
+            reserve_points_ = std::max(reserve_points_,
+                                       cloud_->points.capacity());
+            publishCloud();
+          }
+        last_rotation_ = rotation;
+
+        if (!cloud_)
+          startCloud(scanMsg->header.frame_id);
+
+        data_->unpack(pkt, *cloud_);
+        cloud_->header.stamp = pcl_conversions::toPCL(pkt.stamp);
+        ++cloud_packets_;
+
+        if (config_.sector_packets > 0
+            && cloud_packets_ >= config_.sector_packets)
+          publishCloud();
+      }
+  }
+
+  /** @brief Take the next cloud of the ring that no subscriber still holds. */
+  void Convert::startCloud(const std::string &frame_id)
+  {
+    for (size_t n = 0; n < clouds_.size(); ++n)
+      {
+        velodyne_rawdata::VPointCloud::Ptr &cloud =
+          clouds_[(next_cloud_ + n) % clouds_.size()];
+        if (!cloud || cloud.unique())
+          {
+            next_cloud_ = (next_cloud_ + n + 1) % clouds_.size();
+            if (!cloud)
+              cloud.reset(new velodyne_rawdata::VPointCloud());
+            cloud_ = cloud;
+            break;
+          }
+      }
+
+    if (!cloud_)
+      {
+        // every buffer is still in use downstream, replace the oldest
+        ROS_DEBUG_STREAM("all " << clouds_.size()
+                         << " point cloud buffers in use, allocating");
+        velodyne_rawdata::VPointCloud::Ptr &cloud = clouds_[next_cloud_];
+        next_cloud_ = (next_cloud_ + 1) % clouds_.size();
+        cloud.reset(new velodyne_rawdata::VPointCloud());
+        cloud_ = cloud;
+      }
+
+    // clear() keeps the capacity of earlier revolutions
+    cloud_->points.clear();
+    cloud_->points.reserve(reserve_points_);
+    cloud_->width = 0;
+    cloud_->height = 1;
+    cloud_->header.frame_id = frame_id;
+    cloud_packets_ = 0;
+  }
+
+  void Convert::publishCloud()
+  {
+    ROS_DEBUG_STREAM("Publishing " << cloud_->width << " Velodyne points from "
+                     << cloud_packets_ << " packets, time: "
+                     << cloud_->header.stamp);
+    output_.publish(cloud_);
+    cloud_.reset();
+  }
+
 } // namespace velodyne_pointcloud
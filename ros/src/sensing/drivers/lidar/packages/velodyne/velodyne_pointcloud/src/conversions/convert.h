@@ -17,6 +17,8 @@
 #ifndef _VELODYNE_POINTCLOUD_CONVERT_H_
 #define _VELODYNE_POINTCLOUD_CONVERT_H_ 1
 
+#include <vector>
+
 #include <ros/ros.h>
 
 #include <sensor_msgs/PointCloud2.h>
@@ -39,6 +41,9 @@ namespace velodyne_pointcloud
     void callback(velodyne_pointcloud::VelodyneConfigConfig &config,
                 uint32_t level);
     void processScan(const velodyne_msgs::VelodyneScan::ConstPtr &scanMsg);
+    void processPackets(const velodyne_msgs::VelodyneScan::ConstPtr &scanMsg);
+    void startCloud(const std::string &frame_id);
+    void publishCloud();
 
     ///Pointer to dynamic reconfigure service srv_
     boost::shared_ptr<dynamic_reconfigure::Server<velodyne_pointcloud::
@@ -51,8 +56,19 @@ namespace velodyne_pointcloud
     /// configuration parameters
     typedef struct {
       int npackets;                    ///< number of packets to combine
+      bool streaming;                  ///< unpack packets as they arrive
+      int sector_packets;              ///< packets per published sector, 0 for full revolutions
+      int buffers;                     ///< number of preallocated clouds
     } Config;
     Config config_;
+
+    /// streaming mode: clouds are reused once no subscriber holds them
+    std::vector<velodyne_rawdata::VPointCloud::Ptr> clouds_;
+    size_t next_cloud_;
+    velodyne_rawdata::VPointCloud::Ptr cloud_; ///< cloud being filled
+    int cloud_packets_;                        ///< packets unpacked into cloud_
+    int last_rotation_;                        ///< azimuth of the previous packet
+    size_t reserve_points_;                    ///< capacity given to new clouds
   };
 
 } // namespace velodyne_pointcloud
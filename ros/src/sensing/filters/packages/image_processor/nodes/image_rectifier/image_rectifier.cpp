@@ -0,0 +1,197 @@
+/*
+ *  Copyright (c) 2017, Nagoya University
+ *  All rights reserved.
+ *
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions are met:
+ *
+ *  * Redistributions of source code must retain the above copyright notice, this
+ *    list of conditions and the following disclaimer.
+ *
+ *  * Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ *  * Neither the name of Autoware nor the names of its
+ *    contributors may be used to endorse or promote products derived from
+ *    this software without specific prior written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ *  AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ *  IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ *  DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+ *  FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ *  DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ *  SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ *  CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ *  OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ *  OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+#include "image_rectifier.h"
+
+/**
+ * Remaps a band of rows, every band reads the full source image through its slice of the maps
+ */
+class RemapBody : public cv::ParallelLoopBody
+{
+	const cv::Mat& src_;
+	cv::Mat& dst_;
+	const cv::Mat& map1_;
+	const cv::Mat& map2_;
+	int tile_rows_;
+
+public:
+	RemapBody(const cv::Mat& in_src, cv::Mat& out_dst, const cv::Mat& in_map1, const cv::Mat& in_map2, int in_tile_rows) :
+			src_(in_src), dst_(out_dst), map1_(in_map1), map2_(in_map2), tile_rows_(in_tile_rows)
+	{
+	}
+
+	void operator()(const cv::Range& in_range) const
+	{
+		for (int tile = in_range.start; tile < in_range.end; tile++)
+		{
+			int row_start = tile * tile_rows_;
+			int row_end = std::min(row_start + tile_rows_, dst_.rows);
+			cv::Range rows(row_start, row_end);
+			cv::Mat dst_tile = dst_.rowRange(rows);
+			cv::Mat map2_tile = map2_.empty() ? cv::Mat() : map2_.rowRange(rows);
+			cv::remap(src_, dst_tile, map1_.rowRange(rows), map2_tile,
+			          cv::INTER_LINEAR, cv::BORDER_CONSTANT);
+		}
+	}
+};
+
+void RosImageRectifierApp::ImageCallback(const sensor_msgs::ImageConstPtr& in_image_sensor)
+{
+	//Receive Image, share its buffer when it already is bgr8
+	cv_bridge::CvImageConstPtr cv_image = cv_bridge::toCvShare(in_image_sensor, sensor_msgs::image_encodings::BGR8);
+
+	cv_bridge::CvImagePtr out_msg(new cv_bridge::CvImage);
+	out_msg->header   = in_image_sensor->header; // Same timestamp and tf frame as input image
+	out_msg->encoding = sensor_msgs::image_encodings::BGR8;
+
+	{
+		std::lock_guard<std::mutex> lock(maps_mutex_);
+		if (camera_instrinsics_.empty())
+		{
+			ROS_INFO("[%s] Make sure camera_info is being published in the specified topic", _NODE_NAME_);
+			out_msg->image = cv_image->image;
+		}
+		else
+		{
+			if (maps_size_ != cv_image->image.size())
+				BuildUndistortMaps(cv_image->image.size());
+			Remap(cv_image->image, out_msg->image);
+		}
+	}
+
+	publisher_image_rectified_.publish(out_msg->toImageMsg());
+}
+
+void RosImageRectifierApp::IntrinsicsCallback(const sensor_msgs::CameraInfo& in_message)
+{
+	cv::Mat camera_instrinsics(3,3, CV_64F);
+	for (int row=0; row<3; row++) {
+		for (int col=0; col<3; col++) {
+			camera_instrinsics.at<double>(row, col) = in_message.K[row * 3 + col];
+		}
+	}
+
+	cv::Mat distortion_coefficients(1,5,CV_64F, cv::Scalar(0));
+	for (int col=0; col<5 && col<(int)in_message.D.size(); col++) {
+		distortion_coefficients.at<double>(col) = in_message.D[col];
+	}
+
+	std::lock_guard<std::mutex> lock(maps_mutex_);
+	image_size_.height = in_message.height;
+	image_size_.width = in_message.width;
+
+	//CameraInfo is usually latched or repeated at frame rate, only a real change invalidates the tables
+	if (!camera_instrinsics_.empty()
+	    && cv::countNonZero(camera_instrinsics != camera_instrinsics_) == 0
+	    && cv::countNonZero(distortion_coefficients != distortion_coefficients_) == 0)
+		return;
+
+	camera_instrinsics_ = camera_instrinsics;
+	distortion_coefficients_ = distortion_coefficients;
+	maps_size_ = cv::Size();
+}
+
+void RosImageRectifierApp::BuildUndistortMaps(const cv::Size& in_size)
+{
+	//same tables cv::undistort builds internally on every call
+	int map_type = use_fixed_point_maps_ ? CV_16SC2 : CV_32FC1;
+	cv::initUndistortRectifyMap(camera_instrinsics_, distortion_coefficients_, cv::Mat(), camera_instrinsics_,
+	                            in_size, map_type, undistort_map1_, undistort_map2_);
+	maps_size_ = in_size;
+	ROS_INFO("[%s] Built %s undistortion maps for %dx%d images", _NODE_NAME_,
+	         use_fixed_point_maps_ ? "fixed point" : "floating point", in_size.width, in_size.height);
+}
+
+void RosImageRectifierApp::Remap(const cv::Mat& in_image, cv::Mat& out_image)
+{
+	out_image.create(in_image.size(), in_image.type());
+	int tile_rows = remap_tile_rows_ > 0 ? remap_tile_rows_ : in_image.rows;
+	int tiles = (in_image.rows + tile_rows - 1) / tile_rows;
+	cv::parallel_for_(cv::Range(0, tiles),
+	                  RemapBody(in_image, out_image, undistort_map1_, undistort_map2_, tile_rows));
+}
+
+void RosImageRectifierApp::Init(ros::NodeHandle& in_node_handle, ros::NodeHandle& in_private_node_handle)
+{
+	std::string image_raw_topic_str, camera_info_topic_str, image_rectified_str = "/image_rectified";
+	std::string name_space_str = in_node_handle.getNamespace();
+
+	in_private_node_handle.param<std::string>("image_src", image_raw_topic_str, "/image_raw");
+
+	in_private_node_handle.param<std::string>("camera_info_src", camera_info_topic_str, "/camera_info");
+	ROS_INFO("[%s] camera_info_src: %s", _NODE_NAME_, camera_info_topic_str.c_str());
+
+	in_private_node_handle.param<bool>("fixed_point_maps", use_fixed_point_maps_, true);
+	in_private_node_handle.param<int>("remap_tile_rows", remap_tile_rows_, 32);
+	ROS_INFO("[%s] fixed_point_maps: %d, remap_tile_rows: %d", _NODE_NAME_, use_fixed_point_maps_, remap_tile_rows_);
+
+	if (name_space_str != "/") {
+		if (name_space_str.substr(0, 2) == "//") {
+			/* if name space obtained by ros::this::node::getNamespace()
+			   starts with "//", delete one of them */
+			name_space_str.erase(name_space_str.begin());
+		}
+		image_raw_topic_str = name_space_str + image_raw_topic_str;
+		image_rectified_str = name_space_str + image_rectified_str;
+		camera_info_topic_str = name_space_str + camera_info_topic_str;
+	}
+
+	ROS_INFO("[%s] image_src: %s", _NODE_NAME_, image_raw_topic_str.c_str());
+
+	ROS_INFO("[%s] Subscribing to... %s", _NODE_NAME_, image_raw_topic_str.c_str());
+	subscriber_image_raw_ = in_private_node_handle.subscribe(image_raw_topic_str, 1, &RosImageRectifierApp::ImageCallback, this);
+
+	ROS_INFO("[%s] Subscribing to... %s", _NODE_NAME_, camera_info_topic_str.c_str());
+	subscriber_intrinsics_ = in_private_node_handle.subscribe(camera_info_topic_str, 1, &RosImageRectifierApp::IntrinsicsCallback, this);
+
+	publisher_image_rectified_ = in_private_node_handle.advertise<sensor_msgs::Image>(image_rectified_str, 1);
+	ROS_INFO("[%s] Publishing Rectified image in %s", _NODE_NAME_, image_rectified_str.c_str());
+
+	ROS_INFO("[%s] Ready. Waiting for data...", _NODE_NAME_);
+}
+
+void RosImageRectifierApp::Run()
+{
+	ros::NodeHandle node_handle;
+	ros::NodeHandle private_node_handle("~");//to receive args
+
+	Init(node_handle, private_node_handle);
+
+	ros::spin();
+	ROS_INFO("[%s] END rect", _NODE_NAME_);
+}
+
+RosImageRectifierApp::~RosImageRectifierApp()
+{
+}
+
+RosImageRectifierApp::RosImageRectifierApp() :
+		use_fixed_point_maps_(true), remap_tile_rows_(32)
+{
+}
@@ -0,0 +1,92 @@
+/*
+ *  Copyright (c) 2017, Nagoya University
+ *  All rights reserved.
+ *
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions are met:
+ *
+ *  * Redistributions of source code must retain the above copyright notice, this
+ *    list of conditions and the following disclaimer.
+ *
+ *  * Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ *  * Neither the name of Autoware nor the names of its
+ *    contributors may be used to endorse or promote products derived from
+ *    this software without specific prior written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ *  AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ *  IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ *  DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+ *  FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ *  DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ *  SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ *  CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ *  OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ *  OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+#ifndef IMAGE_RECTIFIER_H
+#define IMAGE_RECTIFIER_H
+
+#include <mutex>
+#include <string>
+#include <vector>
+#include <ros/ros.h>
+#include <cv_bridge/cv_bridge.h>
+#include <sensor_msgs/Image.h>
+#include <sensor_msgs/image_encodings.h>
+#include <sensor_msgs/CameraInfo.h>
+
+#include "opencv2/highgui/highgui.hpp"
+#include "opencv2/imgproc/imgproc.hpp"
+#include "opencv2/calib3d/calib3d.hpp"
+
+#define _NODE_NAME_ "image_rectifier"
+
+class RosImageRectifierApp
+
+{
+	ros::Subscriber     subscriber_image_raw_;
+	ros::Subscriber     subscriber_intrinsics_;
+
+	ros::Publisher      publisher_image_rectified_;
+
+	std::mutex          maps_mutex_;
+
+	cv::Size            image_size_;
+	cv::Mat             camera_instrinsics_;
+	cv::Mat             distortion_coefficients_;
+
+	// undistortion tables, rebuilt only when the CameraInfo or the image size changes
+	cv::Size            maps_size_;
+	cv::Mat             undistort_map1_;
+	cv::Mat             undistort_map2_;
+	bool                use_fixed_point_maps_;
+	int                 remap_tile_rows_;
+
+	void ImageCallback(const sensor_msgs::ImageConstPtr& in_image_sensor);
+
+	void IntrinsicsCallback(const sensor_msgs::CameraInfo& in_message);
+
+	void BuildUndistortMaps(const cv::Size& in_size);
+
+	void Remap(const cv::Mat& in_image, cv::Mat& out_image);
+
+public:
+	/**
+	 * Subscribes and advertises the rectifier topics, relative to the namespace of in_node_handle
+	 * @param in_node_handle public node handle
+	 * @param in_private_node_handle private node handle to read parameters from
+	 */
+	void Init(ros::NodeHandle& in_node_handle, ros::NodeHandle& in_private_node_handle);
+
+	void Run();
+
+	~RosImageRectifierApp();
+
+	RosImageRectifierApp();
+};
+
+#endif //IMAGE_RECTIFIER_H
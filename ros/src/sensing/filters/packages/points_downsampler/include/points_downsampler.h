@@ -1,7 +1,7 @@
 #ifndef POINTS_DOWNSAMPLER_H
 #define POINTS_DOWNSAMPLER_H
 
-static pcl::PointCloud<pcl::PointXYZI> removePointsByRange(pcl::PointCloud<pcl::PointXYZI> scan, double min_range, double max_range)
+static pcl::PointCloud<pcl::PointXYZI> removePointsByRange(const pcl::PointCloud<pcl::PointXYZI>& scan, double min_range, double max_range)
 {
   pcl::PointCloud<pcl::PointXYZI> narrowed_scan;
   narrowed_scan.header = scan.header;
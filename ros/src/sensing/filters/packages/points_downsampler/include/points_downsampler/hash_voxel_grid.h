@@ -0,0 +1,352 @@
+/*
+ *  Copyright (c) 2017, Nagoya University
+ *  All rights reserved.
+ *
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions are met:
+ *
+ *  * Redistributions of source code must retain the above copyright notice, this
+ *    list of conditions and the following disclaimer.
+ *
+ *  * Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ *  * Neither the name of Autoware nor the names of its
+ *    contributors may be used to endorse or promote products derived from
+ *    this software without specific prior written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ *  AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ *  IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ *  DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+ *  FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ *  DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ *  SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ *  CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ *  OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ *  OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#ifndef POINTS_DOWNSAMPLER_HASH_VOXEL_GRID_H
+#define POINTS_DOWNSAMPLER_HASH_VOXEL_GRID_H
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <vector>
+
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+
+#include <pcl/point_types.h>
+#include <pcl/point_cloud.h>
+
+namespace points_downsampler
+{
+
+/**
+ * Voxel grid downsampling of XYZI clouds with an open addressing hash keyed by the voxel coordinates.
+ * Each OpenMP thread accumulates a contiguous chunk of the input in its own table, the tables are merged
+ * in chunk order and the voxels are output in the same order as pcl::VoxelGrid.
+ * The optional range limit (distance on the XY plane, as removePointsByRange) is applied in the same pass.
+ * Voxel coordinates are stored in 21 bits, the points beyond +-2^20 leaves of the origin (about +-105km with
+ * a 0.1m leaf) would alias with other voxels and are left out of the output, see getOutOfKeyRangeSize().
+ * The tables are kept between calls, use one instance per stream of scans.
+ */
+class HashVoxelGrid
+{
+public:
+  enum Policy
+  {
+    CENTROID,    // centroid of the xyz and intensity of the points in the voxel, as pcl::VoxelGrid
+    FIRST_POINT  // first point of the input that falls in the voxel
+  };
+
+  HashVoxelGrid() :
+    leaf_size_(1.0),
+    min_range_(0.0),
+    max_range_(std::numeric_limits<double>::infinity()),
+    policy_(CENTROID),
+    ranged_points_size_(0),
+    out_of_key_range_size_(0)
+  {
+  }
+
+  void setLeafSize(double leaf_size)
+  {
+    leaf_size_ = leaf_size;
+  }
+
+  /**
+   * Only the points with min_range <= distance <= max_range are downsampled
+   */
+  void setMeasurementRange(double min_range, double max_range)
+  {
+    min_range_ = min_range;
+    max_range_ = max_range;
+  }
+
+  void setPolicy(Policy policy)
+  {
+    policy_ = policy;
+  }
+
+  /**
+   * Number of finite points inside the measurement range in the last filtered cloud
+   */
+  size_t getRangedPointsSize() const
+  {
+    return ranged_points_size_;
+  }
+
+  /**
+   * Number of points of the last filtered cloud that were dropped because their voxel coordinates do not fit in a key
+   */
+  size_t getOutOfKeyRangeSize() const
+  {
+    return out_of_key_range_size_;
+  }
+
+  void filter(const pcl::PointCloud<pcl::PointXYZI>& input, pcl::PointCloud<pcl::PointXYZI>& output)
+  {
+    const size_t points_size = input.points.size();
+    const double square_min_range = min_range_ * min_range_;
+    const double square_max_range = max_range_ * max_range_;
+    const float inverse_leaf = 1.0 / leaf_size_;
+
+    int max_threads = 1;
+#ifdef _OPENMP
+    max_threads = omp_get_max_threads();
+#endif
+    if (tables_.size() < static_cast<size_t>(max_threads))
+      tables_.resize(max_threads);
+
+    int used_threads = 1;
+    size_t ranged_points_size = 0;
+    size_t out_of_key_range_size = 0;
+
+#pragma omp parallel num_threads(max_threads) reduction(+:ranged_points_size, out_of_key_range_size)
+    {
+      int thread_id = 0;
+      int threads = 1;
+#ifdef _OPENMP
+      thread_id = omp_get_thread_num();
+      threads = omp_get_num_threads();
+#endif
+      if (thread_id == 0)
+        used_threads = threads;
+
+      VoxelTable& table = tables_[thread_id];
+      table.clear();
+
+      const size_t begin = points_size * thread_id / threads;
+      const size_t end = points_size * (thread_id + 1) / threads;
+      for (size_t i = begin; i < end; i++)
+      {
+        const pcl::PointXYZI& p = input.points[i];
+        if (!std::isfinite(p.x) || !std::isfinite(p.y) || !std::isfinite(p.z))
+          continue;
+
+        const double square_distance = p.x * p.x + p.y * p.y;
+        if (square_distance < square_min_range || square_distance > square_max_range)
+          continue;
+        ranged_points_size++;
+
+        uint64_t key;
+        if (!computeKey(p, inverse_leaf, key))
+        {
+          out_of_key_range_size++;
+          continue;
+        }
+        Voxel& voxel = table.insert(key, i);
+        voxel.x += p.x;
+        voxel.y += p.y;
+        voxel.z += p.z;
+        voxel.intensity += p.intensity;
+        voxel.count++;
+      }
+    }
+    ranged_points_size_ = ranged_points_size;
+    out_of_key_range_size_ = out_of_key_range_size;
+
+    // the chunks are merged in input order, the first point of a voxel is kept from the lowest chunk
+    const VoxelTable* result = &tables_[0];
+    if (used_threads > 1)
+    {
+      merged_.clear();
+      for (int t = 0; t < used_threads; t++)
+      {
+        const std::vector<Voxel>& slots = tables_[t].slots();
+        for (size_t s = 0; s < slots.size(); s++)
+        {
+          if (slots[s].key == EMPTY_KEY)
+            continue;
+          Voxel& voxel = merged_.insert(slots[s].key, slots[s].first);
+          voxel.x += slots[s].x;
+          voxel.y += slots[s].y;
+          voxel.z += slots[s].z;
+          voxel.intensity += slots[s].intensity;
+          voxel.count += slots[s].count;
+        }
+      }
+      result = &merged_;
+    }
+
+    occupied_.clear();
+    const std::vector<Voxel>& slots = result->slots();
+    for (size_t s = 0; s < slots.size(); s++)
+    {
+      if (slots[s].key != EMPTY_KEY)
+        occupied_.push_back(&slots[s]);
+    }
+    std::sort(occupied_.begin(), occupied_.end(), compareKeys);
+
+    output.points.resize(occupied_.size());
+    for (size_t v = 0; v < occupied_.size(); v++)
+    {
+      const Voxel& voxel = *occupied_[v];
+      pcl::PointXYZI& p = output.points[v];
+      if (policy_ == FIRST_POINT)
+      {
+        p = input.points[voxel.first];
+      }
+      else
+      {
+        p.x = voxel.x / voxel.count;
+        p.y = voxel.y / voxel.count;
+        p.z = voxel.z / voxel.count;
+        p.intensity = voxel.intensity / voxel.count;
+      }
+    }
+    output.header = input.header;
+    output.width = output.points.size();
+    output.height = 1;
+    output.is_dense = true;
+  }
+
+private:
+  static const int KEY_BITS = 21;
+  static const uint64_t EMPTY_KEY = ~0ULL;  // the keys use 63 bits, never matches a voxel
+
+  struct Voxel
+  {
+    uint64_t key;
+    uint32_t first;
+    uint32_t count;
+    double x, y, z, intensity;
+  };
+
+  class VoxelTable
+  {
+  public:
+    VoxelTable() : size_(0)
+    {
+    }
+
+    void clear()
+    {
+      if (slots_.empty())
+        slots_.resize(1024);
+      for (size_t s = 0; s < slots_.size(); s++)
+        slots_[s].key = EMPTY_KEY;
+      size_ = 0;
+    }
+
+    /**
+     * Returns the voxel of the key, a new voxel starts with no points and the given first index
+     */
+    Voxel& insert(uint64_t key, uint32_t first)
+    {
+      if ((size_ + 1) * 2 > slots_.size())
+        grow();
+
+      const size_t mask = slots_.size() - 1;
+      size_t s = hash(key) & mask;
+      while (slots_[s].key != key)
+      {
+        if (slots_[s].key == EMPTY_KEY)
+        {
+          Voxel& voxel = slots_[s];
+          voxel.key = key;
+          voxel.first = first;
+          voxel.count = 0;
+          voxel.x = voxel.y = voxel.z = voxel.intensity = 0.0;
+          size_++;
+          return voxel;
+        }
+        s = (s + 1) & mask;
+      }
+      return slots_[s];
+    }
+
+    const std::vector<Voxel>& slots() const
+    {
+      return slots_;
+    }
+
+  private:
+    std::vector<Voxel> slots_;
+    size_t size_;
+
+    static size_t hash(uint64_t key)
+    {
+      return (key * 0x9E3779B97F4A7C15ULL) >> 20;
+    }
+
+    void grow()
+    {
+      std::vector<Voxel> old_slots(slots_.size() * 2);
+      old_slots.swap(slots_);
+      for (size_t s = 0; s < slots_.size(); s++)
+        slots_[s].key = EMPTY_KEY;
+
+      const size_t mask = slots_.size() - 1;
+      for (size_t o = 0; o < old_slots.size(); o++)
+      {
+        if (old_slots[o].key == EMPTY_KEY)
+          continue;
+        size_t s = hash(old_slots[o].key) & mask;
+        while (slots_[s].key != EMPTY_KEY)
+          s = (s + 1) & mask;
+        slots_[s] = old_slots[o];
+      }
+    }
+  };
+
+  // x changes fastest in the key order, the same order as the voxel indices of pcl::VoxelGrid.
+  // Returns false if the voxel coordinates do not fit in KEY_BITS
+  static bool computeKey(const pcl::PointXYZI& p, float inverse_leaf, uint64_t& key)
+  {
+    const int64_t offset = 1LL << (KEY_BITS - 1);
+    const int64_t max_index = (1LL << KEY_BITS) - 1;
+    const int64_t ix = static_cast<int64_t>(std::floor(p.x * inverse_leaf)) + offset;
+    const int64_t iy = static_cast<int64_t>(std::floor(p.y * inverse_leaf)) + offset;
+    const int64_t iz = static_cast<int64_t>(std::floor(p.z * inverse_leaf)) + offset;
+    if (ix < 0 || iy < 0 || iz < 0 || ix > max_index || iy > max_index || iz > max_index)
+      return false;
+    key = (static_cast<uint64_t>(iz) << (2 * KEY_BITS)) | (static_cast<uint64_t>(iy) << KEY_BITS) | static_cast<uint64_t>(ix);
+    return true;
+  }
+
+  static bool compareKeys(const Voxel* a, const Voxel* b)
+  {
+    return a->key < b->key;
+  }
+
+  double leaf_size_;
+  double min_range_;
+  double max_range_;
+  Policy policy_;
+  size_t ranged_points_size_;
+  size_t out_of_key_range_size_;
+
+  std::vector<VoxelTable> tables_;
+  VoxelTable merged_;
+  std::vector<const Voxel*> occupied_;
+};
+
+}  // namespace points_downsampler
+
+#endif  // POINTS_DOWNSAMPLER_HASH_VOXEL_GRID_H
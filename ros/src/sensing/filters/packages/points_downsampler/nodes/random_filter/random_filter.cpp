@@ -28,140 +28,121 @@
  *  OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 */
 
-#include <ros/ros.h>
-#include <sensor_msgs/PointCloud2.h>
-
-#include <pcl/point_types.h>
 #include <pcl_conversions/pcl_conversions.h>
 
-#include "autoware_msgs/ConfigRandomFilter.h"
-
-#include <points_downsampler/PointsDownsamplerInfo.h>
-
-#include <chrono>
-
+#include "random_filter.h"
 #include "points_downsampler.h"
 
 #define MAX_MEASUREMENT_RANGE 200.0
 
-ros::Publisher filtered_points_pub;
-
-static int sample_num = 1000;
-
-static ros::Publisher points_downsampler_info_pub;
-static points_downsampler::PointsDownsamplerInfo points_downsampler_info_msg;
-
-static std::chrono::time_point<std::chrono::system_clock> filter_start, filter_end;
-
-static bool _output_log = false;
-static std::ofstream ofs;
-static std::string filename;
-
-static std::string POINTS_TOPIC;
-static double measurement_range = MAX_MEASUREMENT_RANGE;
-
-static void config_callback(const autoware_msgs::ConfigRandomFilter::ConstPtr& input)
+RandomFilter::RandomFilter() :
+  sample_num_(1000),
+  output_log_(false),
+  measurement_range_(MAX_MEASUREMENT_RANGE)
 {
-  sample_num = input->sample_num;
-  measurement_range = input->measurement_range;
 }
 
-static void scan_callback(const sensor_msgs::PointCloud2::ConstPtr& input)
+void RandomFilter::config_callback(const autoware_msgs::ConfigRandomFilter::ConstPtr& input)
 {
-  pcl::PointXYZI sampled_p;
-  pcl::PointCloud<pcl::PointXYZI> scan;
+  sample_num_ = input->sample_num;
+  measurement_range_ = input->measurement_range;
+}
 
-  pcl::fromROSMsg(*input, scan);
+void RandomFilter::scan_callback(const pcl::PointCloud<pcl::PointXYZI>::ConstPtr& input)
+{
+  // the input is shared with the publisher and other subscribers, it is only read here
+  pcl::PointCloud<pcl::PointXYZI>::ConstPtr scan_ptr = input;
 
-  if(measurement_range != MAX_MEASUREMENT_RANGE){
-    scan = removePointsByRange(scan, 0, measurement_range);
+  if(measurement_range_ != MAX_MEASUREMENT_RANGE){
+    scan_ptr = boost::make_shared<pcl::PointCloud<pcl::PointXYZI> >(removePointsByRange(*input, 0, measurement_range_));
   }
+  const pcl::PointCloud<pcl::PointXYZI>& scan = *scan_ptr;
 
-  pcl::PointCloud<pcl::PointXYZI>::Ptr filtered_scan_ptr(new pcl::PointCloud<pcl::PointXYZI>());
-  filtered_scan_ptr->header = scan.header;
+  pcl::PointCloud<pcl::PointXYZI>::ConstPtr filtered_scan_ptr;
 
-  filter_start = std::chrono::system_clock::now();
+  filter_start_ = std::chrono::system_clock::now();
 
   int points_num = scan.size();
-  int step = points_num / sample_num;
+  int step = points_num / sample_num_;
 
-  if(scan.points.size() >= sample_num)
+  if(scan.points.size() >= sample_num_)
   {
+    pcl::PointCloud<pcl::PointXYZI>::Ptr sampled_scan_ptr(new pcl::PointCloud<pcl::PointXYZI>());
+    sampled_scan_ptr->header = input->header;
     for (int i = 0; i < points_num; i++)
     {
-      if ((int)filtered_scan_ptr->size() < sample_num && i % step == 0)
+      if ((int)sampled_scan_ptr->size() < sample_num_ && i % step == 0)
       {
-        filtered_scan_ptr->points.push_back(scan.at(i));
+        sampled_scan_ptr->points.push_back(scan.at(i));
       }
     }
+    filtered_scan_ptr = sampled_scan_ptr;
   }else{
-    filtered_scan_ptr = scan.makeShared();
+    // nothing to sample, the scan is forwarded as it is
+    filtered_scan_ptr = scan_ptr;
   }
 
-  sensor_msgs::PointCloud2 filtered_msg;
-  pcl::toROSMsg(*filtered_scan_ptr, filtered_msg);
+  filter_end_ = std::chrono::system_clock::now();
 
-  filter_end = std::chrono::system_clock::now();
+  filtered_points_pub_.publish(filtered_scan_ptr);
 
-  filtered_msg.header = input->header;
-  filtered_points_pub.publish(filtered_msg);
+  pcl_conversions::fromPCL(input->header, points_downsampler_info_msg_.header);
+  points_downsampler_info_msg_.filter_name = "random_filter";
+  points_downsampler_info_msg_.measurement_range = measurement_range_;
+  points_downsampler_info_msg_.original_points_size = points_num;
+  points_downsampler_info_msg_.filtered_points_size = filtered_scan_ptr->size();
+  points_downsampler_info_msg_.original_ring_size = 0;
+  points_downsampler_info_msg_.filtered_ring_size = 0;
+  points_downsampler_info_msg_.exe_time = std::chrono::duration_cast<std::chrono::microseconds>(filter_end_ - filter_start_).count() / 1000.0;
+  points_downsampler_info_pub_.publish(points_downsampler_info_msg_);
 
-  points_downsampler_info_msg.header = input->header;
-  points_downsampler_info_msg.filter_name = "random_filter";
-  points_downsampler_info_msg.measurement_range = measurement_range;
-  points_downsampler_info_msg.original_points_size = points_num;
-  points_downsampler_info_msg.filtered_points_size = filtered_scan_ptr->size();
-  points_downsampler_info_msg.original_ring_size = 0;
-  points_downsampler_info_msg.filtered_ring_size = 0;
-  points_downsampler_info_msg.exe_time = std::chrono::duration_cast<std::chrono::microseconds>(filter_end - filter_start).count() / 1000.0;
-  points_downsampler_info_pub.publish(points_downsampler_info_msg);
-
-  if(_output_log == true){
-	  if(!ofs){
-		  std::cerr << "Could not open " << filename << "." << std::endl;
+  if(output_log_ == true){
+	  if(!ofs_){
+		  std::cerr << "Could not open " << filename_ << "." << std::endl;
 		  exit(1);
 	  }
-	  ofs << points_downsampler_info_msg.header.seq << ","
-		  << points_downsampler_info_msg.header.stamp << ","
-		  << points_downsampler_info_msg.header.frame_id << ","
-		  << points_downsampler_info_msg.filter_name << ","
-		  << points_downsampler_info_msg.original_points_size << ","
-		  << points_downsampler_info_msg.filtered_points_size << ","
-		  << points_downsampler_info_msg.original_ring_size << ","
-		  << points_downsampler_info_msg.filtered_ring_size << ","
-		  << points_downsampler_info_msg.exe_time << ","
+	  ofs_ << points_downsampler_info_msg_.header.seq << ","
+		  << points_downsampler_info_msg_.header.stamp << ","
+		  << points_downsampler_info_msg_.header.frame_id << ","
+		  << points_downsampler_info_msg_.filter_name << ","
+		  << points_downsampler_info_msg_.original_points_size << ","
+		  << points_downsampler_info_msg_.filtered_points_size << ","
+		  << points_downsampler_info_msg_.original_ring_size << ","
+		  << points_downsampler_info_msg_.filtered_ring_size << ","
+		  << points_downsampler_info_msg_.exe_time << ","
 		  << std::endl;
   }
 
 }
 
-int main(int argc, char** argv)
+void RandomFilter::Init(ros::NodeHandle& in_node_handle, ros::NodeHandle& in_private_node_handle)
 {
-  ros::init(argc, argv, "random_filter");
-
-  ros::NodeHandle nh;
-  ros::NodeHandle private_nh("~");
-
-  private_nh.getParam("points_topic", POINTS_TOPIC);
-  private_nh.getParam("output_log", _output_log);
-  if(_output_log == true){
+  in_private_node_handle.getParam("points_topic", points_topic_);
+  in_private_node_handle.getParam("output_log", output_log_);
+  if(output_log_ == true){
 	  char buffer[80];
 	  std::time_t now = std::time(NULL);
 	  std::tm *pnow = std::localtime(&now);
 	  std::strftime(buffer,80,"%Y%m%d_%H%M%S",pnow);
-	  filename = "random_filter_" + std::string(buffer) + ".csv";
-	  ofs.open(filename.c_str(), std::ios::app);
+	  filename_ = "random_filter_" + std::string(buffer) + ".csv";
+	  ofs_.open(filename_.c_str(), std::ios::app);
   }
 
   // Publishers
-  filtered_points_pub = nh.advertise<sensor_msgs::PointCloud2>("/filtered_points", 10);
-  points_downsampler_info_pub = nh.advertise<points_downsampler::PointsDownsamplerInfo>("/points_downsampler_info", 1000);
+  filtered_points_pub_ = in_node_handle.advertise<pcl::PointCloud<pcl::PointXYZI> >("/filtered_points", 10);
+  points_downsampler_info_pub_ = in_node_handle.advertise<points_downsampler::PointsDownsamplerInfo>("/points_downsampler_info", 1000);
 
   // Subscribers
-  ros::Subscriber config_sub = nh.subscribe("config/random_filter", 10, config_callback);
-  ros::Subscriber scan_sub = nh.subscribe(POINTS_TOPIC, 10, scan_callback);
+  config_sub_ = in_node_handle.subscribe("config/random_filter", 10, &RandomFilter::config_callback, this);
+  scan_sub_ = in_node_handle.subscribe(points_topic_, 10, &RandomFilter::scan_callback, this);
+}
 
-  ros::spin();
+void RandomFilter::Run()
+{
+  ros::NodeHandle nh;
+  ros::NodeHandle private_nh("~");
+
+  Init(nh, private_nh);
 
-  return 0;
+  ros::spin();
 }
@@ -28,66 +28,39 @@
  *  OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 */
 
-#include <ros/ros.h>
-#include <sensor_msgs/PointCloud2.h>
-
-#include <pcl/point_types.h>
 #include <pcl_conversions/pcl_conversions.h>
 #include <pcl/filters/voxel_grid.h>
 
-#include <velodyne_pointcloud/point_types.h>
-
-#include "autoware_msgs/ConfigRingFilter.h"
-
-#include <points_downsampler/PointsDownsamplerInfo.h>
-
-#include <chrono>
+#include "ring_filter.h"
 
 #define MAX_MEASUREMENT_RANGE 200.0
 
-ros::Publisher filtered_points_pub;
-
-// Leaf size of VoxelGrid filter.
-static double voxel_leaf_size = 2.0;
-
-int ring_max = 0;
-int ring_div = 3;
-
-static ros::Publisher points_downsampler_info_pub;
-static points_downsampler::PointsDownsamplerInfo points_downsampler_info_msg;
-
-static std::chrono::time_point<std::chrono::system_clock> filter_start, filter_end;
-
-static bool _output_log = false;
-static std::ofstream ofs;
-static std::string filename;
-
-static std::string POINTS_TOPIC;
-static double measurement_range = MAX_MEASUREMENT_RANGE;
-
-static void config_callback(const autoware_msgs::ConfigRingFilter::ConstPtr& input)
+RingFilter::RingFilter() :
+  voxel_leaf_size_(2.0),
+  ring_max_(0),
+  ring_div_(3),
+  output_log_(false),
+  measurement_range_(MAX_MEASUREMENT_RANGE)
 {
-  ring_div = input->ring_div;
-  voxel_leaf_size = input->voxel_leaf_size;
-  measurement_range = input->measurement_range;
 }
 
-static void scan_callback(const sensor_msgs::PointCloud2::ConstPtr& input)
+void RingFilter::config_callback(const autoware_msgs::ConfigRingFilter::ConstPtr& input)
 {
-  pcl::PointCloud<pcl::PointXYZI> scan;
-  pcl::PointCloud<velodyne_pointcloud::PointXYZIR> tmp;
-  sensor_msgs::PointCloud2 filtered_msg;
-
-  pcl::fromROSMsg(*input, scan);
-  pcl::fromROSMsg(*input, tmp);
+  ring_div_ = input->ring_div;
+  voxel_leaf_size_ = input->voxel_leaf_size;
+  measurement_range_ = input->measurement_range;
+}
 
-  filter_start = std::chrono::system_clock::now();
+void RingFilter::scan_callback(const pcl::PointCloud<velodyne_pointcloud::PointXYZIR>::ConstPtr& input)
+{
+  pcl::PointCloud<pcl::PointXYZI>::Ptr scan_ptr(new pcl::PointCloud<pcl::PointXYZI>());
+  scan_ptr->header = input->header;
 
-  scan.points.clear();
+  filter_start_ = std::chrono::system_clock::now();
 
-  double square_measurement_range = measurement_range*measurement_range;
+  double square_measurement_range = measurement_range_*measurement_range_;
 
-  for (pcl::PointCloud<velodyne_pointcloud::PointXYZIR>::const_iterator item = tmp.begin(); item != tmp.end(); item++)
+  for (pcl::PointCloud<velodyne_pointcloud::PointXYZIR>::const_iterator item = input->begin(); item != input->end(); item++)
   {
     pcl::PointXYZI p;
     p.x = item->x;
@@ -97,103 +70,100 @@ static void scan_callback(const sensor_msgs::PointCloud2::ConstPtr& input)
 
     double square_distance = p.x * p.x + p.y * p.y;
 
-    if (item->ring % ring_div == 0 && square_distance <= square_measurement_range)
+    if (item->ring % ring_div_ == 0 && square_distance <= square_measurement_range)
     {
-      scan.points.push_back(p);
+      scan_ptr->points.push_back(p);
     }
-    if (item->ring > ring_max)
+    if (item->ring > ring_max_)
     {
-      ring_max = item->ring;
+      ring_max_ = item->ring;
     }
   }
 
-  pcl::PointCloud<pcl::PointXYZI>::Ptr scan_ptr(new pcl::PointCloud<pcl::PointXYZI>(scan));
   pcl::PointCloud<pcl::PointXYZI>::Ptr filtered_scan_ptr(new pcl::PointCloud<pcl::PointXYZI>());
 
   // if voxel_leaf_size < 0.1 voxel_grid_filter cannot down sample (It is specification in PCL)
-  if (voxel_leaf_size >= 0.1)
+  if (voxel_leaf_size_ >= 0.1)
   {
     // Downsampling the velodyne scan using VoxelGrid filter
     pcl::VoxelGrid<pcl::PointXYZI> voxel_grid_filter;
-    voxel_grid_filter.setLeafSize(voxel_leaf_size, voxel_leaf_size, voxel_leaf_size);
+    voxel_grid_filter.setLeafSize(voxel_leaf_size_, voxel_leaf_size_, voxel_leaf_size_);
     voxel_grid_filter.setInputCloud(scan_ptr);
     voxel_grid_filter.filter(*filtered_scan_ptr);
-
-    pcl::toROSMsg(*filtered_scan_ptr, filtered_msg);
+    filtered_scan_ptr->header = input->header;
+    filtered_points_pub_.publish(filtered_scan_ptr);
   }
   else
   {
-    pcl::toROSMsg(*scan_ptr, filtered_msg);
+    filtered_points_pub_.publish(scan_ptr);
   }
 
-  filter_end = std::chrono::system_clock::now();
-
-  filtered_msg.header = input->header;
-  filtered_points_pub.publish(filtered_msg);
+  filter_end_ = std::chrono::system_clock::now();
 
-  points_downsampler_info_msg.header = input->header;
-  points_downsampler_info_msg.filter_name = "ring_filter";
-  points_downsampler_info_msg.measurement_range = measurement_range;
-  points_downsampler_info_msg.original_points_size = scan.size();
-  if (voxel_leaf_size >= 0.1)
+  pcl_conversions::fromPCL(input->header, points_downsampler_info_msg_.header);
+  points_downsampler_info_msg_.filter_name = "ring_filter";
+  points_downsampler_info_msg_.measurement_range = measurement_range_;
+  points_downsampler_info_msg_.original_points_size = scan_ptr->size();
+  if (voxel_leaf_size_ >= 0.1)
   {
-    points_downsampler_info_msg.filtered_points_size = filtered_scan_ptr->size();
+    points_downsampler_info_msg_.filtered_points_size = filtered_scan_ptr->size();
   }
   else
   {
-    points_downsampler_info_msg.filtered_points_size = scan_ptr->size();
+    points_downsampler_info_msg_.filtered_points_size = scan_ptr->size();
   }
-  points_downsampler_info_msg.original_ring_size = ring_max;
-  points_downsampler_info_msg.filtered_ring_size = ring_max / ring_div;
-  points_downsampler_info_msg.exe_time = std::chrono::duration_cast<std::chrono::microseconds>(filter_end - filter_start).count() / 1000.0;
-  points_downsampler_info_pub.publish(points_downsampler_info_msg);
-
-  if(_output_log == true){
-	  if(!ofs){
-		  std::cerr << "Could not open " << filename << "." << std::endl;
+  points_downsampler_info_msg_.original_ring_size = ring_max_;
+  points_downsampler_info_msg_.filtered_ring_size = ring_max_ / ring_div_;
+  points_downsampler_info_msg_.exe_time = std::chrono::duration_cast<std::chrono::microseconds>(filter_end_ - filter_start_).count() / 1000.0;
+  points_downsampler_info_pub_.publish(points_downsampler_info_msg_);
+
+  if(output_log_ == true){
+	  if(!ofs_){
+		  std::cerr << "Could not open " << filename_ << "." << std::endl;
 		  exit(1);
 	  }
-	  ofs << points_downsampler_info_msg.header.seq << ","
-		  << points_downsampler_info_msg.header.stamp << ","
-		  << points_downsampler_info_msg.header.frame_id << ","
-		  << points_downsampler_info_msg.filter_name << ","
-		  << points_downsampler_info_msg.original_points_size << ","
-		  << points_downsampler_info_msg.filtered_points_size << ","
-		  << points_downsampler_info_msg.original_ring_size << ","
-		  << points_downsampler_info_msg.filtered_ring_size << ","
-		  << points_downsampler_info_msg.exe_time << ","
+	  ofs_ << points_downsampler_info_msg_.header.seq << ","
+		  << points_downsampler_info_msg_.header.stamp << ","
+		  << points_downsampler_info_msg_.header.frame_id << ","
+		  << points_downsampler_info_msg_.filter_name << ","
+		  << points_downsampler_info_msg_.original_points_size << ","
+		  << points_downsampler_info_msg_.filtered_points_size << ","
+		  << points_downsampler_info_msg_.original_ring_size << ","
+		  << points_downsampler_info_msg_.filtered_ring_size << ","
+		  << points_downsampler_info_msg_.exe_time << ","
 		  << std::endl;
   }
 
 }
 
-int main(int argc, char** argv)
+void RingFilter::Init(ros::NodeHandle& in_node_handle, ros::NodeHandle& in_private_node_handle)
 {
-  ros::init(argc, argv, "ring_filter");
-
-  ros::NodeHandle nh;
-  ros::NodeHandle private_nh("~");
-
-  private_nh.getParam("points_topic", POINTS_TOPIC);
-  private_nh.getParam("output_log", _output_log);
-  if(_output_log == true){
+  in_private_node_handle.getParam("points_topic", points_topic_);
+  in_private_node_handle.getParam("output_log", output_log_);
+  if(output_log_ == true){
 	  char buffer[80];
 	  std::time_t now = std::time(NULL);
 	  std::tm *pnow = std::localtime(&now);
 	  std::strftime(buffer,80,"%Y%m%d_%H%M%S",pnow);
-	  filename = "ring_filter_" + std::string(buffer) + ".csv";
-	  ofs.open(filename.c_str(), std::ios::app);
+	  filename_ = "ring_filter_" + std::string(buffer) + ".csv";
+	  ofs_.open(filename_.c_str(), std::ios::app);
   }
 
   // Publishers
-  filtered_points_pub = nh.advertise<sensor_msgs::PointCloud2>("/filtered_points", 10);
-  points_downsampler_info_pub = nh.advertise<points_downsampler::PointsDownsamplerInfo>("/points_downsampler_info", 1000);
+  filtered_points_pub_ = in_node_handle.advertise<pcl::PointCloud<pcl::PointXYZI> >("/filtered_points", 10);
+  points_downsampler_info_pub_ = in_node_handle.advertise<points_downsampler::PointsDownsamplerInfo>("/points_downsampler_info", 1000);
 
   // Subscribers
-  ros::Subscriber config_sub = nh.subscribe("config/ring_filter", 10, config_callback);
-  ros::Subscriber scan_sub = nh.subscribe(POINTS_TOPIC, 10, scan_callback);
+  config_sub_ = in_node_handle.subscribe("config/ring_filter", 10, &RingFilter::config_callback, this);
+  scan_sub_ = in_node_handle.subscribe(points_topic_, 10, &RingFilter::scan_callback, this);
+}
 
-  ros::spin();
+void RingFilter::Run()
+{
+  ros::NodeHandle nh;
+  ros::NodeHandle private_nh("~");
+
+  Init(nh, private_nh);
 
-  return 0;
+  ros::spin();
 }
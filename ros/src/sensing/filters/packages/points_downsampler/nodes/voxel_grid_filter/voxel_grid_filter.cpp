@@ -28,145 +28,137 @@
  *  OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 */
 
-#include <ros/ros.h>
-#include <sensor_msgs/PointCloud2.h>
-
-#include <pcl/point_types.h>
 #include <pcl_conversions/pcl_conversions.h>
-#include <pcl/filters/voxel_grid.h>
-
-#include "autoware_msgs/ConfigVoxelGridFilter.h"
 
-#include <points_downsampler/PointsDownsamplerInfo.h>
-
-#include <chrono>
+#include <limits>
 
+#include "voxel_grid_filter.h"
 #include "points_downsampler.h"
 
 #define MAX_MEASUREMENT_RANGE 200.0
 
-ros::Publisher filtered_points_pub;
-
-// Leaf size of VoxelGrid filter.
-static double voxel_leaf_size = 2.0;
-
-static ros::Publisher points_downsampler_info_pub;
-static points_downsampler::PointsDownsamplerInfo points_downsampler_info_msg;
-
-static std::chrono::time_point<std::chrono::system_clock> filter_start, filter_end;
-
-static bool _output_log = false;
-static std::ofstream ofs;
-static std::string filename;
-
-static std::string POINTS_TOPIC;
-static double measurement_range = MAX_MEASUREMENT_RANGE;
-
-static void config_callback(const autoware_msgs::ConfigVoxelGridFilter::ConstPtr& input)
+VoxelGridFilter::VoxelGridFilter() :
+  voxel_leaf_size_(2.0),
+  first_point_per_voxel_(false),
+  output_log_(false),
+  measurement_range_(MAX_MEASUREMENT_RANGE)
 {
-  voxel_leaf_size = input->voxel_leaf_size;
-  measurement_range = input->measurement_range;
 }
 
-static void scan_callback(const sensor_msgs::PointCloud2::ConstPtr& input)
+void VoxelGridFilter::config_callback(const autoware_msgs::ConfigVoxelGridFilter::ConstPtr& input)
 {
-  pcl::PointCloud<pcl::PointXYZI> scan;
-  pcl::fromROSMsg(*input, scan);
+  voxel_leaf_size_ = input->voxel_leaf_size;
+  measurement_range_ = input->measurement_range;
+}
 
-  if(measurement_range != MAX_MEASUREMENT_RANGE){
-    scan = removePointsByRange(scan, 0, measurement_range);
-  }
+void VoxelGridFilter::scan_callback(const pcl::PointCloud<pcl::PointXYZI>::ConstPtr& input)
+{
+  // the input is shared with the publisher and other subscribers, it is only read here
+  pcl::PointCloud<pcl::PointXYZI>::ConstPtr scan_ptr = input;
 
-  pcl::PointCloud<pcl::PointXYZI>::Ptr scan_ptr(new pcl::PointCloud<pcl::PointXYZI>(scan));
   pcl::PointCloud<pcl::PointXYZI>::Ptr filtered_scan_ptr(new pcl::PointCloud<pcl::PointXYZI>());
 
-  sensor_msgs::PointCloud2 filtered_msg;
-
-  filter_start = std::chrono::system_clock::now();
+  filter_start_ = std::chrono::system_clock::now();
 
   // if voxel_leaf_size < 0.1 voxel_grid_filter cannot down sample (It is specification in PCL)
-  if (voxel_leaf_size >= 0.1)
+  if (voxel_leaf_size_ >= 0.1)
   {
-    // Downsampling the velodyne scan using VoxelGrid filter
-    pcl::VoxelGrid<pcl::PointXYZI> voxel_grid_filter;
-    voxel_grid_filter.setLeafSize(voxel_leaf_size, voxel_leaf_size, voxel_leaf_size);
-    voxel_grid_filter.setInputCloud(scan_ptr);
-    voxel_grid_filter.filter(*filtered_scan_ptr);
-    pcl::toROSMsg(*filtered_scan_ptr, filtered_msg);
+    // Downsampling the velodyne scan, the range limit is applied in the same pass
+    voxel_grid_.setLeafSize(voxel_leaf_size_);
+    // as removePointsByRange, an empty range keeps the whole scan
+    if(measurement_range_ != MAX_MEASUREMENT_RANGE && measurement_range_ <= 0){
+      ROS_ERROR_ONCE("min_range>=max_range @(%lf, %lf)", 0.0, measurement_range_);
+    }
+    if(measurement_range_ != MAX_MEASUREMENT_RANGE && measurement_range_ > 0){
+      voxel_grid_.setMeasurementRange(0, measurement_range_);
+    }
+    else{
+      voxel_grid_.setMeasurementRange(0, std::numeric_limits<double>::infinity());
+    }
+    voxel_grid_.filter(*input, *filtered_scan_ptr);
+    if (voxel_grid_.getOutOfKeyRangeSize() > 0)
+      ROS_WARN_THROTTLE(1.0, "voxel_grid_filter: %zu points beyond the voxel key range were dropped", voxel_grid_.getOutOfKeyRangeSize());
+    filtered_points_pub_.publish(filtered_scan_ptr);
   }
   else
   {
-    pcl::toROSMsg(*scan_ptr, filtered_msg);
+    if(measurement_range_ != MAX_MEASUREMENT_RANGE){
+      scan_ptr = boost::make_shared<pcl::PointCloud<pcl::PointXYZI> >(removePointsByRange(*input, 0, measurement_range_));
+    }
+    filtered_points_pub_.publish(scan_ptr);
   }
 
-  filter_end = std::chrono::system_clock::now();
+  filter_end_ = std::chrono::system_clock::now();
 
-  filtered_msg.header = input->header;
-  filtered_points_pub.publish(filtered_msg);
-
-  points_downsampler_info_msg.header = input->header;
-  points_downsampler_info_msg.filter_name = "voxel_grid_filter";
-  points_downsampler_info_msg.measurement_range = measurement_range;
-  points_downsampler_info_msg.original_points_size = scan.size();
-  if (voxel_leaf_size >= 0.1)
+  pcl_conversions::fromPCL(input->header, points_downsampler_info_msg_.header);
+  points_downsampler_info_msg_.filter_name = "voxel_grid_filter";
+  points_downsampler_info_msg_.measurement_range = measurement_range_;
+  if (voxel_leaf_size_ >= 0.1)
   {
-    points_downsampler_info_msg.filtered_points_size = filtered_scan_ptr->size();
+    points_downsampler_info_msg_.original_points_size = voxel_grid_.getRangedPointsSize();
+    points_downsampler_info_msg_.filtered_points_size = filtered_scan_ptr->size();
   }
   else
   {
-    points_downsampler_info_msg.filtered_points_size = scan_ptr->size();
+    points_downsampler_info_msg_.original_points_size = scan_ptr->size();
+    points_downsampler_info_msg_.filtered_points_size = scan_ptr->size();
   }
-  points_downsampler_info_msg.original_ring_size = 0;
-  points_downsampler_info_msg.filtered_ring_size = 0;
-  points_downsampler_info_msg.exe_time = std::chrono::duration_cast<std::chrono::microseconds>(filter_end - filter_start).count() / 1000.0;
-  points_downsampler_info_pub.publish(points_downsampler_info_msg);
-
-  if(_output_log == true){
-	  if(!ofs){
-		  std::cerr << "Could not open " << filename << "." << std::endl;
+  points_downsampler_info_msg_.original_ring_size = 0;
+  points_downsampler_info_msg_.filtered_ring_size = 0;
+  points_downsampler_info_msg_.exe_time = std::chrono::duration_cast<std::chrono::microseconds>(filter_end_ - filter_start_).count() / 1000.0;
+  points_downsampler_info_pub_.publish(points_downsampler_info_msg_);
+
+  if(output_log_ == true){
+	  if(!ofs_){
+		  std::cerr << "Could not open " << filename_ << "." << std::endl;
 		  exit(1);
 	  }
-	  ofs << points_downsampler_info_msg.header.seq << ","
-		  << points_downsampler_info_msg.header.stamp << ","
-		  << points_downsampler_info_msg.header.frame_id << ","
-		  << points_downsampler_info_msg.filter_name << ","
-		  << points_downsampler_info_msg.original_points_size << ","
-		  << points_downsampler_info_msg.filtered_points_size << ","
-		  << points_downsampler_info_msg.original_ring_size << ","
-		  << points_downsampler_info_msg.filtered_ring_size << ","
-		  << points_downsampler_info_msg.exe_time << ","
+	  ofs_ << points_downsampler_info_msg_.header.seq << ","
+		  << points_downsampler_info_msg_.header.stamp << ","
+		  << points_downsampler_info_msg_.header.frame_id << ","
+		  << points_downsampler_info_msg_.filter_name << ","
+		  << points_downsampler_info_msg_.original_points_size << ","
+		  << points_downsampler_info_msg_.filtered_points_size << ","
+		  << points_downsampler_info_msg_.original_ring_size << ","
+		  << points_downsampler_info_msg_.filtered_ring_size << ","
+		  << points_downsampler_info_msg_.exe_time << ","
 		  << std::endl;
   }
 
 }
 
-int main(int argc, char** argv)
+void VoxelGridFilter::Init(ros::NodeHandle& in_node_handle, ros::NodeHandle& in_private_node_handle)
 {
-  ros::init(argc, argv, "voxel_grid_filter");
-
-  ros::NodeHandle nh;
-  ros::NodeHandle private_nh("~");
-
-  private_nh.getParam("points_topic", POINTS_TOPIC);
-  private_nh.getParam("output_log", _output_log);
-  if(_output_log == true){
+  in_private_node_handle.getParam("points_topic", points_topic_);
+  in_private_node_handle.getParam("output_log", output_log_);
+  in_private_node_handle.getParam("first_point_per_voxel", first_point_per_voxel_);
+  if(first_point_per_voxel_ == true){
+    voxel_grid_.setPolicy(points_downsampler::HashVoxelGrid::FIRST_POINT);
+  }
+  if(output_log_ == true){
 	  char buffer[80];
 	  std::time_t now = std::time(NULL);
 	  std::tm *pnow = std::localtime(&now);
 	  std::strftime(buffer,80,"%Y%m%d_%H%M%S",pnow);
-	  filename = "voxel_grid_filter_" + std::string(buffer) + ".csv";
-	  ofs.open(filename.c_str(), std::ios::app);
+	  filename_ = "voxel_grid_filter_" + std::string(buffer) + ".csv";
+	  ofs_.open(filename_.c_str(), std::ios::app);
   }
 
   // Publishers
-  filtered_points_pub = nh.advertise<sensor_msgs::PointCloud2>("/filtered_points", 10);
-  points_downsampler_info_pub = nh.advertise<points_downsampler::PointsDownsamplerInfo>("/points_downsampler_info", 1000);
+  filtered_points_pub_ = in_node_handle.advertise<pcl::PointCloud<pcl::PointXYZI> >("/filtered_points", 10);
+  points_downsampler_info_pub_ = in_node_handle.advertise<points_downsampler::PointsDownsamplerInfo>("/points_downsampler_info", 1000);
 
   // Subscribers
-  ros::Subscriber config_sub = nh.subscribe("config/voxel_grid_filter", 10, config_callback);
-  ros::Subscriber scan_sub = nh.subscribe(POINTS_TOPIC, 10, scan_callback);
+  config_sub_ = in_node_handle.subscribe("config/voxel_grid_filter", 10, &VoxelGridFilter::config_callback, this);
+  scan_sub_ = in_node_handle.subscribe(points_topic_, 10, &VoxelGridFilter::scan_callback, this);
+}
 
-  ros::spin();
+void VoxelGridFilter::Run()
+{
+  ros::NodeHandle nh;
+  ros::NodeHandle private_nh("~");
+
+  Init(nh, private_nh);
 
-  return 0;
+  ros::spin();
 }
@@ -0,0 +1,89 @@
+/*
+ *  Copyright (c) 2015, Nagoya University
+ *  All rights reserved.
+ *
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions are met:
+ *
+ *  * Redistributions of source code must retain the above copyright notice, this
+ *    list of conditions and the following disclaimer.
+ *
+ *  * Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ *  * Neither the name of Autoware nor the names of its
+ *    contributors may be used to endorse or promote products derived from
+ *    this software without specific prior written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ *  AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ *  IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ *  DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+ *  FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ *  DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ *  SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ *  CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ *  OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ *  OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#ifndef VOXEL_GRID_FILTER_H
+#define VOXEL_GRID_FILTER_H
+
+#include <ros/ros.h>
+
+#include <pcl/point_types.h>
+#include <pcl_ros/point_cloud.h>
+
+#include "autoware_msgs/ConfigVoxelGridFilter.h"
+
+#include <points_downsampler/PointsDownsamplerInfo.h>
+#include <points_downsampler/hash_voxel_grid.h>
+
+#include <chrono>
+#include <fstream>
+#include <string>
+
+class VoxelGridFilter
+{
+public:
+  VoxelGridFilter();
+
+  /**
+   * Reads the parameters and connects the filter topics, shared by the node and the nodelet
+   * @param in_node_handle public node handle
+   * @param in_private_node_handle private node handle to read parameters from
+   */
+  void Init(ros::NodeHandle& in_node_handle, ros::NodeHandle& in_private_node_handle);
+
+  void Run();
+
+private:
+  ros::Publisher filtered_points_pub_;
+  ros::Publisher points_downsampler_info_pub_;
+  ros::Subscriber config_sub_;
+  ros::Subscriber scan_sub_;
+
+  points_downsampler::PointsDownsamplerInfo points_downsampler_info_msg_;
+
+  std::chrono::time_point<std::chrono::system_clock> filter_start_, filter_end_;
+
+  // Leaf size of VoxelGrid filter.
+  double voxel_leaf_size_;
+  // Output the first point of each voxel instead of the centroid.
+  bool first_point_per_voxel_;
+  points_downsampler::HashVoxelGrid voxel_grid_;
+
+  bool output_log_;
+  std::ofstream ofs_;
+  std::string filename_;
+
+  std::string points_topic_;
+  double measurement_range_;
+
+  void config_callback(const autoware_msgs::ConfigVoxelGridFilter::ConstPtr& input);
+  void scan_callback(const pcl::PointCloud<pcl::PointXYZI>::ConstPtr& input);
+};
+
+#endif // VOXEL_GRID_FILTER_H
@@ -0,0 +1,334 @@
+/*
+ *  Copyright (c) 2017, Nagoya University
+ *  All rights reserved.
+ *
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions are met:
+ *
+ *  * Redistributions of source code must retain the above copyright notice, this
+ *    list of conditions and the following disclaimer.
+ *
+ *  * Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ *  * Neither the name of Autoware nor the names of its
+ *    contributors may be used to endorse or promote products derived from
+ *    this software without specific prior written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ *  AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ *  IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ *  DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+ *  FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ *  DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ *  SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ *  CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ *  OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ *  OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ ********************
+ *  v1.0: amc-nu (abrahammonrroy@yahoo.com)
+ */
+#include <algorithm>
+#include <cmath>
+#include <pcl_ros/transforms.h>
+
+#include "fused_filter.h"
+
+#define MAX_MEASUREMENT_RANGE 200.0
+
+FusedFilter::FusedFilter() :
+		transform_ok_(false),
+		radial_dividers_num_(0)
+{
+}
+
+void FusedFilter::RayConfigCallback(const autoware_msgs::ConfigRayGroundFilter::ConstPtr& in_param)
+{
+	ground_classifier_.sensor_height               = in_param->sensor_height;
+	ground_classifier_.general_max_slope           = in_param->general_max_slope;
+	ground_classifier_.local_max_slope             = in_param->local_max_slope;
+	ground_classifier_.concentric_divider_distance = in_param->concentric_divider_distance;
+	ground_classifier_.min_height_threshold        = in_param->min_height_threshold;
+	ground_classifier_.reclass_distance_threshold  = in_param->reclass_distance_threshold;
+	radial_divider_angle_   = in_param->radial_divider_angle;
+	clipping_height_        = in_param->clipping_height;
+	min_point_distance_     = in_param->min_point_distance;
+	radial_dividers_num_    = ceil(360 / radial_divider_angle_);
+}
+
+void FusedFilter::VoxelConfigCallback(const autoware_msgs::ConfigVoxelGridFilter::ConstPtr& in_param)
+{
+	voxel_leaf_size_   = in_param->voxel_leaf_size;
+	measurement_range_ = in_param->measurement_range;
+}
+
+bool FusedFilter::LookupTransform(const std::string& in_frame_id, Eigen::Matrix4f& out_transform)
+{
+	if (target_frame_.empty() || target_frame_ == in_frame_id)
+		return false;
+
+	tf::StampedTransform transform;
+	try
+	{
+		tf_listener_ptr_->lookupTransform(target_frame_, in_frame_id, ros::Time(0), transform);
+	}
+	catch (tf::TransformException ex)
+	{
+		ROS_ERROR("fused_filter: %s NOT Transforming.", ex.what());
+		transform_ok_ = false;
+		return false;
+	}
+	pcl_ros::transformAsMatrix(transform, out_transform);
+	if (!transform_ok_)
+		{ROS_INFO("fused_filter: Correctly Transformed"); transform_ok_ = true;}
+
+	return true;
+}
+
+void FusedFilter::PackPoints(const pcl::PointCloud<pcl::PointXYZI>& in_cloud,
+                             const Eigen::Matrix4f& in_transform,
+                             bool in_do_transform)
+{
+	const float m00 = in_transform(0, 0), m01 = in_transform(0, 1), m02 = in_transform(0, 2), m03 = in_transform(0, 3);
+	const float m10 = in_transform(1, 0), m11 = in_transform(1, 1), m12 = in_transform(1, 2), m13 = in_transform(1, 3);
+	const float m20 = in_transform(2, 0), m21 = in_transform(2, 1), m22 = in_transform(2, 2), m23 = in_transform(2, 3);
+
+	//as voxel_grid_filter, an empty range keeps the whole scan
+	if (measurement_range_ != MAX_MEASUREMENT_RANGE && measurement_range_ <= 0)
+		ROS_ERROR_ONCE("min_range>=max_range @(%lf, %lf)", 0.0, measurement_range_);
+	const bool  limit_range      = measurement_range_ != MAX_MEASUREMENT_RANGE && measurement_range_ > 0;
+	const float square_max_range = measurement_range_ * measurement_range_;
+	const float square_min_point_distance = min_point_distance_ * min_point_distance_;
+	const float radial_divisions_per_deg = 1.0 / radial_divider_angle_;
+
+	ground_candidates_.clear();
+	ranged_cloud_.points.clear();
+	ground_candidates_.reserve(in_cloud.points.size());
+	ranged_cloud_.points.reserve(in_cloud.points.size());
+
+	for (size_t i = 0; i < in_cloud.points.size(); i++)
+	{
+		const pcl::PointXYZI& in_point = in_cloud.points[i];
+		if (!pcl_isfinite(in_point.x) || !pcl_isfinite(in_point.y) || !pcl_isfinite(in_point.z))
+			continue;
+
+		pcl::PointXYZI point = in_point;
+		if (in_do_transform)
+		{
+			point.x = m00 * in_point.x + m01 * in_point.y + m02 * in_point.z + m03;
+			point.y = m10 * in_point.x + m11 * in_point.y + m12 * in_point.z + m13;
+			point.z = m20 * in_point.x + m21 * in_point.y + m22 * in_point.z + m23;
+		}
+
+		const float square_radius = point.x * point.x + point.y * point.y;
+
+		//voxel_grid_filter input, only limited by the measurement range
+		if (!limit_range || square_radius <= square_max_range)
+			ranged_cloud_.points.push_back(point);
+
+		//space_filter
+		if (lateral_removal_ && (point.y > left_distance_ || point.y < -right_distance_))
+			continue;
+		if (vertical_removal_ && (point.z < below_distance_ || point.z > above_distance_))
+			continue;
+
+		//ray_ground_filter ClipCloud and RemovePointsUpTo
+		if (point.z > clipping_height_ || square_radius < square_min_point_distance)
+			continue;
+
+		PackedPoint packed;
+		packed.x = point.x;
+		packed.y = point.y;
+		packed.z = point.z;
+		packed.intensity = point.intensity;
+		packed.radius = sqrt(square_radius);
+
+		float theta = atan2(point.y, point.x) * 180 / M_PI;
+		if (theta < 0){ theta += 360; }
+		packed.radial_div = std::min(static_cast<size_t>(theta * radial_divisions_per_deg), radial_dividers_num_ - 1);
+
+		ground_candidates_.push_back(packed);
+	}
+}
+
+void FusedFilter::ClassifyGround()
+{
+	//counting sort by radial division, the divisions end up contiguous in sorted_candidates_
+	division_offsets_.assign(radial_dividers_num_ + 1, 0);
+	for (size_t i = 0; i < ground_candidates_.size(); i++)
+	{
+		division_offsets_[ground_candidates_[i].radial_div + 1]++;
+	}
+	for (size_t i = 0; i < radial_dividers_num_; i++)
+	{
+		division_offsets_[i + 1] += division_offsets_[i];
+	}
+
+	sorted_candidates_.resize(ground_candidates_.size());
+	ground_labels_.resize(ground_candidates_.size());
+	{
+		std::vector<uint32_t> insert_position(division_offsets_.begin(), division_offsets_.end() - 1);
+		for (size_t i = 0; i < ground_candidates_.size(); i++)
+		{
+			sorted_candidates_[insert_position[ground_candidates_[i].radial_div]++] = ground_candidates_[i];
+		}
+	}
+
+	//the divisions are independent
+#pragma omp parallel for schedule(dynamic, 64)
+	for (size_t i = 0; i < radial_dividers_num_; i++)
+	{
+		const uint32_t begin = division_offsets_[i];
+		const uint32_t end = division_offsets_[i + 1];
+		if (begin == end)
+			continue;
+
+		std::sort(sorted_candidates_.begin() + begin, sorted_candidates_.begin() + end,
+		          [](const PackedPoint& a, const PackedPoint& b){ return a.radius < b.radius; });
+
+		RayGroundClassifier::Ray ray;
+		ground_classifier_.Reset(ray);
+		for (uint32_t j = begin; j < end; j++)
+		{
+			ground_labels_[j] = ground_classifier_.IsGround(ray, sorted_candidates_[j].radius, sorted_candidates_[j].z);
+		}
+	}
+}
+
+void FusedFilter::DownsampleRangedPoints(pcl::PointCloud<pcl::PointXYZI>& out_cloud)
+{
+	//as voxel_grid_filter, pcl::VoxelGrid cannot handle leaves smaller than 0.1
+	if (voxel_leaf_size_ < 0.1)
+	{
+		out_cloud.points = ranged_cloud_.points;
+		return;
+	}
+
+	//the range limit is already applied by PackPoints
+	voxel_grid_.setLeafSize(voxel_leaf_size_);
+	voxel_grid_.filter(ranged_cloud_, out_cloud);
+	if (voxel_grid_.getOutOfKeyRangeSize() > 0)
+		ROS_WARN_THROTTLE(1.0, "fused_filter: %zu points beyond the voxel key range were not downsampled",
+		                  voxel_grid_.getOutOfKeyRangeSize());
+}
+
+void FusedFilter::CloudCallback(const pcl::PointCloud<pcl::PointXYZI>::ConstPtr& in_sensor_cloud)
+{
+	Eigen::Matrix4f transform = Eigen::Matrix4f::Identity();
+	bool do_transform = LookupTransform(in_sensor_cloud->header.frame_id, transform);
+
+	PackPoints(*in_sensor_cloud, transform, do_transform);
+	ClassifyGround();
+
+	pcl::PCLHeader header = in_sensor_cloud->header;
+	if (do_transform)
+		header.frame_id = target_frame_;
+
+	pcl::PointCloud<pcl::PointXYZI>::Ptr ground_cloud_ptr(new pcl::PointCloud<pcl::PointXYZI>);
+	pcl::PointCloud<pcl::PointXYZI>::Ptr no_ground_cloud_ptr(new pcl::PointCloud<pcl::PointXYZI>);
+	pcl::PointCloud<pcl::PointXYZI>::Ptr filtered_cloud_ptr(new pcl::PointCloud<pcl::PointXYZI>);
+
+	ground_cloud_ptr->points.reserve(sorted_candidates_.size());
+	no_ground_cloud_ptr->points.reserve(sorted_candidates_.size());
+	for (size_t i = 0; i < sorted_candidates_.size(); i++)
+	{
+		pcl::PointXYZI point;
+		point.x = sorted_candidates_[i].x;
+		point.y = sorted_candidates_[i].y;
+		point.z = sorted_candidates_[i].z;
+		point.intensity = sorted_candidates_[i].intensity;
+		if (ground_labels_[i])
+			ground_cloud_ptr->points.push_back(point);
+		else
+			no_ground_cloud_ptr->points.push_back(point);
+	}
+
+	DownsampleRangedPoints(*filtered_cloud_ptr);
+
+	pcl::PointCloud<pcl::PointXYZI>::Ptr out_clouds[] = {ground_cloud_ptr, no_ground_cloud_ptr, filtered_cloud_ptr};
+	for (size_t i = 0; i < 3; i++)
+	{
+		out_clouds[i]->header = header;
+		out_clouds[i]->width = out_clouds[i]->points.size();
+		out_clouds[i]->height = 1;
+		out_clouds[i]->is_dense = true;
+	}
+
+	ground_points_pub_.publish(ground_cloud_ptr);
+	groundless_points_pub_.publish(no_ground_cloud_ptr);
+	filtered_points_pub_.publish(filtered_cloud_ptr);
+}
+
+void FusedFilter::Init(ros::NodeHandle& in_node_handle, ros::NodeHandle& in_private_node_handle)
+{
+	node_handle_ = in_private_node_handle;
+
+	ROS_INFO("Initializing Fused Filter, please wait...");
+	node_handle_.param<std::string>("input_point_topic", input_point_topic_, "/points_raw");
+	ROS_INFO("Input point_topic: %s", input_point_topic_.c_str());
+
+	//cloud_transformer, empty to keep the frame of the input
+	node_handle_.param<std::string>("target_frame", target_frame_, "");
+	ROS_INFO("Target Frame in TF (target_frame) : %s", target_frame_.c_str());
+	if (!target_frame_.empty())
+		tf_listener_ptr_.reset(new tf::TransformListener());
+
+	//space_filter
+	node_handle_.param("lateral_removal", lateral_removal_, false);
+	node_handle_.param("left_distance", left_distance_, 5.0);
+	node_handle_.param("right_distance", right_distance_, 5.0);
+	node_handle_.param("vertical_removal", vertical_removal_, false);
+	node_handle_.param("below_distance", below_distance_, -1.5);
+	node_handle_.param("above_distance", above_distance_, 0.5);
+	ROS_INFO("lateral_removal: %d [%f, %f]", lateral_removal_, -right_distance_, left_distance_);
+	ROS_INFO("vertical_removal: %d [%f, %f]", vertical_removal_, below_distance_, above_distance_);
+
+	//ray_ground_filter, same defaults
+	node_handle_.param("sensor_height", ground_classifier_.sensor_height, 1.7);
+	node_handle_.param("general_max_slope", ground_classifier_.general_max_slope, 3.0);
+	node_handle_.param("local_max_slope", ground_classifier_.local_max_slope, 5.0);
+	node_handle_.param("concentric_divider_distance", ground_classifier_.concentric_divider_distance, 0.01);
+	node_handle_.param("min_height_threshold", ground_classifier_.min_height_threshold, 0.05);
+	node_handle_.param("reclass_distance_threshold", ground_classifier_.reclass_distance_threshold, 0.2);
+	node_handle_.param("radial_divider_angle", radial_divider_angle_, 0.1);
+	node_handle_.param("clipping_height", clipping_height_, 0.2);
+	node_handle_.param("min_point_distance", min_point_distance_, 1.85);
+	radial_dividers_num_ = ceil(360 / radial_divider_angle_);
+	ROS_INFO("sensor_height[meters]: %f", ground_classifier_.sensor_height);
+	ROS_INFO("Radial Divisions: %d", (int)radial_dividers_num_);
+
+	//voxel_grid_filter
+	node_handle_.param("voxel_leaf_size", voxel_leaf_size_, 2.0);
+	node_handle_.param("measurement_range", measurement_range_, MAX_MEASUREMENT_RANGE);
+	ROS_INFO("voxel_leaf_size[meters]: %f", voxel_leaf_size_);
+	ROS_INFO("measurement_range[meters]: %f", measurement_range_);
+
+	std::string no_ground_topic, ground_topic, filtered_topic;
+	node_handle_.param<std::string>("no_ground_point_topic", no_ground_topic, "/points_no_ground");
+	node_handle_.param<std::string>("ground_point_topic", ground_topic, "/points_ground");
+	node_handle_.param<std::string>("filtered_point_topic", filtered_topic, "/filtered_points");
+	ROS_INFO("Output topics: %s %s %s", no_ground_topic.c_str(), ground_topic.c_str(), filtered_topic.c_str());
+
+	groundless_points_pub_ = node_handle_.advertise<pcl::PointCloud<pcl::PointXYZI> >(no_ground_topic, 2);
+	ground_points_pub_ = node_handle_.advertise<pcl::PointCloud<pcl::PointXYZI> >(ground_topic, 2);
+	filtered_points_pub_ = node_handle_.advertise<pcl::PointCloud<pcl::PointXYZI> >(filtered_topic, 10);
+
+	ray_config_sub_ = node_handle_.subscribe("/config/ray_ground_filter", 1, &FusedFilter::RayConfigCallback, this);
+	voxel_config_sub_ = node_handle_.subscribe("/config/voxel_grid_filter", 10, &FusedFilter::VoxelConfigCallback, this);
+
+	ROS_INFO("Subscribing to... %s", input_point_topic_.c_str());
+	points_node_sub_ = node_handle_.subscribe(input_point_topic_, 1, &FusedFilter::CloudCallback, this);
+
+	ROS_INFO("Ready");
+}
+
+void FusedFilter::Run()
+{
+	ros::NodeHandle node_handle;
+	ros::NodeHandle private_node_handle("~");
+
+	Init(node_handle, private_node_handle);
+
+	ros::spin();
+}
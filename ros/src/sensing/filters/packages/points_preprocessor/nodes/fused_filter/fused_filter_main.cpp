@@ -0,0 +1,14 @@
+#include <ros/ros.h>
+#include "fused_filter.h"
+
+
+int main(int argc, char **argv)
+{
+	ros::init(argc, argv, "fused_filter");
+	FusedFilter app;
+
+	app.Run();
+
+	return 0;
+
+}
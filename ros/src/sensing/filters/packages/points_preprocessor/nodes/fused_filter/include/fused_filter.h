@@ -0,0 +1,163 @@
+/*
+ *  Copyright (c) 2017, Nagoya University
+ *  All rights reserved.
+ *
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions are met:
+ *
+ *  * Redistributions of source code must retain the above copyright notice, this
+ *    list of conditions and the following disclaimer.
+ *
+ *  * Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ *  * Neither the name of Autoware nor the names of its
+ *    contributors may be used to endorse or promote products derived from
+ *    this software without specific prior written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ *  AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ *  IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ *  DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+ *  FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ *  DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ *  SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ *  CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ *  OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ *  OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ ********************
+ *  v1.0: amc-nu (abrahammonrroy@yahoo.com)
+ */
+#ifndef FUSED_FILTER_H_
+#define FUSED_FILTER_H_
+
+#include <string>
+#include <vector>
+#include <ros/ros.h>
+#include <pcl_ros/point_cloud.h>
+#include <pcl/point_types.h>
+#include <tf/transform_listener.h>
+#include <Eigen/Core>
+#include "autoware_msgs/ConfigRayGroundFilter.h"
+#include "autoware_msgs/ConfigVoxelGridFilter.h"
+
+#include <points_downsampler/hash_voxel_grid.h>
+
+#include "ray_ground_classifier.h"
+
+/*!
+ * Runs cloud_transformer, space_filter, ray_ground_filter and voxel_grid_filter as one stage.
+ * The input is read once, the points kept for ground classification are packed in a reusable buffer
+ * grouped by radial division, and the points inside the measurement range are downsampled by HashVoxelGrid.
+ * Publishes the same topics as the separate filters.
+ */
+class FusedFilter
+{
+private:
+
+	ros::NodeHandle     node_handle_;
+	ros::Subscriber     points_node_sub_;
+	ros::Subscriber     ray_config_sub_;
+	ros::Subscriber     voxel_config_sub_;
+	ros::Publisher      groundless_points_pub_;
+	ros::Publisher      ground_points_pub_;
+	ros::Publisher      filtered_points_pub_;
+
+	std::string         input_point_topic_;
+
+	//cloud_transformer
+	std::string         target_frame_;//empty to keep the input frame
+	boost::shared_ptr<tf::TransformListener> tf_listener_ptr_;
+	bool                transform_ok_;
+
+	//space_filter
+	bool                lateral_removal_;
+	double              left_distance_;
+	double              right_distance_;
+	bool                vertical_removal_;
+	double              below_distance_;
+	double              above_distance_;
+
+	//ray_ground_filter
+	RayGroundClassifier ground_classifier_;
+	double              radial_divider_angle_;//degrees
+	double              clipping_height_; //the points higher than this are not classified
+	double              min_point_distance_;//minimum distance from the origin to consider a point as valid
+	size_t              radial_dividers_num_;
+
+	//voxel_grid_filter
+	double              voxel_leaf_size_;
+	double              measurement_range_;
+	points_downsampler::HashVoxelGrid voxel_grid_;
+
+	//point as stored in the packed buffer, 24 bytes
+	struct PackedPoint
+	{
+		float    x;
+		float    y;
+		float    z;
+		float    intensity;
+		float    radius;
+		uint32_t radial_div;
+	};
+
+	//buffers reused between clouds, no allocation once they reached the size of a scan
+	std::vector<PackedPoint>   ground_candidates_;
+	std::vector<PackedPoint>   sorted_candidates_;
+	std::vector<uint32_t>      division_offsets_;
+	std::vector<unsigned char> ground_labels_;
+	pcl::PointCloud<pcl::PointXYZI> ranged_cloud_;
+
+	void RayConfigCallback(const autoware_msgs::ConfigRayGroundFilter::ConstPtr& in_param);
+
+	void VoxelConfigCallback(const autoware_msgs::ConfigVoxelGridFilter::ConstPtr& in_param);
+
+	/*!
+	 * Looks up the transform from the cloud frame to the target frame
+	 * @param in_frame_id Frame of the input cloud
+	 * @param out_transform Resulting transformation matrix
+	 * @return true if the points have to be transformed
+	 */
+	bool LookupTransform(const std::string& in_frame_id, Eigen::Matrix4f& out_transform);
+
+	/*!
+	 * Single pass over the input: transforms each point, keeps the points inside the measurement range for
+	 * downsampling and the points inside the crop box for ground classification
+	 * @param in_cloud Input cloud
+	 * @param in_transform Transformation applied to every point
+	 * @param in_do_transform false to use the points as they are
+	 */
+	void PackPoints(const pcl::PointCloud<pcl::PointXYZI>& in_cloud,
+	                const Eigen::Matrix4f& in_transform,
+	                bool in_do_transform);
+
+	/*!
+	 * Groups the packed points by radial division with a counting sort, then orders each division by radius
+	 * and applies the ray ground rule
+	 */
+	void ClassifyGround();
+
+	/*!
+	 * Computes the centroid of the points in each occupied voxel, as pcl::VoxelGrid, with the HashVoxelGrid
+	 * kernel shared with voxel_grid_filter
+	 * @param out_cloud Downsampled cloud
+	 */
+	void DownsampleRangedPoints(pcl::PointCloud<pcl::PointXYZI>& out_cloud);
+
+	void CloudCallback(const pcl::PointCloud<pcl::PointXYZI>::ConstPtr& in_sensor_cloud);
+
+public:
+	FusedFilter();
+
+	/*!
+	 * Reads the parameters and connects the filter topics, shared by the node and the nodelet
+	 * @param in_node_handle public node handle
+	 * @param in_private_node_handle private node handle to read parameters from
+	 */
+	void Init(ros::NodeHandle& in_node_handle, ros::NodeHandle& in_private_node_handle);
+
+	void Run();
+};
+
+#endif  // FUSED_FILTER_H_
@@ -0,0 +1,121 @@
+/*
+ *  Copyright (c) 2017, Nagoya University
+ *  All rights reserved.
+ *
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions are met:
+ *
+ *  * Redistributions of source code must retain the above copyright notice, this
+ *    list of conditions and the following disclaimer.
+ *
+ *  * Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ *  * Neither the name of Autoware nor the names of its
+ *    contributors may be used to endorse or promote products derived from
+ *    this software without specific prior written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ *  AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ *  IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ *  DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+ *  FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ *  DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ *  SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ *  CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ *  OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ *  OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ ********************
+ *  v1.0: amc-nu (abrahammonrroy@yahoo.com)
+ */
+#ifndef RAY_GROUND_CLASSIFIER_H_
+#define RAY_GROUND_CLASSIFIER_H_
+
+#include <cmath>
+#include <pcl/pcl_macros.h>
+
+/*!
+ * Ground rule of the ray ground filter. The points of one radial division are visited in increasing radius,
+ * each one is compared with the previous point (local slope) and with the sensor height (general slope).
+ * Shared by RayGroundFilter and FusedFilter.
+ */
+class RayGroundClassifier
+{
+public:
+	double sensor_height;//meters
+	double general_max_slope;//degrees
+	double local_max_slope;//degrees
+	double concentric_divider_distance;//distance in meters between concentric divisions
+	double min_height_threshold;//minimum height threshold regardless the slope, useful for close points
+	double reclass_distance_threshold;//distance between points at which re classification will occur
+
+	struct Ray
+	{
+		float prev_radius;
+		float prev_height;
+		bool  prev_ground;
+	};
+
+	/*!
+	 * Starts a new radial division
+	 * @param out_ray State of the division
+	 */
+	void Reset(Ray& out_ray) const
+	{
+		out_ray.prev_radius = 0.f;
+		out_ray.prev_height = - sensor_height;
+		out_ray.prev_ground = false;
+	}
+
+	/*!
+	 * Classifies the next point of a radial division
+	 * @param in_out_ray State of the division, updated with this point
+	 * @param in_radius Distance of the point to the origin in the XY plane
+	 * @param in_height Height of the point
+	 * @return true if the point is ground
+	 */
+	bool IsGround(Ray& in_out_ray, float in_radius, float in_height) const
+	{
+		bool current_ground = false;
+		float points_distance = in_radius - in_out_ray.prev_radius;
+		float height_threshold = tan(DEG2RAD(local_max_slope)) * points_distance;
+		float general_height_threshold = tan(DEG2RAD(general_max_slope)) * in_radius;
+
+		//for points which are very close causing the height threshold to be tiny, set a minimum value
+		if (points_distance > concentric_divider_distance && height_threshold < min_height_threshold)
+		{ height_threshold = min_height_threshold; }
+
+		//check current point height against the LOCAL threshold (previous point)
+		if (in_height <= (in_out_ray.prev_height + height_threshold)
+		    && in_height >= (in_out_ray.prev_height - height_threshold)
+		   )
+		{
+			//Check again using general geometry (radius from origin) if previous points wasn't ground
+			if (!in_out_ray.prev_ground)
+			{
+				current_ground = (in_height <= (-sensor_height + general_height_threshold)
+				                  && in_height >= (-sensor_height - general_height_threshold));
+			}
+			else
+			{
+				current_ground = true;
+			}
+		}
+		else
+		{
+			//check if previous point is too far from previous one, if so classify again
+			current_ground = (points_distance > reclass_distance_threshold &&
+			                  (in_height <= (-sensor_height + height_threshold)
+			                   && in_height >= (-sensor_height - height_threshold)));
+		}
+
+		in_out_ray.prev_ground = current_ground;
+		in_out_ray.prev_radius = in_radius;
+		in_out_ray.prev_height = in_height;
+
+		return current_ground;
+	}
+};
+
+#endif  // RAY_GROUND_CLASSIFIER_H_
@@ -45,6 +45,7 @@
 #include <pcl/filters/extract_indices.h>
 #include <velodyne_pointcloud/point_types.h>
 #include "autoware_msgs/ConfigRayGroundFilter.h"
+#include "ray_ground_classifier.h"
 
 #include <opencv2/core/version.hpp>
 #if (CV_MAJOR_VERSION == 3)
@@ -101,9 +102,13 @@ private:
 
 	void update_config_params(const autoware_msgs::ConfigRayGroundFilter::ConstPtr& param);
 
+	/*!
+	 * Publishes the cloud by pointer, subscribers in the same nodelet manager receive it without a copy.
+	 * The cloud must not be modified after this call.
+	 */
 	void publish_cloud(const ros::Publisher& in_publisher,
 	                         const pcl::PointCloud<pcl::PointXYZI>::Ptr in_cloud_to_publish_ptr,
-	                         const std_msgs::Header& in_header);
+	                         const pcl::PCLHeader& in_header);
 	
 	/*!
 	 *
@@ -135,7 +140,7 @@ private:
 	 * @param in_clip_height Maximum allowed height in the cloud
 	 * @param out_clipped_cloud_ptr Resultung PointCloud with the points removed
 	 */
-	void ClipCloud(const pcl::PointCloud<pcl::PointXYZI>::Ptr in_cloud_ptr,
+	void ClipCloud(const pcl::PointCloud<pcl::PointXYZI>::ConstPtr in_cloud_ptr,
 	               double in_clip_height,
 	               pcl::PointCloud<pcl::PointXYZI>::Ptr out_clipped_cloud_ptr);
 	
@@ -163,12 +168,20 @@ private:
 	                      double in_min_distance,
 	                      pcl::PointCloud<pcl::PointXYZI>::Ptr out_filtered_cloud_ptr);
 	
-	void CloudCallback(const sensor_msgs::PointCloud2ConstPtr &in_sensor_cloud);
+	void CloudCallback(const pcl::PointCloud<pcl::PointXYZI>::ConstPtr &in_sensor_cloud);
 	
 friend class RayGroundFilter_clipCloud_Test;
 public:
 	RayGroundFilter();
-  void Run();
+
+	/*!
+	 * Reads the parameters and connects the filter topics, shared by the node and the nodelet
+	 * @param in_node_handle public node handle
+	 * @param in_private_node_handle private node handle to read parameters from
+	 */
+	void Init(ros::NodeHandle& in_node_handle, ros::NodeHandle& in_private_node_handle);
+
+	void Run();
 };
 
 #endif  // RAY_GROUND_FILTER_H_
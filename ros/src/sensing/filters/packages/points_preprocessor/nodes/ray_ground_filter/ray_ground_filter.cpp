@@ -67,12 +67,10 @@ void RayGroundFilter::update_config_params(const autoware_msgs::ConfigRayGroundF
 
 void RayGroundFilter::publish_cloud(const ros::Publisher& in_publisher,
     const pcl::PointCloud<pcl::PointXYZI>::Ptr in_cloud_to_publish_ptr,
-    const std_msgs::Header& in_header)
+    const pcl::PCLHeader& in_header)
 {
-  sensor_msgs::PointCloud2 cloud_msg;
-  pcl::toROSMsg(*in_cloud_to_publish_ptr, cloud_msg);
-  cloud_msg.header = in_header;
-  in_publisher.publish(cloud_msg);
+  in_cloud_to_publish_ptr->header = in_header;
+  in_publisher.publish(in_cloud_to_publish_ptr);
 }
 
 /*!
@@ -145,72 +143,30 @@ void RayGroundFilter::ClassifyPointCloud(std::vector<PointCloudXYZIRTColor>& in_
 {
   out_ground_indices.indices.clear();
   out_no_ground_indices.indices.clear();
+
+  RayGroundClassifier classifier;
+  classifier.sensor_height = sensor_height_;
+  classifier.general_max_slope = general_max_slope_;
+  classifier.local_max_slope = local_max_slope_;
+  classifier.concentric_divider_distance = concentric_divider_distance_;
+  classifier.min_height_threshold = min_height_threshold_;
+  classifier.reclass_distance_threshold = reclass_distance_threshold_;
+
 #pragma omp for
   for (size_t i=0; i < in_radial_ordered_clouds.size(); i++)//sweep through each radial division
   {
-    float prev_radius = 0.f;
-    float prev_height = - sensor_height_;
-    bool prev_ground = false;
-    bool current_ground = false;
+    RayGroundClassifier::Ray ray;
+    classifier.Reset(ray);
     for (size_t j=0; j < in_radial_ordered_clouds[i].size(); j++)//loop through each point in the radial div
     {
-      float points_distance = in_radial_ordered_clouds[i][j].radius - prev_radius;
-      float height_threshold = tan(DEG2RAD(local_max_slope_)) * points_distance;
-      float current_height = in_radial_ordered_clouds[i][j].point.z;
-      float general_height_threshold = tan(DEG2RAD(general_max_slope_)) * in_radial_ordered_clouds[i][j].radius;
-
-      //for points which are very close causing the height threshold to be tiny, set a minimum value
-      if (points_distance > concentric_divider_distance_ && height_threshold < min_height_threshold_)
-      { height_threshold = min_height_threshold_; }
-
-      //check current point height against the LOCAL threshold (previous point)
-      if (current_height <= (prev_height + height_threshold)
-          && current_height >= (prev_height - height_threshold)
-         )
-      {
-        //Check again using general geometry (radius from origin) if previous points wasn't ground
-        if (!prev_ground)
-        {
-          if(current_height <= (-sensor_height_ + general_height_threshold)
-              && current_height >= (-sensor_height_ - general_height_threshold))
-          {
-            current_ground = true;
-          }
-          else
-          {current_ground = false;}
-        }
-        else
-        {
-          current_ground = true;
-        }
-      }
-      else
-      {
-        //check if previous point is too far from previous one, if so classify again
-        if (points_distance > reclass_distance_threshold_ &&
-            (current_height <= (-sensor_height_ + height_threshold)
-             && current_height >= (-sensor_height_ - height_threshold))
-           )
-        {
-          current_ground = true;
-        }
-        else
-        {current_ground = false;}
-      }
-
-      if (current_ground)
+      if (classifier.IsGround(ray, in_radial_ordered_clouds[i][j].radius, in_radial_ordered_clouds[i][j].point.z))
       {
         out_ground_indices.indices.push_back(in_radial_ordered_clouds[i][j].original_index);
-        prev_ground=true;
       }
       else
       {
         out_no_ground_indices.indices.push_back(in_radial_ordered_clouds[i][j].original_index);
-        prev_ground = false;
       }
-
-      prev_radius = in_radial_ordered_clouds[i][j].radius;
-      prev_height = in_radial_ordered_clouds[i][j].point.z;
     }
   }
 }
@@ -221,7 +177,7 @@ void RayGroundFilter::ClassifyPointCloud(std::vector<PointCloudXYZIRTColor>& in_
  * @param in_clip_height Maximum allowed height in the cloud
  * @param out_clipped_cloud_ptr Resultung PointCloud with the points removed
  */
-void RayGroundFilter::ClipCloud(const pcl::PointCloud<pcl::PointXYZI>::Ptr in_cloud_ptr,
+void RayGroundFilter::ClipCloud(const pcl::PointCloud<pcl::PointXYZI>::ConstPtr in_cloud_ptr,
     double in_clip_height,
     pcl::PointCloud<pcl::PointXYZI>::Ptr out_clipped_cloud_ptr)
 {
@@ -295,15 +251,12 @@ void RayGroundFilter::RemovePointsUpTo(const pcl::PointCloud<pcl::PointXYZI>::Pt
   extractor.filter(*out_filtered_cloud_ptr);
 }
 
-void RayGroundFilter::CloudCallback(const sensor_msgs::PointCloud2ConstPtr &in_sensor_cloud)
+void RayGroundFilter::CloudCallback(const pcl::PointCloud<pcl::PointXYZI>::ConstPtr &in_sensor_cloud)
 {
-  pcl::PointCloud<pcl::PointXYZI>::Ptr current_sensor_cloud_ptr(new pcl::PointCloud<pcl::PointXYZI>);
-  pcl::fromROSMsg(*in_sensor_cloud, *current_sensor_cloud_ptr);
-
   pcl::PointCloud<pcl::PointXYZI>::Ptr clipped_cloud_ptr(new pcl::PointCloud<pcl::PointXYZI>);
 
   //remove points above certain point
-  ClipCloud(current_sensor_cloud_ptr, clipping_height_, clipped_cloud_ptr);
+  ClipCloud(in_sensor_cloud, clipping_height_, clipped_cloud_ptr);
 
   //remove closer points than a threshold
   pcl::PointCloud<pcl::PointXYZI>::Ptr filtered_cloud_ptr(new pcl::PointCloud<pcl::PointXYZI>);
@@ -343,8 +296,10 @@ RayGroundFilter::RayGroundFilter():node_handle_("~")
 {
 }
 
-void RayGroundFilter::Run()
+void RayGroundFilter::Init(ros::NodeHandle& in_node_handle, ros::NodeHandle& in_private_node_handle)
 {
+  node_handle_ = in_private_node_handle;
+
   //Model   |   Horizontal   |   Vertical   | FOV(Vertical)    degrees / rads
   //----------------------------------------------------------
   //HDL-64  |0.08-0.35(0.32) |     0.4      |  -24.9 <=x<=2.0   (26.9  / 0.47)
@@ -398,12 +353,19 @@ void RayGroundFilter::Run()
 
   config_node_sub_ = node_handle_.subscribe("/config/ray_ground_filter", 1, &RayGroundFilter::update_config_params, this);
 
-  groundless_points_pub_ = node_handle_.advertise<sensor_msgs::PointCloud2>(no_ground_topic, 2);
-  ground_points_pub_ = node_handle_.advertise<sensor_msgs::PointCloud2>(ground_topic, 2);
+  groundless_points_pub_ = node_handle_.advertise<pcl::PointCloud<pcl::PointXYZI> >(no_ground_topic, 2);
+  ground_points_pub_ = node_handle_.advertise<pcl::PointCloud<pcl::PointXYZI> >(ground_topic, 2);
 
   ROS_INFO("Ready");
+}
 
-  ros::spin();
+void RayGroundFilter::Run()
+{
+  ros::NodeHandle node_handle;
+  ros::NodeHandle private_node_handle("~");
 
+  Init(node_handle, private_node_handle);
+
+  ros::spin();
 }
 
@@ -0,0 +1,86 @@
+/*
+ * ring_ground_filter.h
+ *
+ * Created on	: May 19, 2017
+ * Author	: Patiphon Narksri
+ * @brief Below algorithm is documented here https://github.com/CPFL/Autoware-Manuals/tree/master/en/pdfs/ground_filter.pdf.
+ */
+#ifndef RING_GROUND_FILTER_H_
+#define RING_GROUND_FILTER_H_
+
+#include <ros/ros.h>
+#include <sensor_msgs/PointCloud2.h>
+#include <pcl_ros/point_cloud.h>
+#include <pcl_conversions/pcl_conversions.h>
+#include <pcl/point_types.h>
+#include <velodyne_pointcloud/point_types.h>
+#include <velodyne_pointcloud/range_image.h>
+#include "autoware_msgs/ConfigRingGroundFilter.h"
+
+enum Label
+{
+	GROUND,
+	VERTICAL,
+	UNKNOWN //Initial state, not classified
+};
+
+class RingGroundFilter
+{
+public:
+
+	RingGroundFilter();
+
+	/*!
+	 * Reads the parameters and connects the filter topics, shared by the node and the nodelet
+	 * @param in_node_handle public node handle
+	 * @param in_private_node_handle private node handle to read parameters from
+	 */
+	void Init(ros::NodeHandle& in_node_handle, ros::NodeHandle& in_private_node_handle);
+
+	void Run();
+
+private:
+
+	ros::NodeHandle node_handle_;
+	ros::Subscriber config_node_sub_;
+	ros::Subscriber points_node_sub_;
+	ros::Publisher groundless_points_pub_;
+	ros::Publisher ground_points_pub_;
+
+	std::string point_topic_;
+	int 		sensor_model_;
+	double 		sensor_height_;
+	double 		max_slope_;
+	int 		min_point_;
+	double 		clipping_thres_;
+	double 		gap_thres_;
+	double		point_distance_;
+	bool		floor_removal_;
+
+	int 		vertical_res_;
+	int 		horizontal_res_;
+	double 		limiting_ratio_;
+	velodyne_pointcloud::RangeImage range_image_;
+	Label 		class_label_[64];
+
+	boost::chrono::high_resolution_clock::time_point t1_;
+	boost::chrono::high_resolution_clock::time_point t2_;
+	boost::chrono::nanoseconds elap_time_;
+
+	const int 	DEFAULT_HOR_RES = 2000;
+
+	void SetHorizontalRes(const int sensor_model, int &horizontal_res);
+	void InitLabelArray(int in_model);
+	void PublishPointCloud(const pcl::PointCloud<velodyne_pointcloud::PointXYZIR>::ConstPtr &in_cloud_msg,
+				int in_indices[], int &in_out_index_size,
+				pcl::PointCloud<velodyne_pointcloud::PointXYZIR> &in_cloud);
+
+	void ConfigCallback(const autoware_msgs::ConfigRingGroundFilterConstPtr &config);
+	void VelodyneCallback(const pcl::PointCloud<velodyne_pointcloud::PointXYZIR>::ConstPtr &in_cloud_msg);
+	void FilterGround(const pcl::PointCloud<velodyne_pointcloud::PointXYZIR>::ConstPtr &in_cloud_msg,
+				pcl::PointCloud<velodyne_pointcloud::PointXYZIR> &out_groundless_points,
+				pcl::PointCloud<velodyne_pointcloud::PointXYZIR> &out_ground_points);
+
+};
+
+#endif  // RING_GROUND_FILTER_H_
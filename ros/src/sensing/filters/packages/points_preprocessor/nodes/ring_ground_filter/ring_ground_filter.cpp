@@ -5,75 +5,16 @@
  * Author	: Patiphon Narksri
  * @brief Below algorithm is documented here https://github.com/CPFL/Autoware-Manuals/tree/master/en/pdfs/ground_filter.pdf.
  */
-#include <ros/ros.h>
-#include <sensor_msgs/PointCloud2.h>
-#include <pcl_ros/point_cloud.h>
-#include <pcl_conversions/pcl_conversions.h>
-#include <pcl/point_types.h>
-#include <velodyne_pointcloud/point_types.h>
-#include <opencv/cv.h>
-#include "autoware_msgs/ConfigRingGroundFilter.h"
+#include "ring_ground_filter.h"
 
-enum Label
+RingGroundFilter::RingGroundFilter()
 {
-	GROUND,
-	VERTICAL,
-	UNKNOWN //Initial state, not classified
-};
+}
 
-class RingGroundFilter
+void RingGroundFilter::Init(ros::NodeHandle& in_node_handle, ros::NodeHandle& in_private_node_handle)
 {
-public:
-
-	RingGroundFilter();
-
-private:
-
-	ros::NodeHandle node_handle_;
-	ros::Subscriber config_node_sub_;
-	ros::Subscriber points_node_sub_;
-	ros::Publisher groundless_points_pub_;
-	ros::Publisher ground_points_pub_;
-
-	std::string point_topic_;
-	int 		sensor_model_;
-	double 		sensor_height_;
-	double 		max_slope_;
-	int 		min_point_;
-	double 		clipping_thres_;
-	double 		gap_thres_;
-	double		point_distance_;
-	bool		floor_removal_;
-
-	int 		vertical_res_;
-	int 		horizontal_res_;
-	double 		limiting_ratio_;
-	cv::Mat 	index_map_;
-	Label 		class_label_[64];
-
-	boost::chrono::high_resolution_clock::time_point t1_;
-	boost::chrono::high_resolution_clock::time_point t2_;
-	boost::chrono::nanoseconds elap_time_;
+	node_handle_ = in_private_node_handle;
 
-	const int 	DEFAULT_HOR_RES = 2000;
-
-	void SetHorizontalRes(const int sensor_model, int &horizontal_res);
-	void InitLabelArray(int in_model);
-	void InitDepthMap(int in_width);
-	void PublishPointCloud(const pcl::PointCloud<velodyne_pointcloud::PointXYZIR>::ConstPtr &in_cloud_msg,
-				int in_indices[], int &in_out_index_size,
-				pcl::PointCloud<velodyne_pointcloud::PointXYZIR> &in_cloud);
-
-	void ConfigCallback(const autoware_msgs::ConfigRingGroundFilterConstPtr &config);
-	void VelodyneCallback(const pcl::PointCloud<velodyne_pointcloud::PointXYZIR>::ConstPtr &in_cloud_msg);
-	void FilterGround(const pcl::PointCloud<velodyne_pointcloud::PointXYZIR>::ConstPtr &in_cloud_msg,
-				pcl::PointCloud<velodyne_pointcloud::PointXYZIR> &out_groundless_points,
-				pcl::PointCloud<velodyne_pointcloud::PointXYZIR> &out_ground_points);
-
-};
-
-RingGroundFilter::RingGroundFilter() : node_handle_("~")
-{
 	ROS_INFO("Inititalizing Ground Filter...");
 	node_handle_.param<std::string>("point_topic", point_topic_, "/points_raw");
 	ROS_INFO("Input Point Cloud: %s", point_topic_.c_str());
@@ -106,8 +47,8 @@ RingGroundFilter::RingGroundFilter() : node_handle_("~")
 
 	config_node_sub_ = node_handle_.subscribe("/config/ring_ground_filter", 10, &RingGroundFilter::ConfigCallback, this);
 	points_node_sub_ = node_handle_.subscribe(point_topic_, 2, &RingGroundFilter::VelodyneCallback, this);
-	groundless_points_pub_ = node_handle_.advertise<sensor_msgs::PointCloud2>(no_ground_topic, 2);
-	ground_points_pub_ = node_handle_.advertise<sensor_msgs::PointCloud2>(ground_topic, 2);
+	groundless_points_pub_ = node_handle_.advertise<pcl::PointCloud<velodyne_pointcloud::PointXYZIR> >(no_ground_topic, 2);
+	ground_points_pub_ = node_handle_.advertise<pcl::PointCloud<velodyne_pointcloud::PointXYZIR> >(ground_topic, 2);
 
 	vertical_res_ = sensor_model_;
 	InitLabelArray(sensor_model_);
@@ -142,12 +83,6 @@ void RingGroundFilter::InitLabelArray(int in_model)
 	}
 }
 
-void RingGroundFilter::InitDepthMap(int in_width)
-{
-	const int mOne = -1;
-	index_map_ = cv::Mat_<int>(vertical_res_, in_width, mOne);
-}
-
 void RingGroundFilter::PublishPointCloud(const pcl::PointCloud<velodyne_pointcloud::PointXYZIR>::ConstPtr &in_cloud_msg,
 				int in_indices[], int &in_out_index_size,
 				pcl::PointCloud<velodyne_pointcloud::PointXYZIR> &in_cloud)
@@ -174,16 +109,7 @@ void RingGroundFilter::FilterGround(const pcl::PointCloud<velodyne_pointcloud::P
 
 	//This line is not necessary
 	//horizontal_res_ = int(in_cloud_msg->points.size() / vertical_res_);
-	InitDepthMap(horizontal_res_);
-
-	for (size_t i = 0; i < in_cloud_msg->points.size(); i++)
-	{
-		double u = atan2(in_cloud_msg->points[i].y,in_cloud_msg->points[i].x) * 180/M_PI;
-		if (u < 0) { u = 360 + u; }
-		int column = horizontal_res_ - (int)((double)horizontal_res_ * u / 360.0) - 1;
-		int row = vertical_res_ - 1 - in_cloud_msg->points[i].ring;
-		index_map_.at<int>(row, column) = i;
-	}
+	range_image_.build(*in_cloud_msg, vertical_res_, horizontal_res_);
 
 	for (int i = 0; i < horizontal_res_; i++)
 	{
@@ -198,12 +124,11 @@ void RingGroundFilter::FilterGround(const pcl::PointCloud<velodyne_pointcloud::P
 
 		for (int j = vertical_res_ - 1; j >= 0; j--)
 		{
-			if (index_map_.at<int>(j,i) > -1 && point_class[j] == UNKNOWN)
+			//j is the row of the former index map, counted from the top ring
+			if (range_image_.valid(vertical_res_ - 1 - j, i) && point_class[j] == UNKNOWN)
 			{
-				double x0 = in_cloud_msg->points[index_map_.at<int>(j, i)].x;
-				double y0 = in_cloud_msg->points[index_map_.at<int>(j, i)].y;
-				double z0 = in_cloud_msg->points[index_map_.at<int>(j, i)].z;
-				double r0 = sqrt(x0*x0 + y0*y0);
+				double z0 = in_cloud_msg->points[range_image_.index(vertical_res_ - 1 - j, i)].z;
+				double r0 = range_image_.range(vertical_res_ - 1 - j, i);
 				double r_diff = r0 - r_ref;
 				double z_diff = fabs(z0 - z_ref);
 				double pair_angle;
@@ -236,7 +161,7 @@ void RingGroundFilter::FilterGround(const pcl::PointCloud<velodyne_pointcloud::P
 					{
 						for (int m = 0; m < point_index_size; m++)
 						{
-							int index = index_map_.at<int>(point_index[m],i);
+							int index = range_image_.index(vertical_res_ - 1 - point_index[m], i);
 							point.x = in_cloud_msg->points[index].x;
 							point.y = in_cloud_msg->points[index].y;
 							point.z = in_cloud_msg->points[index].z;
@@ -251,7 +176,7 @@ void RingGroundFilter::FilterGround(const pcl::PointCloud<velodyne_pointcloud::P
 					{
 						for (int m = 0; m < point_index_size; m++)
 						{
-							int index = index_map_.at<int>(point_index[m],i);
+							int index = range_image_.index(vertical_res_ - 1 - point_index[m], i);
 							point.z = in_cloud_msg->points[index].z;
 							if (point.z > clipping_thres_ - sensor_height_)
 							{
@@ -285,7 +210,7 @@ void RingGroundFilter::FilterGround(const pcl::PointCloud<velodyne_pointcloud::P
 					{
 						for (int m = 0; m < point_index_size; m++)
 						{
-							int index = index_map_.at<int>(point_index[m],i);
+							int index = range_image_.index(vertical_res_ - 1 - point_index[m], i);
 							point.x = in_cloud_msg->points[index].x;
 							point.y = in_cloud_msg->points[index].y;
 							point.z = in_cloud_msg->points[index].z;
@@ -300,7 +225,7 @@ void RingGroundFilter::FilterGround(const pcl::PointCloud<velodyne_pointcloud::P
 					{
 						for (int m = 0; m < point_index_size; m++)
 						{
-							int index = index_map_.at<int>(point_index[m],i);
+							int index = range_image_.index(vertical_res_ - 1 - point_index[m], i);
 							point.z = in_cloud_msg->points[index].z;
 							if (point.z > clipping_thres_ - sensor_height_)
 							{
@@ -394,32 +319,34 @@ void RingGroundFilter::ConfigCallback(const autoware_msgs::ConfigRingGroundFilte
 void RingGroundFilter::VelodyneCallback(const pcl::PointCloud<velodyne_pointcloud::PointXYZIR>::ConstPtr &in_cloud_msg)
 {
 
-	pcl::PointCloud<velodyne_pointcloud::PointXYZIR> vertical_points;
-	pcl::PointCloud<velodyne_pointcloud::PointXYZIR> ground_points;
-	vertical_points.header = in_cloud_msg->header;
-	ground_points.header = in_cloud_msg->header;
-	vertical_points.clear();
-	ground_points.clear();
+	pcl::PointCloud<velodyne_pointcloud::PointXYZIR>::Ptr vertical_points(new pcl::PointCloud<velodyne_pointcloud::PointXYZIR>);
+	pcl::PointCloud<velodyne_pointcloud::PointXYZIR>::Ptr ground_points(new pcl::PointCloud<velodyne_pointcloud::PointXYZIR>);
+	vertical_points->header = in_cloud_msg->header;
+	ground_points->header = in_cloud_msg->header;
+	vertical_points->clear();
+	ground_points->clear();
 
-	FilterGround(in_cloud_msg, vertical_points, ground_points);
+	FilterGround(in_cloud_msg, *vertical_points, *ground_points);
 
+	// published by pointer, the clouds are not touched after this point
 	if (!floor_removal_)
 	{
-		vertical_points = *in_cloud_msg;
+		groundless_points_pub_.publish(in_cloud_msg);
+	}
+	else
+	{
+		groundless_points_pub_.publish(vertical_points);
 	}
-
-	groundless_points_pub_.publish(vertical_points);
 	ground_points_pub_.publish(ground_points);
 
 }
 
-int main(int argc, char **argv)
+void RingGroundFilter::Run()
 {
+	ros::NodeHandle node_handle;
+	ros::NodeHandle private_node_handle("~");
 
-	ros::init(argc, argv, "ring_ground_filter");
-	RingGroundFilter node;
-	ros::spin();
-
-	return 0;
+	Init(node_handle, private_node_handle);
 
+	ros::spin();
 }
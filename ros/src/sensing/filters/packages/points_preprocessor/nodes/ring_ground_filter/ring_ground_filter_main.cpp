@@ -0,0 +1,13 @@
+#include <ros/ros.h>
+#include "ring_ground_filter.h"
+
+
+int main(int argc, char **argv)
+{
+	ros::init(argc, argv, "ring_ground_filter");
+	RingGroundFilter node;
+
+	node.Run();
+
+	return 0;
+}
@@ -0,0 +1,58 @@
+/*
+ *  Copyright (c) 2017, Nagoya University
+ *  All rights reserved.
+ *
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions are met:
+ *
+ *  * Redistributions of source code must retain the above copyright notice, this
+ *    list of conditions and the following disclaimer.
+ *
+ *  * Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ *  * Neither the name of Autoware nor the names of its
+ *    contributors may be used to endorse or promote products derived from
+ *    this software without specific prior written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ *  AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ *  IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ *  DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+ *  FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ *  DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ *  SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ *  CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ *  OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ *  OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+#include <pluginlib/class_list_macros.h>
+#include <nodelet/nodelet.h>
+
+#include "ring_ground_filter.h"
+
+namespace points_preprocessor
+{
+	/**
+	 * Runs the ring ground filter inside a nodelet manager, clouds from and to other nodelets are passed by pointer
+	 */
+	class RingGroundFilterNodelet : public nodelet::Nodelet
+	{
+	public:
+		RingGroundFilterNodelet() {}
+		~RingGroundFilterNodelet() {}
+
+	private:
+		virtual void onInit()
+		{
+			filter_.reset(new RingGroundFilter());
+			filter_->Init(getNodeHandle(), getPrivateNodeHandle());
+		}
+
+		boost::shared_ptr<RingGroundFilter> filter_;
+	};
+
+} // namespace points_preprocessor
+
+PLUGINLIB_EXPORT_CLASS(points_preprocessor::RingGroundFilterNodelet, nodelet::Nodelet)
@@ -0,0 +1,57 @@
+/*
+ * space_filter.h
+ *
+ *  Created on: Nov 4, 2016
+ *      Author: ne0
+ */
+#ifndef SPACE_FILTER_H_
+#define SPACE_FILTER_H_
+
+#include <ros/ros.h>
+#include <pcl_ros/point_cloud.h>
+#include <pcl/point_types.h>
+#include <pcl/filters/extract_indices.h>
+
+
+class SpaceFilter
+{
+public:
+	SpaceFilter();
+
+	/*!
+	 * Reads the parameters and connects the filter topics, shared by the node and the nodelet
+	 * @param in_node_handle public node handle
+	 * @param in_private_node_handle private node handle to read parameters from
+	 */
+	void Init(ros::NodeHandle& in_node_handle, ros::NodeHandle& in_private_node_handle);
+
+	void Run();
+
+private:
+
+	ros::NodeHandle node_handle_;
+	ros::Subscriber cloud_sub_;
+	ros::Publisher 	cloud_pub_;
+
+	std::string 	subscribe_topic_;
+
+	bool			lateral_removal_;
+	bool			vertical_removal_;
+
+	double 			left_distance_;
+	double 			right_distance_;
+	double 			below_distance_;
+	double 			above_distance_;
+
+	void VelodyneCallback(const pcl::PointCloud<pcl::PointXYZI>::ConstPtr& in_sensor_cloud_ptr);
+	void KeepLanes(const pcl::PointCloud<pcl::PointXYZI>::ConstPtr in_cloud_ptr,
+							pcl::PointCloud<pcl::PointXYZI>::Ptr out_cloud_ptr,
+							float in_left_lane_threshold,
+							float in_right_lane_threshold);
+	void ClipCloud(const pcl::PointCloud<pcl::PointXYZI>::ConstPtr in_cloud_ptr,
+							pcl::PointCloud<pcl::PointXYZI>::Ptr out_cloud_ptr,
+							float in_min_height,
+							float in_max_height);
+};
+
+#endif  // SPACE_FILTER_H_
@@ -4,49 +4,15 @@
  *  Created on: Nov 4, 2016
  *      Author: ne0
  */
-#include <ros/ros.h>
-#include <pcl_conversions/pcl_conversions.h>
-#include <pcl/filters/extract_indices.h>
-#include <sensor_msgs/point_cloud_conversion.h>
-#include <sensor_msgs/PointCloud.h>
-#include <sensor_msgs/PointCloud2.h>
+#include "space_filter.h"
 
-
-class SpaceFilter
+SpaceFilter::SpaceFilter()
 {
-public:
-	SpaceFilter();
-
-private:
-
-	ros::NodeHandle node_handle_;
-	ros::Subscriber cloud_sub_;
-	ros::Publisher 	cloud_pub_;
-
-	std::string 	subscribe_topic_;
-
-	bool			lateral_removal_;
-	bool			vertical_removal_;
-
-	double 			left_distance_;
-	double 			right_distance_;
-	double 			below_distance_;
-	double 			above_distance_;
-
-	void VelodyneCallback(const sensor_msgs::PointCloud2::Ptr& in_sensor_cloud_ptr);
-	void KeepLanes(const pcl::PointCloud<pcl::PointXYZ>::Ptr in_cloud_ptr,
-							pcl::PointCloud<pcl::PointXYZ>::Ptr out_cloud_ptr,
-							float in_left_lane_threshold,
-							float in_right_lane_threshold);
-	void ClipCloud(const pcl::PointCloud<pcl::PointXYZ>::Ptr in_cloud_ptr,
-							pcl::PointCloud<pcl::PointXYZ>::Ptr out_cloud_ptr,
-							float in_min_height,
-							float in_max_height);
-};
+}
 
-SpaceFilter::SpaceFilter() :
-		node_handle_("~")
+void SpaceFilter::Init(ros::NodeHandle& in_node_handle, ros::NodeHandle& in_private_node_handle)
 {
+	node_handle_ = in_private_node_handle;
 
 	node_handle_.param<std::string>("subscribe_topic",  subscribe_topic_,  "/points_raw");
 
@@ -59,11 +25,11 @@ SpaceFilter::SpaceFilter() :
 	node_handle_.param("above_distance",  above_distance_,  0.5);
 
 	cloud_sub_ = node_handle_.subscribe(subscribe_topic_, 10, &SpaceFilter::VelodyneCallback, this);
-	cloud_pub_ = node_handle_.advertise<sensor_msgs::PointCloud2>( "/points_clipped", 10);
+	cloud_pub_ = node_handle_.advertise<pcl::PointCloud<pcl::PointXYZI> >( "/points_clipped", 10);
 }
 
-void SpaceFilter::KeepLanes(const pcl::PointCloud<pcl::PointXYZ>::Ptr in_cloud_ptr,
-		pcl::PointCloud<pcl::PointXYZ>::Ptr out_cloud_ptr,
+void SpaceFilter::KeepLanes(const pcl::PointCloud<pcl::PointXYZI>::ConstPtr in_cloud_ptr,
+		pcl::PointCloud<pcl::PointXYZI>::Ptr out_cloud_ptr,
 		float in_left_lane_threshold,
 		float in_right_lane_threshold)
 {
@@ -83,15 +49,15 @@ void SpaceFilter::KeepLanes(const pcl::PointCloud<pcl::PointXYZ>::Ptr in_cloud_p
 		}
 	}
 	out_cloud_ptr->points.clear();
-	pcl::ExtractIndices<pcl::PointXYZ> extract;
+	pcl::ExtractIndices<pcl::PointXYZI> extract;
 	extract.setInputCloud (in_cloud_ptr);
 	extract.setIndices(far_indices);
 	extract.setNegative(true);//true removes the indices, false leaves only the indices
 	extract.filter(*out_cloud_ptr);
 }
 
-void SpaceFilter::ClipCloud(const pcl::PointCloud<pcl::PointXYZ>::Ptr in_cloud_ptr,
-		pcl::PointCloud<pcl::PointXYZ>::Ptr out_cloud_ptr,
+void SpaceFilter::ClipCloud(const pcl::PointCloud<pcl::PointXYZI>::ConstPtr in_cloud_ptr,
+		pcl::PointCloud<pcl::PointXYZI>::Ptr out_cloud_ptr,
 		float in_min_height,
 		float in_max_height)
 {
@@ -106,49 +72,34 @@ void SpaceFilter::ClipCloud(const pcl::PointCloud<pcl::PointXYZ>::Ptr in_cloud_p
 	}
 }
 
-void SpaceFilter::VelodyneCallback(const sensor_msgs::PointCloud2::Ptr& in_sensor_cloud_ptr)
+void SpaceFilter::VelodyneCallback(const pcl::PointCloud<pcl::PointXYZI>::ConstPtr& in_sensor_cloud_ptr)
 {
-	pcl::PointCloud<pcl::PointXYZ>::Ptr current_sensor_cloud_ptr (new pcl::PointCloud<pcl::PointXYZ>);
-	pcl::PointCloud<pcl::PointXYZ>::Ptr inlanes_cloud_ptr (new pcl::PointCloud<pcl::PointXYZ>);
-	pcl::PointCloud<pcl::PointXYZ>::Ptr clipped_cloud_ptr (new pcl::PointCloud<pcl::PointXYZ>);
-
-	pcl::fromROSMsg(*in_sensor_cloud_ptr, *current_sensor_cloud_ptr);
+	pcl::PointCloud<pcl::PointXYZI>::ConstPtr current_sensor_cloud_ptr = in_sensor_cloud_ptr;
 
 	if (lateral_removal_)
 	{
+		pcl::PointCloud<pcl::PointXYZI>::Ptr inlanes_cloud_ptr (new pcl::PointCloud<pcl::PointXYZI>);
 		KeepLanes(current_sensor_cloud_ptr, inlanes_cloud_ptr, left_distance_, right_distance_);
-	}
-	else
-	{
-		inlanes_cloud_ptr = current_sensor_cloud_ptr;
+		current_sensor_cloud_ptr = inlanes_cloud_ptr;
 	}
 	if (vertical_removal_)
 	{
-		ClipCloud(inlanes_cloud_ptr, clipped_cloud_ptr, below_distance_, above_distance_);
+		pcl::PointCloud<pcl::PointXYZI>::Ptr clipped_cloud_ptr (new pcl::PointCloud<pcl::PointXYZI>);
+		ClipCloud(current_sensor_cloud_ptr, clipped_cloud_ptr, below_distance_, above_distance_);
+		clipped_cloud_ptr->header = in_sensor_cloud_ptr->header;
+		current_sensor_cloud_ptr = clipped_cloud_ptr;
 	}
-	else
-	{
-		clipped_cloud_ptr = inlanes_cloud_ptr;
-	}
-
-	sensor_msgs::PointCloud2 cloud_msg;
 
-	pcl::toROSMsg(*clipped_cloud_ptr, cloud_msg);
-
-	cloud_msg.header=in_sensor_cloud_ptr->header;
-	cloud_pub_.publish(cloud_msg);
+	// with both removals disabled the input cloud is forwarded untouched
+	cloud_pub_.publish(current_sensor_cloud_ptr);
 }
 
-int main(int argc, char **argv)
+void SpaceFilter::Run()
 {
+	ros::NodeHandle node_handle;
+	ros::NodeHandle private_node_handle("~");
 
-	ros::init(argc, argv, "space_filter");
-	SpaceFilter node;
-	ros::spin();
+	Init(node_handle, private_node_handle);
 
-	return 0;
+	ros::spin();
 }
-
-
-
-
@@ -0,0 +1,13 @@
+#include <ros/ros.h>
+#include "space_filter.h"
+
+
+int main(int argc, char **argv)
+{
+	ros::init(argc, argv, "space_filter");
+	SpaceFilter node;
+
+	node.Run();
+
+	return 0;
+}
@@ -1,9 +1,12 @@
 
 #include <cmath>
+#include <cstdlib>
+#include <vector>
 
 #include <ros/ros.h>
 
 #include "ray_ground_filter.h"
+#include "ray_ground_classifier.h"
 
 // test fixtures are necessary to use friend classes
 TEST(RayGroundFilter, clipCloud)
@@ -53,3 +56,98 @@ TEST(RayGroundFilter, clipCloud)
   ASSERT_LT(fabsf(out_cloud_ptr->points[3].y - 6.0F), TOL);
   ASSERT_LT(fabsf(out_cloud_ptr->points[3].z - 1.5F), TOL);
 }
+
+// ray rule as it was written inline in RayGroundFilter::ClassifyPointCloud, the points are sorted by radius
+static std::vector<bool> classify_ray_reference(const std::vector<float>& radius, const std::vector<float>& height,
+                                                float sensor_height, float general_max_slope, float local_max_slope,
+                                                float concentric_divider_distance, float min_height_threshold,
+                                                float reclass_distance_threshold)
+{
+  std::vector<bool> ground;
+  float prev_radius = 0.f;
+  float prev_height = - sensor_height;
+  bool prev_ground = false;
+  bool current_ground = false;
+  for (size_t j = 0; j < radius.size(); j++)
+  {
+    float points_distance = radius[j] - prev_radius;
+    float height_threshold = tan(DEG2RAD(local_max_slope)) * points_distance;
+    float current_height = height[j];
+    float general_height_threshold = tan(DEG2RAD(general_max_slope)) * radius[j];
+
+    if (points_distance > concentric_divider_distance && height_threshold < min_height_threshold)
+    { height_threshold = min_height_threshold; }
+
+    if (current_height <= (prev_height + height_threshold)
+        && current_height >= (prev_height - height_threshold))
+    {
+      if (!prev_ground)
+      {
+        current_ground = (current_height <= (-sensor_height + general_height_threshold)
+                          && current_height >= (-sensor_height - general_height_threshold));
+      }
+      else
+      {
+        current_ground = true;
+      }
+    }
+    else
+    {
+      current_ground = (points_distance > reclass_distance_threshold &&
+                        (current_height <= (-sensor_height + height_threshold)
+                         && current_height >= (-sensor_height - height_threshold)));
+    }
+
+    ground.push_back(current_ground);
+    prev_ground = current_ground;
+    prev_radius = radius[j];
+    prev_height = current_height;
+  }
+  return ground;
+}
+
+TEST(RayGroundClassifier, matchesRayGroundFilterRule)
+{
+  RayGroundClassifier classifier;
+  classifier.sensor_height = 1.7;
+  classifier.general_max_slope = 3.0;
+  classifier.local_max_slope = 5.0;
+  classifier.concentric_divider_distance = 0.01;
+  classifier.min_height_threshold = 0.05;
+  classifier.reclass_distance_threshold = 0.2;
+
+  // rays over flat ground with a curb, an obstacle, close points and a gap that triggers the reclassification
+  std::vector<float> radius, height;
+  srand(7);
+  float r = 1.9F;
+  for (int i = 0; i < 400; i++)
+  {
+    r += (i % 50 == 49) ? 1.0F : 0.005F * (rand() % 40);
+    float z = -1.7F + 0.02F * ((rand() % 11) - 5);
+    if (i >= 120 && i < 140)
+      z = -1.5F;  // curb
+    if (i >= 200 && i < 230)
+      z = -1.7F + 0.05F * (i - 200);  // obstacle
+    radius.push_back(r);
+    height.push_back(z);
+  }
+
+  std::vector<bool> expected = classify_ray_reference(radius, height,
+      classifier.sensor_height, classifier.general_max_slope, classifier.local_max_slope,
+      classifier.concentric_divider_distance, classifier.min_height_threshold,
+      classifier.reclass_distance_threshold);
+
+  RayGroundClassifier::Ray ray;
+  classifier.Reset(ray);
+  size_t ground_points = 0;
+  for (size_t j = 0; j < radius.size(); j++)
+  {
+    bool ground = classifier.IsGround(ray, radius[j], height[j]);
+    ASSERT_EQ(ground, expected[j]) << "point " << j;
+    if (ground)
+      ground_points++;
+  }
+  // both labels have to show up for the comparison to mean anything
+  ASSERT_GT(ground_points, 0);
+  ASSERT_LT(ground_points, radius.size());
+}
@@ -19,12 +19,21 @@
 // ###############################################################################################
 // ###############################################################################################
 
+#include <condition_variable>
 #include <iostream>
 #include <fstream>
 #include <limits>
+#include <map>
+#include <mutex>
 #include <sstream>
 #include <string>
+#include <thread>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
 #include <ros/ros.h>
+#include <ros/callback_queue.h>
 #include <boost/algorithm/string.hpp>
 #include <boost/lexical_cast.hpp>
 //#include <boost/locale.hpp>
@@ -48,6 +57,7 @@
 #include <tf/LinearMath/Transform.h>
 #include <tf/transform_broadcaster.h>
 #include <tf/transform_listener.h>
+#include <topic_tools/shape_shifter.h>
 #include <time.h>
 
 /// EXTRA messages, not from KITTI
@@ -78,52 +88,92 @@ struct kitti_player_options
     bool    stereoDisp;       // use precalculated stereoDisparities
     bool    viewDisparities;  // view use precalculated stereoDisparities
     unsigned int startFrame;  // start the replay at frame ...
+    unsigned int prefetch;    // frames read ahead on a background thread, 0 reads them in the main loop
+    bool    fast;             // ignore frequency and publish as fast as frames are read
+    string  syncTopic;        // after each frame wait for one message on this topic
+    float   syncTimeout;      // seconds to wait on syncTopic, 0 waits forever
 
     /// Extra parameters
     bool    laneDetections;   // send laneDetections;
 };
 
 /**
- * @brief publish_velodyne
- * @param pub The ROS publisher as reference
- * @param infile file with data to publish
- * @param header Header to use to publish the message
+ * @brief read_velodyne
+ * @param infile .bin file with x,y,z,reflectance floats per point
+ * @param points output cloud, resized to the number of points in the file
  * @return 1 if file is correctly readed, 0 otherwise
+ *
+ * The file is memory mapped and copied once into the cloud.
  */
-int publish_velodyne(ros::Publisher &pub, string infile, std_msgs::Header *header)
+int read_velodyne(const string &infile, pcl::PointCloud<pcl::PointXYZI> &points)
 {
-    fstream input(infile.c_str(), ios::in | ios::binary);
-    if(!input.good())
+    int fd = open(infile.c_str(), O_RDONLY);
+    if (fd < 0)
     {
         ROS_ERROR_STREAM ( "Could not read file: " << infile );
         return 0;
     }
-    else
-    {
-        ROS_DEBUG_STREAM ("reading " << infile);
-        input.seekg(0, ios::beg);
 
-        pcl::PointCloud<pcl::PointXYZI>::Ptr points (new pcl::PointCloud<pcl::PointXYZI>);
+    struct stat st;
+    if (fstat(fd, &st) < 0)
+    {
+        ROS_ERROR_STREAM ( "Could not read file: " << infile );
+        close(fd);
+        return 0;
+    }
 
-        int i;
-        for (i=0; input.good() && !input.eof(); i++) {
-            pcl::PointXYZI point;
-            input.read((char *) &point.x, 3*sizeof(float));
-            input.read((char *) &point.intensity, sizeof(float));
-            points->push_back(point);
-        }
-        input.close();
+    ROS_DEBUG_STREAM ("reading " << infile);
 
-        //workaround for the PCL headers... http://wiki.ros.org/hydro/Migration#PCL
-        sensor_msgs::PointCloud2 pc2;
+    const size_t num_points = st.st_size / (4*sizeof(float));
+    points.clear();
+    if (num_points == 0)
+    {
+        close(fd);
+        return 1;
+    }
 
-        pc2.header.frame_id= "velodyne"; //ros::this_node::getName();
-        pc2.header.stamp=header->stamp;
-        points->header = pcl_conversions::toPCL(pc2.header);
-        pub.publish(points);
+    void *data = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (data == MAP_FAILED)
+    {
+        ROS_ERROR_STREAM ( "Could not map file: " << infile );
+        return 0;
+    }
+    madvise(data, st.st_size, MADV_SEQUENTIAL);
 
-        return 1;
+    points.resize(num_points);
+    const float *src = static_cast<const float *>(data);
+    for (size_t i = 0; i < num_points; i++, src += 4)
+    {
+        pcl::PointXYZI &point = points.points[i];
+        point.x         = src[0];
+        point.y         = src[1];
+        point.z         = src[2];
+        point.intensity = src[3];
     }
+    points.width    = num_points;
+    points.height   = 1;
+    points.is_dense = true;
+
+    munmap(data, st.st_size);
+    return 1;
+}
+
+/**
+ * @brief publish_velodyne
+ * @param pub The ROS publisher as reference
+ * @param points cloud to publish (frame and stamp are set here)
+ * @param header Header to use to publish the message
+ */
+void publish_velodyne(ros::Publisher &pub, pcl::PointCloud<pcl::PointXYZI>::Ptr points, std_msgs::Header *header)
+{
+    //workaround for the PCL headers... http://wiki.ros.org/hydro/Migration#PCL
+    sensor_msgs::PointCloud2 pc2;
+
+    pc2.header.frame_id= "velodyne"; //ros::this_node::getName();
+    pc2.header.stamp=header->stamp;
+    points->header = pcl_conversions::toPCL(pc2.header);
+    pub.publish(points);
 }
 
 /**
@@ -456,6 +506,236 @@ int getLaneDetection(string infile, road_layout_estimation::msg_lines *msg_lines
 }
 */
 
+/**
+ * @brief load_timestamps
+ * @param filename timestamps.txt of a sensor
+ * @param lines one timestamp per frame
+ * @return 1 if file is correctly readed, 0 otherwise
+ *
+ * Read once at startup instead of seeking the file for every frame.
+ */
+int load_timestamps(const string &filename, vector<string> &lines)
+{
+    ifstream timestamps(filename.c_str());
+    if (!timestamps.is_open())
+    {
+        ROS_ERROR_STREAM("Fail to open " << filename);
+        return 0;
+    }
+
+    lines.clear();
+    string line;
+    while (getline(timestamps, line))
+        lines.push_back(line);
+    return 1;
+}
+
+/**
+ * @brief timestamp_at
+ * @param lines timestamps loaded by load_timestamps
+ * @param frame frame number
+ * @param header output, stamp of the frame
+ * @return 1 if the frame has a timestamp, 0 otherwise
+ */
+int timestamp_at(const vector<string> &lines, unsigned int frame, std_msgs::Header *header)
+{
+    if (frame >= lines.size())
+    {
+        ROS_ERROR_STREAM("No timestamp for frame " << frame);
+        return 0;
+    }
+    header->stamp = parseTime(lines[frame]).stamp;
+    return 1;
+}
+
+/// Directories of the data loaded for every frame
+struct kitti_frame_dirs
+{
+    string image00;
+    string image01;
+    string image02;
+    string image03;
+    string image04;   // disparities
+    string oxts;
+    string velodyne_points;
+};
+
+/// Everything read from disk for one frame, stamps are set when it is published
+struct kitti_frame
+{
+    unsigned int index;
+    cv::Mat image00;
+    cv::Mat image01;
+    cv::Mat image02;
+    cv::Mat image03;
+    cv::Mat image04;
+    pcl::PointCloud<pcl::PointXYZI>::Ptr velodyne;   // NULL if the file could not be read
+    bool gps_ok;
+    bool imu_ok;
+    sensor_msgs::NavSatFix gps;
+    sensor_msgs::Imu imu;
+};
+
+/**
+ * @brief load_frame read all the enabled data of one frame
+ */
+void load_frame(const kitti_player_options &options, const kitti_frame_dirs &dirs, unsigned int index, kitti_frame *frame)
+{
+    const string name = boost::str(boost::format("%010d") % index );
+    std_msgs::Header header;
+
+    frame->index = index;
+
+    if(options.stereoDisp)
+        frame->image04 = cv::imread(dirs.image04 + name + ".png", CV_LOAD_IMAGE_GRAYSCALE);
+
+    if(options.color || options.all_data)
+    {
+        frame->image02 = cv::imread(dirs.image02 + name + ".png", CV_LOAD_IMAGE_UNCHANGED);
+        frame->image03 = cv::imread(dirs.image03 + name + ".png", CV_LOAD_IMAGE_UNCHANGED);
+    }
+
+    if(options.grayscale || options.all_data)
+    {
+        frame->image00 = cv::imread(dirs.image00 + name + ".png", CV_LOAD_IMAGE_UNCHANGED);
+        frame->image01 = cv::imread(dirs.image01 + name + ".png", CV_LOAD_IMAGE_UNCHANGED);
+    }
+
+    if(options.velodyne || options.all_data)
+    {
+        frame->velodyne.reset(new pcl::PointCloud<pcl::PointXYZI>);
+        if (!read_velodyne(dirs.velodyne_points + name + ".bin", *frame->velodyne))
+            frame->velodyne.reset();
+    }
+
+    frame->gps_ok = frame->imu_ok = false;
+    if(options.gps || options.all_data)
+        frame->gps_ok = getGPS(dirs.oxts + name + ".txt", &frame->gps, &header);
+    if(options.imu || options.all_data)
+        frame->imu_ok = getIMU(dirs.oxts + name + ".txt", &frame->imu, &header);
+}
+
+/**
+ * @brief The FramePrefetcher class loads the next frames on a background thread
+ *
+ * At most depth frames are kept in memory, the thread waits for the player to
+ * take one before reading further.
+ */
+class FramePrefetcher
+{
+public:
+    FramePrefetcher(const kitti_player_options &options, const kitti_frame_dirs &dirs,
+                    unsigned int first, unsigned int end, unsigned int depth)
+        : options_(options), dirs_(dirs), next_(first), end_(end), depth_(depth), stop_(false)
+    {
+        thread_ = std::thread(&FramePrefetcher::run, this);
+    }
+
+    ~FramePrefetcher()
+    {
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            stop_ = true;
+        }
+        cond_.notify_all();
+        thread_.join();
+    }
+
+    /// waits until frame index is loaded and moves it to frame
+    void get(unsigned int index, kitti_frame *frame)
+    {
+        if (index >= end_)
+        {
+            load_frame(options_, dirs_, index, frame);
+            return;
+        }
+
+        std::unique_lock<std::mutex> lock(mutex_);
+        cond_.wait(lock, [this, index] { return frames_.count(index) > 0; });
+        *frame = std::move(frames_[index]);
+        frames_.erase(index);
+        lock.unlock();
+        cond_.notify_all();
+    }
+
+private:
+    void run()
+    {
+        while (true)
+        {
+            unsigned int index;
+            {
+                std::unique_lock<std::mutex> lock(mutex_);
+                cond_.wait(lock, [this] { return stop_ || frames_.size() < depth_; });
+                if (stop_ || next_ >= end_)
+                    return;
+                index = next_++;
+            }
+
+            kitti_frame frame;
+            load_frame(options_, dirs_, index, &frame);
+
+            {
+                std::lock_guard<std::mutex> lock(mutex_);
+                frames_[index] = std::move(frame);
+            }
+            cond_.notify_all();
+        }
+    }
+
+    const kitti_player_options &options_;
+    const kitti_frame_dirs &dirs_;
+    unsigned int next_;
+    const unsigned int end_;
+    const unsigned int depth_;
+    bool stop_;
+    std::map<unsigned int, kitti_frame> frames_;
+    std::mutex mutex_;
+    std::condition_variable cond_;
+    std::thread thread_;
+};
+
+/**
+ * @brief The ConsumerSync class paces the player on the output of a consumer
+ *
+ * After a frame is published the player waits for one message (of any type)
+ * on the sync topic, so the dataset is played as fast as the consumer allows.
+ */
+class ConsumerSync
+{
+public:
+    ConsumerSync(ros::NodeHandle &node, const string &topic, double timeout)
+        : received_(0), timeout_(timeout)
+    {
+        sub_ = node.subscribe(topic, 10, &ConsumerSync::callback, this);
+    }
+
+    /// returns false on timeout
+    bool wait(unsigned long seen)
+    {
+        ros::WallTime start = ros::WallTime::now();
+        while (received_ <= seen && ros::ok())
+        {
+            ros::getGlobalCallbackQueue()->callAvailable(ros::WallDuration(0.005));
+            if (timeout_ > 0 && (ros::WallTime::now() - start).toSec() > timeout_)
+                return false;
+        }
+        return true;
+    }
+
+    unsigned long received() const { return received_; }
+
+private:
+    void callback(const topic_tools::ShapeShifter::ConstPtr &)
+    {
+        received_++;
+    }
+
+    ros::Subscriber sub_;
+    unsigned long received_;
+    double timeout_;
+};
+
 /**
  * @brief main Kitti_player, a player for KITTI raw datasets
  * @param argc
@@ -478,6 +758,10 @@ int getLaneDetection(string infile, road_layout_estimation::msg_lines *msg_lines
  *   -D [ --viewDisp   ] [=arg(=1)] (=0) view loaded disparity images
  *   -l [ --laneDetect ] [=arg(=1)] (=0) send extra lanes message
  *   -F [ --frame      ] [=arg(=0)] (=0) start playing at frame ...
+ *   -p [ --prefetch   ] arg (=4)        frames read ahead, 0 reads them synchronously
+ *   -x [ --fast       ] [=arg(=1)] (=0) ignore frequency, play as fast as possible
+ *   -S [ --syncTopic  ] arg             wait for a message on this topic after each frame
+ *   -t [ --syncTimeout] arg (=1)        seconds to wait on syncTopic, 0 waits forever
  *
  * Datasets can be downloaded from: http://www.cvlibs.net/datasets/kitti/raw_data.php
  */
@@ -503,6 +787,10 @@ int main(int argc, char **argv)
         ("viewDisp  ,D ", po::value<bool>         (&options.viewDisparities)->default_value(0) ->implicit_value(1)   ,  "view loaded disparity images")
         ("laneDetect,l",  po::value<bool>         (&options.laneDetections) ->default_value(0) ->implicit_value(1)   ,  "send extra lanes message")
         ("frame     ,F",  po::value<unsigned int> (&options.startFrame)     ->default_value(0) ->implicit_value(0)   ,  "start playing at frame...")
+        ("prefetch  ,p",  po::value<unsigned int> (&options.prefetch)       ->default_value(4)                       ,  "frames read ahead, 0 reads them synchronously")
+        ("fast      ,x",  po::value<bool>         (&options.fast)           ->default_value(0) ->implicit_value(1)   ,  "ignore Frequency, play as fast as possible")
+        ("syncTopic ,S",  po::value<string>       (&options.syncTopic)      ->default_value("")                      ,  "wait for a message on this topic after each frame")
+        ("syncTimeout,t", po::value<float>        (&options.syncTimeout)    ->default_value(1.0)                     ,  "seconds to wait on syncTopic, 0 waits forever")
     ;
 
     try // parse options
@@ -966,22 +1254,63 @@ int main(int argc, char **argv)
         ros_cameraInfoMsg_camera01.width  = ros_cameraInfoMsg_camera00.width  = cv_image00.cols;// -1;
     }
 
+    kitti_frame_dirs frame_dirs;
+    frame_dirs.image00         = dir_image00;
+    frame_dirs.image01         = dir_image01;
+    frame_dirs.image02         = dir_image02;
+    frame_dirs.image03         = dir_image03;
+    frame_dirs.image04         = dir_image04;
+    frame_dirs.oxts            = dir_oxts;
+    frame_dirs.velodyne_points = dir_velodyne_points;
+
+    // timestamps are read once, not seeked for every frame
+    vector<string> timestamps_image02, timestamps_image03, timestamps_velodyne, timestamps_oxts;
+    if (options.timestamps)
+    {
+        if (((options.color || options.grayscale || options.all_data) && !load_timestamps(dir_timestamp_image02 + "timestamps.txt", timestamps_image02)) ||
+            ((options.color || options.all_data)                      && !load_timestamps(dir_timestamp_image03 + "timestamps.txt", timestamps_image03)) ||
+            ((options.velodyne || options.all_data)                   && !load_timestamps(dir_timestamp_velodyne + "timestamps.txt", timestamps_velodyne)) ||
+            ((options.gps || options.imu || options.all_data)         && !load_timestamps(dir_timestamp_oxts + "timestamps.txt", timestamps_oxts)))
+        {
+            node.shutdown();
+            return -1;
+        }
+    }
+
+    boost::shared_ptr<FramePrefetcher> prefetcher;
+    if (options.prefetch > 0)
+        prefetcher.reset(new FramePrefetcher(options, frame_dirs, entries_played, total_entries, options.prefetch));
+
+    boost::shared_ptr<ConsumerSync> consumer_sync;
+    if (!options.syncTopic.empty())
+    {
+        ROS_INFO_STREAM("Waiting for " << options.syncTopic << " after each frame");
+        consumer_sync.reset(new ConsumerSync(node, options.syncTopic, options.syncTimeout));
+    }
+
     boost::progress_display progress(total_entries) ;
     double cv_min, cv_max=0.0f;
+    kitti_frame frame;
 
     // This is the main KITTI_PLAYER Loop
     do
     {
+        // frame data, already loaded when prefetching
+        if (prefetcher)
+            prefetcher->get(entries_played, &frame);
+        else
+            load_frame(options, frame_dirs, entries_played, &frame);
+
         // single timestamp for all published stuff
         Time current_timestamp=ros::Time::now();
+        unsigned long consumer_messages = (consumer_sync) ? consumer_sync->received() : 0;
 
         if(options.stereoDisp)
         {
             // Allocate new disparity image message
             stereo_msgs::DisparityImagePtr disp_msg = boost::make_shared<stereo_msgs::DisparityImage>();
 
-            full_filename_image04 = dir_image04 + boost::str(boost::format("%010d") % entries_played ) + ".png";
-            cv_image04 = cv::imread(full_filename_image04, CV_LOAD_IMAGE_GRAYSCALE);
+            cv_image04 = frame.image04;
 
             cv::minMaxLoc(cv_image04,&cv_min,&cv_max);
 
@@ -1040,8 +1369,8 @@ int main(int argc, char **argv)
             full_filename_image03 = dir_image03 + boost::str(boost::format("%010d") % entries_played ) + ".png";
             ROS_DEBUG_STREAM ( full_filename_image02 << endl << full_filename_image03 << endl << endl);
 
-            cv_image02 = cv::imread(full_filename_image02, CV_LOAD_IMAGE_UNCHANGED);
-            cv_image03 = cv::imread(full_filename_image03, CV_LOAD_IMAGE_UNCHANGED);
+            cv_image02 = frame.image02;
+            cv_image03 = frame.image03;
 
             if ( (cv_image02.data == NULL) || (cv_image03.data == NULL) ){
                 ROS_ERROR_STREAM("Error reading color images (02 & 03)");
@@ -1068,20 +1397,11 @@ int main(int argc, char **argv)
             }
             else
             {
-
-                str_support = dir_timestamp_image02 + "timestamps.txt";
-                ifstream timestamps(str_support.c_str());
-                if (!timestamps.is_open())
+                if (!timestamp_at(timestamps_image02, entries_played, &cv_bridge_img.header))
                 {
-                    string timestamps_string;
-                    timestamps >> timestamps_string;
-                    ROS_ERROR_STREAM("Fail to open " << timestamps_string);
                     node.shutdown();
                     return -1;
                 }
-                timestamps.seekg(30*entries_played);
-                getline(timestamps,str_support);
-                cv_bridge_img.header.stamp = parseTime(str_support).stamp;
                 ros_msg02.header.stamp = ros_cameraInfoMsg_camera02.header.stamp = cv_bridge_img.header.stamp;
             }
             cv_bridge_img.image = cv_image02;
@@ -1094,20 +1414,11 @@ int main(int argc, char **argv)
             }
             else
             {
-
-                str_support = dir_timestamp_image03 + "timestamps.txt";
-                ifstream timestamps(str_support.c_str());
-                if (!timestamps.is_open())
+                if (!timestamp_at(timestamps_image03, entries_played, &cv_bridge_img.header))
                 {
-                    string timestamps_string;
-                    timestamps >> timestamps_string;
-                    ROS_ERROR_STREAM("Fail to open " << timestamps_string);
                     node.shutdown();
                     return -1;
                 }
-                timestamps.seekg(30*entries_played);
-                getline(timestamps,str_support);
-                cv_bridge_img.header.stamp = parseTime(str_support).stamp;
                 ros_msg03.header.stamp = ros_cameraInfoMsg_camera03.header.stamp = cv_bridge_img.header.stamp;
             }
 
@@ -1125,8 +1436,8 @@ int main(int argc, char **argv)
             full_filename_image01 = dir_image01 + boost::str(boost::format("%010d") % entries_played ) + ".png";
             ROS_DEBUG_STREAM ( full_filename_image00 << endl << full_filename_image01 << endl << endl);
 
-            cv_image00 = cv::imread(full_filename_image00, CV_LOAD_IMAGE_UNCHANGED);
-            cv_image01 = cv::imread(full_filename_image01, CV_LOAD_IMAGE_UNCHANGED);
+            cv_image00 = frame.image00;
+            cv_image01 = frame.image01;
 
             if ( (cv_image00.data == NULL) || (cv_image01.data == NULL) ){
                 ROS_ERROR_STREAM("Error reading color images (00 & 01)");
@@ -1153,20 +1464,11 @@ int main(int argc, char **argv)
             }
             else
             {
-
-                str_support = dir_timestamp_image02 + "timestamps.txt";
-                ifstream timestamps(str_support.c_str());
-                if (!timestamps.is_open())
+                if (!timestamp_at(timestamps_image02, entries_played, &cv_bridge_img.header))
                 {
-                    string timestamps_string;
-                    timestamps >> timestamps_string;
-                    ROS_ERROR_STREAM("Fail to open " << timestamps_string);
                     node.shutdown();
                     return -1;
                 }
-                timestamps.seekg(30*entries_played);
-                getline(timestamps,str_support);
-                cv_bridge_img.header.stamp = parseTime(str_support).stamp;
                 ros_msg00.header.stamp = ros_cameraInfoMsg_camera00.header.stamp = cv_bridge_img.header.stamp;
             }
             cv_bridge_img.image = cv_image00;
@@ -1179,20 +1481,11 @@ int main(int argc, char **argv)
             }
             else
             {
-
-                str_support = dir_timestamp_image02 + "timestamps.txt";
-                ifstream timestamps(str_support.c_str());
-                if (!timestamps.is_open())
+                if (!timestamp_at(timestamps_image02, entries_played, &cv_bridge_img.header))
                 {
-                    string timestamps_string;
-                    timestamps >> timestamps_string;
-                    ROS_ERROR_STREAM("Fail to open " << timestamps_string);
                     node.shutdown();
                     return -1;
                 }
-                timestamps.seekg(30*entries_played);
-                getline(timestamps,str_support);
-                cv_bridge_img.header.stamp = parseTime(str_support).stamp;
                 ros_msg01.header.stamp = ros_cameraInfoMsg_camera01.header.stamp = cv_bridge_img.header.stamp;
             }
             cv_bridge_img.image = cv_image01;
@@ -1208,51 +1501,32 @@ int main(int argc, char **argv)
             header_support.stamp = current_timestamp;
             full_filename_velodyne = dir_velodyne_points + boost::str(boost::format("%010d") % entries_played ) + ".bin";
 
-            if (!options.timestamps)
-                publish_velodyne(map_pub, full_filename_velodyne,&header_support);
-            else
+            if (options.timestamps && !timestamp_at(timestamps_velodyne, entries_played, &header_support))
             {
-                str_support = dir_timestamp_velodyne + "timestamps.txt";
-                ifstream timestamps(str_support.c_str());
-                if (!timestamps.is_open())
-                {
-                    string timestamps_string;
-                    timestamps >> timestamps_string;
-                    ROS_ERROR_STREAM("Fail to open " << timestamps_string);
-                    node.shutdown();
-                    return -1;
-                }
-                timestamps.seekg(30*entries_played);
-                getline(timestamps,str_support);
-                header_support.stamp = parseTime(str_support).stamp;
-                publish_velodyne(map_pub, full_filename_velodyne,&header_support);
+                node.shutdown();
+                return -1;
             }
 
+            // read errors were reported while loading the frame
+            if (frame.velodyne)
+                publish_velodyne(map_pub, frame.velodyne, &header_support);
+
 
         }
 
         if(options.gps || options.all_data)
         {
             header_support.stamp = current_timestamp; //ros::Time::now();
-            if (options.timestamps)
+            if (options.timestamps && !timestamp_at(timestamps_oxts, entries_played, &header_support))
             {
-                str_support = dir_timestamp_oxts + "timestamps.txt";
-                ifstream timestamps(str_support.c_str());
-                if (!timestamps.is_open())
-                {
-                    string timestamps_string;
-                    timestamps >> timestamps_string;
-                    ROS_ERROR_STREAM("Fail to open " << timestamps_string);
-                    node.shutdown();
-                    return -1;
-                }
-                timestamps.seekg(30*entries_played);
-                getline(timestamps,str_support);
-                header_support.stamp = parseTime(str_support).stamp;
+                node.shutdown();
+                return -1;
             }
 
             full_filename_oxts = dir_oxts + boost::str(boost::format("%010d") % entries_played ) + ".txt";
-            if (!getGPS(full_filename_oxts,&ros_msgGpsFix,&header_support))
+            ros_msgGpsFix = frame.gps;
+            ros_msgGpsFix.header.stamp = header_support.stamp;
+            if (!frame.gps_ok)
             {
                 ROS_ERROR_STREAM("Fail to open " << full_filename_oxts);
                 node.shutdown();
@@ -1275,26 +1549,17 @@ int main(int argc, char **argv)
         if(options.imu || options.all_data)
         {
             header_support.stamp = current_timestamp; //ros::Time::now();
-            if (options.timestamps)
+            if (options.timestamps && !timestamp_at(timestamps_oxts, entries_played, &header_support))
             {
-                str_support = dir_timestamp_oxts + "timestamps.txt";
-                ifstream timestamps(str_support.c_str());
-                if (!timestamps.is_open())
-                {
-                    string timestamps_string;
-                    timestamps >> timestamps_string;
-                     ROS_ERROR_STREAM("Fail to open " << timestamps_string);
-                    node.shutdown();
-                    return -1;
-                }
-                timestamps.seekg(30*entries_played);
-                getline(timestamps,str_support);
-                header_support.stamp = parseTime(str_support).stamp;
+                node.shutdown();
+                return -1;
             }
 
 
             full_filename_oxts = dir_oxts + boost::str(boost::format("%010d") % entries_played ) + ".txt";
-            if (!getIMU(full_filename_oxts,&ros_msgImu,&header_support))
+            ros_msgImu = frame.imu;
+            ros_msgImu.header.stamp = header_support.stamp;
+            if (!frame.imu_ok)
             {
                 ROS_ERROR_STREAM("Fail to open " << full_filename_oxts);
                 node.shutdown();
@@ -1304,9 +1569,13 @@ int main(int argc, char **argv)
 
         }
 
+        if (consumer_sync && !consumer_sync->wait(consumer_messages))
+            ROS_WARN_STREAM("No message on " << options.syncTopic << " for frame " << entries_played);
+
         ++progress;
         entries_played++;
-        loop_rate.sleep();
+        if (!options.fast && !consumer_sync)
+            loop_rate.sleep();
     }
     while(entries_played<=total_entries-1 && ros::ok());
 